@@ -53,6 +53,7 @@ check_type_size( intptr_t    INTPTR_T    )
 set( HAVE_ANN       ${ANN_FOUND}        )
 set( HAVE_EXPAT     ${EXPAT_FOUND}      )
 set( HAVE_LIBGD     ${GD_FOUND}         )
+set( HAVE_PTHREAD   ${CMAKE_USE_PTHREADS_INIT} )
 set( HAVE_ZLIB      ${ZLIB_FOUND}       )
 
 if (LTDL_FOUND)
@@ -11,6 +11,7 @@
  * Contributors: See CVS logs. Details at http://www.graphviz.org/
  *************************************************************************/
 
+#include	<stdio.h>
 #include	<cghdr.h>
 
 /*
@@ -184,7 +185,7 @@ static Agrec_t *agmakeattrs(Agraph_t * context, void *obj)
     Agsym_t *sym;
     Dict_t *datadict;
 
-    rec = agbindrec(obj, AgDataRecName, sizeof(Agattr_t), FALSE);
+    rec = agbindrec(obj, AgDataRecName, sizeof(Agattrx_t), FALSE);
     datadict = agdictof(context, AGTYPE(obj));
     assert(datadict);
     if (rec->dict == NIL(Dict_t *)) {
@@ -214,6 +215,8 @@ static void freeattr(Agobj_t * obj, Agattr_t * attr)
     for (i = 0; i < sz; i++)
 	agstrfree(g, attr->str[i]);
     agfree(g, attr->str);
+    if (((Agattrx_t *) attr)->val)
+	agfree(g, ((Agattrx_t *) attr)->val);
 }
 
 static void freesym(Dict_t * d, void * obj, Dtdisc_t * disc)
@@ -452,6 +455,126 @@ char *agxget(void *obj, Agsym_t * sym)
     return rv;
 }
 
+/* Parsed forms of attribute values.
+ * Layouts read the same numeric attributes many times, so the result of
+ * each kind of parse is kept in the object's attribute record. An entry
+ * remembers the string it was parsed from; agxset clears it, and any
+ * other change of the string is caught by comparing the pointers.
+ * Reading a value may fill its entry, so, like agxset, the readers below
+ * are not safe to call on one graph from several threads at once.
+ */
+#define AGVAL_DBL	1
+#define AGVAL_INT	2
+#define AGVAL_PT	4
+
+static Agattrval_t *attrval(void *obj, Agsym_t * sym)
+{
+    Agattrx_t *data;
+    Agattrval_t *av;
+    Agraph_t *g;
+    int sz;
+
+    data = (Agattrx_t *) agattrrec((Agobj_t *) obj);
+    assert((sym->id >= 0) && (sym->id < topdictsize(obj)));
+    if (sym->id >= data->nval) {
+	g = agraphof(obj);
+	sz = topdictsize(obj);
+	if (data->val)
+	    data->val = (Agattrval_t *) AGDISC(g, mem)->resize(AGCLOS(g, mem),
+						     data->val,
+						     data->nval *
+						     sizeof(Agattrval_t),
+						     sz * sizeof(Agattrval_t));
+	else
+	    data->val = agalloc(g, sz * sizeof(Agattrval_t));
+	data->nval = sz;
+    }
+    av = &data->val[sym->id];
+    if (av->str != data->attr.str[sym->id]) {
+	av->str = data->attr.str[sym->id];
+	av->flags = 0;
+    }
+    return av;
+}
+
+/* agxgetdouble:
+ * If the value of sym on obj begins with a number, as read by strtod,
+ * store it in v and return 1. Otherwise, return 0.
+ */
+int agxgetdouble(void *obj, Agsym_t * sym, double *v)
+{
+    Agattrval_t *av;
+    char *endp;
+
+    av = attrval(obj, sym);
+    if (!(av->flags & AGVAL_DBL)) {
+	av->dok = 0;
+	if (av->str) {
+	    av->dval = strtod(av->str, &endp);
+	    av->dok = (endp != av->str);
+	}
+	av->flags |= AGVAL_DBL;
+    }
+    if (av->dok)
+	*v = av->dval;
+    return av->dok;
+}
+
+/* agxgetint:
+ * As agxgetdouble, for a decimal integer as read by strtol.
+ */
+int agxgetint(void *obj, Agsym_t * sym, int *v)
+{
+    Agattrval_t *av;
+    char *endp;
+
+    av = attrval(obj, sym);
+    if (!(av->flags & AGVAL_INT)) {
+	av->iok = 0;
+	if (av->str) {
+	    av->ival = strtol(av->str, &endp, 10);
+	    av->iok = (endp != av->str);
+	}
+	av->flags |= AGVAL_INT;
+    }
+    if (av->iok)
+	*v = av->ival;
+    return av->iok;
+}
+
+/* agxgetpoint:
+ * Read a point "x,y" (dim 2) or "x,y,z" (dim 3) from the value of sym
+ * on obj, as sscanf would with "%lf,%lf%c" or "%lf,%lf,%lf%c".
+ * The coordinates read are stored in pt and their number is returned.
+ * If c is not NULL, it receives the character following a complete
+ * point, or 0.
+ */
+int agxgetpoint(void *obj, Agsym_t * sym, double *pt, int dim, char *c)
+{
+    Agattrval_t *av;
+    int i, n;
+
+    av = attrval(obj, sym);
+    if (!(av->flags & AGVAL_PT)) {
+	av->np2 = av->np3 = 0;
+	av->c2 = av->c3 = '\0';
+	if (av->str) {
+	    n = sscanf(av->str, "%lf,%lf,%lf%c", av->pt, av->pt + 1,
+		       av->pt + 2, &av->c3);
+	    av->np3 = (n < 0) ? 0 : (n > 3) ? 3 : n;
+	    n = sscanf(av->str, "%lf,%lf%c", av->pt, av->pt + 1, &av->c2);
+	    av->np2 = (n < 0) ? 0 : (n > 2) ? 2 : n;
+	}
+	av->flags |= AGVAL_PT;
+    }
+    n = (dim >= 3) ? av->np3 : av->np2;
+    for (i = 0; i < n; i++)
+	pt[i] = av->pt[i];
+    if (c)
+	*c = (dim >= 3) ? av->c3 : av->c2;
+    return n;
+}
+
 int agset(void *obj, char *name, char *value)
 {
     Agsym_t *sym;
@@ -470,6 +593,7 @@ int agxset(void *obj, Agsym_t * sym, char *value)
     Agraph_t *g;
     Agobj_t *hdr;
     Agattr_t *data;
+    Agattrx_t *datax;
     Agsym_t *lsym;
 
     g = agraphof(obj);
@@ -478,6 +602,11 @@ int agxset(void *obj, Agsym_t * sym, char *value)
     assert((sym->id >= 0) && (sym->id < topdictsize(obj)));
     agstrfree(g, data->str[sym->id]);
     data->str[sym->id] = agstrdup(g, value);
+    datax = (Agattrx_t *) data;
+    if (sym->id < datax->nval) {
+	datax->val[sym->id].str = NIL(char *);
+	datax->val[sym->id].flags = 0;
+    }
     if (hdr->tag.objtype == AGRAPH) {
 	/* also update dict default */
 	Dict_t *dict;
@@ -66,9 +66,36 @@
 #define AGDISC(g,d)			((g)->clos->disc.d)
 #define AGCLOS(g,d)			((g)->clos->state.d)
 #define AGNEW(g,t)			((t*)(agalloc(g,sizeof(t))))
+#define AGGEN(g)			(((Agclosx_t*)((g)->clos))->gen)
 
 #define ISALNUM(c) ((isalnum(c)) || ((c) == '_') || (!isascii(c)))
 
+	/* the closure as allocated by agopen, with fields private to cgraph */
+typedef struct {
+    Agclos_t clos;
+    uint64_t gen;		/* bumped when the node or edge sets change */
+} Agclosx_t;
+
+	/* a cached parse of one attribute value; see attr.c */
+typedef struct {
+    char *str;			/* value the fields below were parsed from */
+    unsigned char flags;	/* which parses are valid */
+    unsigned char dok, iok;	/* value parsed as a double, an int */
+    unsigned char np2, np3;	/* doubles read as "x,y" and "x,y,z" */
+    char c2, c3;		/* character following them, or 0 */
+    int ival;
+    double dval;
+    double pt[3];
+} Agattrval_t;
+
+	/* the attribute record as bound to objects, with fields private
+	 * to cgraph */
+typedef struct {
+    Agattr_t attr;
+    Agattrval_t *val;		/* numeric values parsed from str, or NULL */
+    int nval;			/* number of entries in val */
+} Agattrx_t;
+
 	/* functional definitions */
 typedef Agobj_t *(*agobjsearchfn_t) (Agraph_t * g, Agobj_t * obj);
 CGHDR_API int agapply(Agraph_t * g, Agobj_t * obj, agobjfn_t fn, void *arg,
@@ -106,6 +133,7 @@ uint64_t agnextseq(Agraph_t * g, int objtype);
 /* dict helper functions */
 Dict_t *agdtopen(Agraph_t * g, Dtdisc_t * disc, Dtmethod_t * method);
 void agdtdisc(Agraph_t * g, Dict_t * dict, Dtdisc_t * disc);
+void *agdtinsert(Agraph_t * g, Dict_t * dict, void *obj);
 long agdtdelete(Agraph_t * g, Dict_t * dict, void *obj);
 int agdtclose(Agraph_t * g, Dict_t * dict);
 void *agdictobjmem(Dict_t * dict, void * p, size_t size,
@@ -129,6 +157,8 @@ void aglexinit(Agdisc_t * disc, void *ifile);
 int aaglex(void);
 void aglexeof(void);
 void aglexbad(void);
+int aglexbuffer(char *buf, size_t len);
+size_t aglexbufferend(void);
 
 	/* ID management */
 int agmapnametoid(Agraph_t * g, int objtype, char *str,
@@ -200,6 +200,11 @@ CGRAPH_API Agiodisc_t AgIoDisc;
 
 CGRAPH_API Agdisc_t AgDefaultDisc;
 
+	/* arena memory: objects are released in bulk by agclose */
+CGRAPH_API Agmemdisc_t AgArenaMemDisc;
+CGRAPH_API Agmemdisc_t AgPoolMemDisc;	/* arenas are reused by later graphs */
+CGRAPH_API void agpoolclose(void);
+
 struct Agdstate_s {
     void *mem;
     void *id;
@@ -257,6 +262,7 @@ CGRAPH_API Agraph_t *agopen(char *name, Agdesc_t desc, Agdisc_t * disc);
 CGRAPH_API int agclose(Agraph_t * g);
 CGRAPH_API Agraph_t *agread(void *chan, Agdisc_t * disc);
 CGRAPH_API Agraph_t *agmemread(const char *cp);
+CGRAPH_API Agraph_t *agmmapread(void *chan, Agdisc_t * disc);
 CGRAPH_API void agreadline(int);
 CGRAPH_API void agsetfile(char *);
 CGRAPH_API Agraph_t *agconcat(Agraph_t * g, void *chan, Agdisc_t * disc);
@@ -291,6 +297,36 @@ CGRAPH_API Agedge_t *agnxtout(Agraph_t * g, Agedge_t * e);
 CGRAPH_API Agedge_t *agfstedge(Agraph_t * g, Agnode_t * n);
 CGRAPH_API Agedge_t *agnxtedge(Agraph_t * g, Agedge_t * e, Agnode_t * n);
 
+/* frozen graphs: read-only compressed sparse row snapshot of g.
+ * The out-edges of node i are out[outoff[i]] .. out[outoff[i+1]-1],
+ * and the index of an edge is its position in out[].
+ * A snapshot is not updated when g changes; see agcsrvalid.
+ */
+typedef struct Agcsr_s {
+    Agraph_t *g;
+    uint64_t gen;		/* generation of the node and edge sets */
+    int nnodes, nedges;
+    Agnode_t **node;		/* nodes in sequence order */
+    int *outoff, *inoff;	/* nnodes+1 offsets into out[] and in[] */
+    Agedge_t **out;		/* out-edges grouped by tail */
+    Agedge_t **in;		/* in-edges grouped by head */
+    int *head;			/* node index of the head of out[j] */
+    int *tail;			/* node index of the tail of in[k] */
+    int *inedge;		/* edge index of in[k] */
+    int *nodeidx, nseq;		/* node index by node sequence number */
+    int *edgeidx, *inpos, eseq;	/* out[] and in[] position by edge seq */
+} Agcsr_t;
+
+CGRAPH_API Agcsr_t *agfreeze(Agraph_t * g);
+CGRAPH_API void agthaw(Agcsr_t * c);
+CGRAPH_API int agcsrvalid(Agcsr_t * c);
+CGRAPH_API int agnodeindex(Agcsr_t * c, Agnode_t * n);
+CGRAPH_API int agedgeindex(Agcsr_t * c, Agedge_t * e);
+CGRAPH_API Agedge_t *agcsrfstout(Agcsr_t * c, Agnode_t * n);
+CGRAPH_API Agedge_t *agcsrnxtout(Agcsr_t * c, Agedge_t * e);
+CGRAPH_API Agedge_t *agcsrfstin(Agcsr_t * c, Agnode_t * n);
+CGRAPH_API Agedge_t *agcsrnxtin(Agcsr_t * c, Agedge_t * e);
+
 /* generic */
 CGRAPH_API Agraph_t *agraphof(void* obj);
 CGRAPH_API Agraph_t *agroot(void* obj);
@@ -353,6 +389,10 @@ CGRAPH_API void agclean(Agraph_t * g, int kind, char *rec_name);
 
 CGRAPH_API char *agget(void *obj, char *name);
 CGRAPH_API char *agxget(void *obj, Agsym_t * sym);
+CGRAPH_API int agxgetdouble(void *obj, Agsym_t * sym, double *v);
+CGRAPH_API int agxgetint(void *obj, Agsym_t * sym, int *v);
+CGRAPH_API int agxgetpoint(void *obj, Agsym_t * sym, double *pt, int dim,
+			   char *c);
 CGRAPH_API int agset(void *obj, char *name, char *value);
 CGRAPH_API int agxset(void *obj, Agsym_t * sym, char *value);
 CGRAPH_API int agsafeset(void* obj, char* name, char* value, char* def);
@@ -0,0 +1,181 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/*
+ * Frozen graphs: a read-only snapshot of the adjacency of a graph
+ * in compressed sparse row form. Nodes appear in the order of agfstnode,
+ * and the out- and in-edges of each node in the order of agfstout and
+ * agfstin, so a traversal of the snapshot visits objects in the same
+ * order as the equivalent traversal of the graph.
+ */
+
+#include <cghdr.h>
+
+#define SEQ(obj)	((int) AGSEQ(obj))
+#define NEWARRAY(g,n,t)	((t*)agalloc(g,((n)+1)*sizeof(t)))
+
+Agcsr_t *agfreeze(Agraph_t * g)
+{
+    Agcsr_t *c;
+    Agnode_t *n;
+    Agedge_t *e;
+    int i, j, k, nseq, eseq;
+
+    c = agalloc(g, sizeof(Agcsr_t));
+    c->g = g;
+    c->gen = AGGEN(g);
+    c->nnodes = agnnodes(g);
+    c->nedges = agnedges(g);
+
+    nseq = eseq = 0;
+    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	if (SEQ(n) >= nseq)
+	    nseq = SEQ(n) + 1;
+	for (e = agfstout(g, n); e; e = agnxtout(g, e))
+	    if (SEQ(e) >= eseq)
+		eseq = SEQ(e) + 1;
+    }
+    c->nseq = nseq;
+    c->eseq = eseq;
+
+    c->node = NEWARRAY(g, c->nnodes, Agnode_t *);
+    c->nodeidx = NEWARRAY(g, nseq, int);
+    for (i = 0; i < nseq; i++)
+	c->nodeidx[i] = -1;
+    i = 0;
+    for (n = agfstnode(g); n; n = agnxtnode(g, n)) {
+	c->node[i] = n;
+	c->nodeidx[SEQ(n)] = i++;
+    }
+
+    c->outoff = NEWARRAY(g, c->nnodes, int);
+    c->inoff = NEWARRAY(g, c->nnodes, int);
+    c->out = NEWARRAY(g, c->nedges, Agedge_t *);
+    c->in = NEWARRAY(g, c->nedges, Agedge_t *);
+    c->head = NEWARRAY(g, c->nedges, int);
+    c->tail = NEWARRAY(g, c->nedges, int);
+    c->inedge = NEWARRAY(g, c->nedges, int);
+    c->edgeidx = NEWARRAY(g, eseq, int);
+    c->inpos = NEWARRAY(g, eseq, int);
+    for (i = 0; i < eseq; i++)
+	c->edgeidx[i] = c->inpos[i] = -1;
+
+    for (i = j = 0; i < c->nnodes; i++) {
+	c->outoff[i] = j;
+	for (e = agfstout(g, c->node[i]); e; e = agnxtout(g, e)) {
+	    c->out[j] = e;
+	    c->head[j] = c->nodeidx[SEQ(aghead(e))];
+	    c->edgeidx[SEQ(e)] = j++;
+	}
+    }
+    c->outoff[i] = j;
+
+    for (i = k = 0; i < c->nnodes; i++) {
+	c->inoff[i] = k;
+	for (e = agfstin(g, c->node[i]); e; e = agnxtin(g, e)) {
+	    c->in[k] = e;
+	    c->tail[k] = c->nodeidx[SEQ(agtail(e))];
+	    c->inedge[k] = c->edgeidx[SEQ(e)];
+	    c->inpos[SEQ(e)] = k++;
+	}
+    }
+    c->inoff[i] = k;
+
+    return c;
+}
+
+void agthaw(Agcsr_t * c)
+{
+    Agraph_t *g;
+
+    if (!c)
+	return;
+    g = c->g;
+    agfree(g, c->node);
+    agfree(g, c->nodeidx);
+    agfree(g, c->outoff);
+    agfree(g, c->inoff);
+    agfree(g, c->out);
+    agfree(g, c->in);
+    agfree(g, c->head);
+    agfree(g, c->tail);
+    agfree(g, c->inedge);
+    agfree(g, c->edgeidx);
+    agfree(g, c->inpos);
+    agfree(g, c);
+}
+
+/* agcsrvalid:
+ * Return true if no node or edge has been added to, deleted from or
+ * reordered in the root graph since c was built.
+ */
+int agcsrvalid(Agcsr_t * c)
+{
+    return (c->gen == AGGEN(c->g));
+}
+
+int agnodeindex(Agcsr_t * c, Agnode_t * n)
+{
+    if (SEQ(n) >= c->nseq)
+	return -1;
+    return c->nodeidx[SEQ(n)];
+}
+
+int agedgeindex(Agcsr_t * c, Agedge_t * e)
+{
+    if (SEQ(e) >= c->eseq)
+	return -1;
+    return c->edgeidx[SEQ(e)];
+}
+
+Agedge_t *agcsrfstout(Agcsr_t * c, Agnode_t * n)
+{
+    int i = agnodeindex(c, n);
+
+    if ((i < 0) || (c->outoff[i] == c->outoff[i + 1]))
+	return NILedge;
+    return c->out[c->outoff[i]];
+}
+
+Agedge_t *agcsrnxtout(Agcsr_t * c, Agedge_t * e)
+{
+    int j = agedgeindex(c, e);
+
+    if (j < 0)
+	return NILedge;
+    j++;
+    if (j == c->outoff[c->nodeidx[SEQ(agtail(e))] + 1])
+	return NILedge;
+    return c->out[j];
+}
+
+Agedge_t *agcsrfstin(Agcsr_t * c, Agnode_t * n)
+{
+    int i = agnodeindex(c, n);
+
+    if ((i < 0) || (c->inoff[i] == c->inoff[i + 1]))
+	return NILedge;
+    return c->in[c->inoff[i]];
+}
+
+Agedge_t *agcsrnxtin(Agcsr_t * c, Agedge_t * e)
+{
+    int k;
+
+    if (agedgeindex(c, e) < 0)
+	return NILedge;
+    k = c->inpos[SEQ(e)] + 1;
+    if (k == c->inoff[c->nodeidx[SEQ(aghead(e))] + 1])
+	return NILedge;
+    return c->in[k];
+}
@@ -166,18 +166,18 @@ Agsubnode_t *agsubrep(Agraph_t * g, Agnode_t * n)
     return sn;
 }
 
-static void ins(Dict_t * d, Dtlink_t ** set, Agedge_t * e)
+static void ins(Agraph_t * g, Dict_t * d, Dtlink_t ** set, Agedge_t * e)
 {
     dtrestore(d, *set);
-    dtinsert(d, e);
+    agdtinsert(g, d, e);
     *set = dtextract(d);
 }
 
-static void del(Dict_t * d, Dtlink_t ** set, Agedge_t * e)
+static void del(Agraph_t * g, Dict_t * d, Dtlink_t ** set, Agedge_t * e)
 {
-    void *x;
+    long x;
     dtrestore(d, *set);
-    x = dtdelete(d, e);
+    x = agdtdelete(g, d, e);
     assert(x);
     *set = dtextract(d);
 }
@@ -195,11 +195,12 @@ static void installedge(Agraph_t * g, Agedge_t * e)
     while (g) {
 	if (agfindedge_by_key(g, t, h, AGTAG(e))) break;
 	sn = agsubrep(g, t);
-	ins(g->e_seq, &sn->out_seq, out);
-	ins(g->e_id, &sn->out_id, out);
+	ins(g, g->e_seq, &sn->out_seq, out);
+	ins(g, g->e_id, &sn->out_id, out);
 	sn = agsubrep(g, h);
-	ins(g->e_seq, &sn->in_seq, in);
-	ins(g->e_id, &sn->in_id, in);
+	ins(g, g->e_seq, &sn->in_seq, in);
+	ins(g, g->e_id, &sn->in_id, in);
+	AGGEN(g)++;
 	g = agparent(g);
     }
 }
@@ -232,7 +233,7 @@ static Agedge_t *newedge(Agraph_t * g, Agnode_t * t, Agnode_t * h,
 
     installedge(g, out);
     if (g->desc.has_attrs) {
-	(void) agbindrec(out, AgDataRecName, sizeof(Agattr_t), FALSE);
+	(void) agbindrec(out, AgDataRecName, sizeof(Agattrx_t), FALSE);
 	agedgeattr_init(g, out);
     }
     agmethod_init(g, out);
@@ -341,11 +342,12 @@ void agdeledgeimage(Agraph_t * g, Agedge_t * e, void *ignored)
     t = in->node;
     h = out->node;
     sn = agsubrep(g, t);
-    del(g->e_seq, &sn->out_seq, out);
-    del(g->e_id, &sn->out_id, out);
+    del(g, g->e_seq, &sn->out_seq, out);
+    del(g, g->e_id, &sn->out_id, out);
     sn = agsubrep(g, h);
-    del(g->e_seq, &sn->in_seq, in);
-    del(g->e_id, &sn->in_id, in);
+    del(g, g->e_seq, &sn->in_seq, in);
+    del(g, g->e_id, &sn->in_id, in);
+    AGGEN(g)++;
 #ifdef DEBUG
     for (e = agfstin(g,h); e; e = agnxtin(g,e))
 	assert(e != in);
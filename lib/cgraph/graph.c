@@ -29,7 +29,7 @@ static Agclos_t *agclos(Agdisc_t * proto)
     /* establish an allocation arena */
     memdisc = ((proto && proto->mem) ? proto->mem : &AgMemDisc);
     memclosure = memdisc->open(proto);
-    rv = memdisc->alloc(memclosure, sizeof(Agclos_t));
+    rv = memdisc->alloc(memclosure, sizeof(Agclosx_t));
     rv->disc.mem = memdisc;
     rv->state.mem = memclosure;
     rv->disc.id = ((proto && proto->id) ? proto->id : &AgIdDisc);
@@ -16,6 +16,10 @@
 #if defined(_WIN32)
 #include <io.h>
 #endif
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 /* experimental ICONV code - probably should be removed - JCE */
 #undef HAVE_ICONV
@@ -128,11 +132,31 @@ memiofread(void *chan, char *buf, int bufsize)
 
 static Agiodisc_t memIoDisc = {memiofread, 0, 0};
 
+/* bufread:
+ * Parse one graph from the len bytes at buf, scanning them in place.
+ * buf must have 2 writable bytes past len, which are set to 0.
+ * The number of bytes consumed is stored in used.
+ */
+static Agraph_t *bufread(char *buf, size_t len, Agdisc_t * disc,
+			 size_t * used)
+{
+    Agraph_t *g;
+
+    buf[len] = buf[len + 1] = '\0';
+    if (aglexbuffer(buf, len))
+	return NIL(Agraph_t *);
+    g = agconcat(NIL(Agraph_t *), NIL(void *), disc);
+    *used = aglexbufferend();
+    return g;
+}
+
 Agraph_t *agmemread(const char *cp)
 {
     Agraph_t* g;
     rdr_t rdr;
     Agdisc_t disc;
+    size_t len, used;
+    char *buf;
 
     memIoDisc.putstr = AgIoDisc.putstr;
     memIoDisc.flush = AgIoDisc.flush;
@@ -143,7 +167,14 @@ Agraph_t *agmemread(const char *cp)
     disc.mem = &AgMemDisc;
     disc.id = &AgIdDisc;
     disc.io = &memIoDisc;  
-    g = agread (&rdr, &disc);
+    /* scan a single copy of the string rather than feeding it line by line */
+    len = rdr.len;
+    if ((buf = malloc(len + 2))) {
+	memcpy(buf, cp, len);
+	g = bufread(buf, len, &disc, &used);
+	free(buf);
+    } else
+	g = agread (&rdr, &disc);
     /* Null out filename and reset line number 
      * The name may have been set with a ppDirective, and
      * we want to reset line_num.
@@ -152,3 +183,65 @@ Agraph_t *agmemread(const char *cp)
     return g;
 }
 
+/* agmmapread:
+ * Read the next graph from the stdio stream chan, normally a regular file.
+ * The rest of the file is mapped into memory and scanned in place, so
+ * identifiers are interned directly from the file's pages. Where mapping
+ * is not possible, the rest of the file is read into one buffer.
+ * On return, the stream is positioned just after the graph. Other kinds
+ * of input are read with agread.
+ */
+Agraph_t *agmmapread(void *chan, Agdisc_t * disc)
+{
+    FILE *fp = (FILE *) chan;
+    struct stat st;
+    Agraph_t *g;
+    long off;
+    size_t len, used;
+    char *buf = NIL(char *);
+#ifdef HAVE_SYS_MMAN_H
+    char *map = NIL(char *);
+    size_t delta = 0, maplen = 0;
+    long pgsz;
+#endif
+
+    off = ftell(fp);
+    if ((off < 0) || fstat(fileno(fp), &st) || !S_ISREG(st.st_mode))
+	return agread(fp, disc);
+    if (st.st_size <= off)
+	return NIL(Agraph_t *);
+    len = st.st_size - off;
+
+#ifdef HAVE_SYS_MMAN_H
+    /* The scanner needs 2 bytes past the data. Past the end of the
+     * file, the last page reads as 0 and is writable in a private map.
+     */
+    pgsz = sysconf(_SC_PAGESIZE);
+    delta = off % pgsz;
+    maplen = delta + len;
+    if ((maplen % pgsz) && (pgsz - maplen % pgsz >= 2)) {
+	map = mmap(NIL(void *), maplen + 2, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE, fileno(fp), off - delta);
+	if (map == MAP_FAILED)
+	    map = NIL(char *);
+	else
+	    buf = map + delta;
+    }
+#endif
+    if (!buf) {
+	if (!(buf = malloc(len + 2)))
+	    return agread(fp, disc);
+	len = fread(buf, 1, len, fp);
+    }
+
+    g = bufread(buf, len, disc, &used);
+    fseek(fp, g ? off + (long) used : st.st_size, SEEK_SET);
+
+#ifdef HAVE_SYS_MMAN_H
+    if (map)
+	munmap(map, maplen + 2);
+    else
+#endif
+	free(buf);
+    return g;
+}
@@ -12,6 +12,9 @@
  *************************************************************************/
 
 #include <cghdr.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 /* memory management discipline and entry points */
 static void *memopen(Agdisc_t* disc)
@@ -59,6 +62,247 @@ static void memclose(void *heap)
 Agmemdisc_t AgMemDisc =
     { memopen, memalloc, memresize, memfree, memclose };
 
+/* Arena discipline.
+ * Objects are carved from large chunks. Small blocks are rounded up to a
+ * multiple of ARENA_ALIGN and recycled through a free list per size;
+ * larger ones are allocated individually and kept on a list. Each block
+ * is preceded by a header giving its size, so free needs no search.
+ * Closing the arena releases everything at once, which agclose uses to
+ * skip deleting objects one by one.
+ */
+#define ARENA_ALIGN	16
+#define ARENA_CHUNK	(64 * 1024)
+#define ARENA_MAXSMALL	1024	/* largest block, with header, kept in a class */
+#define ARENA_NCLASS	(ARENA_MAXSMALL / ARENA_ALIGN + 1)
+#define ARENA_NPOOL	4	/* arenas kept for reuse by AgPoolMemDisc */
+
+typedef union {
+    size_t size;		/* block size, including the header */
+    void *next;			/* free list link */
+    double d;
+    char pad[ARENA_ALIGN];
+} arenahdr_t;
+
+typedef struct arenabig_s {
+    struct arenabig_s *prev, *next;
+    arenahdr_t hdr;
+} arenabig_t;
+
+typedef union arenachunk_u {
+    union arenachunk_u *next;
+    char pad[ARENA_ALIGN];
+} arenachunk_t;
+
+typedef struct {
+    arenachunk_t *chunks;	/* chunks in use, most recent first */
+    arenachunk_t *spare;	/* chunks kept by a pooled arena */
+    char *cur, *end;		/* unused part of the current chunk */
+    void *freelist[ARENA_NCLASS];
+    arenabig_t *big;
+} arena_t;
+
+#define HDR(p)	((arenahdr_t *)(p) - 1)
+
+static void *arenaopen(Agdisc_t * disc)
+{
+    NOTUSED(disc);
+    return calloc(1, sizeof(arena_t));
+}
+
+static void *arenaalloc(void *heap, size_t request)
+{
+    arena_t *a = heap;
+    arenahdr_t *h;
+    arenachunk_t *c;
+    arenabig_t *b;
+    size_t sz;
+    void *rv;
+
+    sz = (request + sizeof(arenahdr_t) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    if (sz > ARENA_MAXSMALL) {
+	b = malloc(sizeof(arenabig_t) + request);
+	if (!b)
+	    return NIL(void *);
+	b->prev = NIL(arenabig_t *);
+	b->next = a->big;
+	if (a->big)
+	    a->big->prev = b;
+	a->big = b;
+	b->hdr.size = sz;
+	rv = &b->hdr + 1;
+	memset(rv, 0, request);
+	return rv;
+    }
+    if ((rv = a->freelist[sz / ARENA_ALIGN])) {
+	a->freelist[sz / ARENA_ALIGN] = HDR(rv)->next;
+	HDR(rv)->size = sz;
+	memset(rv, 0, sz - sizeof(arenahdr_t));
+	return rv;
+    }
+    if (a->cur + sz > a->end) {
+	if ((c = a->spare))
+	    a->spare = c->next;
+	else if (!(c = malloc(sizeof(arenachunk_t) + ARENA_CHUNK)))
+	    return NIL(void *);
+	c->next = a->chunks;
+	a->chunks = c;
+	a->cur = (char *) (c + 1);
+	a->end = a->cur + ARENA_CHUNK;
+    }
+    h = (arenahdr_t *) a->cur;
+    a->cur += sz;
+    h->size = sz;
+    rv = h + 1;
+    memset(rv, 0, sz - sizeof(arenahdr_t));
+    return rv;
+}
+
+static void arenafree(void *heap, void *ptr)
+{
+    arena_t *a = heap;
+    arenabig_t *b;
+    size_t sz;
+
+    sz = HDR(ptr)->size;
+    if (sz > ARENA_MAXSMALL) {
+	b = (arenabig_t *) ((char *) ptr - offsetof(arenabig_t, hdr) - sizeof(arenahdr_t));
+	if (b->prev)
+	    b->prev->next = b->next;
+	else
+	    a->big = b->next;
+	if (b->next)
+	    b->next->prev = b->prev;
+	free(b);
+    } else {
+	HDR(ptr)->next = a->freelist[sz / ARENA_ALIGN];
+	a->freelist[sz / ARENA_ALIGN] = ptr;
+    }
+}
+
+static void *arenaresize(void *heap, void *ptr, size_t oldsize,
+			 size_t request)
+{
+    size_t cap;
+    void *rv;
+
+    cap = HDR(ptr)->size - sizeof(arenahdr_t);
+    if ((request <= cap) && (HDR(ptr)->size <= ARENA_MAXSMALL)) {
+	if (request > oldsize)
+	    memset((char *) ptr + oldsize, 0, request - oldsize);
+	return ptr;
+    }
+    rv = arenaalloc(heap, request);
+    if (rv) {
+	if (oldsize > cap)
+	    oldsize = cap;
+	memcpy(rv, ptr, (oldsize < request) ? oldsize : request);
+	arenafree(heap, ptr);
+    }
+    return rv;
+}
+
+/* arenareset:
+ * Release all blocks. Chunks are kept on the spare list if keep is set.
+ */
+static void arenareset(arena_t * a, int keep)
+{
+    arenachunk_t *c, *next;
+    arenabig_t *b, *bnext;
+
+    for (b = a->big; b; b = bnext) {
+	bnext = b->next;
+	free(b);
+    }
+    for (c = a->chunks; c; c = next) {
+	next = c->next;
+	if (keep) {
+	    c->next = a->spare;
+	    a->spare = c;
+	} else
+	    free(c);
+    }
+    if (!keep) {
+	for (c = a->spare; c; c = next) {
+	    next = c->next;
+	    free(c);
+	}
+	a->spare = NIL(arenachunk_t *);
+    }
+    a->chunks = NIL(arenachunk_t *);
+    a->big = NIL(arenabig_t *);
+    a->cur = a->end = NIL(char *);
+    memset(a->freelist, 0, sizeof(a->freelist));
+}
+
+static void arenaclose(void *heap)
+{
+    arenareset(heap, FALSE);
+    free(heap);
+}
+
+Agmemdisc_t AgArenaMemDisc =
+    { arenaopen, arenaalloc, arenaresize, arenafree, arenaclose };
+
+/* Pooled arenas: on close, an arena keeps its chunks and is
+ * put aside for the next graph, so reading a sequence of graphs
+ * reuses the same memory. agpoolclose releases the pool.
+ * The pool is shared by all graphs using the discipline, so it
+ * is guarded by a lock.
+ */
+static arena_t *Pool[ARENA_NPOOL];
+static int NPool;
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t PoolLock = PTHREAD_MUTEX_INITIALIZER;
+#define POOL_LOCK()	pthread_mutex_lock(&PoolLock)
+#define POOL_UNLOCK()	pthread_mutex_unlock(&PoolLock)
+#else
+#define POOL_LOCK()
+#define POOL_UNLOCK()
+#endif
+
+static void *poolopen(Agdisc_t * disc)
+{
+    arena_t *heap = NIL(arena_t *);
+
+    POOL_LOCK();
+    if (NPool > 0)
+	heap = Pool[--NPool];
+    POOL_UNLOCK();
+    if (heap)
+	return heap;
+    return arenaopen(disc);
+}
+
+static void poolclose(void *heap)
+{
+    arenareset(heap, TRUE);
+    POOL_LOCK();
+    if (NPool < ARENA_NPOOL) {
+	Pool[NPool++] = heap;
+	heap = NIL(void *);
+    }
+    POOL_UNLOCK();
+    if (heap)
+	arenaclose(heap);
+}
+
+void agpoolclose(void)
+{
+    arena_t *heap;
+
+    for (;;) {
+	POOL_LOCK();
+	heap = (NPool > 0) ? Pool[--NPool] : NIL(arena_t *);
+	POOL_UNLOCK();
+	if (!heap)
+	    break;
+	arenaclose(heap);
+    }
+}
+
+Agmemdisc_t AgPoolMemDisc =
+    { poolopen, arenaalloc, arenaresize, arenafree, poolclose };
+
 void *agalloc(Agraph_t * g, size_t size)
 {
     void *mem;
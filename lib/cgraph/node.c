@@ -77,7 +77,7 @@ static Agnode_t *newnode(Agraph_t * g, IDTYPE id, uint64_t seq)
     AGSEQ(n) = seq;
     n->root = agroot(g);
     if (agroot(g)->desc.has_attrs)
-	(void) agbindrec(n, AgDataRecName, sizeof(Agattr_t), FALSE);
+	(void) agbindrec(n, AgDataRecName, sizeof(Agattrx_t), FALSE);
     /* nodeattr_init and method_init will be called later, from the
      * subgraph where the node was actually created, but first it has
      * to be installed in all the (sub)graphs up to root. */
@@ -96,6 +96,7 @@ static void installnode(Agraph_t * g, Agnode_t * n)
     sn->node = n;
     dtinsert(g->n_id, sn);
     dtinsert(g->n_seq, sn);
+    AGGEN(g)++;
     assert(dtsize(g->n_id) == dtsize(g->n_seq));
     assert(dtsize(g->n_id) == osize + 1);
 }
@@ -187,6 +188,7 @@ void agdelnodeimage(Agraph_t * g, Agnode_t * n, void *ignored)
      */ 
     dtdelete(g->n_id, &template);
     dtdelete(g->n_seq, &template);
+    AGGEN(g)++;
 }
 
 int agdelnode(Agraph_t * g, Agnode_t * n)
@@ -358,6 +360,7 @@ int agnodebefore(Agnode_t *fst, Agnode_t *snd)
 
 	g = agroot(fst);
 	if (AGSEQ(fst) > AGSEQ(snd)) return SUCCESS;
+	AGGEN(g)++;
 
 	/* move snd out of the way somewhere */
 	n = snd;
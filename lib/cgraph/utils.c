@@ -50,24 +50,64 @@ void agdictobjfree(Dict_t * dict, void * p, Dtdisc_t * disc)
 	free(p);
 }
 
+/* agdictopenevent:
+ * Asks dtopen to allocate the dictionary header itself through the
+ * memory function, and not with malloc.
+ */
+static int agdictopenevent(Dict_t * dict, int type, void *data,
+			   Dtdisc_t * disc)
+{
+    NOTUSED(dict);
+    NOTUSED(data);
+    NOTUSED(disc);
+    return (type == DT_OPEN);
+}
+
+/* agdtopen:
+ * If the memory discipline of g releases its heap in bulk, the whole
+ * dictionary lives in the heap, so that agclose need not close it.
+ */
 Dict_t *agdtopen(Agraph_t * g, Dtdisc_t * disc, Dtmethod_t * method)
 {
     Dtmemory_f memf;
+    Dtevent_f eventf;
     Dict_t *d;
 
     memf = disc->memoryf;
+    eventf = disc->eventf;
     disc->memoryf = agdictobjmem;
+    if (g && AGDISC(g, mem)->close && !eventf)
+	disc->eventf = agdictopenevent;
     Ag_dictop_G = g;
     d = dtopen(disc, method);
     disc->memoryf = memf;
+    disc->eventf = eventf;
     Ag_dictop_G = NIL(Agraph_t*);
     return d;
 }
 
+/* agdtinsert, agdtdelete:
+ * Dictionaries using external holders allocate and free them during
+ * insertion and deletion, so the memory discipline of g must be current.
+ */
+void *agdtinsert(Agraph_t * g, Dict_t * dict, void *obj)
+{
+    void *rv;
+
+    Ag_dictop_G = g;
+    rv = dtinsert(dict, obj);
+    Ag_dictop_G = NIL(Agraph_t*);
+    return rv;
+}
+
 long agdtdelete(Agraph_t * g, Dict_t * dict, void *obj)
 {
+    long rv;
+
     Ag_dictop_G = g;
-    return (long) dtdelete(dict, obj);
+    rv = (long) dtdelete(dict, obj);
+    Ag_dictop_G = NIL(Agraph_t*);
+    return rv;
 }
 
 int agobjfinalize(void * obj)
@@ -171,6 +171,10 @@
 #define		SERVER_NN	200
 #define		SERVER_NE	500
 
+/* network simplex engines: nsrank, nsmode */
+#define NS_CLASSIC	0
+#define NS_INCREMENTAL	1
+
 /* for neato */
 #define Spring_coeff    1.0
 #define MYHUGE          (1.0e+37)
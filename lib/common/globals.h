@@ -77,6 +77,7 @@ extern "C" {
     EXTERN double Epsilon;	/* defined in input_graph */
     EXTERN int MaxIter;
     EXTERN int Ndim;
+    EXTERN int Nthreads;	/* threads for parallel layout loops */
     EXTERN int State;		/* last finished phase */
     EXTERN int EdgeLabelsDone;	/* true if edge labels have been positioned */
     EXTERN double Initial_dist;
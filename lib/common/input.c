@@ -534,6 +534,27 @@ static char *myfgets(char * ubuf, int n, FILE * fp)
 }
 #endif
 
+/* If the environment variable GV_POOLMEM is true, input graphs are
+ * read into pooled arenas, so the memory of a graph is released in bulk
+ * when it is closed and reused by the next one. By default, they use
+ * the usual malloc discipline.
+ */
+static Agdisc_t PoolDisc = { &AgPoolMemDisc, &AgIdDisc, &AgIoDisc };
+
+static Agdisc_t *inputDisc(void)
+{
+    static Agdisc_t *disc;
+    static boolean init;
+    char *s;
+
+    if (!init) {
+	if ((s = getenv("GV_POOLMEM")) && mapbool(s))
+	    disc = &PoolDisc;
+	init = TRUE;
+    }
+    return disc;
+}
+
 graph_t *gvNextInputGraph(GVC_t *gvc)
 {
     graph_t *g = NULL;
@@ -564,7 +585,7 @@ graph_t *gvNextInputGraph(GVC_t *gvc)
 #ifdef EXPERIMENTAL_MYFGETS
 	g = agread_usergets(fp, myfgets);
 #else
-	g = agread(fp,NIL(Agdisc_t*));
+	g = agread(fp,inputDisc());
 #endif
 	if (g) {
 	    gvg_init(gvc, g, fn, gidx++);
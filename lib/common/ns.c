@@ -19,50 +19,64 @@
 #include "render.h"
 #include <setjmp.h>
 
-static int init_graph(graph_t *);
+#define LENGTH(e)		(ND_rank(aghead(e)) - ND_rank(agtail(e)))
+#define SLACK(e)		(LENGTH(e) - ED_minlen(e))
+#define SEQ(a,b,c)		(((a) <= (b)) && ((b) <= (c)))
+#define TREE_EDGE(e)	(ED_tree_index(e) >= 0)
+#define SEARCHSIZE 30
+
+/* nsctx_t:
+ * All of the solver state for one invocation of rank2.
+ * Keeping it on the caller's stack, rather than in file statics,
+ * makes the solver reentrant: independent graphs can be ranked
+ * concurrently from different threads.
+ */
+typedef struct {
+    jmp_buf jbuf;
+    graph_t *G;
+    int N_nodes, N_edges;
+    int Minrank, Maxrank;
+    int S_i;			/* search index for enter_edge */
+    int Search_size;
+    nlist_t Tree_node;
+    elist Tree_edge;
+    edge_t *Enter;		/* state for enter_edge search */
+    int Low, Lim, Slack;
+    int mode;			/* NS_CLASSIC or NS_INCREMENTAL */
+    elist Cand;			/* NS_INCREMENTAL: leaving edge candidates */
+} nsctx_t;
+
+static int init_graph(nsctx_t *, graph_t *);
 static void dfs_cutval(node_t * v, edge_t * par);
 static int dfs_range(node_t * v, edge_t * par, int low);
+static int dfs_range_incr(node_t * v, edge_t * par, int low);
+static void invalidate_path(node_t * lca, node_t * to_node);
 static int x_val(edge_t * e, node_t * v, int dir);
 #ifdef DEBUG
 static void check_cycles(graph_t * g);
 #endif
 
-#define LENGTH(e)		(ND_rank(aghead(e)) - ND_rank(agtail(e)))
-#define SLACK(e)		(LENGTH(e) - ED_minlen(e))
-#define SEQ(a,b,c)		(((a) <= (b)) && ((b) <= (c)))
-#define TREE_EDGE(e)	(ED_tree_index(e) >= 0)
-
-static jmp_buf jbuf;
-static graph_t *G;
-static int N_nodes, N_edges;
-static int Minrank, Maxrank;
-static int S_i;			/* search index for enter_edge */
-static int Search_size;
-#define SEARCHSIZE 30
-static nlist_t Tree_node;
-static elist Tree_edge;
-
-static void add_tree_edge(edge_t * e)
+static void add_tree_edge(nsctx_t * ctx, edge_t * e)
 {
     node_t *n;
     //fprintf(stderr,"add tree edge %p %s ", (void*)e, agnameof(agtail(e))) ; fprintf(stderr,"%s\n", agnameof(aghead(e))) ;
     if (TREE_EDGE(e)) {
 	agerr(AGERR, "add_tree_edge: missing tree edge\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
-    ED_tree_index(e) = Tree_edge.size;
-    Tree_edge.list[Tree_edge.size++] = e;
+    ED_tree_index(e) = ctx->Tree_edge.size;
+    ctx->Tree_edge.list[ctx->Tree_edge.size++] = e;
     if (ND_mark(agtail(e)) == FALSE)
-	Tree_node.list[Tree_node.size++] = agtail(e);
+	ctx->Tree_node.list[ctx->Tree_node.size++] = agtail(e);
     if (ND_mark(aghead(e)) == FALSE)
-	Tree_node.list[Tree_node.size++] = aghead(e);
+	ctx->Tree_node.list[ctx->Tree_node.size++] = aghead(e);
     n = agtail(e);
     ND_mark(n) = TRUE;
     ND_tree_out(n).list[ND_tree_out(n).size++] = e;
     ND_tree_out(n).list[ND_tree_out(n).size] = NULL;
     if (ND_out(n).list[ND_tree_out(n).size - 1] == 0) {
 	agerr(AGERR, "add_tree_edge: empty outedge list\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
     n = aghead(e);
     ND_mark(n) = TRUE;
@@ -70,17 +84,17 @@ static void add_tree_edge(edge_t * e)
     ND_tree_in(n).list[ND_tree_in(n).size] = NULL;
     if (ND_in(n).list[ND_tree_in(n).size - 1] == 0) {
 	agerr(AGERR, "add_tree_edge: empty inedge list\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
 }
 
-static void exchange_tree_edges(edge_t * e, edge_t * f)
+static void exchange_tree_edges(nsctx_t * ctx, edge_t * e, edge_t * f)
 {
     int i, j;
     node_t *n;
 
     ED_tree_index(f) = ED_tree_index(e);
-    Tree_edge.list[ED_tree_index(e)] = f;
+    ctx->Tree_edge.list[ED_tree_index(e)] = f;
     ED_tree_index(e) = -1;
 
     n = agtail(e);
@@ -107,17 +121,17 @@ static void exchange_tree_edges(edge_t * e, edge_t * f)
 }
 
 static
-void init_rank(void)
+void init_rank(nsctx_t * ctx)
 {
     int i, ctr;
     nodequeue *Q;
     node_t *v;
     edge_t *e;
 
-    Q = new_queue(N_nodes);
+    Q = new_queue(ctx->N_nodes);
     ctr = 0;
 
-    for (v = GD_nlist(G); v; v = ND_next(v)) {
+    for (v = GD_nlist(ctx->G); v; v = ND_next(v)) {
 	if (ND_priority(v) == 0)
 	    enqueue(Q, v);
     }
@@ -132,99 +146,177 @@ void init_rank(void)
 		enqueue(Q, aghead(e));
 	}
     }
-    if (ctr != N_nodes) {
+    if (ctr != ctx->N_nodes) {
 	agerr(AGERR, "trouble in init_rank\n");
-	for (v = GD_nlist(G); v; v = ND_next(v))
+	for (v = GD_nlist(ctx->G); v; v = ND_next(v))
 	    if (ND_priority(v))
 		agerr(AGPREV, "\t%s %d\n", agnameof(v), ND_priority(v));
     }
     free_queue(Q);
 }
 
-static edge_t *leave_edge(void)
+static edge_t *leave_edge(nsctx_t * ctx)
 {
     edge_t *f, *rv = NULL;
     int j, cnt = 0;
 
-    j = S_i;
-    while (S_i < Tree_edge.size) {
-	if (ED_cutvalue(f = Tree_edge.list[S_i]) < 0) {
+    j = ctx->S_i;
+    while (ctx->S_i < ctx->Tree_edge.size) {
+	if (ED_cutvalue(f = ctx->Tree_edge.list[ctx->S_i]) < 0) {
 	    if (rv) {
 		if (ED_cutvalue(rv) > ED_cutvalue(f))
 		    rv = f;
 	    } else
-		rv = Tree_edge.list[S_i];
-	    if (++cnt >= Search_size)
+		rv = ctx->Tree_edge.list[ctx->S_i];
+	    if (++cnt >= ctx->Search_size)
 		return rv;
 	}
-	S_i++;
+	ctx->S_i++;
     }
     if (j > 0) {
-	S_i = 0;
-	while (S_i < j) {
-	    if (ED_cutvalue(f = Tree_edge.list[S_i]) < 0) {
+	ctx->S_i = 0;
+	while (ctx->S_i < j) {
+	    if (ED_cutvalue(f = ctx->Tree_edge.list[ctx->S_i]) < 0) {
 		if (rv) {
 		    if (ED_cutvalue(rv) > ED_cutvalue(f))
 			rv = f;
 		} else
-		    rv = Tree_edge.list[S_i];
-		if (++cnt >= Search_size)
+		    rv = ctx->Tree_edge.list[ctx->S_i];
+		if (++cnt >= ctx->Search_size)
 		    return rv;
 	    }
-	    S_i++;
+	    ctx->S_i++;
 	}
     }
     return rv;
 }
 
-static edge_t *Enter;
-static int Low, Lim, Slack;
+/* leave_edge_cand:
+ * Candidate list variant of leave_edge used by NS_INCREMENTAL.
+ * Rather than rescanning up to Search_size tree edges on every pivot,
+ * keep the negative edges found by the last scan and keep choosing
+ * among them while they remain negative tree edges. A full scan is
+ * only done once the list runs dry.
+ */
+static edge_t *leave_edge_cand(nsctx_t * ctx)
+{
+    edge_t *f, *rv;
+    int i, j, cnt, limit;
+
+    /* drop candidates that have left the tree or are no longer negative */
+    for (i = j = 0; i < ctx->Cand.size; i++) {
+	f = ctx->Cand.list[i];
+	if (TREE_EDGE(f) && (ED_cutvalue(f) < 0))
+	    ctx->Cand.list[j++] = f;
+    }
+    ctx->Cand.size = j;
+
+    if (ctx->Cand.size == 0) {
+	limit = MIN(ctx->Search_size, ctx->Tree_edge.size);
+	limit = MAX(limit, 1);
+	for (cnt = 0; cnt < ctx->Tree_edge.size; cnt++) {
+	    f = ctx->Tree_edge.list[ctx->S_i];
+	    if (++ctx->S_i >= ctx->Tree_edge.size)
+		ctx->S_i = 0;
+	    if (ED_cutvalue(f) < 0) {
+		ctx->Cand.list[ctx->Cand.size++] = f;
+		if (ctx->Cand.size >= limit)
+		    break;
+	    }
+	}
+    }
+    if (ctx->Cand.size == 0)
+	return NULL;
+
+    j = 0;
+    for (i = 1; i < ctx->Cand.size; i++)
+	if (ED_cutvalue(ctx->Cand.list[i]) < ED_cutvalue(ctx->Cand.list[j]))
+	    j = i;
+    rv = ctx->Cand.list[j];
+    ctx->Cand.list[j] = ctx->Cand.list[--ctx->Cand.size];
+    return rv;
+}
 
-static void dfs_enter_outedge(node_t * v)
+static void dfs_enter_outedge(nsctx_t * ctx, node_t * v)
 {
     int i, slack;
     edge_t *e;
 
     for (i = 0; (e = ND_out(v).list[i]); i++) {
 	if (TREE_EDGE(e) == FALSE) {
-	    if (!SEQ(Low, ND_lim(aghead(e)), Lim)) {
+	    if (!SEQ(ctx->Low, ND_lim(aghead(e)), ctx->Lim)) {
 		slack = SLACK(e);
-		if ((slack < Slack) || (Enter == NULL)) {
-		    Enter = e;
-		    Slack = slack;
+		if ((slack < ctx->Slack) || (ctx->Enter == NULL)) {
+		    ctx->Enter = e;
+		    ctx->Slack = slack;
 		}
 	    }
 	} else if (ND_lim(aghead(e)) < ND_lim(v))
-	    dfs_enter_outedge(aghead(e));
+	    dfs_enter_outedge(ctx, aghead(e));
     }
-    for (i = 0; (e = ND_tree_in(v).list[i]) && (Slack > 0); i++)
+    for (i = 0; (e = ND_tree_in(v).list[i]) && (ctx->Slack > 0); i++)
 	if (ND_lim(agtail(e)) < ND_lim(v))
-	    dfs_enter_outedge(agtail(e));
+	    dfs_enter_outedge(ctx, agtail(e));
 }
 
-static void dfs_enter_inedge(node_t * v)
+static void dfs_enter_inedge(nsctx_t * ctx, node_t * v)
 {
     int i, slack;
     edge_t *e;
 
     for (i = 0; (e = ND_in(v).list[i]); i++) {
 	if (TREE_EDGE(e) == FALSE) {
-	    if (!SEQ(Low, ND_lim(agtail(e)), Lim)) {
+	    if (!SEQ(ctx->Low, ND_lim(agtail(e)), ctx->Lim)) {
 		slack = SLACK(e);
-		if ((slack < Slack) || (Enter == NULL)) {
-		    Enter = e;
-		    Slack = slack;
+		if ((slack < ctx->Slack) || (ctx->Enter == NULL)) {
+		    ctx->Enter = e;
+		    ctx->Slack = slack;
 		}
 	    }
 	} else if (ND_lim(agtail(e)) < ND_lim(v))
-	    dfs_enter_inedge(agtail(e));
+	    dfs_enter_inedge(ctx, agtail(e));
     }
-    for (i = 0; (e = ND_tree_out(v).list[i]) && (Slack > 0); i++)
+    for (i = 0; (e = ND_tree_out(v).list[i]) && (ctx->Slack > 0); i++)
 	if (ND_lim(aghead(e)) < ND_lim(v))
-	    dfs_enter_inedge(aghead(e));
+	    dfs_enter_inedge(ctx, aghead(e));
 }
 
-static edge_t *enter_edge(edge_t * e)
+/* scan_enter_complement:
+ * Find the same entering edge as dfs_enter_outedge/dfs_enter_inedge,
+ * but by looking at the nodes outside the subtree [Low,Lim] rather than
+ * inside it. Used by NS_INCREMENTAL when the subtree is the larger side
+ * of the cut.
+ */
+static void scan_enter_complement(nsctx_t * ctx, int outsearch)
+{
+    int i, j, slack;
+    node_t *w, *x;
+    edge_t *f;
+    elist *L;
+
+    for (i = 0; i < ctx->Tree_node.size; i++) {
+	w = ctx->Tree_node.list[i];
+	if (SEQ(ctx->Low, ND_lim(w), ctx->Lim))
+	    continue;
+	L = (outsearch ? &ND_in(w) : &ND_out(w));
+	for (j = 0; (f = L->list[j]); j++) {
+	    if (TREE_EDGE(f))
+		continue;
+	    x = (outsearch ? agtail(f) : aghead(f));
+	    if (!SEQ(ctx->Low, ND_lim(x), ctx->Lim))
+		continue;
+	    slack = SLACK(f);
+	    if ((slack < ctx->Slack) || (ctx->Enter == NULL)) {
+		ctx->Enter = f;
+		ctx->Slack = slack;
+		if (slack == 0)
+		    return;
+	    }
+	}
+    }
+}
+
+static edge_t *enter_edge(nsctx_t * ctx, edge_t * e)
 {
     node_t *v;
     int outsearch;
@@ -237,21 +329,24 @@ static edge_t *enter_edge(edge_t * e)
 	v = aghead(e);
 	outsearch = TRUE;
     }
-    Enter = NULL;
-    Slack = INT_MAX;
-    Low = ND_low(v);
-    Lim = ND_lim(v);
-    if (outsearch)
-	dfs_enter_outedge(v);
+    ctx->Enter = NULL;
+    ctx->Slack = INT_MAX;
+    ctx->Low = ND_low(v);
+    ctx->Lim = ND_lim(v);
+    if ((ctx->mode == NS_INCREMENTAL)
+	&& (2 * (ctx->Lim - ctx->Low + 1) > ctx->N_nodes))
+	scan_enter_complement(ctx, outsearch);
+    else if (outsearch)
+	dfs_enter_outedge(ctx, v);
     else
-	dfs_enter_inedge(v);
-    return Enter;
+	dfs_enter_inedge(ctx, v);
+    return ctx->Enter;
 }
 
-static void init_cutvalues(void)
+static void init_cutvalues(nsctx_t * ctx)
 {
-    dfs_range(GD_nlist(G), NULL, 1);
-    dfs_cutval(GD_nlist(G), NULL);
+    dfs_range(GD_nlist(ctx->G), NULL, 1);
+    dfs_cutval(GD_nlist(ctx->G), NULL);
 }
 
 /* functions for initial tight tree construction */
@@ -264,10 +359,11 @@ typedef struct subtree_s {
         int    size;            /* total tight tree size */
         int    heap_index;      /* required to find non-min elts when merged */
         struct subtree_s *par;  /* union find */
+        struct subtree_s *child, *sib, *prev;  /* pairing heap links */
 } subtree_t;
 
 /* find initial tight subtrees */
-static int tight_subtree_search(Agnode_t *v, subtree_t *st)
+static int tight_subtree_search(nsctx_t *ctx, Agnode_t *v, subtree_t *st)
 {
     Agedge_t *e;
     int     i;
@@ -278,26 +374,26 @@ static int tight_subtree_search(Agnode_t *v, subtree_t *st)
     for (i = 0; (e = ND_in(v).list[i]); i++) {
         if (TREE_EDGE(e)) continue;
         if ((ND_subtree(agtail(e)) == 0) && (SLACK(e) == 0)) {
-               add_tree_edge(e);
-               rv += tight_subtree_search(agtail(e),st);
+               add_tree_edge(ctx, e);
+               rv += tight_subtree_search(ctx,agtail(e),st);
         }
     }
     for (i = 0; (e = ND_out(v).list[i]); i++) {
         if (TREE_EDGE(e)) continue;
         if ((ND_subtree(aghead(e)) == 0) && (SLACK(e) == 0)) {
-               add_tree_edge(e);
-               rv += tight_subtree_search(aghead(e),st);
+               add_tree_edge(ctx, e);
+               rv += tight_subtree_search(ctx,aghead(e),st);
         }
     }
     return rv;
 }
 
-static subtree_t *find_tight_subtree(Agnode_t *v)
+static subtree_t *find_tight_subtree(nsctx_t *ctx, Agnode_t *v)
 {
     subtree_t       *rv;
     rv = NEW(subtree_t);
     rv->rep = v;
-    rv->size = tight_subtree_search(v,rv);
+    rv->size = tight_subtree_search(ctx,v,rv);
     rv->par = rv;
     return rv;
 }
@@ -435,6 +531,110 @@ subtree_t *STextractmin(STheap_t *heap)
     return rv;
 }
 
+/* Pairing heap of subtrees, keyed on size, used by NS_INCREMENTAL.
+ * Merging a subtree into one still in the heap only grows the key of the
+ * survivor, which is handled by cutting it out and melding it back in,
+ * instead of sifting through an array as STheapify does.
+ * As with the array heap, heap_index is -1 once a subtree is extracted.
+ */
+typedef struct {
+        subtree_t       *root;
+        int             size;
+} STpheap_t;
+
+static subtree_t *STmeld(subtree_t *a, subtree_t *b)
+{
+    subtree_t *t;
+
+    if (!a) return b;
+    if (!b) return a;
+    if (b->size < a->size) {
+        t = a; a = b; b = t;
+    }
+    b->prev = a;
+    b->sib = a->child;
+    if (a->child) a->child->prev = b;
+    a->child = b;
+    a->sib = a->prev = NULL;
+    return a;
+}
+
+/* STmergepairs:
+ * Standard two-pass combine of a sibling list, done iteratively.
+ */
+static subtree_t *STmergepairs(subtree_t *first)
+{
+    subtree_t *a, *b, *next, *pairs = NULL, *rv = NULL;
+
+    while (first) {
+        a = first;
+        b = a->sib;
+        next = (b ? b->sib : NULL);
+        a->sib = a->prev = NULL;
+        if (b) {
+            b->sib = b->prev = NULL;
+            a = STmeld(a, b);
+        }
+        a->sib = pairs;
+        pairs = a;
+        first = next;
+    }
+    while (pairs) {
+        next = pairs->sib;
+        pairs->sib = NULL;
+        rv = STmeld(rv, pairs);
+        pairs = next;
+    }
+    return rv;
+}
+
+static
+STpheap_t *STbuildpheap(subtree_t **elt, int size)
+{
+    int     i;
+    STpheap_t *heap;
+    heap = NEW(STpheap_t);
+    for (i = 0; i < size; i++) {
+        elt[i]->heap_index = 0;
+        heap->root = STmeld(heap->root, elt[i]);
+    }
+    heap->size = size;
+    return heap;
+}
+
+static
+subtree_t *STpextractmin(STpheap_t *heap)
+{
+    subtree_t *rv = heap->root;
+    heap->root = STmergepairs(rv->child);
+    rv->child = NULL;
+    rv->heap_index = -1;
+    heap->size--;
+    return rv;
+}
+
+/* STpresize:
+ * Reposition st, whose size has grown, in the heap.
+ */
+static
+void STpresize(STpheap_t *heap, subtree_t *st)
+{
+    subtree_t *kids;
+
+    if (st == heap->root) {
+        heap->root = STmergepairs(st->child);
+    }
+    else {
+        if (st->prev->child == st) st->prev->child = st->sib;
+        else st->prev->sib = st->sib;
+        if (st->sib) st->sib->prev = st->prev;
+        kids = STmergepairs(st->child);
+        heap->root = STmeld(heap->root, kids);
+    }
+    st->child = st->sib = st->prev = NULL;
+    heap->root = STmeld(heap->root, st);
+}
+
 static
 void tree_adjust(Agnode_t *v, Agnode_t *from, int delta)
 {
@@ -455,7 +655,7 @@ void tree_adjust(Agnode_t *v, Agnode_t *from, int delta)
 }
 
 static
-subtree_t *merge_trees(Agedge_t *e)   /* entering tree edge */
+subtree_t *merge_trees(nsctx_t *ctx, Agedge_t *e)   /* entering tree edge */
 {
   int       delta;
   subtree_t *t0, *t1, *rv;
@@ -465,7 +665,7 @@ subtree_t *merge_trees(Agedge_t *e)   /* entering tree edge */
   t0 = STsetFind(agtail(e));
   t1 = STsetFind(aghead(e));
 
-  //fprintf(stderr,"merge trees of %d %d of %d, delta %d\n",t0->size,t1->size,N_nodes,delta);
+  //fprintf(stderr,"merge trees of %d %d of %d, delta %d\n",t0->size,t1->size,ctx->N_nodes,delta);
 
   if (t0->heap_index == -1) {   // move t0
     delta = SLACK(e);
@@ -475,7 +675,7 @@ subtree_t *merge_trees(Agedge_t *e)   /* entering tree edge */
     delta = -SLACK(e);
     tree_adjust(t1->rep,0,delta);
   }
-  add_tree_edge(e);
+  add_tree_edge(ctx, e);
   rv = STsetUnion(t0,t1);
   
   return rv;
@@ -487,47 +687,63 @@ subtree_t *merge_trees(Agedge_t *e)   /* entering tree edge */
  * Return 1 if input graph is not connected; 0 on success.
  */
 static
-int feasible_tree(void)
+int feasible_tree(nsctx_t *ctx)
 {
   Agnode_t *n;
   Agedge_t *ee;
   subtree_t **tree, *tree0, *tree1;
   int i, subtree_count = 0;
   STheap_t *heap;
+  STpheap_t *pheap;
   int error = 0;
 
   /* initialization */
-  for (n = GD_nlist(G); n; n = ND_next(n)) {
+  for (n = GD_nlist(ctx->G); n; n = ND_next(n)) {
       ND_subtree_set(n,0);
   }
 
-  tree = N_NEW(N_nodes,subtree_t*);
+  tree = N_NEW(ctx->N_nodes,subtree_t*);
   /* given init_rank, find all tight subtrees */
-  for (n = GD_nlist(G); n; n = ND_next(n)) {
+  for (n = GD_nlist(ctx->G); n; n = ND_next(n)) {
         if (ND_subtree(n) == 0) {
-                tree[subtree_count] = find_tight_subtree(n);
+                tree[subtree_count] = find_tight_subtree(ctx,n);
                 subtree_count++;
         }
   }
 
   /* incrementally merge subtrees */
-  heap = STbuildheap(tree,subtree_count);
-  while (STheapsize(heap) > 1) {
-    tree0 = STextractmin(heap);
-    if (!(ee = inter_tree_edge(tree0))) {
-      error = 1;
-      break;
+  if (ctx->mode == NS_INCREMENTAL) {
+    pheap = STbuildpheap(tree,subtree_count);
+    while (pheap->size > 1) {
+      tree0 = STpextractmin(pheap);
+      if (!(ee = inter_tree_edge(tree0))) {
+        error = 1;
+        break;
+      }
+      tree1 = merge_trees(ctx,ee);
+      STpresize(pheap,tree1);
     }
-    tree1 = merge_trees(ee);
-    STheapify(heap,tree1->heap_index);
+    free(pheap);
+  }
+  else {
+    heap = STbuildheap(tree,subtree_count);
+    while (STheapsize(heap) > 1) {
+      tree0 = STextractmin(heap);
+      if (!(ee = inter_tree_edge(tree0))) {
+        error = 1;
+        break;
+      }
+      tree1 = merge_trees(ctx,ee);
+      STheapify(heap,tree1->heap_index);
+    }
+    free(heap);
   }
 
-  free(heap);
   for (i = 0; i < subtree_count; i++) free(tree[i]);
   free(tree);
   if (error) return 1;
-  assert(Tree_edge.size == N_nodes - 1);
-  init_cutvalues();
+  assert(ctx->Tree_edge.size == ctx->N_nodes - 1);
+  init_cutvalues(ctx);
   return 0;
 }
 
@@ -575,11 +791,35 @@ static void rerank(Agnode_t * v, int delta)
 	    rerank(agtail(e), delta);
 }
 
+/* invalidate_path:
+ * Mark the nodes on the tree path from to_node up to lca as needing
+ * renumbering, by clearing ND_low. These are the only nodes whose
+ * subtrees change when a tree edge below lca is exchanged, so
+ * dfs_range_incr can skip everything else.
+ */
+static void invalidate_path(node_t * lca, node_t * to_node)
+{
+    edge_t *e;
+
+    for (;;) {
+	if (ND_low(to_node) == -1)
+	    break;
+	ND_low(to_node) = -1;
+	e = ND_par(to_node);
+	if ((e == NULL) || (ND_lim(to_node) >= ND_lim(lca)))
+	    break;
+	if (ND_lim(agtail(e)) > ND_lim(aghead(e)))
+	    to_node = agtail(e);
+	else
+	    to_node = aghead(e);
+    }
+}
+
 /* e is the tree edge that is leaving and f is the nontree edge that
  * is entering.  compute new cut values, ranks, and exchange e and f.
  */
 static void 
-update(edge_t * e, edge_t * f)
+update(nsctx_t * ctx, edge_t * e, edge_t * f)
 {
     int cutvalue, delta;
     Agnode_t *lca;
@@ -608,54 +848,63 @@ update(edge_t * e, edge_t * f)
     lca = treeupdate(agtail(f), aghead(f), cutvalue, 1);
     if (treeupdate(aghead(f), agtail(f), cutvalue, 0) != lca) {
 	agerr(AGERR, "update: mismatched lca in treeupdates\n");
-	longjmp (jbuf, 1);
+	longjmp (ctx->jbuf, 1);
     }
     ED_cutvalue(f) = -cutvalue;
     ED_cutvalue(e) = 0;
-    exchange_tree_edges(e, f);
-    dfs_range(lca, ND_par(lca), ND_low(lca));
+    if (ctx->mode == NS_INCREMENTAL) {
+	int lca_low = ND_low(lca);
+	invalidate_path(lca, aghead(f));
+	invalidate_path(lca, agtail(f));
+	exchange_tree_edges(ctx, e, f);
+	dfs_range_incr(lca, ND_par(lca), lca_low);
+    }
+    else {
+	exchange_tree_edges(ctx, e, f);
+	dfs_range(lca, ND_par(lca), ND_low(lca));
+    }
 }
 
-static void scan_and_normalize(void)
+static void scan_and_normalize(nsctx_t * ctx)
 {
     node_t *n;
 
-    Minrank = INT_MAX;
-    Maxrank = -INT_MAX;
-    for (n = GD_nlist(G); n; n = ND_next(n)) {
+    ctx->Minrank = INT_MAX;
+    ctx->Maxrank = -INT_MAX;
+    for (n = GD_nlist(ctx->G); n; n = ND_next(n)) {
 	if (ND_node_type(n) == NORMAL) {
-	    Minrank = MIN(Minrank, ND_rank(n));
-	    Maxrank = MAX(Maxrank, ND_rank(n));
+	    ctx->Minrank = MIN(ctx->Minrank, ND_rank(n));
+	    ctx->Maxrank = MAX(ctx->Maxrank, ND_rank(n));
 	}
     }
-    if (Minrank != 0) {
-	for (n = GD_nlist(G); n; n = ND_next(n))
-	    ND_rank(n) -= Minrank;
-	Maxrank -= Minrank;
-	Minrank = 0;
+    if (ctx->Minrank != 0) {
+	for (n = GD_nlist(ctx->G); n; n = ND_next(n))
+	    ND_rank(n) -= ctx->Minrank;
+	ctx->Maxrank -= ctx->Minrank;
+	ctx->Minrank = 0;
     }
 }
 
 static void
-freeTreeList (graph_t* g)
+freeTreeList (nsctx_t * ctx)
 {
     node_t *n;
-    for (n = GD_nlist(G); n; n = ND_next(n)) {
+    for (n = GD_nlist(ctx->G); n; n = ND_next(n)) {
 	free_list(ND_tree_in(n));
 	free_list(ND_tree_out(n));
 	ND_mark(n) = FALSE;
     }
 }
 
-static void LR_balance(void)
+static void LR_balance(nsctx_t * ctx)
 {
     int i, delta;
     edge_t *e, *f;
 
-    for (i = 0; i < Tree_edge.size; i++) {
-	e = Tree_edge.list[i];
+    for (i = 0; i < ctx->Tree_edge.size; i++) {
+	e = ctx->Tree_edge.list[i];
 	if (ED_cutvalue(e) == 0) {
-	    f = enter_edge(e);
+	    f = enter_edge(ctx, e);
 	    if (f == NULL)
 		continue;
 	    delta = SLACK(f);
@@ -667,7 +916,7 @@ static void LR_balance(void)
 		rerank(aghead(e), -delta / 2);
 	}
     }
-    freeTreeList (G);
+    freeTreeList (ctx);
 }
 
 static int decreasingrankcmpf(node_t **n0, node_t **n1) {
@@ -678,7 +927,7 @@ static int increasingrankcmpf(node_t **n0, node_t **n1) {
   return ND_rank(*n0) - ND_rank(*n1);
 }
 
-static void TB_balance(void)
+static void TB_balance(nsctx_t * ctx)
 {
     node_t *n;
     edge_t *e;
@@ -687,38 +936,38 @@ static void TB_balance(void)
     int adj = 0;
     char *s;
 
-    scan_and_normalize();
+    scan_and_normalize(ctx);
 
     /* find nodes that are not tight and move to less populated ranks */
-    nrank = N_NEW(Maxrank + 1, int);
-    for (i = 0; i <= Maxrank; i++)
+    nrank = N_NEW(ctx->Maxrank + 1, int);
+    for (i = 0; i <= ctx->Maxrank; i++)
 	nrank[i] = 0;
-    if (s = agget(G,"TBbalance")) {
+    if (s = agget(ctx->G,"TBbalance")) {
          if (streq(s,"min")) adj = 1;
          else if (streq(s,"max")) adj = 2;
-         if (adj) for (n = GD_nlist(G); n; n = ND_next(n))
+         if (adj) for (n = GD_nlist(ctx->G); n; n = ND_next(n))
               if (ND_node_type(n) == NORMAL)
                 if (ND_out(n).size == 0)
-                   ND_rank(n) = ((adj == 1)? Minrank : Maxrank);
+                   ND_rank(n) = ((adj == 1)? ctx->Minrank : ctx->Maxrank);
     }
-    for (ii = 0, n = GD_nlist(G); n; ii++, n = ND_next(n)) {
-      Tree_node.list[ii] = n;
+    for (ii = 0, n = GD_nlist(ctx->G); n; ii++, n = ND_next(n)) {
+      ctx->Tree_node.list[ii] = n;
     }
-    Tree_node.size = ii;
-    qsort(Tree_node.list, Tree_node.size, sizeof(Tree_node.list[0]),
+    ctx->Tree_node.size = ii;
+    qsort(ctx->Tree_node.list, ctx->Tree_node.size, sizeof(ctx->Tree_node.list[0]),
         adj > 1? decreasingrankcmpf : increasingrankcmpf);
-    for (i = 0; i < Tree_node.size; i++) {
-        n = Tree_node.list[i];
+    for (i = 0; i < ctx->Tree_node.size; i++) {
+        n = ctx->Tree_node.list[i];
         if (ND_node_type(n) == NORMAL)
           nrank[ND_rank(n)]++;
     }
-    for (ii = 0; ii < Tree_node.size; ii++) {
-      n = Tree_node.list[ii];
+    for (ii = 0; ii < ctx->Tree_node.size; ii++) {
+      n = ctx->Tree_node.list[ii];
       if (ND_node_type(n) != NORMAL)
         continue;
       inweight = outweight = 0;
       low = 0;
-      high = Maxrank;
+      high = ctx->Maxrank;
       for (i = 0; (e = ND_in(n).list[i]); i++) {
         inweight += ED_weight(e);
         low = MAX(low, ND_rank(agtail(e)) + ED_minlen(e));
@@ -751,25 +1000,25 @@ static void TB_balance(void)
     free(nrank);
 }
 
-static int init_graph(graph_t * g)
+static int init_graph(nsctx_t * ctx, graph_t * g)
 {
     int i, feasible;
     node_t *n;
     edge_t *e;
 
-    G = g;
-    N_nodes = N_edges = S_i = 0;
+    ctx->G = g;
+    ctx->N_nodes = ctx->N_edges = ctx->S_i = 0;
     for (n = GD_nlist(g); n; n = ND_next(n)) {
 	ND_mark(n) = FALSE;
-	N_nodes++;
+	ctx->N_nodes++;
 	for (i = 0; (e = ND_out(n).list[i]); i++)
-	    N_edges++;
+	    ctx->N_edges++;
     }
 
-    Tree_node.list = ALLOC(N_nodes, Tree_node.list, node_t *);
-    Tree_node.size = 0;
-    Tree_edge.list = ALLOC(N_nodes, Tree_edge.list, edge_t *);
-    Tree_edge.size = 0;
+    ctx->Tree_node.list = N_NEW(ctx->N_nodes, node_t *);
+    ctx->Tree_node.size = 0;
+    ctx->Tree_edge.list = N_NEW(ctx->N_nodes, edge_t *);
+    ctx->Tree_edge.size = 0;
 
     feasible = TRUE;
     for (n = GD_nlist(g); n; n = ND_next(n)) {
@@ -812,19 +1061,11 @@ graphSize (graph_t * g, int* nn, int* ne)
     *ne = nedges;
 }
 
-/* rank:
- * Apply network simplex to rank the nodes in a graph.
- * Uses ED_minlen as the internode constraint: if a->b with minlen=ml,
- * rank b - rank a >= ml.
- * Assumes the graph has the following additional structure:
- *   A list of all nodes, starting at GD_nlist, and linked using ND_next.
- *   Out and in edges lists stored in ND_out and ND_in, even if the node
- *  doesn't have any out or in edges.
- * The node rank values are stored in ND_rank.
- * Returns 0 if successful; returns 1 if the graph was not connected;
- * returns 2 if something seriously wrong;
+/* ns_solve:
+ * Body of rank2, run against the caller-supplied solver context.
  */
-int rank2(graph_t * g, int balance, int maxiter, int search_size)
+static int
+ns_solve(nsctx_t * ctx, graph_t * g, int balance, int maxiter, int search_size)
 {
     int iter = 0, feasible;
     char *ns = "network simplex: ";
@@ -840,30 +1081,33 @@ int rank2(graph_t * g, int balance, int maxiter, int search_size)
 	    nn, ne, maxiter, balance);
 	start_timer();
     }
-    feasible = init_graph(g);
+    feasible = init_graph(ctx, g);
     if (!feasible)
-	init_rank();
+	init_rank(ctx);
     if (maxiter <= 0) {
-	freeTreeList (g);
+	freeTreeList (ctx);
 	return 0;
     }
 
     if (search_size >= 0)
-	Search_size = search_size;
+	ctx->Search_size = search_size;
     else
-	Search_size = SEARCHSIZE;
+	ctx->Search_size = SEARCHSIZE;
 
-    if (setjmp (jbuf)) {
+    if (setjmp (ctx->jbuf)) {
 	return 2;
     }
 
-    if (feasible_tree()) {
-	freeTreeList (g);
+    if (feasible_tree(ctx)) {
+	freeTreeList (ctx);
 	return 1;
     }
-    while ((e = leave_edge())) {
-	f = enter_edge(e);
-	update(e, f);
+    if (ctx->mode == NS_INCREMENTAL)
+	ctx->Cand.list = N_NEW(MAX(ctx->N_nodes, 1), edge_t *);
+    while ((e = (ctx->mode == NS_INCREMENTAL ? leave_edge_cand(ctx)
+					      : leave_edge(ctx)))) {
+	f = enter_edge(ctx, e);
+	update(ctx, e, f);
 	iter++;
 	if (Verbose && (iter % 100 == 0)) {
 	    if (iter % 1000 == 100)
@@ -877,25 +1121,74 @@ int rank2(graph_t * g, int balance, int maxiter, int search_size)
     }
     switch (balance) {
     case 1:
-	TB_balance();
+	TB_balance(ctx);
 	break;
     case 2:
-	LR_balance();
+	LR_balance(ctx);
 	break;
     default:
-	scan_and_normalize();
-	freeTreeList (G);
+	scan_and_normalize(ctx);
+	freeTreeList (ctx);
 	break;
     }
     if (Verbose) {
 	if (iter >= 100)
 	    fputc('\n', stderr);
 	fprintf(stderr, "%s%d nodes %d edges %d iter %.2f sec\n",
-		ns, N_nodes, N_edges, iter, elapsed_sec());
+		ns, ctx->N_nodes, ctx->N_edges, iter, elapsed_sec());
     }
     return 0;
 }
 
+/* rank:
+ * Apply network simplex to rank the nodes in a graph.
+ * Uses ED_minlen as the internode constraint: if a->b with minlen=ml,
+ * rank b - rank a >= ml.
+ * Assumes the graph has the following additional structure:
+ *   A list of all nodes, starting at GD_nlist, and linked using ND_next.
+ *   Out and in edges lists stored in ND_out and ND_in, even if the node
+ *  doesn't have any out or in edges.
+ * The node rank values are stored in ND_rank.
+ * Returns 0 if successful; returns 1 if the graph was not connected;
+ * returns 2 if something seriously wrong;
+ * All solver state lives in a context local to the call, so rank2 may be
+ * run concurrently on distinct graphs.
+ * nsrank additionally selects the engine: NS_CLASSIC is the original
+ * solver; NS_INCREMENTAL merges initial subtrees with a pairing heap,
+ * picks leaving edges from a candidate list, and renumbers only the
+ * part of the tree touched by each exchange.
+ */
+int nsrank(graph_t * g, int balance, int maxiter, int search_size, int mode)
+{
+    nsctx_t ctx;
+    int rv;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.mode = mode;
+    rv = ns_solve(&ctx, g, balance, maxiter, search_size);
+    free(ctx.Tree_node.list);
+    free(ctx.Tree_edge.list);
+    free(ctx.Cand.list);
+    return rv;
+}
+
+int rank2(graph_t * g, int balance, int maxiter, int search_size)
+{
+    return nsrank(g, balance, maxiter, search_size, NS_CLASSIC);
+}
+
+/* nsmode:
+ * Return the network simplex engine requested by the nsmode attribute of g.
+ */
+int nsmode(graph_t * g)
+{
+    char *s = agget(g, "nsmode");
+
+    if (s && (streq(s, "incremental") || streq(s, "incr")))
+	return NS_INCREMENTAL;
+    return NS_CLASSIC;
+}
+
 int rank(graph_t * g, int balance, int maxiter)
 {
     char *s;
@@ -906,7 +1199,7 @@ int rank(graph_t * g, int balance, int maxiter)
     else
 	search_size = SEARCHSIZE;
 
-    return rank2 (g, balance, maxiter, search_size);
+    return nsrank (g, balance, maxiter, search_size, nsmode(g));
 }
 
 /* set cut value of f, assuming values of edges on one side were already set */
@@ -1004,8 +1297,34 @@ static int dfs_range(node_t * v, edge_t * par, int low)
     return lim + 1;
 }
 
+/* dfs_range_incr:
+ * As dfs_range, but stop at any subtree whose parent edge and low value
+ * are unchanged, since its numbering is still valid.
+ * Callers must first clear ND_low along the paths that did change;
+ * see invalidate_path.
+ */
+static int dfs_range_incr(node_t * v, edge_t * par, int low)
+{
+    edge_t *e;
+    int i, lim;
+
+    if ((ND_par(v) == par) && (ND_low(v) == low))
+	return ND_lim(v) + 1;
+    lim = low;
+    ND_par(v) = par;
+    ND_low(v) = low;
+    for (i = 0; (e = ND_tree_out(v).list[i]); i++)
+	if (e != par)
+	    lim = dfs_range_incr(aghead(e), e, lim);
+    for (i = 0; (e = ND_tree_in(v).list[i]); i++)
+	if (e != par)
+	    lim = dfs_range_incr(agtail(e), e, lim);
+    ND_lim(v) = lim;
+    return lim + 1;
+}
+
 #ifdef DEBUG
-void tchk(void)
+void tchk(nsctx_t * ctx)
 {
     int i, n_cnt, e_cnt;
     node_t *n;
@@ -1013,7 +1332,7 @@ void tchk(void)
 
     n_cnt = 0;
     e_cnt = 0;
-    for (n = agfstnode(G); n; n = agnxtnode(G, n)) {
+    for (n = agfstnode(ctx->G); n; n = agnxtnode(ctx->G, n)) {
 	n_cnt++;
 	for (i = 0; (e = ND_tree_out(n).list[i]); i++) {
 	    e_cnt++;
@@ -1021,17 +1340,17 @@ void tchk(void)
 		fprintf(stderr, "not a tight tree %p", e);
 	}
     }
-    if ((n_cnt != Tree_node.size) || (e_cnt != Tree_edge.size))
+    if ((n_cnt != ctx->Tree_node.size) || (e_cnt != ctx->Tree_edge.size))
 	fprintf(stderr, "something missing\n");
 }
 
-void check_cutvalues(void)
+void check_cutvalues(nsctx_t * ctx)
 {
     node_t *v;
     edge_t *e;
     int i, save;
 
-    for (v = agfstnode(G); v; v = agnxtnode(G, v)) {
+    for (v = agfstnode(ctx->G); v; v = agnxtnode(ctx->G, v)) {
 	for (i = 0; (e = ND_tree_out(v).list[i]); i++) {
 	    save = ED_cutvalue(e);
 	    x_cutval(e);
@@ -1041,14 +1360,14 @@ void check_cutvalues(void)
     }
 }
 
-int check_ranks(void)
+int check_ranks(nsctx_t * ctx)
 {
     int cost = 0;
     node_t *n;
     edge_t *e;
 
-    for (n = agfstnode(G); n; n = agnxtnode(G, n)) {
-	for (e = agfstout(G, n); e; e = agnxtout(G, e)) {
+    for (n = agfstnode(ctx->G); n; n = agnxtnode(ctx->G, n)) {
+	for (e = agfstout(ctx->G, n); e; e = agnxtout(ctx->G, e)) {
 	    cost += (ED_weight(e)) * abs(LENGTH(e));
 	    if (ND_rank(aghead(e)) - ND_rank(agtail(e)) - ED_minlen(e) < 0)
 		abort();
@@ -1058,13 +1377,13 @@ int check_ranks(void)
     return cost;
 }
 
-void checktree(void)
+void checktree(nsctx_t * ctx)
 {
     int i, n = 0, m = 0;
     node_t *v;
     edge_t *e;
 
-    for (v = agfstnode(G); v; v = agnxtnode(G, v)) {
+    for (v = agfstnode(ctx->G); v; v = agnxtnode(ctx->G, v)) {
 	for (i = 0; (e = ND_tree_out(v).list[i]); i++)
 	    n++;
 	if (i != ND_tree_out(v).size)
@@ -1074,7 +1393,7 @@ void checktree(void)
 	if (i != ND_tree_in(v).size)
 	    abort();
     }
-    fprintf(stderr, "%d %d %d\n", Tree_edge.size, n, m);
+    fprintf(stderr, "%d %d %d\n", ctx->Tree_edge.size, n, m);
 }
 
 void check_fast_node(node_t * n)
@@ -0,0 +1,191 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property 
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/*
+ * A small pool of worker threads for data parallel loops.
+ *
+ * parallel_for splits a loop into a fixed number of chunks of consecutive
+ * iterations. Which thread runs a chunk varies from run to run, but the
+ * chunk boundaries depend only on the number of iterations and chunks.
+ * A caller that keeps per chunk results, and combines them in chunk order,
+ * therefore gets the same answer on every run. Without thread support,
+ * the chunks are run in order by the calling thread.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include "render.h"
+#include "parallel.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#define MAXTHREADS 256
+
+/* parallel_threads:
+ * Number of threads to use for layout of g, from the graph attribute
+ * "threads" or, if that is not set, the environment variable GV_THREADS.
+ * The default is 1.
+ */
+int parallel_threads(void *g)
+{
+    char *p = NULL;
+    int n;
+
+    if (g)
+	p = agget(g, "threads");
+    if (!p || !*p)
+	p = getenv("GV_THREADS");
+    if (!p || (n = atoi(p)) < 1)
+	return 1;
+    return MIN(n, MAXTHREADS);
+}
+
+#define CHUNKLO(n,k,c)	((int)(((long long)(n) * (c)) / (k)))
+
+#ifdef HAVE_PTHREAD
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;	/* signalled when a loop is posted */
+    pthread_cond_t done;	/* signalled when its last chunk finishes */
+    int nworkers;
+    int busy;			/* a loop is running */
+    unsigned long gen;		/* counts posted loops */
+    parallel_fn fn;
+    void *state;
+    int n, nchunks;
+    int next;			/* next chunk to hand out */
+    int pending;		/* chunks not yet finished */
+    int quit;			/* workers are to exit */
+} Pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	   PTHREAD_COND_INITIALIZER, 0, 0, 0, NULL, NULL, 0, 0, 0, 0, 0 };
+static pthread_t Workers[MAXTHREADS];
+
+/* runchunks:
+ * Run chunks of the current loop until none are left.
+ * Called and returns with Pool.lock held.
+ */
+static void runchunks(void)
+{
+    int c;
+
+    while (Pool.next < Pool.nchunks) {
+	c = Pool.next++;
+	pthread_mutex_unlock(&Pool.lock);
+	Pool.fn(Pool.state, c, CHUNKLO(Pool.n, Pool.nchunks, c),
+		CHUNKLO(Pool.n, Pool.nchunks, c + 1));
+	pthread_mutex_lock(&Pool.lock);
+	if (--Pool.pending == 0)
+	    pthread_cond_broadcast(&Pool.done);
+    }
+}
+
+static void *worker(void *arg)
+{
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&Pool.lock);
+    for (;;) {
+	while (Pool.gen == seen && !Pool.quit)
+	    pthread_cond_wait(&Pool.work, &Pool.lock);
+	if (Pool.quit)
+	    break;
+	seen = Pool.gen;
+	runchunks();
+    }
+    pthread_mutex_unlock(&Pool.lock);
+    return arg;
+}
+
+/* startworkers:
+ * Make sure there are at least n workers. Return the number there are.
+ */
+static int startworkers(int n)
+{
+    while (Pool.nworkers < n) {
+	if (pthread_create(&Workers[Pool.nworkers], NULL, worker, NULL))
+	    break;
+	Pool.nworkers++;
+    }
+    return Pool.nworkers;
+}
+#endif
+
+/* parallel_shutdown:
+ * Wait for a running loop to finish, then stop and join the workers.
+ * A later parallel_for starts new ones.
+ */
+void parallel_shutdown(void)
+{
+#ifdef HAVE_PTHREAD
+    int i, n;
+
+    pthread_mutex_lock(&Pool.lock);
+    while (Pool.busy)
+	pthread_cond_wait(&Pool.done, &Pool.lock);
+    n = Pool.nworkers;
+    Pool.quit = 1;
+    pthread_cond_broadcast(&Pool.work);
+    pthread_mutex_unlock(&Pool.lock);
+
+    for (i = 0; i < n; i++)
+	pthread_join(Workers[i], NULL);
+
+    pthread_mutex_lock(&Pool.lock);
+    Pool.nworkers = 0;
+    Pool.quit = 0;
+    pthread_mutex_unlock(&Pool.lock);
+#endif
+}
+
+/* parallel_for:
+ * Call fn(state, c, lo, hi) for c = 0..nchunks-1, where the chunks'
+ * [lo,hi) ranges partition [0,n) in order. Chunks run concurrently
+ * on up to nchunks threads; parallel_for returns when all are done.
+ * A parallel_for issued while another is running, e.g. from within
+ * fn, runs its chunks in the calling thread.
+ */
+void parallel_for(int n, int nchunks, parallel_fn fn, void *state)
+{
+    int c;
+
+    if (nchunks < 1)
+	nchunks = 1;
+#ifdef HAVE_PTHREAD
+    if (nchunks > 1) {
+	pthread_mutex_lock(&Pool.lock);
+	if (!Pool.busy && startworkers(MIN(nchunks, MAXTHREADS) - 1) > 0) {
+	    Pool.busy = 1;
+	    Pool.fn = fn;
+	    Pool.state = state;
+	    Pool.n = n;
+	    Pool.nchunks = nchunks;
+	    Pool.next = 0;
+	    Pool.pending = nchunks;
+	    Pool.gen++;
+	    pthread_cond_broadcast(&Pool.work);
+	    runchunks();
+	    while (Pool.pending > 0)
+		pthread_cond_wait(&Pool.done, &Pool.lock);
+	    Pool.busy = 0;
+	    pthread_cond_broadcast(&Pool.done);
+	    pthread_mutex_unlock(&Pool.lock);
+	    return;
+	}
+	pthread_mutex_unlock(&Pool.lock);
+    }
+#endif
+    for (c = 0; c < nchunks; c++)
+	fn(state, c, CHUNKLO(n, nchunks, c), CHUNKLO(n, nchunks, c + 1));
+}
@@ -0,0 +1,44 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property 
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+#ifndef GV_PARALLEL_H
+#define GV_PARALLEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*visual studio*/
+#ifdef _WIN32
+#ifndef GVC_EXPORTS
+#define extern __declspec(dllimport)
+#endif
+#endif
+/*end visual studio*/
+
+/* Work function for parallel_for. It is called once for each chunk,
+ * with the chunk's index and its range [lo,hi) of the iterations.
+ */
+typedef void (*parallel_fn) (void *state, int chunk, int lo, int hi);
+
+extern int parallel_threads(void *g);
+extern void parallel_for(int n, int nchunks, parallel_fn fn, void *state);
+extern void parallel_shutdown(void);
+
+#undef extern
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
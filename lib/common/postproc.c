@@ -14,6 +14,7 @@
 
 #include "render.h"
 #include "xlabels.h"
+#include "parallel.h"
 
 static int Rankdir;
 static boolean Flip;
@@ -421,6 +422,8 @@ static void addXLabels(Agraph_t * gp)
     object_t* objp;
     xlabel_t* xlp;
     Agsym_t* force;
+    Agsym_t* tiled;
+    Agsym_t* bulk;
     int et = EDGE_TYPE(gp);
 
     if (!(GD_has_labels(gp) & NODE_XLABEL) &&
@@ -566,8 +569,13 @@ static void addXLabels(Agraph_t * gp)
     }
 
     force = agfindgraphattr(gp, "forcelabels");
+    tiled = agfindgraphattr(gp, "xlabeltiles");
+    bulk = agfindgraphattr(gp, "xlabelbulk");
 
     params.force = late_bool(gp, force, TRUE);
+    params.tiled = late_bool(gp, tiled, FALSE);
+    params.bulk = late_bool(gp, bulk, FALSE);
+    params.nthreads = params.tiled ? parallel_threads(gp) : 1;
     params.bb = bb;
     placeLabels(objs, n_objs, lbls, n_lbls, &params);
     if (Verbose)
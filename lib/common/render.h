@@ -56,6 +56,8 @@ extern "C" {
 	point offset;
     } epsf_t;
 
+    typedef struct splrouter_s splrouter_t;	/* see routespl.c */
+
 /*visual studio*/
 #ifdef _WIN32
 #ifndef GVC_EXPORTS
@@ -134,6 +136,10 @@ extern "C" {
     extern void pop_obj_state(GVJ_t *job);
     extern obj_state_t* push_obj_state(GVJ_t *job);
     extern int rank(graph_t * g, int balance, int maxiter);
+    extern int rank2(graph_t * g, int balance, int maxiter, int search_size);
+    extern int nsrank(graph_t * g, int balance, int maxiter, int search_size,
+		     int mode);
+    extern int nsmode(graph_t * g);
     extern port resolvePort(node_t*  n, node_t* other, port* oldport);
     extern void resolvePorts (edge_t* e);
     extern void round_corners(GVJ_t * job, pointf * AF, int sides, int style, int filled);
@@ -142,6 +148,10 @@ extern "C" {
     extern void routesplinesterm(void);
     extern pointf* simpleSplineRoute (pointf, pointf, Ppoly_t, int*, int);
     extern pointf *routepolylines(path* pp, int* npoints);
+    extern splrouter_t *new_splrouter(boolean quiet);
+    extern void free_splrouter(splrouter_t *);
+    extern pointf *routesplines_r(splrouter_t *, path *, int *);
+    extern pointf *routepolylines_r(splrouter_t *, path *, int *);
     extern int selfRightSpace (edge_t* e);
     extern void setup_graph(GVC_t * gvc, graph_t * g);
     extern shape_kind shapeOf(node_t *);
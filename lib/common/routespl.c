@@ -30,19 +30,28 @@ static int maxbn = 0;
 static edge_t *origedge;
 #endif
 
-static int nedges, nboxes; /* total no. of edges and boxes used in routing */
-
 static int routeinit;
-/* static data used across multiple edges */
-static pointf *ps;             /* final spline points */
-static int maxpn;             /* size of ps[] */
-static Ppoint_t *polypoints;  /* vertices of polygon defined by boxes */
-static int polypointn;        /* size of polypoints[] */
-static Pedge_t *edges;        /* polygon edges passed to Proutespline */
-static int edgen;             /* size of edges[] */
-
-static int checkpath(int, boxf*, path*);
-static int mkspacep(int size);
+
+/* data used across multiple edges; routers used by different threads
+ * share none of it.
+ */
+struct splrouter_s {
+    pointf *ps;             /* final spline points */
+    int maxpn;             /* size of ps[] */
+    Ppoint_t *polypoints;  /* vertices of polygon defined by boxes */
+    int polypointn;        /* size of polypoints[] */
+    Pedge_t *edges;        /* polygon edges passed to Proutespline */
+    int edgen;             /* size of edges[] */
+    Pworkspace_t *ws;      /* buffers of the path planner */
+    int nedges, nboxes; /* total no. of edges and boxes used in routing */
+    boolean quiet;         /* if true, report no errors */
+};
+
+/* router of routesplines and routepolylines */
+static splrouter_t Router;
+
+static int checkpath(splrouter_t*, int, boxf*, path*);
+static int mkspacep(splrouter_t*, int size);
 static void printpath(path * pp);
 #ifdef DEBUG
 static void printboxes(int boxn, boxf* boxes)
@@ -234,24 +243,27 @@ simpleSplineRoute (pointf tp, pointf hp, Ppoly_t poly, int* n_spl_pts,
     Ppoint_t eps[2];
     Pvector_t evs[2];
     int i;
+    splrouter_t *rt = &Router;
 
+    if (!rt->ws)
+	rt->ws = Pnewworkspace();
     eps[0].x = tp.x;
     eps[0].y = tp.y;
     eps[1].x = hp.x;
     eps[1].y = hp.y;
-    if (Pshortestpath(&poly, eps, &pl) < 0)
+    if (Pshortestpath_w(rt->ws, &poly, eps, &pl) < 0)
         return NULL;
 
     if (polyline)
-	make_polyline (pl, &spl);
+	make_polyline_w (rt->ws, pl, &spl);
     else {
-	if (poly.pn > edgen) {
-	    edges = ALLOC(poly.pn, edges, Pedge_t);
-	    edgen = poly.pn;
+	if (poly.pn > rt->edgen) {
+	    rt->edges = ALLOC(poly.pn, rt->edges, Pedge_t);
+	    rt->edgen = poly.pn;
 	}
 	for (i = 0; i < poly.pn; i++) {
-	    edges[i].a = poly.ps[i];
-	    edges[i].b = poly.ps[(i + 1) % poly.pn];
+	    rt->edges[i].a = poly.ps[i];
+	    rt->edges[i].b = poly.ps[(i + 1) % poly.pn];
 	}
 #if 0
 	if (pp->start.constrained) {
@@ -267,17 +279,17 @@ simpleSplineRoute (pointf tp, pointf hp, Ppoly_t poly, int* n_spl_pts,
 	} else
 #endif
 	    evs[1].x = evs[1].y = 0;
-	if (Proutespline(edges, poly.pn, pl, evs, &spl) < 0)
+	if (Proutespline_w(rt->ws, rt->edges, poly.pn, pl, evs, &spl) < 0)
             return NULL;
     }
 
-    if (mkspacep(spl.pn))
+    if (mkspacep(rt, spl.pn))
 	return NULL;
     for (i = 0; i < spl.pn; i++) {
-        ps[i] = spl.ps[i];
+        rt->ps[i] = spl.ps[i];
     }
     *n_spl_pts = spl.pn;
-    return ps;
+    return rt->ps;
 }
 
 /* routesplinesinit:
@@ -288,11 +300,11 @@ int
 routesplinesinit()
 {
     if (++routeinit > 1) return 0;
-    if (!(ps = N_GNEW(PINC, pointf))) {
+    if (!(Router.ps = N_GNEW(PINC, pointf))) {
 	agerr(AGERR, "routesplinesinit: cannot allocate ps\n");
 	return 1;
     }
-    maxpn = PINC;
+    Router.maxpn = PINC;
 #ifdef DEBUG
     if (Show_boxes) {
 	int i;
@@ -303,8 +315,8 @@ routesplinesinit()
 	Show_cnt = 0;
     }
 #endif
-    nedges = 0;
-    nboxes = 0;
+    Router.nedges = 0;
+    Router.nboxes = 0;
     if (Verbose)
 	start_timer();
     return 0;
@@ -313,14 +325,51 @@ routesplinesinit()
 void routesplinesterm()
 {
     if (--routeinit > 0) return;
-    free(ps);
+    free(Router.ps);
 #ifdef UNUSED
     free(bs), bs = NULL /*, maxbn = bn = 0 */ ;
 #endif
     if (Verbose)
 	fprintf(stderr,
 		"routesplines: %d edges, %d boxes %.2f sec\n",
-		nedges, nboxes, elapsed_sec());
+		Router.nedges, Router.nboxes, elapsed_sec());
+}
+
+/* new_splrouter:
+ * Return a router with its own buffers, so edges can be routed by
+ * several threads at once. It must be freed by free_splrouter before the
+ * matching routesplinesterm. If quiet is true, no routing errors are
+ * reported; the caller is expected to route a failed edge again with
+ * routesplines.
+ */
+splrouter_t *new_splrouter(boolean quiet)
+{
+    splrouter_t *rt = NEW(splrouter_t);
+
+    if (!(rt->ps = N_GNEW(PINC, pointf))) {
+	free(rt);
+	return NULL;
+    }
+    rt->maxpn = PINC;
+    rt->ws = Pnewworkspace();
+    rt->quiet = quiet;
+    return rt;
+}
+
+/* free_splrouter:
+ * Free the router, adding its counts to those of routesplines.
+ */
+void free_splrouter(splrouter_t *rt)
+{
+    if (!rt)
+	return;
+    Router.nedges += rt->nedges;
+    Router.nboxes += rt->nboxes;
+    free(rt->ps);
+    free(rt->polypoints);
+    free(rt->edges);
+    Pfreeworkspace(rt->ws);
+    free(rt);
 }
 
 static void
@@ -387,7 +436,7 @@ limitBoxes (boxf* boxes, int boxn, pointf *pps, int pn, int delta)
  *
  * If a catastrophic error, return NULL.
  */
-static pointf *_routesplines(path * pp, int *npoints, int polyline)
+static pointf *_routesplines(splrouter_t *rt, path * pp, int *npoints, int polyline)
 {
     Ppoly_t poly;
     Ppolyline_t pl, spl;
@@ -403,8 +452,10 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
     int loopcnt, delta = INIT_DELTA;
     boolean unbounded;
 
-    nedges++;
-    nboxes += pp->nbox;
+    if (!rt->ws)
+	rt->ws = Pnewworkspace();
+    rt->nedges++;
+    rt->nboxes += pp->nbox;
 
     for (realedge = (edge_t *) pp->data;
 #ifdef NOTNOW
@@ -413,14 +464,15 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 	 realedge && ED_edge_type(realedge) != NORMAL;
 	 realedge = ED_to_orig(realedge));
     if (!realedge) {
-	agerr(AGERR, "in routesplines, cannot find NORMAL edge\n");
+	if (!rt->quiet)
+	    agerr(AGERR, "in routesplines, cannot find NORMAL edge\n");
 	return NULL;
     }
 
     boxes = pp->boxes;
     boxn = pp->nbox;
 
-    if (checkpath(boxn, boxes, pp))
+    if (checkpath(rt, boxn, boxes, pp))
 	return NULL;
 
 #ifdef DEBUG
@@ -432,9 +484,9 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
     }
 #endif
 
-    if (boxn * 8 > polypointn) {
-	polypoints = ALLOC(boxn * 8, polypoints, Ppoint_t);
-	polypointn = boxn * 8;
+    if (boxn * 8 > rt->polypointn) {
+	rt->polypoints = ALLOC(boxn * 8, rt->polypoints, Ppoint_t);
+	rt->polypointn = boxn * 8;
     }
 
     if ((boxn > 1) && (boxes[0].LL.y > boxes[1].LL.y)) {
@@ -458,26 +510,27 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 		next = (boxes[bi + 1].LL.y > boxes[bi].LL.y) ? 1 : -1;
 	    if (prev != next) {
 		if (next == -1 || prev == 1) {
-		    polypoints[pi].x = boxes[bi].LL.x;
-		    polypoints[pi++].y = boxes[bi].UR.y;
-		    polypoints[pi].x = boxes[bi].LL.x;
-		    polypoints[pi++].y = boxes[bi].LL.y;
+		    rt->polypoints[pi].x = boxes[bi].LL.x;
+		    rt->polypoints[pi++].y = boxes[bi].UR.y;
+		    rt->polypoints[pi].x = boxes[bi].LL.x;
+		    rt->polypoints[pi++].y = boxes[bi].LL.y;
 		} else {
-		    polypoints[pi].x = boxes[bi].UR.x;
-		    polypoints[pi++].y = boxes[bi].LL.y;
-		    polypoints[pi].x = boxes[bi].UR.x;
-		    polypoints[pi++].y = boxes[bi].UR.y;
+		    rt->polypoints[pi].x = boxes[bi].UR.x;
+		    rt->polypoints[pi++].y = boxes[bi].LL.y;
+		    rt->polypoints[pi].x = boxes[bi].UR.x;
+		    rt->polypoints[pi++].y = boxes[bi].UR.y;
 		}
 	    }
 	    else if (prev == 0) { /* single box */
-		polypoints[pi].x = boxes[bi].LL.x;
-		polypoints[pi++].y = boxes[bi].UR.y;
-		polypoints[pi].x = boxes[bi].LL.x;
-		polypoints[pi++].y = boxes[bi].LL.y;
+		rt->polypoints[pi].x = boxes[bi].LL.x;
+		rt->polypoints[pi++].y = boxes[bi].UR.y;
+		rt->polypoints[pi].x = boxes[bi].LL.x;
+		rt->polypoints[pi++].y = boxes[bi].LL.y;
 	    } 
 	    else {
 		if (!(prev == -1 && next == -1)) {
-		    agerr(AGERR, "in routesplines, illegal values of prev %d and next %d, line %d\n", prev, next, __LINE__);
+		    if (!rt->quiet)
+			agerr(AGERR, "in routesplines, illegal values of prev %d and next %d, line %d\n", prev, next, __LINE__);
 		    return NULL;
 		}
 	    }
@@ -490,42 +543,44 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 		next = (boxes[bi - 1].LL.y > boxes[bi].LL.y) ? 1 : -1;
 	    if (prev != next) {
 		if (next == -1 || prev == 1 ) {
-		    polypoints[pi].x = boxes[bi].LL.x;
-		    polypoints[pi++].y = boxes[bi].UR.y;
-		    polypoints[pi].x = boxes[bi].LL.x;
-		    polypoints[pi++].y = boxes[bi].LL.y;
+		    rt->polypoints[pi].x = boxes[bi].LL.x;
+		    rt->polypoints[pi++].y = boxes[bi].UR.y;
+		    rt->polypoints[pi].x = boxes[bi].LL.x;
+		    rt->polypoints[pi++].y = boxes[bi].LL.y;
 		} else {
-		    polypoints[pi].x = boxes[bi].UR.x;
-		    polypoints[pi++].y = boxes[bi].LL.y;
-		    polypoints[pi].x = boxes[bi].UR.x;
-		    polypoints[pi++].y = boxes[bi].UR.y;
+		    rt->polypoints[pi].x = boxes[bi].UR.x;
+		    rt->polypoints[pi++].y = boxes[bi].LL.y;
+		    rt->polypoints[pi].x = boxes[bi].UR.x;
+		    rt->polypoints[pi++].y = boxes[bi].UR.y;
 		}
 	    } 
 	    else if (prev == 0) { /* single box */
-		polypoints[pi].x = boxes[bi].UR.x;
-		polypoints[pi++].y = boxes[bi].LL.y;
-		polypoints[pi].x = boxes[bi].UR.x;
-		polypoints[pi++].y = boxes[bi].UR.y;
+		rt->polypoints[pi].x = boxes[bi].UR.x;
+		rt->polypoints[pi++].y = boxes[bi].LL.y;
+		rt->polypoints[pi].x = boxes[bi].UR.x;
+		rt->polypoints[pi++].y = boxes[bi].UR.y;
 	    }
 	    else {
 		if (!(prev == -1 && next == -1)) {
 		    /* it went badly, e.g. degenerate box in boxlist */
-		    agerr(AGERR, "in routesplines, illegal values of prev %d and next %d, line %d\n", prev, next, __LINE__);
+		    if (!rt->quiet)
+			agerr(AGERR, "in routesplines, illegal values of prev %d and next %d, line %d\n", prev, next, __LINE__);
 		    return NULL; /* for correctness sake, it's best to just stop */
 		}
-		polypoints[pi].x = boxes[bi].UR.x;
-		polypoints[pi++].y = boxes[bi].LL.y;
-		polypoints[pi].x = boxes[bi].UR.x;
-		polypoints[pi++].y = boxes[bi].UR.y;
-		polypoints[pi].x = boxes[bi].LL.x;
-		polypoints[pi++].y = boxes[bi].UR.y;
-		polypoints[pi].x = boxes[bi].LL.x;
-		polypoints[pi++].y = boxes[bi].LL.y;
+		rt->polypoints[pi].x = boxes[bi].UR.x;
+		rt->polypoints[pi++].y = boxes[bi].LL.y;
+		rt->polypoints[pi].x = boxes[bi].UR.x;
+		rt->polypoints[pi++].y = boxes[bi].UR.y;
+		rt->polypoints[pi].x = boxes[bi].LL.x;
+		rt->polypoints[pi++].y = boxes[bi].UR.y;
+		rt->polypoints[pi].x = boxes[bi].LL.x;
+		rt->polypoints[pi++].y = boxes[bi].LL.y;
 	    }
 	}
     }
     else {
-	agerr(AGERR, "in routesplines, edge is a loop at %s\n", agnameof(aghead(realedge)));
+	if (!rt->quiet)
+	    agerr(AGERR, "in routesplines, edge is a loop at %s\n", agnameof(aghead(realedge)));
 	return NULL;
     }
 
@@ -537,16 +592,17 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 	    boxes[bi].LL.y = -v;
 	}
 	for (i = 0; i < pi; i++)
-	    polypoints[i].y *= -1;
+	    rt->polypoints[i].y *= -1;
     }
 
     for (bi = 0; bi < boxn; bi++)
 	boxes[bi].LL.x = INT_MAX, boxes[bi].UR.x = INT_MIN;
-    poly.ps = polypoints, poly.pn = pi;
+    poly.ps = rt->polypoints, poly.pn = pi;
     eps[0].x = pp->start.p.x, eps[0].y = pp->start.p.y;
     eps[1].x = pp->end.p.x, eps[1].y = pp->end.p.y;
-    if (Pshortestpath(&poly, eps, &pl) < 0) {
-	agerr(AGERR, "in routesplines, Pshortestpath failed\n");
+    if (Pshortestpath_w(rt->ws, &poly, eps, &pl) < 0) {
+	if (!rt->quiet)
+	    agerr(AGERR, "in routesplines, Pshortestpath failed\n");
 	return NULL;
     }
 #ifdef DEBUG
@@ -557,16 +613,16 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 #endif
 
     if (polyline) {
-	make_polyline (pl, &spl);
+	make_polyline_w (rt->ws, pl, &spl);
     }
     else {
-	if (poly.pn > edgen) {
-	    edges = ALLOC(poly.pn, edges, Pedge_t);
-	    edgen = poly.pn;
+	if (poly.pn > rt->edgen) {
+	    rt->edges = ALLOC(poly.pn, rt->edges, Pedge_t);
+	    rt->edgen = poly.pn;
 	}
 	for (edgei = 0; edgei < poly.pn; edgei++) {
-	    edges[edgei].a = polypoints[edgei];
-	    edges[edgei].b = polypoints[(edgei + 1) % poly.pn];
+	    rt->edges[edgei].a = rt->polypoints[edgei];
+	    rt->edges[edgei].b = rt->polypoints[(edgei + 1) % poly.pn];
 	}
 	if (pp->start.constrained) {
 	    evs[0].x = cos(pp->start.theta);
@@ -579,8 +635,9 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 	} else
 	    evs[1].x = evs[1].y = 0;
 
-	if (Proutespline(edges, poly.pn, pl, evs, &spl) < 0) {
-	    agerr(AGERR, "in routesplines, Proutespline failed\n");
+	if (Proutespline_w(rt->ws, rt->edges, poly.pn, pl, evs, &spl) < 0) {
+	    if (!rt->quiet)
+		agerr(AGERR, "in routesplines, Proutespline failed\n");
 	    return NULL;
 	}
 #ifdef DEBUG
@@ -590,7 +647,7 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 	}
 #endif
     }
-    if (mkspacep(spl.pn))
+    if (mkspacep(rt, spl.pn))
 	return NULL;  /* Bailout if no memory left */
 
     for (bi = 0; bi < boxn; bi++) {
@@ -599,11 +656,11 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
     }
     unbounded = TRUE;
     for (splinepi = 0; splinepi < spl.pn; splinepi++) {
-	ps[splinepi] = spl.ps[splinepi];
+	rt->ps[splinepi] = spl.ps[splinepi];
     }
 
     for (loopcnt = 0; unbounded && (loopcnt < LOOP_TRIES); loopcnt++) {
-	limitBoxes (boxes, boxn, ps, spl.pn, delta);
+	limitBoxes (boxes, boxn, rt->ps, spl.pn, delta);
 
     /* The following check is necessary because if a box is not very 
      * high, it is possible that the sampling above might miss it.
@@ -630,10 +687,10 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 	 * loop and we can see the bad edge, and even use the showboxes scaffolding.
 	 */
 	Ppolyline_t polyspl;
-	agerr(AGWARN, "Unable to reclaim box space in spline routing for edge \"%s\" -> \"%s\". Something is probably seriously wrong.\n", agnameof(agtail(realedge)), agnameof(aghead(realedge)));
-	make_polyline (pl, &polyspl);
+	if (!rt->quiet)
+	    agerr(AGWARN, "Unable to reclaim box space in spline routing for edge \"%s\" -> \"%s\". Something is probably seriously wrong.\n", agnameof(agtail(realedge)), agnameof(aghead(realedge)));
+	make_polyline_w (rt->ws, pl, &polyspl);
 	limitBoxes (boxes, boxn, polyspl.ps, polyspl.pn, INIT_DELTA);
-	free (polyspl.ps);
     }
 
     *npoints = spl.pn;
@@ -647,17 +704,31 @@ static pointf *_routesplines(path * pp, int *npoints, int polyline)
 	printboxes(boxn, boxes);
 #endif
 
-    return ps;
+    return rt->ps;
 }
 
 pointf *routesplines(path * pp, int *npoints)
 {
-    return _routesplines (pp, npoints, 0);
+    return _routesplines (&Router, pp, npoints, 0);
 }
 
 pointf *routepolylines(path * pp, int *npoints)
 {
-    return _routesplines (pp, npoints, 1);
+    return _routesplines (&Router, pp, npoints, 1);
+}
+
+/* routesplines_r:
+ * As routesplines, using the buffers of rt. The points returned
+ * are valid until the next call with rt.
+ */
+pointf *routesplines_r(splrouter_t *rt, path * pp, int *npoints)
+{
+    return _routesplines (rt, pp, npoints, 0);
+}
+
+pointf *routepolylines_r(splrouter_t *rt, path * pp, int *npoints)
+{
+    return _routesplines (rt, pp, npoints, 1);
 }
 
 static int overlap(int i0, int i1, int j0, int j1)
@@ -684,7 +755,7 @@ static int overlap(int i0, int i1, int j0, int j1)
  *
  * Return 1 on failure; 0 on success.
  */
-static int checkpath(int boxn, boxf* boxes, path* thepath)
+static int checkpath(splrouter_t *rt, int boxn, boxf* boxes, path* thepath)
 {
     boxf *ba, *bb;
     int bi, i, errs, l, r, d, u;
@@ -707,16 +778,20 @@ static int checkpath(int boxn, boxf* boxes, path* thepath)
 
     ba = &boxes[0];
     if (ba->LL.x > ba->UR.x || ba->LL.y > ba->UR.y) {
-	agerr(AGERR, "in checkpath, box 0 has LL coord > UR coord\n");
-	printpath(thepath);
+	if (!rt->quiet) {
+	    agerr(AGERR, "in checkpath, box 0 has LL coord > UR coord\n");
+	    printpath(thepath);
+	}
 	return 1;
     }
     for (bi = 0; bi < boxn - 1; bi++) {
 	ba = &boxes[bi], bb = &boxes[bi + 1];
 	if (bb->LL.x > bb->UR.x || bb->LL.y > bb->UR.y) {
-	    agerr(AGERR, "in checkpath, box %d has LL coord > UR coord\n",
-		  bi + 1);
-	    printpath(thepath);
+	    if (!rt->quiet) {
+		agerr(AGERR, "in checkpath, box %d has LL coord > UR coord\n",
+		      bi + 1);
+		printpath(thepath);
+	    }
 	    return 1;
 	}
 	l = (ba->UR.x < bb->LL.x) ? 1 : 0;
@@ -724,7 +799,7 @@ static int checkpath(int boxn, boxf* boxes, path* thepath)
 	d = (ba->UR.y < bb->LL.y) ? 1 : 0;
 	u = (ba->LL.y > bb->UR.y) ? 1 : 0;
 	errs = l + r + d + u;
-	if (errs > 0 && Verbose) {
+	if (errs > 0 && Verbose && !rt->quiet) {
 	    fprintf(stderr, "in checkpath, boxes %d and %d don't touch\n",
 		    bi, bi + 1);
 	    printpath(thepath);
@@ -801,7 +876,7 @@ static int checkpath(int boxn, boxf* boxes, path* thepath)
 	|| thepath->start.p.x > boxes[0].UR.x
 	|| thepath->start.p.y < boxes[0].LL.y
 	|| thepath->start.p.y > boxes[0].UR.y) {
-	if (Verbose) {
+	if (Verbose && !rt->quiet) {
 	    fprintf(stderr, "in checkpath, start port not in first box\n");
 	    printpath(thepath);
 	}
@@ -822,7 +897,7 @@ static int checkpath(int boxn, boxf* boxes, path* thepath)
 	|| thepath->end.p.x > boxes[boxn - 1].UR.x
 	|| thepath->end.p.y < boxes[boxn - 1].LL.y
 	|| thepath->end.p.y > boxes[boxn - 1].UR.y) {
-	if (Verbose) {
+	if (Verbose && !rt->quiet) {
 	    fprintf(stderr, "in checkpath, end port not in last box\n");
 	    printpath(thepath);
 	}
@@ -842,16 +917,17 @@ static int checkpath(int boxn, boxf* boxes, path* thepath)
     return 0;
 }
 
-static int mkspacep(int size)
+static int mkspacep(splrouter_t *rt, int size)
 {
-    if (size > maxpn) {
-	int newmax = maxpn + (size / PINC + 1) * PINC;
-	ps = RALLOC(newmax, ps, pointf);
-	if (!ps) {
-	    agerr(AGERR, "cannot re-allocate ps\n");
+    if (size > rt->maxpn) {
+	int newmax = rt->maxpn + (size / PINC + 1) * PINC;
+	rt->ps = RALLOC(newmax, rt->ps, pointf);
+	if (!rt->ps) {
+	    if (!rt->quiet)
+		agerr(AGERR, "cannot re-allocate ps\n");
 	    return 1;
 	}
-	maxpn = newmax;
+	rt->maxpn = newmax;
     }
     return 0;
 }
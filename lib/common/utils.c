@@ -68,35 +68,28 @@ node_t *dequeue(nodequeue * q)
     return n;
 }
 
+/* late_int and late_double use the values cached by agxgetint and
+ * agxgetdouble, so each attribute string is parsed only once.
+ */
 int late_int(void *obj, attrsym_t * attr, int def, int low)
 {
-    char *p;
-    char *endp;
     int rv;
     if (attr == NULL)
 	return def;
-    p = ag_xget(obj, attr);
-    if (!p || p[0] == '\0')
-	return def;
-    rv = strtol (p, &endp, 10);
-    if (p == endp) return def;  /* invalid int format */
+    if (!agxgetint(obj, attr, &rv))
+	return def;  /* empty or invalid int format */
     if (rv < low) return low;
     else return rv;
 }
 
 double late_double(void *obj, attrsym_t * attr, double def, double low)
 {
-    char *p;
-    char *endp;
     double rv;
 
     if (!attr || !obj)
 	return def;
-    p = ag_xget(obj, attr);
-    if (!p || p[0] == '\0')
-	return def;
-    rv = strtod (p, &endp);
-    if (p == endp) return def;  /* invalid double format */
+    if (!agxgetdouble(obj, attr, &rv))
+	return def;  /* empty or invalid double format */
     if (rv < low) return low;
     else return rv;
 }
@@ -2080,6 +2073,45 @@ findCluster (Dt_t* map, char* name)
 	return NULL;
 }
 
+typedef struct atclose_s {
+    void (*fn) (void);
+    struct atclose_s *next;
+} atclose_t;
+
+static atclose_t *Atclose;
+
+/* gv_atclose:
+ * Register fn to release a cache that a layout keeps from one graph
+ * to the next. gvFreeContext calls each registered function once and
+ * then forgets it. Registering a function twice has no effect.
+ */
+void gv_atclose(void (*fn) (void))
+{
+    atclose_t *p;
+
+    for (p = Atclose; p; p = p->next)
+	if (p->fn == fn)
+	    return;
+    p = NEW(atclose_t);
+    p->fn = fn;
+    p->next = Atclose;
+    Atclose = p;
+}
+
+/* gv_runatclose:
+ * Call and forget the functions registered by gv_atclose.
+ */
+void gv_runatclose(void)
+{
+    atclose_t *p;
+
+    while ((p = Atclose)) {
+	Atclose = p->next;
+	p->fn();
+	free(p);
+    }
+}
+
 Agnodeinfo_t* ninf(Agnode_t* n) {return (Agnodeinfo_t*)AGDATA(n);}
 Agraphinfo_t* ginf(Agraph_t* g) {return (Agraphinfo_t*)AGDATA(g);}
 Agedgeinfo_t* einf(Agedge_t* e) {return (Agedgeinfo_t*)AGDATA(e);}
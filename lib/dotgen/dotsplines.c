@@ -17,6 +17,7 @@
  */
 
 #include "dot.h"
+#include "parallel.h"
 
 #ifdef ORTHO
 #include <ortho.h>
@@ -51,12 +52,46 @@
 	ED_to_orig(newp) = old; \
 }
 
-static boxf boxes[1000];
+#define MAXBOXES 1000		/* boxes between the ends of a regular edge */
+
+static boxf boxes[MAXBOXES];
 typedef struct {
     int LeftBound, RightBound, Splinesep, Multisep;
     boxf* Rank_box;
 } spline_info_t;
 
+/* A call of routesplines made ahead of time: the path given, and what
+ * routesplines returned or changed in it.
+ */
+typedef struct {
+    boolean polyline;		/* routed with routepolylines */
+    int nbox;
+    boxf *boxes;		/* nbox boxes given, then nbox boxes returned */
+    port start, end;		/* ends given */
+    pointf sp, ep;		/* start.p and end.p returned */
+    pointf *ps;			/* spline points returned */
+    int pn;
+} segroute_t;
+
+/* routes of the segments of a group of equivalent regular edges */
+typedef struct {
+    segroute_t *segs;
+    int nsegs;
+} grouproute_t;
+
+/* State of make_regular_edge. While speculating, the routes of a group
+ * are only recorded in memo; nothing in the graph is changed.
+ */
+typedef struct {
+    boxf *boxes;		/* MAXBOXES boxes */
+    pointf *pointfs, *pointfs2;
+    int numpts, numpts2;
+    splrouter_t *rt;		/* router used while speculating */
+    grouproute_t *memo;		/* routes of the group, or NULL */
+    int seg;			/* next segment of memo */
+    boolean speculate;
+} regedge_t;
+
 static void adjustregularpath(path *, int, int);
 static Agedge_t *bot_bound(Agedge_t *, int);
 static boolean pathscross(Agnode_t *, Agnode_t *, Agedge_t *, Agedge_t *);
@@ -66,7 +101,7 @@ static void completeregularpath(path *, Agedge_t *, Agedge_t *,
 				pathend_t *, pathend_t *, boxf *, int, int);
 static int edgecmp(Agedge_t **, Agedge_t **);
 static void make_flat_edge(graph_t*, spline_info_t*, path *, Agedge_t **, int, int, int);
-static void make_regular_edge(graph_t* g, spline_info_t*, path *, Agedge_t **, int, int, int);
+static void make_regular_edge(graph_t* g, spline_info_t*, path *, Agedge_t **, int, int, int, regedge_t *);
 static boxf makeregularend(boxf, int, double);
 static boxf maximal_bbox(graph_t* g, spline_info_t*, Agnode_t *, Agedge_t *, Agedge_t *);
 static Agnode_t *neighbor(graph_t*, Agnode_t *, Agedge_t *, Agedge_t *, int);
@@ -244,6 +279,228 @@ setEdgeLabelPos (graph_t * g)
     }
 }
 
+/* group_edges:
+ * Split the sorted edges into groups of equivalent edges, which are
+ * routed together. Group k is edges[start[k]..start[k+1]-1].
+ * Return the number of groups.
+ */
+static int group_edges(edge_t ** edges, int n_edges, int *start)
+{
+    int i, ngroups = 0;
+    Agedgeinfo_t fwdedgeai, fwdedgebi;
+    Agedgepair_t fwdedgea, fwdedgeb;
+    edge_t *e0, *e1, *ea, *eb, *le0, *le1;
+
+    fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
+    fwdedgeb.out.base.data = (Agrec_t*)&fwdedgebi;
+    for (i = 0; i < n_edges;) {
+	start[ngroups++] = i;
+	le0 = getmainedge((e0 = edges[i++]));
+	if (ED_tail_port(e0).defined || ED_head_port(e0).defined) {
+	    ea = e0;
+	} else {
+	    ea =  le0;
+	}
+	if (ED_tree_index(ea) & BWDEDGE) {
+	    MAKEFWDEDGE(&fwdedgea.out, ea);
+	    ea = &fwdedgea.out;
+	}
+	for (; i < n_edges; i++) {
+	    if (le0 != (le1 = getmainedge((e1 = edges[i]))))
+		break;
+	    if (ED_adjacent(e0)) continue; /* all flat adjacent edges at once */
+	    if (ED_tail_port(e1).defined || ED_head_port(e1).defined) {
+		    eb = e1;
+	    } else {
+		    eb = le1;
+	    }
+	    if (ED_tree_index(eb) & BWDEDGE) {
+		MAKEFWDEDGE(&fwdedgeb.out, eb);
+		eb = &fwdedgeb.out;
+	    }
+	    if (portcmp(ED_tail_port(ea), ED_tail_port(eb)))
+		break;
+	    if (portcmp(ED_head_port(ea), ED_head_port(eb)))
+		break;
+	    if ((ED_tree_index(e0) & EDGETYPEMASK) == FLATEDGE
+		&& ED_label(e0) != ED_label(e1))
+		break;
+	    if (ED_tree_index(edges[i]) & MAINGRAPH)	/* Aha! -C is on */
+		break;
+	}
+    }
+    start[ngroups] = n_edges;
+    return ngroups;
+}
+
+/* fixed_ends:
+ * True if beginpath and endpath leave the edge, and the graph, as they are.
+ * A port resolved at routing time, or one on a side of its node, is
+ * changed by them.
+ */
+static boolean fixed_ends(edge_t * e)
+{
+    return !ED_tail_port(e).dyna && !ED_tail_port(e).side
+	&& !ED_head_port(e).dyna && !ED_head_port(e).side;
+}
+
+static boolean same_end(port * p, port * q)
+{
+    return p->p.x == q->p.x && p->p.y == q->p.y
+	&& p->constrained == q->constrained
+	&& (!p->constrained || p->theta == q->theta);
+}
+
+/* route_path:
+ * Route P with routesplines or routepolylines. While speculating, record
+ * the route in re->memo. Otherwise, if the route of the same segment was
+ * recorded for exactly the same path, return it, with the changes routing
+ * made to P.
+ */
+static pointf *route_path(regedge_t * re, path * P, boolean polyline,
+			  int *npts)
+{
+    grouproute_t *m = re->memo;
+    segroute_t *s;
+    pointf *ps;
+    size_t sz = P->nbox * sizeof(boxf);
+
+    if (re->speculate) {
+	m->segs = ALLOC(m->nsegs + 1, m->segs, segroute_t);
+	s = &m->segs[m->nsegs];
+	s->polyline = polyline;
+	s->nbox = P->nbox;
+	s->boxes = N_GNEW(2 * P->nbox, boxf);
+	memcpy(s->boxes, P->boxes, sz);
+	s->start = P->start;
+	s->end = P->end;
+	if (polyline)
+	    ps = routepolylines_r(re->rt, P, npts);
+	else
+	    ps = routesplines_r(re->rt, P, npts);
+	if (!ps) {
+	    free(s->boxes);
+	    *npts = 0;
+	    return NULL;
+	}
+	memcpy(s->boxes + s->nbox, P->boxes, sz);
+	s->sp = P->start.p;
+	s->ep = P->end.p;
+	s->pn = *npts;
+	s->ps = N_GNEW(s->pn, pointf);
+	memcpy(s->ps, ps, s->pn * sizeof(pointf));
+	m->nsegs++;
+	return ps;
+    }
+    if (m && re->seg < m->nsegs) {
+	s = &m->segs[re->seg++];
+	if (s->polyline == polyline && s->nbox == P->nbox
+	    && same_end(&s->start, &P->start) && same_end(&s->end, &P->end)
+	    && !memcmp(s->boxes, P->boxes, sz)) {
+	    memcpy(P->boxes, s->boxes + s->nbox, sz);
+	    P->start.p = s->sp;
+	    P->end.p = s->ep;
+	    *npts = s->pn;
+	    return s->ps;
+	}
+    }
+    if (polyline)
+	return routepolylines(P, npts);
+    return routesplines(P, npts);
+}
+
+typedef struct {
+    graph_t *g;
+    spline_info_t *sp;
+    edge_t **edges;
+    int *gstart;
+    int et;
+    grouproute_t *memo;
+    regedge_t *re;		/* state of each chunk */
+    path *P;			/* path of each chunk */
+} routeahead_t;
+
+/* parallel_for work function routing the regular groups in [lo,hi) */
+static void route_groups(void *state, int chunk, int lo, int hi)
+{
+    routeahead_t *st = state;
+    regedge_t *re = &st->re[chunk];
+    edge_t *e0;
+    int i;
+
+    for (i = lo; i < hi; i++) {
+	e0 = st->edges[st->gstart[i]];
+	if (agtail(e0) == aghead(e0)
+	    || ND_rank(agtail(e0)) == ND_rank(aghead(e0)))
+	    continue;
+	re->memo = &st->memo[i];
+	make_regular_edge(st->g, st->sp, &st->P[chunk], st->edges,
+			  st->gstart[i], st->gstart[i + 1] - st->gstart[i],
+			  st->et, re);
+    }
+}
+
+/* route_ahead:
+ * Route the regular edges concurrently, as if they were the first edges
+ * routed, and return the routes. Routing an edge changes the space left
+ * for the later ones, so a route is only good if the serial pass meets
+ * exactly the same path; see route_path.
+ */
+static grouproute_t *route_ahead(graph_t * g, spline_info_t * sp,
+				 edge_t ** edges, int ngroups, int *gstart,
+				 int et, int nthreads, int nboxes)
+{
+    routeahead_t st;
+    int i, r;
+
+    /* fill the cache of rank boxes, which the threads share */
+    for (r = GD_minrank(g); r < GD_maxrank(g); r++)
+	if (GD_rank(g)[r].n && GD_rank(g)[r + 1].n)
+	    rank_box(sp, g, r);
+
+    if (nthreads > ngroups)
+	nthreads = ngroups;
+    st.g = g;
+    st.sp = sp;
+    st.edges = edges;
+    st.gstart = gstart;
+    st.et = et;
+    st.memo = N_NEW(ngroups, grouproute_t);
+    st.re = N_NEW(nthreads, regedge_t);
+    st.P = N_NEW(nthreads, path);
+    for (i = 0; i < nthreads; i++) {
+	st.re[i].boxes = N_NEW(MAXBOXES, boxf);
+	st.re[i].rt = new_splrouter(TRUE);
+	st.re[i].speculate = TRUE;
+	st.P[i].boxes = N_NEW(nboxes, boxf);
+    }
+    parallel_for(ngroups, nthreads, route_groups, &st);
+    for (i = 0; i < nthreads; i++) {
+	free(st.re[i].boxes);
+	free(st.re[i].pointfs);
+	free(st.re[i].pointfs2);
+	free_splrouter(st.re[i].rt);
+	free(st.P[i].boxes);
+    }
+    free(st.re);
+    free(st.P);
+    return st.memo;
+}
+
+static void free_routes(grouproute_t * memo, int ngroups)
+{
+    int i, j;
+
+    for (i = 0; i < ngroups; i++) {
+	for (j = 0; j < memo[i].nsegs; j++) {
+	    free(memo[i].segs[j].boxes);
+	    free(memo[i].segs[j].ps);
+	}
+	free(memo[i].segs);
+    }
+    free(memo);
+}
+
 /* _dot_splines:
  * Main spline routing code.
  * The normalize parameter allows this function to be called by the
@@ -253,16 +510,15 @@ setEdgeLabelPos (graph_t * g)
  */
 static void _dot_splines(graph_t * g, int normalize)
 {
-    int i, j, k, n_nodes, n_edges, ind, cnt;
+    int i, j, k, n_nodes, n_edges, ind, cnt, ngroups, nthreads;
+    int *gstart = NULL;
     node_t *n;
-    Agedgeinfo_t fwdedgeai, fwdedgebi;
-    Agedgepair_t fwdedgea, fwdedgeb;
-    edge_t *e, *e0, *e1, *ea, *eb, *le0, *le1, **edges = NULL;
+    edge_t *e, *e0, **edges = NULL;
     path *P = NULL;
     spline_info_t sd;
+    regedge_t re;
+    grouproute_t *memo = NULL;
     int et = EDGE_TYPE(g);
-    fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
-    fwdedgeb.out.base.data = (Agrec_t*)&fwdedgebi;
 
     if (et == ET_NONE) return; 
     if (et == ET_CURVED) {
@@ -377,42 +633,20 @@ static void _dot_splines(graph_t * g, int normalize)
 	}
     }
 
-    for (i = 0; i < n_edges;) {
-	ind = i;
-	le0 = getmainedge((e0 = edges[i++]));
-	if (ED_tail_port(e0).defined || ED_head_port(e0).defined) {
-	    ea = e0;
-	} else {
-	    ea =  le0;
-	}
-	if (ED_tree_index(ea) & BWDEDGE) {
-	    MAKEFWDEDGE(&fwdedgea.out, ea);
-	    ea = &fwdedgea.out;
-	}
-	for (cnt = 1; i < n_edges; cnt++, i++) {
-	    if (le0 != (le1 = getmainedge((e1 = edges[i]))))
-		break;
-	    if (ED_adjacent(e0)) continue; /* all flat adjacent edges at once */
-	    if (ED_tail_port(e1).defined || ED_head_port(e1).defined) {
-		    eb = e1;
-	    } else {
-		    eb = le1;
-	    }
-	    if (ED_tree_index(eb) & BWDEDGE) {
-		MAKEFWDEDGE(&fwdedgeb.out, eb);
-		eb = &fwdedgeb.out;
-	    }
-	    if (portcmp(ED_tail_port(ea), ED_tail_port(eb)))
-		break;
-	    if (portcmp(ED_head_port(ea), ED_head_port(eb)))
-		break;
-	    if ((ED_tree_index(e0) & EDGETYPEMASK) == FLATEDGE
-		&& ED_label(e0) != ED_label(e1))
-		break;
-	    if (ED_tree_index(edges[i]) & MAINGRAPH)	/* Aha! -C is on */
-		break;
-	}
-
+    /* with several threads, the regular edges are routed ahead; see route_path */
+    gstart = N_NEW(n_edges + 1, int);
+    ngroups = group_edges(edges, n_edges, gstart);
+    memset(&re, 0, sizeof(re));
+    re.boxes = boxes;
+    if ((et == ET_SPLINE || et == ET_PLINE) && ngroups > 1
+	&& (nthreads = parallel_threads(g)) > 1)
+	memo = route_ahead(g, &sd, edges, ngroups, gstart, et, nthreads,
+			   n_nodes + 20 * 2 * NSUB);
+
+    for (i = 0; i < ngroups; i++) {
+	ind = gstart[i];
+	cnt = gstart[i + 1] - ind;
+	e0 = edges[ind];
 	if (et == ET_CURVED) {
 	    int ii;
 	    edge_t* e0;
@@ -456,9 +690,17 @@ static void _dot_splines(graph_t * g, int normalize)
 	else if (ND_rank(agtail(e0)) == ND_rank(aghead(e0))) {
 	    make_flat_edge(g, &sd, P, edges, ind, cnt, et);
 	}
-	else
-	    make_regular_edge(g, &sd, P, edges, ind, cnt, et);
+	else {
+	    re.memo = memo ? &memo[i] : NULL;
+	    re.seg = 0;
+	    make_regular_edge(g, &sd, P, edges, ind, cnt, et, &re);
+	}
     }
+    if (memo)
+	free_routes(memo, ngroups);
+    free(gstart);
+    free(re.pointfs);
+    free(re.pointfs2);
 
     /* place regular edge labels */
     for (n = GD_nlist(g); n; n = ND_next(n)) {
@@ -1728,7 +1970,7 @@ makeLineEdge(graph_t* g, edge_t* fe, pointf* points, node_t** hp)
 /* make_regular_edge:
  */
 static void
-make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int ind, int cnt, int et)
+make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int ind, int cnt, int et, regedge_t* re)
 {
     node_t *tn, *hn;
     Agedgeinfo_t fwdedgeai, fwdedgebi, fwdedgei;
@@ -1738,24 +1980,23 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
     pathend_t tend, hend;
     boxf b;
     int boxn, sl, si, smode, i, j, dx, pn, hackflag, longedge;
-    static pointf* pointfs;
-    static pointf* pointfs2;
-    static int numpts;
-    static int numpts2;
+    boxf *boxes = re->boxes;
     int pointn;
 
     fwdedgea.out.base.data = (Agrec_t*)&fwdedgeai;
     fwdedgeb.out.base.data = (Agrec_t*)&fwdedgebi;
     fwdedge.out.base.data = (Agrec_t*)&fwdedgei;
 
-    if (!pointfs) {
-	pointfs = N_GNEW(NUMPTS, pointf);
-   	pointfs2 = N_GNEW(NUMPTS, pointf);
-	numpts = NUMPTS;
-	numpts2 = NUMPTS;
+    if (!re->pointfs) {
+	re->pointfs = N_GNEW(NUMPTS, pointf);
+   	re->pointfs2 = N_GNEW(NUMPTS, pointf);
+	re->numpts = NUMPTS;
+	re->numpts2 = NUMPTS;
     }
     sl = 0;
     e = edges[ind];
+    if (re->speculate && !fixed_ends(e))
+	return;
     hackflag = FALSE;
     if (ABS(ND_rank(agtail(e)) - ND_rank(aghead(e))) > 1) {
 	fwdedgeai = *(Agedgeinfo_t*)e->base.data;
@@ -1793,7 +2034,7 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 
     /* compute the spline points for the edge */
 
-    if ((et == ET_LINE) && (pointn = makeLineEdge (g, fe, pointfs, &hn))) {
+    if ((et == ET_LINE) && (pointn = makeLineEdge (g, fe, re->pointfs, &hn))) {
     }
     else {
 	int splines = et == ET_SPLINE;
@@ -1837,9 +2078,9 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 	        hend.boxes[hend.boxn++] = b;
 	    P->end.theta = M_PI / 2, P->end.constrained = TRUE;
 	    completeregularpath(P, segfirst, e, &tend, &hend, boxes, boxn, 1);
-	    if (splines) ps = routesplines(P, &pn);
+	    if (splines) ps = route_path(re, P, FALSE, &pn);
 	    else {
-		ps = routepolylines (P, &pn);
+		ps = route_path(re, P, TRUE, &pn);
 		if ((et == ET_LINE) && (pn > 4)) {
 		    ps[1] = ps[0];
 		    ps[3] = ps[2] = ps[pn-1];
@@ -1849,18 +2090,19 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 	    if (pn == 0)
 	        return;
 	
-	    if (pointn + pn > numpts) {
+	    if (pointn + pn > re->numpts) {
                 /* This should be enough to include 3 extra points added by
                  * straight_path below.
                  */
-		numpts = 2*(pointn+pn); 
-		pointfs = RALLOC(numpts, pointfs, pointf);
+		re->numpts = 2*(pointn+pn); 
+		re->pointfs = RALLOC(re->numpts, re->pointfs, pointf);
 	    }
 	    for (i = 0; i < pn; i++) {
-		pointfs[pointn++] = ps[i];
+		re->pointfs[pointn++] = ps[i];
 	    }
-	    e = straight_path(ND_out(hn).list[0], sl, pointfs, &pointn);
-	    recover_slack(segfirst, P);
+	    e = straight_path(ND_out(hn).list[0], sl, re->pointfs, &pointn);
+	    if (!re->speculate)
+		recover_slack(segfirst, P);
 	    segfirst = e;
 	    tn = agtail(e);
 	    hn = aghead(e);
@@ -1885,8 +2127,8 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 	    hend.boxes[hend.boxn++] = b;
 	completeregularpath(P, segfirst, e, &tend, &hend, boxes, boxn,
 	    		longedge);
-	if (splines) ps = routesplines(P, &pn);
-	else ps = routepolylines (P, &pn);
+	if (splines) ps = route_path(re, P, FALSE, &pn);
+	else ps = route_path(re, P, TRUE, &pn);
 	if ((et == ET_LINE) && (pn > 4)) {
 	    /* Here we have used the polyline case to handle
 	     * an edge between two nodes on adjacent ranks. If the
@@ -1898,13 +2140,15 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
         }
 	if (pn == 0)
 	    return;
-	if (pointn + pn > numpts) {
-	    numpts = 2*(pointn+pn); 
-	    pointfs = RALLOC(numpts, pointfs, pointf);
+	if (pointn + pn > re->numpts) {
+	    re->numpts = 2*(pointn+pn); 
+	    re->pointfs = RALLOC(re->numpts, re->pointfs, pointf);
 	}
 	for (i = 0; i < pn; i++) {
-	    pointfs[pointn++] = ps[i];
+	    re->pointfs[pointn++] = ps[i];
 	}
+	if (re->speculate)
+	    return;
 	recover_slack(segfirst, P);
 	hn = hackflag ? aghead(&fwdedgeb.out) : aghead(e);
     }
@@ -1912,20 +2156,20 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
     /* make copies of the spline points, one per multi-edge */
 
     if (cnt == 1) {
-	clip_and_install(fe, hn, pointfs, pointn, &sinfo);
+	clip_and_install(fe, hn, re->pointfs, pointn, &sinfo);
 	return;
     }
     dx = sp->Multisep * (cnt - 1) / 2;
     for (i = 1; i < pointn - 1; i++)
-	pointfs[i].x -= dx;
+	re->pointfs[i].x -= dx;
 
-    if (numpts > numpts2) {
-	numpts2 = numpts; 
-	pointfs2 = RALLOC(numpts2, pointfs2, pointf);
+    if (re->numpts > re->numpts2) {
+	re->numpts2 = re->numpts; 
+	re->pointfs2 = RALLOC(re->numpts2, re->pointfs2, pointf);
     }
     for (i = 0; i < pointn; i++)
-	pointfs2[i] = pointfs[i];
-    clip_and_install(fe, hn, pointfs2, pointn, &sinfo);
+	re->pointfs2[i] = re->pointfs[i];
+    clip_and_install(fe, hn, re->pointfs2, pointn, &sinfo);
     for (j = 1; j < cnt; j++) {
 	e = edges[ind + j];
 	if (ED_tree_index(e) & BWDEDGE) {
@@ -1933,10 +2177,10 @@ make_regular_edge(graph_t* g, spline_info_t* sp, path * P, edge_t ** edges, int
 	    e = &fwdedge.out;
 	}
 	for (i = 1; i < pointn - 1; i++)
-	    pointfs[i].x += sp->Multisep;
+	    re->pointfs[i].x += sp->Multisep;
 	for (i = 0; i < pointn; i++)
-	    pointfs2[i] = pointfs[i];
-	clip_and_install(e, aghead(e), pointfs2, pointn, &sinfo);
+	    re->pointfs2[i] = re->pointfs[i];
+	clip_and_install(e, aghead(e), re->pointfs2, pointn, &sinfo);
     }
 }
 
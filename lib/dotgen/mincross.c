@@ -20,29 +20,54 @@
  */
 
 #include "dot.h"
+#include "parallel.h"
 
 /* #define DEBUG */
 #define MARK(v)		(ND_mark(v))
 #define saveorder(v)	(ND_coord(v)).x
 #define flatindex(v)	ND_low(v)
 
+typedef struct mcstate_s mcstate_t;
+
 	/* forward declarations */
-static boolean medians(graph_t * g, int r0, int r1);
+static boolean medians(mcstate_t * ms, graph_t * g, int r0, int r1);
 static int nodeposcmpf(node_t ** n0, node_t ** n1);
 static int edgeidcmpf(edge_t ** e0, edge_t ** e1);
 static void flat_breakcycles(graph_t * g);
-static void flat_reorder(graph_t * g);
+static void flat_reorder(mcstate_t * ms, graph_t * g, boolean fixlr);
+static void flat_fixlr(graph_t * g, int r);
 static void flat_search(graph_t * g, node_t * v);
 static void init_mincross(graph_t * g);
 static void merge2(graph_t * g);
 static void init_mccomp(graph_t * g, int c);
 static void cleanup2(graph_t * g, int nc);
 static int mincross_clust(graph_t * par, graph_t * g, int);
-static int mincross(graph_t * g, int startpass, int endpass, int);
-static void mincross_step(graph_t * g, int pass);
+
+	/* options of the multi-start crossing minimization of one graph */
+typedef struct {
+    int trials;			/* number of initial orderings tried */
+    unsigned int seed;		/* seed for randomized trials */
+    int nthreads;		/* threads running the trials after the first */
+} mctrial_t;
+
+static int mincross(graph_t * g, int startpass, int endpass, int,
+		    mcstate_t * ms);
+static int mincross_trials(graph_t * g, int doBalance, mctrial_t * mt);
+static void trial_options(graph_t * g, mctrial_t * mt);
+static void trial_ranks(mcstate_t * ms, graph_t * g, int pass);
+static void build_ranks_search(mcstate_t * ms, graph_t * g, int pass,
+			       boolean dfs);
+static void mincross_step(mcstate_t * ms, graph_t * g, int pass);
 static void mincross_options(graph_t * g);
-static void save_best(graph_t * g);
-static void restore_best(graph_t * g);
+static void save_best(mcstate_t * ms, graph_t * g);
+static void restore_best(mcstate_t * ms, graph_t * g);
+static int ncross_ms(mcstate_t * ms);
+static void install_cluster_ms(mcstate_t * ms, graph_t * g, node_t * n,
+			       int pass, nodequeue * q);
+static void enqueue_neighbors_ms(mcstate_t * ms, nodequeue * q, node_t * n0,
+				 int pass);
+static void install_in_rank_ms(mcstate_t * ms, graph_t * g, node_t * n);
+static int inside_cluster(graph_t * g, node_t * v);
 static adjmatrix_t *new_matrix(int i, int j);
 static void free_matrix(adjmatrix_t * p);
 static int ordercmpf(int *i0, int *i1);
@@ -70,6 +95,47 @@ static edge_t **TE_list;
 static int *TI_list;
 static boolean ReMincross;
 
+	/* crossing counts of adjacent pairs, cached during transpose */
+typedef struct {
+    node_t *v, *w;		/* the pair, v immediately left of w */
+    int c0, c1;			/* crossings with v left of w, w left of v */
+    int stamp;			/* valid if equal to PC_stamp */
+} paircross_t;
+static paircross_t *PC_list;	/* indexed by PC_base[rank] + order */
+static int *PC_base;
+static int PC_size;
+static int PC_stamp;
+
+	/* private state of a trial run on a worker thread, standing in for
+	 * the rank arrays of Root, the node fields used by mincross and the
+	 * static scratch space. Nodes are indexed by ND_id, which
+	 * mincross_trials numbers densely within the component.
+	 */
+struct mcstate_s {
+    int trial;			/* 0 is the standard ordering */
+    unsigned int rand;		/* state of the trial random number generator */
+    rank_t *rank;		/* copy of GD_rank(Root), with its own v */
+    int *order;			/* ND_order */
+    double *mval;		/* ND_mval */
+    double *saveorder;		/* saveorder */
+    char *mark;			/* MARK */
+    char *installed;		/* GD_installed, by ND_id of a rank leader */
+    char *inside;		/* inside_cluster(Root, v), shared */
+    paircross_t *pc_list;	/* PC_list */
+    int pc_stamp;		/* PC_stamp */
+    int *count, c;		/* Count and C of rcross */
+    int *ti_list;		/* TI_list */
+};
+
+	/* fields of the trial state ms, or of the graph if ms is NULL */
+#define ORDER(ms,v)	(*((ms) ? &(ms)->order[ND_id(v)] : &ND_order(v)))
+#define MVAL(ms,v)	(*((ms) ? &(ms)->mval[ND_id(v)] : &ND_mval(v)))
+#define SAVEORDER(ms,v)	(*((ms) ? &(ms)->saveorder[ND_id(v)] : &saveorder(v)))
+#define TMARK(ms,v)	(*((ms) ? &(ms)->mark[ND_id(v)] : &MARK(v)))
+#define RANKS(ms,g)	((ms) ? (ms)->rank : GD_rank(g))
+#define PCLIST(ms)	((ms) ? (ms)->pc_list : PC_list)
+#define PCSTAMP(ms)	(*((ms) ? &(ms)->pc_stamp : &PC_stamp))
+
 #if DEBUG > 1
 static void indent(graph_t* g)
 {
@@ -333,12 +399,17 @@ void dot_mincross(graph_t * g, int doBalance)
 {
     int c, nc;
     char *s;
+    mctrial_t mt;
 
     init_mincross(g);
+    trial_options(g, &mt);
 
     for (nc = c = 0; c < GD_comp(g).size; c++) {
 	init_mccomp(g, c);
-	nc += mincross(g, 0, 2, doBalance);
+	if (mt.trials > 1)
+	    nc += mincross_trials(g, doBalance, &mt);
+	else
+	    nc += mincross(g, 0, 2, doBalance, NULL);
     }
 
     merge2(g);
@@ -356,7 +427,7 @@ void dot_mincross(graph_t * g, int doBalance)
 	&& (!(s = agget(g, "remincross")) || (mapbool(s)))) {
 	mark_lowclusters(g);
 	ReMincross = TRUE;
-	nc = mincross(g, 2, 2, doBalance);
+	nc = mincross(g, 2, 2, doBalance, NULL);
 #ifdef DEBUG
 	for (c = 1; c <= GD_n_cluster(g); c++)
 	    check_vlists(GD_clust(g)[c]);
@@ -514,8 +585,8 @@ static int mincross_clust(graph_t * par, graph_t * g, int doBalance)
     expand_cluster(g);
     ordered_edges(g);
     flat_breakcycles(g);
-    flat_reorder(g);
-    nc = mincross(g, 2, 2, doBalance);
+    flat_reorder(NULL, g, TRUE);
+    nc = mincross(g, 2, 2, doBalance, NULL);
 
     for (c = 1; c <= GD_n_cluster(g); c++)
 	nc += mincross_clust(g, GD_clust(g)[c], doBalance);
@@ -524,7 +595,7 @@ static int mincross_clust(graph_t * par, graph_t * g, int doBalance)
     return nc;
 }
 
-static int left2right(graph_t * g, node_t * v, node_t * w)
+static int left2right(mcstate_t * ms, graph_t * g, node_t * v, node_t * w)
 {
     adjmatrix_t *M;
     int rv;
@@ -546,7 +617,7 @@ static int left2right(graph_t * g, node_t * v, node_t * w)
 	if ((ND_clust(v)) != (ND_clust(w)))
 	    return TRUE;
     }
-    M = GD_rank(g)[ND_rank(v)].flat;
+    M = RANKS(ms, g)[ND_rank(v)].flat;
     if (M == NULL)
 	rv = FALSE;
     else {
@@ -560,7 +631,7 @@ static int left2right(graph_t * g, node_t * v, node_t * w)
     return rv;
 }
 
-static int in_cross(node_t * v, node_t * w)
+static int in_cross(mcstate_t * ms, node_t * v, node_t * w)
 {
     register edge_t **e1, **e2;
     register int inv, cross = 0, t;
@@ -568,10 +639,10 @@ static int in_cross(node_t * v, node_t * w)
     for (e2 = ND_in(w).list; *e2; e2++) {
 	register int cnt = ED_xpenalty(*e2);		
 		
-	inv = ND_order((agtail(*e2)));
+	inv = ORDER(ms, agtail(*e2));
 
 	for (e1 = ND_in(v).list; *e1; e1++) {
-	    t = ND_order(agtail(*e1)) - inv;
+	    t = ORDER(ms, agtail(*e1)) - inv;
 	    if ((t > 0)
 		|| ((t == 0)
 		    && (  ED_tail_port(*e1).p.x > ED_tail_port(*e2).p.x)))
@@ -581,17 +652,17 @@ static int in_cross(node_t * v, node_t * w)
     return cross;
 }
 
-static int out_cross(node_t * v, node_t * w)
+static int out_cross(mcstate_t * ms, node_t * v, node_t * w)
 {
     register edge_t **e1, **e2;
     register int inv, cross = 0, t;
 
     for (e2 = ND_out(w).list; *e2; e2++) {
 	register int cnt = ED_xpenalty(*e2);
-	inv = ND_order(aghead(*e2));
+	inv = ORDER(ms, aghead(*e2));
 
 	for (e1 = ND_out(v).list; *e1; e1++) {
-	    t = ND_order(aghead(*e1)) - inv;
+	    t = ORDER(ms, aghead(*e1)) - inv;
 	    if ((t > 0)
 		|| ((t == 0)
 		    && ((ED_head_port(*e1)).p.x > (ED_head_port(*e2)).p.x)))
@@ -602,20 +673,21 @@ static int out_cross(node_t * v, node_t * w)
 
 }
 
-static void exchange(node_t * v, node_t * w)
+static void exchange(mcstate_t * ms, node_t * v, node_t * w)
 {
     int vi, wi, r;
 
     r = ND_rank(v);
-    vi = ND_order(v);
-    wi = ND_order(w);
-    ND_order(v) = wi;
-    GD_rank(Root)[r].v[wi] = v;
-    ND_order(w) = vi;
-    GD_rank(Root)[r].v[vi] = w;
+    vi = ORDER(ms, v);
+    wi = ORDER(ms, w);
+    ORDER(ms, v) = wi;
+    RANKS(ms, Root)[r].v[wi] = v;
+    ORDER(ms, w) = vi;
+    RANKS(ms, Root)[r].v[vi] = w;
 }
 
-static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
+static void balanceNodes(mcstate_t * ms, graph_t * g, int r, node_t * v,
+			 node_t * w)
 {
     node_t *s;			/* separator node */
     int sepIndex = 0;
@@ -628,8 +700,8 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
 	return;
 
     /* count the number of dummy and original nodes */
-    for (i = 0; i < GD_rank(g)[r].n; i++) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == NORMAL)
+    for (i = 0; i < RANKS(ms, g)[r].n; i++) {
+	if (ND_node_type(RANKS(ms, g)[r].v[i]) == NORMAL)
 	    cntOri++;
 	else
 	    cntDummy++;
@@ -648,8 +720,8 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
     }
 
     /* get the separator node index */
-    for (i = 0; i < GD_rank(g)[r].n; i++) {
-	if (GD_rank(g)[r].v[i] == s)
+    for (i = 0; i < RANKS(ms, g)[r].n; i++) {
+	if (RANKS(ms, g)[r].v[i] == s)
 	    sepIndex = i;
     }
 
@@ -659,14 +731,14 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
      * right of the separator node 
      */
     for (i = sepIndex - 1; i >= 0; i--) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+	if (ND_node_type(RANKS(ms, g)[r].v[i]) == nullType)
 	    k++;
 	else
 	    break;
     }
 
-    for (i = sepIndex + 1; i < GD_rank(g)[r].n; i++) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+    for (i = sepIndex + 1; i < RANKS(ms, g)[r].n; i++) {
+	if (ND_node_type(RANKS(ms, g)[r].v[i]) == nullType)
 	    m++;
 	else
 	    break;
@@ -674,11 +746,11 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
 
     /* now exchange v,w and calculate the same counts */
 
-    exchange(v, w);
+    exchange(ms, v, w);
 
     /* get the separator node index */
-    for (i = 0; i < GD_rank(g)[r].n; i++) {
-	if (GD_rank(g)[r].v[i] == s)
+    for (i = 0; i < RANKS(ms, g)[r].n; i++) {
+	if (RANKS(ms, g)[r].v[i] == s)
 	    sepIndex = i;
     }
 
@@ -686,25 +758,25 @@ static void balanceNodes(graph_t * g, int r, node_t * v, node_t * w)
      * right of the separator node 
      */
     for (i = sepIndex - 1; i >= 0; i--) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+	if (ND_node_type(RANKS(ms, g)[r].v[i]) == nullType)
 	    k1++;
 	else
 	    break;
     }
 
-    for (i = sepIndex + 1; i < GD_rank(g)[r].n; i++) {
-	if (ND_node_type(GD_rank(g)[r].v[i]) == nullType)
+    for (i = sepIndex + 1; i < RANKS(ms, g)[r].n; i++) {
+	if (ND_node_type(RANKS(ms, g)[r].v[i]) == nullType)
 	    m1++;
 	else
 	    break;
     }
 
     if (abs(k1 - m1) > abs(k - m)) {
-	exchange(v, w);		//revert to the original ordering
+	exchange(ms, v, w);		//revert to the original ordering
     }
 }
 
-static int balance(graph_t * g)
+static int balance(mcstate_t * ms, graph_t * g)
 {
     int i, c0, c1, rv;
     node_t *v, *w;
@@ -714,96 +786,150 @@ static int balance(graph_t * g)
 
     for (r = GD_maxrank(g); r >= GD_minrank(g); r--) {
 
-	GD_rank(g)[r].candidate = FALSE;
-	for (i = 0; i < GD_rank(g)[r].n - 1; i++) {
-	    v = GD_rank(g)[r].v[i];
-	    w = GD_rank(g)[r].v[i + 1];
-	    assert(ND_order(v) < ND_order(w));
-	    if (left2right(g, v, w))
+	RANKS(ms, g)[r].candidate = FALSE;
+	for (i = 0; i < RANKS(ms, g)[r].n - 1; i++) {
+	    v = RANKS(ms, g)[r].v[i];
+	    w = RANKS(ms, g)[r].v[i + 1];
+	    assert(ORDER(ms, v) < ORDER(ms, w));
+	    if (left2right(ms, g, v, w))
 		continue;
 	    c0 = c1 = 0;
 	    if (r > 0) {
-		c0 += in_cross(v, w);
-		c1 += in_cross(w, v);
+		c0 += in_cross(ms, v, w);
+		c1 += in_cross(ms, w, v);
 	    }
 
-	    if (GD_rank(g)[r + 1].n > 0) {
-		c0 += out_cross(v, w);
-		c1 += out_cross(w, v);
+	    if (RANKS(ms, g)[r + 1].n > 0) {
+		c0 += out_cross(ms, v, w);
+		c1 += out_cross(ms, w, v);
 	    }
 #if 0
 	    if ((c1 < c0) || ((c0 > 0) && reverse && (c1 == c0))) {
-		exchange(v, w);
+		exchange(ms, v, w);
 		rv += (c0 - c1);
-		GD_rank(Root)[r].valid = FALSE;
-		GD_rank(g)[r].candidate = TRUE;
+		RANKS(ms, Root)[r].valid = FALSE;
+		RANKS(ms, g)[r].candidate = TRUE;
 
 		if (r > GD_minrank(g)) {
-		    GD_rank(Root)[r - 1].valid = FALSE;
-		    GD_rank(g)[r - 1].candidate = TRUE;
+		    RANKS(ms, Root)[r - 1].valid = FALSE;
+		    RANKS(ms, g)[r - 1].candidate = TRUE;
 		}
 		if (r < GD_maxrank(g)) {
-		    GD_rank(Root)[r + 1].valid = FALSE;
-		    GD_rank(g)[r + 1].candidate = TRUE;
+		    RANKS(ms, Root)[r + 1].valid = FALSE;
+		    RANKS(ms, g)[r + 1].candidate = TRUE;
 		}
 	    }
 #endif
 
 	    if (c1 <= c0) {
-		balanceNodes(g, r, v, w);
+		balanceNodes(ms, g, r, v, w);
 	    }
 	}
     }
     return rv;
 }
 
-static int transpose_step(graph_t * g, int r, int reverse)
+/* pair_cross:
+ * Return the crossing counts for the adjacent pair v, w in rank r,
+ * computing them only if the cached entry is stale. An entry stays
+ * valid for one call of transpose unless pc_invalidate clears it.
+ */
+static paircross_t *pair_cross(mcstate_t * ms, graph_t * g, int r,
+			       node_t * v, node_t * w)
+{
+    paircross_t *pc = &PCLIST(ms)[PC_base[r] + ORDER(ms, v)];
+
+    if ((pc->stamp != PCSTAMP(ms)) || (pc->v != v) || (pc->w != w)) {
+	pc->v = v;
+	pc->w = w;
+	pc->c0 = pc->c1 = 0;
+	if (r > 0) {
+	    pc->c0 += in_cross(ms, v, w);
+	    pc->c1 += in_cross(ms, w, v);
+	}
+	if (RANKS(ms, g)[r + 1].n > 0) {
+	    pc->c0 += out_cross(ms, v, w);
+	    pc->c1 += out_cross(ms, w, v);
+	}
+	pc->stamp = PCSTAMP(ms);
+    }
+    return pc;
+}
+
+/* pc_clear:
+ * Invalidate the cached pairs on either side of u.
+ */
+static void pc_clear(mcstate_t * ms, node_t * u)
+{
+    paircross_t *pc = &PCLIST(ms)[PC_base[ND_rank(u)] + ORDER(ms, u)];
+
+    pc->stamp = 0;
+    if (ORDER(ms, u) > 0)
+	pc[-1].stamp = 0;
+}
+
+/* pc_invalidate:
+ * v has moved within its rank. Invalidate the cached pairs in the
+ * adjacent ranks whose counts depend on the position of v. Pairs in
+ * the rank of v are caught by the identity check in pair_cross.
+ */
+static void pc_invalidate(mcstate_t * ms, node_t * v)
+{
+    edge_t *e;
+    int i;
+
+    for (i = 0; (e = ND_in(v).list[i]); i++)
+	pc_clear(ms, agtail(e));
+    for (i = 0; (e = ND_out(v).list[i]); i++)
+	pc_clear(ms, aghead(e));
+}
+
+static int transpose_step(mcstate_t * ms, graph_t * g, int r, int reverse)
 {
     int i, c0, c1, rv;
     node_t *v, *w;
+    paircross_t *pc;
 
     rv = 0;
-    GD_rank(g)[r].candidate = FALSE;
-    for (i = 0; i < GD_rank(g)[r].n - 1; i++) {
-	v = GD_rank(g)[r].v[i];
-	w = GD_rank(g)[r].v[i + 1];
-	assert(ND_order(v) < ND_order(w));
-	if (left2right(g, v, w))
+    RANKS(ms, g)[r].candidate = FALSE;
+    for (i = 0; i < RANKS(ms, g)[r].n - 1; i++) {
+	v = RANKS(ms, g)[r].v[i];
+	w = RANKS(ms, g)[r].v[i + 1];
+	assert(ORDER(ms, v) < ORDER(ms, w));
+	if (left2right(ms, g, v, w))
 	    continue;
-	c0 = c1 = 0;
-	if (r > 0) {
-	    c0 += in_cross(v, w);
-	    c1 += in_cross(w, v);
-	}
-	if (GD_rank(g)[r + 1].n > 0) {
-	    c0 += out_cross(v, w);
-	    c1 += out_cross(w, v);
-	}
+	pc = pair_cross(ms, g, r, v, w);
+	c0 = pc->c0;
+	c1 = pc->c1;
 	if ((c1 < c0) || ((c0 > 0) && reverse && (c1 == c0))) {
-	    exchange(v, w);
+	    exchange(ms, v, w);
+	    pc_invalidate(ms, v);
+	    pc_invalidate(ms, w);
 	    rv += (c0 - c1);
-	    GD_rank(Root)[r].valid = FALSE;
-	    GD_rank(g)[r].candidate = TRUE;
+	    RANKS(ms, Root)[r].valid = FALSE;
+	    RANKS(ms, g)[r].candidate = TRUE;
 
 	    if (r > GD_minrank(g)) {
-		GD_rank(Root)[r - 1].valid = FALSE;
-		GD_rank(g)[r - 1].candidate = TRUE;
+		RANKS(ms, Root)[r - 1].valid = FALSE;
+		RANKS(ms, g)[r - 1].candidate = TRUE;
 	    }
 	    if (r < GD_maxrank(g)) {
-		GD_rank(Root)[r + 1].valid = FALSE;
-		GD_rank(g)[r + 1].candidate = TRUE;
+		RANKS(ms, Root)[r + 1].valid = FALSE;
+		RANKS(ms, g)[r + 1].candidate = TRUE;
 	    }
 	}
     }
     return rv;
 }
 
-static void transpose(graph_t * g, int reverse)
+static void transpose(mcstate_t * ms, graph_t * g, int reverse)
 {
     int r, delta;
 
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++)
-	GD_rank(g)[r].candidate = TRUE;
+	RANKS(ms, g)[r].candidate = TRUE;
+    if (++PCSTAMP(ms) <= 0)
+	PCSTAMP(ms) = 1;
     do {
 	delta = 0;
 #ifdef NOTDEF
@@ -811,51 +937,63 @@ static void transpose(graph_t * g, int reverse)
 	   i tried making it depend on whether an odd or even pass, 
 	   but that didn't help. */
 	for (r = GD_maxrank(g); r >= GD_minrank(g); r--)
-	    if (GD_rank(g)[r].candidate)
-		delta += transpose_step(g, r, reverse);
+	    if (RANKS(ms, g)[r].candidate)
+		delta += transpose_step(ms, g, r, reverse);
 #endif
 	for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	    if (GD_rank(g)[r].candidate) {
-		delta += transpose_step(g, r, reverse);
+	    if (RANKS(ms, g)[r].candidate) {
+		delta += transpose_step(ms, g, r, reverse);
 	    }
 	}
 	/*} while (delta > ncross(g)*(1.0 - Convergence)); */
     } while (delta >= 1);
 }
 
-static int mincross(graph_t * g, int startpass, int endpass, int doBalance)
+/* mincross:
+ * If ms is not NULL, a trial after the first is run in the private
+ * state ms: the initial orderings vary with the trial, and the flat
+ * edges are left as the first trial set them: its cycle breaking holds
+ * for any ordering, and mincross_trials makes the remaining flat edges
+ * point left to right once an ordering has been chosen.
+ */
+static int mincross(graph_t * g, int startpass, int endpass, int doBalance,
+		    mcstate_t * ms)
 {
     int maxthispass, iter, trying, pass;
     int cur_cross, best_cross;
 
     if (startpass > 1) {
-	cur_cross = best_cross = ncross(g);
-	save_best(g);
+	cur_cross = best_cross = ncross_ms(ms);
+	save_best(ms, g);
     } else
 	cur_cross = best_cross = INT_MAX;
     for (pass = startpass; pass <= endpass; pass++) {
 	if (pass <= 1) {
 	    maxthispass = MIN(4, MaxIter);
-	    if (g == dot_root(g))
-		build_ranks(g, pass);
-	    if (pass == 0)
+	    if (g == dot_root(g)) {
+		if (ms)
+		    trial_ranks(ms, g, pass);
+		else
+		    build_ranks(g, pass);
+	    }
+	    if ((pass == 0) && !ms)
 		flat_breakcycles(g);
-	    flat_reorder(g);
+	    flat_reorder(ms, g, !ms);
 
-	    if ((cur_cross = ncross(g)) <= best_cross) {
-		save_best(g);
+	    if ((cur_cross = ncross_ms(ms)) <= best_cross) {
+		save_best(ms, g);
 		best_cross = cur_cross;
 	    }
 	    trying = 0;
 	} else {
 	    maxthispass = MaxIter;
 	    if (cur_cross > best_cross)
-		restore_best(g);
+		restore_best(ms, g);
 	    cur_cross = best_cross;
 	}
 	trying = 0;
 	for (iter = 0; iter < maxthispass; iter++) {
-	    if (Verbose)
+	    if (Verbose && !ms)
 		fprintf(stderr,
 			"mincross: pass %d iter %d trying %d cur_cross %d best_cross %d\n",
 			pass, iter, trying, cur_cross, best_cross);
@@ -863,9 +1001,9 @@ static int mincross(graph_t * g, int startpass, int endpass, int doBalance)
 		break;
 	    if (cur_cross == 0)
 		break;
-	    mincross_step(g, iter);
-	    if ((cur_cross = ncross(g)) <= best_cross) {
-		save_best(g);
+	    mincross_step(ms, g, iter);
+	    if ((cur_cross = ncross_ms(ms)) <= best_cross) {
+		save_best(ms, g);
 		if (cur_cross < Convergence * best_cross)
 		    trying = 0;
 		best_cross = cur_cross;
@@ -875,49 +1013,299 @@ static int mincross(graph_t * g, int startpass, int endpass, int doBalance)
 	    break;
     }
     if (cur_cross > best_cross)
-	restore_best(g);
+	restore_best(ms, g);
     if (best_cross > 0) {
-	transpose(g, FALSE);
-	best_cross = ncross(g);
+	transpose(ms, g, FALSE);
+	best_cross = ncross_ms(ms);
     }
     if (doBalance) {
 	for (iter = 0; iter < maxthispass; iter++)
-	    balance(g);
+	    balance(ms, g);
     }
 
     return best_cross;
 }
 
-static void restore_best(graph_t * g)
+/* trial_rand:
+ * Small linear congruential generator, so that randomized trials depend
+ * only on mcseed and the trial, and not on the state of the C library
+ * generator.
+ */
+static int trial_rand(mcstate_t * ms)
 {
-    node_t *n;
-    int i, r;
+    ms->rand = ms->rand * 1103515245 + 12345;
+    return (int) ((ms->rand >> 16) & 0x7fff);
+}
+
+/* trial_ranks:
+ * Build the initial ordering for a trial after the first. Odd trials
+ * install the nodes depth first rather than breadth first; trials 2 and
+ * 3 then reverse each rank, and trials from 4 on shuffle each rank.
+ */
+static void trial_ranks(mcstate_t * ms, graph_t * g, int pass)
+{
+    int i, j, r, n;
+    node_t **v, *t;
+
+    build_ranks_search(ms, g, pass, ms->trial % 2);
+    if (ms->trial < 2)
+	return;
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	v = ms->rank[r].v;
+	n = ms->rank[r].n;
+	if (ms->trial < 4) {
+	    for (i = 0, j = n - 1; i < j; i++, j--) {
+		t = v[i];
+		v[i] = v[j];
+		v[j] = t;
+	    }
+	} else {
+	    for (i = n - 1; i > 0; i--) {
+		j = trial_rand(ms) % (i + 1);
+		t = v[i];
+		v[i] = v[j];
+		v[j] = t;
+	    }
+	}
+	for (i = 0; i < n; i++)
+	    ORDER(ms, v[i]) = i;
+	ms->rank[r].valid = FALSE;
+    }
+}
+
+/* new_mcstate:
+ * Allocate the state of a trial on the current component of g, whose
+ * nnodes nodes are numbered by ND_id.
+ */
+static mcstate_t *new_mcstate(graph_t * g, int nnodes, int nedges,
+			      char *inside)
+{
+    mcstate_t *ms = NEW(mcstate_t);
+    rank_t *rk;
+    int r;
+
+    ms->rank = N_NEW(GlobalMaxRank + 2, rank_t);
+    memcpy(ms->rank, GD_rank(Root), (GlobalMaxRank + 2) * sizeof(rank_t));
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	rk = &GD_rank(Root)[r];
+	ms->rank[r].an = rk->an - (rk->v - rk->av);
+	ms->rank[r].av = ms->rank[r].v = N_NEW(ms->rank[r].an + 1, node_t *);
+	ms->rank[r].n = 0;
+	ms->rank[r].valid = FALSE;
+    }
+    ms->order = N_NEW(nnodes, int);
+    ms->mval = N_NEW(nnodes, double);
+    ms->saveorder = N_NEW(nnodes, double);
+    ms->mark = N_NEW(nnodes, char);
+    ms->installed = N_NEW(nnodes, char);
+    ms->inside = inside;
+    ms->pc_list = N_NEW(PC_size + 1, paircross_t);
+    ms->ti_list = N_NEW(nedges + 1, int);
+    return ms;
+}
+
+static void free_mcstate(graph_t * g, mcstate_t * ms)
+{
+    int r;
+
+    for (r = GD_minrank(g); r <= GD_maxrank(g); r++)
+	free(ms->rank[r].av);
+    free(ms->rank);
+    free(ms->order);
+    free(ms->mval);
+    free(ms->saveorder);
+    free(ms->mark);
+    free(ms->installed);
+    free(ms->pc_list);
+    free(ms->count);
+    free(ms->ti_list);
+    free(ms);
+}
+
+	/* the trials after the first, run by parallel_for */
+typedef struct {
+    graph_t *g;
+    int doBalance;
+    mctrial_t *mt;
+    int nnodes;			/* nodes of the component */
+    int nedges;			/* edges of the root graph */
+    int cnt;			/* nodes in its ranks */
+    char *inside;		/* inside_cluster(g, v), by ND_id */
+    int *nc;			/* crossings of each trial, or -1 */
+    int *best_nc, *best_t;	/* best trial of each chunk */
+    node_t ***best;		/* and its ordering, rank after rank */
+} mctrials_t;
+
+/* run_trials:
+ * parallel_for work function running trials lo+1 to hi. A chunk keeps
+ * the first of its trials with the fewest crossings.
+ */
+static void run_trials(void *state, int chunk, int lo, int hi)
+{
+    mctrials_t *st = state;
+    graph_t *g = st->g;
+    mcstate_t *ms = new_mcstate(g, st->nnodes, st->nedges, st->inside);
+    int t, r, i, k, nc;
+
+    st->best_nc[chunk] = INT_MAX;
+    st->best[chunk] = N_NEW(st->cnt + 1, node_t *);
+    for (t = lo + 1; t <= hi; t++) {
+	ms->trial = t;
+	ms->rand = st->mt->seed + 0x9E3779B9u * (unsigned int) t;
+	memset(ms->installed, 0, st->nnodes);
+	nc = st->nc[t] = mincross(g, 0, 2, st->doBalance, ms);
+	if (nc < st->best_nc[chunk]) {
+	    st->best_nc[chunk] = nc;
+	    st->best_t[chunk] = t;
+	    for (k = 0, r = GD_minrank(g); r <= GD_maxrank(g); r++)
+		for (i = 0; i < ms->rank[r].n; i++)
+		    st->best[chunk][k++] = ms->rank[r].v[i];
+	}
+	if (nc == 0)
+	    break;
+    }
+    free_mcstate(g, ms);
+}
+
+/* mincross_trials:
+ * Run mincross on the current component once per trial, each starting
+ * from a different initial ordering, and keep the ordering with the
+ * fewest crossings, the first such trial on a tie. Trial 0 is the usual
+ * deterministic run, so the result is never worse than a single run.
+ * For a given mcseed the result is reproducible, and does not depend
+ * on the number of threads.
+ * Trial 0 runs in the graph, and is the only one to change the flat
+ * edges. The others run concurrently, each in a private mcstate_t, and
+ * only read the graph. If one of them wins, its ordering is installed
+ * and the flat edges are made to agree with it.
+ */
+static int mincross_trials(graph_t * g, int doBalance, mctrial_t * mt)
+{
+    mctrials_t st;
+    node_t *n, **best;
+    int *ids, nchunks, c, r, i, k, t, best_nc, best_t;
+
+    best_nc = mincross(g, 0, 2, doBalance, NULL);
+    if (Verbose)
+	fprintf(stderr, "mincross: trial 0 crossings %d\n", best_nc);
+    if (best_nc == 0)
+	return 0;
+
+    /* number the nodes of the component, and find which are inside
+     * the clusters while still on one thread, as cgraph searches are
+     * not safe to run from several */
+    st.nnodes = 0;
+    for (n = GD_nlist(g); n; n = ND_next(n))
+	st.nnodes++;
+    ids = N_NEW(st.nnodes, int);
+    st.inside = N_NEW(st.nnodes, char);
+    for (i = 0, n = GD_nlist(g); n; n = ND_next(n), i++) {
+	ids[i] = ND_id(n);
+	ND_id(n) = i;
+	if (GD_has_flat_edges(g))
+	    st.inside[i] = inside_cluster(g, n);
+    }
+    for (st.cnt = 0, r = GD_minrank(g); r <= GD_maxrank(g); r++)
+	st.cnt += GD_rank(g)[r].n;
+
+    nchunks = MIN(mt->nthreads, mt->trials - 1);
+    st.nedges = agnedges(dot_root(g));
+    st.g = g;
+    st.doBalance = doBalance;
+    st.mt = mt;
+    st.nc = N_NEW(mt->trials, int);
+    for (t = 0; t < mt->trials; t++)
+	st.nc[t] = -1;
+    st.best_nc = N_NEW(nchunks, int);
+    st.best_t = N_NEW(nchunks, int);
+    st.best = N_NEW(nchunks, node_t **);
+    parallel_for(mt->trials - 1, nchunks, run_trials, &st);
+
+    for (i = 0, n = GD_nlist(g); n; n = ND_next(n), i++)
+	ND_id(n) = ids[i];
+    if (Verbose)
+	for (t = 1; t < mt->trials; t++)
+	    if (st.nc[t] >= 0)
+		fprintf(stderr, "mincross: trial %d crossings %d\n", t,
+			st.nc[t]);
+
+    /* the chunks hold increasing trials, so a later chunk wins only
+     * with fewer crossings */
+    best = NULL;
+    best_t = 0;
+    for (c = 0; c < nchunks; c++)
+	if (st.best_nc[c] < best_nc) {
+	    best_nc = st.best_nc[c];
+	    best_t = st.best_t[c];
+	    best = st.best[c];
+	}
+    if (best) {
+	if (Verbose)
+	    fprintf(stderr, "mincross: trial %d kept\n", best_t);
+	for (k = 0, r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	    for (i = 0; i < GD_rank(g)[r].n; i++) {
+		GD_rank(g)[r].v[i] = best[k++];
+		ND_order(GD_rank(g)[r].v[i]) = i;
+	    }
+	    if (GD_has_flat_edges(g))
+		flat_fixlr(g, r);
+	    GD_rank(Root)[r].valid = FALSE;
+	}
+    }
+
+    for (c = 0; c < nchunks; c++)
+	free(st.best[c]);
+    free(st.best);
+    free(st.best_nc);
+    free(st.best_t);
+    free(st.nc);
+    free(st.inside);
+    free(ids);
+    return best_nc;
+}
+
+static void restore_best(mcstate_t * ms, graph_t * g)
+{
+    node_t *n, **v;
+    int i, k, r;
 
     /* for (n = GD_nlist(g); n; n = ND_next(n)) */
 	/* ND_order(n) = saveorder(n); */
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	for (i = 0; i < GD_rank(g)[r].n; i++) {
-	    n = GD_rank(g)[r].v[i];
-	    ND_order(n) = saveorder(n);
+	for (i = 0; i < RANKS(ms, g)[r].n; i++) {
+	    n = RANKS(ms, g)[r].v[i];
+	    ORDER(ms, n) = SAVEORDER(ms, n);
 	}
     }
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	GD_rank(Root)[r].valid = FALSE;
-	qsort(GD_rank(g)[r].v, GD_rank(g)[r].n, sizeof(GD_rank(g)[0].v[0]),
-	      (qsort_cmpf) nodeposcmpf);
+	RANKS(ms, Root)[r].valid = FALSE;
+	if (ms) {
+	    /* the orders of a rank in a trial are 0 to n-1; put each
+	     * node in its place without the shared qsort comparison */
+	    v = ms->rank[r].v;
+	    for (i = 0; i < ms->rank[r].n; i++)
+		while ((k = ORDER(ms, v[i])) != i) {
+		    assert((k >= 0) && (k < ms->rank[r].n));
+		    n = v[k];
+		    v[k] = v[i];
+		    v[i] = n;
+		}
+	} else
+	    qsort(GD_rank(g)[r].v, GD_rank(g)[r].n,
+		  sizeof(GD_rank(g)[0].v[0]), (qsort_cmpf) nodeposcmpf);
     }
 }
 
-static void save_best(graph_t * g)
+static void save_best(mcstate_t * ms, graph_t * g)
 {
     node_t *n;
     /* for (n = GD_nlist(g); n; n = ND_next(n)) */
 	/* saveorder(n) = ND_order(n); */
     int i, r;
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	for (i = 0; i < GD_rank(g)[r].n; i++) {
-	    n = GD_rank(g)[r].v[i];
-	    saveorder(n) = ND_order(n);
+	for (i = 0; i < RANKS(ms, g)[r].n; i++) {
+	    n = RANKS(ms, g)[r].v[i];
+	    SAVEORDER(ms, n) = ORDER(ms, n);
 	}
     }
 }
@@ -989,6 +1377,12 @@ static void cleanup2(graph_t * g, int nc)
 	free(TE_list);
 	TE_list = NULL;
     }
+    if (PC_list) {
+	free(PC_list);
+	free(PC_base);
+	PC_list = NULL;
+	PC_base = NULL;
+    }
     /* fix vlists of clusters */
     for (c = 1; c <= GD_n_cluster(g); c++)
 	rec_reset_vlists(GD_clust(g)[c]);
@@ -1176,7 +1570,7 @@ fillRanks (Agraph_t* g)
 
 static void init_mincross(graph_t * g)
 {
-    int size;
+    int size, r;
 
     if (Verbose)
 	start_timer();
@@ -1198,6 +1592,14 @@ static void init_mincross(graph_t * g)
     ordered_edges(g);
     GlobalMinRank = GD_minrank(g);
     GlobalMaxRank = GD_maxrank(g);
+
+    PC_base = N_NEW(GD_maxrank(g) + 2, int);
+    for (size = 0, r = GD_minrank(g); r <= GD_maxrank(g); r++) {
+	PC_base[r] = size;
+	size += GD_rank(g)[r].an + 1;
+    }
+    PC_size = size;
+    PC_list = N_NEW(size + 1, paircross_t);
 }
 
 void flat_rev(Agraph_t * g, Agedge_t * e)
@@ -1328,22 +1730,22 @@ void allocate_ranks(graph_t * g)
 }
 
 /* install a node at the current right end of its rank */
-void install_in_rank(graph_t * g, node_t * n)
+static void install_in_rank_ms(mcstate_t * ms, graph_t * g, node_t * n)
 {
     int i, r;
 
     r = ND_rank(n);
-    i = GD_rank(g)[r].n;
-    if (GD_rank(g)[r].an <= 0) {
+    i = RANKS(ms, g)[r].n;
+    if (RANKS(ms, g)[r].an <= 0) {
 	agerr(AGERR, "install_in_rank, line %d: %s %s rank %d i = %d an = 0\n",
 	      __LINE__, agnameof(g), agnameof(n), r, i);
 	return;
     }
 
-    GD_rank(g)[r].v[i] = n;
-    ND_order(n) = i;
-    GD_rank(g)[r].n++;
-    assert(GD_rank(g)[r].n <= GD_rank(g)[r].an);
+    RANKS(ms, g)[r].v[i] = n;
+    ORDER(ms, n) = i;
+    RANKS(ms, g)[r].n++;
+    assert(RANKS(ms, g)[r].n <= RANKS(ms, g)[r].an);
 #ifdef DEBUG
     {
 	node_t *v;
@@ -1354,9 +1756,9 @@ void install_in_rank(graph_t * g, node_t * n)
 	assert(v != NULL);
     }
 #endif
-    if (ND_order(n) > GD_rank(Root)[r].an) {
-	agerr(AGERR, "install_in_rank, line %d: ND_order(%s) [%d] > GD_rank(Root)[%d].an [%d]\n",
-	      __LINE__, agnameof(n), ND_order(n), r, GD_rank(Root)[r].an);
+    if (ORDER(ms, n) > RANKS(ms, Root)[r].an) {
+	agerr(AGERR, "install_in_rank, line %d: ND_order(%s) [%d] > RANKS(ms, Root)[%d].an [%d]\n",
+	      __LINE__, agnameof(n), ORDER(ms, n), r, RANKS(ms, Root)[r].an);
 	return;
     }
     if ((r < GD_minrank(g)) || (r > GD_maxrank(g))) {
@@ -1364,19 +1766,46 @@ void install_in_rank(graph_t * g, node_t * n)
 	      __LINE__, r, GD_minrank(g), GD_maxrank(g));
 	return;
     }
-    if (GD_rank(g)[r].v + ND_order(n) >
-	GD_rank(g)[r].av + GD_rank(Root)[r].an) {
-	agerr(AGERR, "install_in_rank, line %d: GD_rank(g)[%d].v + ND_order(%s) [%d] > GD_rank(g)[%d].av + GD_rank(Root)[%d].an [%d]\n",
-	      __LINE__, r, agnameof(n),GD_rank(g)[r].v + ND_order(n), r, r, GD_rank(g)[r].av+GD_rank(Root)[r].an);
+    if (RANKS(ms, g)[r].v + ORDER(ms, n) >
+	RANKS(ms, g)[r].av + RANKS(ms, Root)[r].an) {
+	agerr(AGERR, "install_in_rank, line %d: RANKS(ms, g)[%d].v + ND_order(%s) [%d] > RANKS(ms, g)[%d].av + RANKS(ms, Root)[%d].an [%d]\n",
+	      __LINE__, r, agnameof(n),RANKS(ms, g)[r].v + ORDER(ms, n), r, r, RANKS(ms, g)[r].av+RANKS(ms, Root)[r].an);
 	return;
     }
 }
 
+void install_in_rank(graph_t * g, node_t * n)
+{
+    install_in_rank_ms(NULL, g, n);
+}
+
 /*	install nodes in ranks. the initial ordering ensure that series-parallel
  *	graphs such as trees are drawn with no crossings.  it tries searching
  *	in- and out-edges and takes the better of the two initial orderings.
  */
 void build_ranks(graph_t * g, int pass)
+{
+    build_ranks_search(NULL, g, pass, FALSE);
+}
+
+/* unqueue:
+ * Remove the node most recently added to q, so that q serves as a stack.
+ */
+static node_t *unqueue(nodequeue * q)
+{
+    if (q->head == q->tail)
+	return NULL;
+    if (q->tail == q->store)
+	q->tail = q->limit;
+    return *(--q->tail);
+}
+
+/* build_ranks_search:
+ * Install the nodes breadth first, as build_ranks does, or depth first
+ * if dfs is true.
+ */
+static void build_ranks_search(mcstate_t * ms, graph_t * g, int pass,
+			       boolean dfs)
 {
     int i, j;
     node_t *n, *n0;
@@ -1385,34 +1814,36 @@ void build_ranks(graph_t * g, int pass)
 
     q = new_queue(GD_n_nodes(g));
     for (n = GD_nlist(g); n; n = ND_next(n))
-	MARK(n) = FALSE;
+	TMARK(ms, n) = FALSE;
 
 #ifdef DEBUG
     {
 	edge_t *e;
 	for (n = GD_nlist(g); n; n = ND_next(n)) {
 	    for (i = 0; (e = ND_out(n).list[i]); i++)
-		assert(MARK(aghead(e)) == FALSE);
+		assert(TMARK(ms, aghead(e)) == FALSE);
 	    for (i = 0; (e = ND_in(n).list[i]); i++)
-		assert(MARK(agtail(e)) == FALSE);
+		assert(TMARK(ms, agtail(e)) == FALSE);
 	}
     }
 #endif
 
     for (i = GD_minrank(g); i <= GD_maxrank(g); i++)
-	GD_rank(g)[i].n = 0;
+	RANKS(ms, g)[i].n = 0;
 
     for (n = GD_nlist(g); n; n = ND_next(n)) {
 	otheredges = ((pass == 0) ? ND_in(n).list : ND_out(n).list);
 	if (otheredges[0] != NULL)
 	    continue;
-	if (MARK(n) == FALSE) {
-	    MARK(n) = TRUE;
+	if (TMARK(ms, n) == FALSE) {
+	    TMARK(ms, n) = TRUE;
 	    enqueue(q, n);
-	    while ((n0 = dequeue(q))) {
+	    while ((n0 = (dfs ? unqueue(q) : dequeue(q)))) {
 		if (ND_ranktype(n0) != CLUSTER) {
-		    install_in_rank(g, n0);
-		    enqueue_neighbors(q, n0, pass);
+		    install_in_rank_ms(ms, g, n0);
+		    enqueue_neighbors_ms(ms, q, n0, pass);
+		} else if (ms) {
+		    install_cluster_ms(ms, g, n0, pass, q);
 		} else {
 		    install_cluster(g, n0, pass, q);
 		}
@@ -1422,23 +1853,24 @@ void build_ranks(graph_t * g, int pass)
     if (dequeue(q))
 	agerr(AGERR, "surprise\n");
     for (i = GD_minrank(g); i <= GD_maxrank(g); i++) {
-	GD_rank(Root)[i].valid = FALSE;
-	if (GD_flip(g) && (GD_rank(g)[i].n > 0)) {
+	RANKS(ms, Root)[i].valid = FALSE;
+	if (GD_flip(g) && (RANKS(ms, g)[i].n > 0)) {
 	    int n, ndiv2;
-	    node_t **vlist = GD_rank(g)[i].v;
-	    n = GD_rank(g)[i].n - 1;
+	    node_t **vlist = RANKS(ms, g)[i].v;
+	    n = RANKS(ms, g)[i].n - 1;
 	    ndiv2 = n / 2;
 	    for (j = 0; j <= ndiv2; j++)
-		exchange(vlist[j], vlist[n - j]);
+		exchange(ms, vlist[j], vlist[n - j]);
 	}
     }
 
-    if ((g == dot_root(g)) && ncross(g) > 0)
-	transpose(g, FALSE);
+    if ((g == dot_root(g)) && ncross_ms(ms) > 0)
+	transpose(ms, g, FALSE);
     free_queue(q);
 }
 
-void enqueue_neighbors(nodequeue * q, node_t * n0, int pass)
+static void enqueue_neighbors_ms(mcstate_t * ms, nodequeue * q, node_t * n0,
+				 int pass)
 {
     int i;
     edge_t *e;
@@ -1446,25 +1878,53 @@ void enqueue_neighbors(nodequeue * q, node_t * n0, int pass)
     if (pass == 0) {
 	for (i = 0; i < ND_out(n0).size; i++) {
 	    e = ND_out(n0).list[i];
-	    if ((MARK(aghead(e))) == FALSE) {
-		MARK(aghead(e)) = TRUE;
+	    if ((TMARK(ms, aghead(e))) == FALSE) {
+		TMARK(ms, aghead(e)) = TRUE;
 		enqueue(q, aghead(e));
 	    }
 	}
     } else {
 	for (i = 0; i < ND_in(n0).size; i++) {
 	    e = ND_in(n0).list[i];
-	    if ((MARK(agtail(e))) == FALSE) {
-		MARK(agtail(e)) = TRUE;
+	    if ((TMARK(ms, agtail(e))) == FALSE) {
+		TMARK(ms, agtail(e)) = TRUE;
 		enqueue(q, agtail(e));
 	    }
 	}
     }
 }
 
-static int constraining_flat_edge(Agraph_t *g, Agnode_t *v, Agedge_t *e)
+void enqueue_neighbors(nodequeue * q, node_t * n0, int pass)
+{
+    enqueue_neighbors_ms(NULL, q, n0, pass);
+}
+
+/* install_cluster_ms:
+ * install_cluster for a trial, keeping the installed pass of the
+ * cluster in ms.
+ */
+static void install_cluster_ms(mcstate_t * ms, graph_t * g, node_t * n,
+			       int pass, nodequeue * q)
+{
+    int r;
+    graph_t *clust;
+    char *installed;
+
+    clust = ND_clust(n);
+    installed = &ms->installed[ND_id(GD_rankleader(clust)[GD_minrank(clust)])];
+    if (*installed != pass + 1) {
+	for (r = GD_minrank(clust); r <= GD_maxrank(clust); r++)
+	    install_in_rank_ms(ms, g, GD_rankleader(clust)[r]);
+	for (r = GD_minrank(clust); r <= GD_maxrank(clust); r++)
+	    enqueue_neighbors_ms(ms, q, GD_rankleader(clust)[r], pass);
+	*installed = pass + 1;
+    }
+}
+
+static int constraining_flat_edge(mcstate_t *ms, Agraph_t *g, Agnode_t *v, Agedge_t *e)
 {
 	if (ED_weight(e) == 0) return FALSE;
+	if (ms) return ms->inside[ND_id(agtail(e))] && ms->inside[ND_id(aghead(e))];
 	if (!inside_cluster(g,agtail(e))) return FALSE;
 	if (!inside_cluster(g,aghead(e))) return FALSE;
 	return TRUE;
@@ -1474,17 +1934,18 @@ static int constraining_flat_edge(Agraph_t *g, Agnode_t *v, Agedge_t *e)
 /* construct nodes reachable from 'here' in post-order.
 * This is the same as doing a topological sort in reverse order.
 */
-static int postorder(graph_t * g, node_t * v, node_t ** list, int r)
+static int postorder(mcstate_t * ms, graph_t * g, node_t * v, node_t ** list,
+		     int r)
 {
     edge_t *e;
     int i, cnt = 0;
 
-    MARK(v) = TRUE;
+    TMARK(ms, v) = TRUE;
     if (ND_flat_out(v).size > 0) {
 	for (i = 0; (e = ND_flat_out(v).list[i]); i++) {
-	    if (!constraining_flat_edge(g,v,e)) continue;
-	    if (MARK(aghead(e)) == FALSE)
-		cnt += postorder(g, aghead(e), list + cnt, r);
+	    if (!constraining_flat_edge(ms,g,v,e)) continue;
+	    if (TMARK(ms, aghead(e)) == FALSE)
+		cnt += postorder(ms, g, aghead(e), list + cnt, r);
 	}
     }
     assert(ND_rank(v) == r);
@@ -1492,43 +1953,72 @@ static int postorder(graph_t * g, node_t * v, node_t ** list, int r)
     return cnt;
 }
 
-static void flat_reorder(graph_t * g)
+/* flat_fixlr:
+ * Nonconstraint flat edges on rank r must be made LR.
+ */
+static void flat_fixlr(graph_t * g, int r)
+{
+    int i, j;
+    node_t *v;
+    edge_t *e;
+
+    for (i = 0; i < GD_rank(g)[r].n; i++) {
+	v = GD_rank(g)[r].v[i];
+	if (ND_flat_out(v).list) {
+	    for (j = 0; (e = ND_flat_out(v).list[j]); j++) {
+		if ( ((GD_flip(g) == FALSE) && (ND_order(aghead(e)) < ND_order(agtail(e)))) ||
+			 ( (GD_flip(g)) && (ND_order(aghead(e)) > ND_order(agtail(e)) ))) {
+		    assert(constraining_flat_edge(NULL,g,v,e) == FALSE);
+		    delete_flat_edge(e);
+		    j--;
+		    flat_rev(g, e);
+		}
+	    }
+	}
+    }
+}
+
+/* flat_reorder:
+ * Put the nodes of each rank in a topological order of their constraining
+ * flat edges. If fixlr is false, the other flat edges are left as they are.
+ */
+static void flat_reorder(mcstate_t * ms, graph_t * g, boolean fixlr)
 {
     int i, j, r, pos, n_search, local_in_cnt, local_out_cnt, base_order;
     node_t *v, **left, **right, *t;
     node_t **temprank = NULL;
-    edge_t *flat_e, *e;
+    edge_t *flat_e;
 
     if (GD_has_flat_edges(g) == FALSE)
 	return;
     for (r = GD_minrank(g); r <= GD_maxrank(g); r++) {
-	if (GD_rank(g)[r].n == 0) continue;
-	base_order = ND_order(GD_rank(g)[r].v[0]);
-	for (i = 0; i < GD_rank(g)[r].n; i++)
-	    MARK(GD_rank(g)[r].v[i]) = FALSE;
+	if (RANKS(ms, g)[r].n == 0) continue;
+	base_order = ORDER(ms, RANKS(ms, g)[r].v[0]);
+	for (i = 0; i < RANKS(ms, g)[r].n; i++)
+	    TMARK(ms, RANKS(ms, g)[r].v[i]) = FALSE;
 	temprank = ALLOC(i + 1, temprank, node_t *);
 	pos = 0;
 
 	/* construct reverse topological sort order in temprank */
-	for (i = 0; i < GD_rank(g)[r].n; i++) {
-	    if (GD_flip(g)) v = GD_rank(g)[r].v[i];
-	    else v = GD_rank(g)[r].v[GD_rank(g)[r].n - i - 1];
+	for (i = 0; i < RANKS(ms, g)[r].n; i++) {
+	    if (GD_flip(g)) v = RANKS(ms, g)[r].v[i];
+	    else v = RANKS(ms, g)[r].v[RANKS(ms, g)[r].n - i - 1];
 
 	    local_in_cnt = local_out_cnt = 0;
 	    for (j = 0; j < ND_flat_in(v).size; j++) {
 		flat_e = ND_flat_in(v).list[j];
-		if (constraining_flat_edge(g,v,flat_e)) local_in_cnt++;
+		if (constraining_flat_edge(ms,g,v,flat_e)) local_in_cnt++;
 	    }
 	    for (j = 0; j < ND_flat_out(v).size; j++) {
 		flat_e = ND_flat_out(v).list[j];
-		if (constraining_flat_edge(g,v,flat_e)) local_out_cnt++;
+		if (constraining_flat_edge(ms,g,v,flat_e)) local_out_cnt++;
 	    }
 	    if ((local_in_cnt == 0) && (local_out_cnt == 0))
 		temprank[pos++] = v;
 	    else {
-		if ((MARK(v) == FALSE) && (local_in_cnt == 0)) {
+		if ((TMARK(ms, v) == FALSE) && (local_in_cnt == 0)) {
 		    left = temprank + pos;
-		    n_search = postorder(g, v, left, r);
+		    n_search = postorder(ms, g, v, left, r);
 		    pos += n_search;
 		}
 	    }
@@ -1546,47 +2036,35 @@ static void flat_reorder(graph_t * g)
 		    right--;
 		}
 	    }
-	    for (i = 0; i < GD_rank(g)[r].n; i++) {
-		v = GD_rank(g)[r].v[i] = temprank[i];
-		ND_order(v) = i + base_order;
+	    for (i = 0; i < RANKS(ms, g)[r].n; i++) {
+		v = RANKS(ms, g)[r].v[i] = temprank[i];
+		ORDER(ms, v) = i + base_order;
 	    }
 
-	    /* nonconstraint flat edges must be made LR */
-	    for (i = 0; i < GD_rank(g)[r].n; i++) {
-		v = GD_rank(g)[r].v[i];
-		if (ND_flat_out(v).list) {
-		    for (j = 0; (e = ND_flat_out(v).list[j]); j++) {
-			if ( ((GD_flip(g) == FALSE) && (ND_order(aghead(e)) < ND_order(agtail(e)))) ||
-				 ( (GD_flip(g)) && (ND_order(aghead(e)) > ND_order(agtail(e)) ))) {
-			    assert(constraining_flat_edge(g,v,e) == FALSE);
-			    delete_flat_edge(e);
-			    j--;
-			    flat_rev(g, e);
-			}
-		    }
-		}
-	    }
+	    if (fixlr)
+		flat_fixlr(g, r);
 	    /* postprocess to restore intended order */
 	}
 	/* else do no harm! */
-	GD_rank(Root)[r].valid = FALSE;
+	RANKS(ms, Root)[r].valid = FALSE;
     }
     if (temprank)
 	free(temprank);
 }
 
-static void reorder(graph_t * g, int r, int reverse, int hasfixed)
+static void reorder(mcstate_t * ms, graph_t * g, int r, int reverse,
+		    int hasfixed)
 {
     int changed = 0, nelt;
     boolean muststay, sawclust;
-    node_t **vlist = GD_rank(g)[r].v;
-    node_t **lp, **rp, **ep = vlist + GD_rank(g)[r].n;
+    node_t **vlist = RANKS(ms, g)[r].v;
+    node_t **lp, **rp, **ep = vlist + RANKS(ms, g)[r].n;
 
-    for (nelt = GD_rank(g)[r].n - 1; nelt >= 0; nelt--) {
+    for (nelt = RANKS(ms, g)[r].n - 1; nelt >= 0; nelt--) {
 	lp = vlist;
 	while (lp < ep) {
 	    /* find leftmost node that can be compared */
-	    while ((lp < ep) && (ND_mval(*lp) < 0))
+	    while ((lp < ep) && (MVAL(ms, *lp) < 0))
 		lp++;
 	    if (lp >= ep)
 		break;
@@ -1595,11 +2073,11 @@ static void reorder(graph_t * g, int r, int reverse, int hasfixed)
 	    for (rp = lp + 1; rp < ep; rp++) {
 		if (sawclust && ND_clust(*rp))
 		    continue;	/* ### */
-		if (left2right(g, *lp, *rp)) {
+		if (left2right(ms, g, *lp, *rp)) {
 		    muststay = TRUE;
 		    break;
 		}
-		if (ND_mval(*rp) >= 0)
+		if (MVAL(ms, *rp) >= 0)
 		    break;
 		if (ND_clust(*rp))
 		    sawclust = TRUE;	/* ### */
@@ -1607,10 +2085,10 @@ static void reorder(graph_t * g, int r, int reverse, int hasfixed)
 	    if (rp >= ep)
 		break;
 	    if (muststay == FALSE) {
-		register int p1 = (ND_mval(*lp));
-		register int p2 = (ND_mval(*rp));
+		register int p1 = (MVAL(ms, *lp));
+		register int p2 = (MVAL(ms, *rp));
 		if ((p1 > p2) || ((p1 == p2) && (reverse))) {
-		    exchange(*lp, *rp);
+		    exchange(ms, *lp, *rp);
 		    changed++;
 		}
 	    }
@@ -1621,13 +2099,13 @@ static void reorder(graph_t * g, int r, int reverse, int hasfixed)
     }
 
     if (changed) {
-	GD_rank(Root)[r].valid = FALSE;
+	RANKS(ms, Root)[r].valid = FALSE;
 	if (r > 0)
-	    GD_rank(Root)[r - 1].valid = FALSE;
+	    RANKS(ms, Root)[r - 1].valid = FALSE;
     }
 }
 
-static void mincross_step(graph_t * g, int pass)
+static void mincross_step(mcstate_t * ms, graph_t * g, int pass)
 {
     int r, other, first, last, dir;
     int hasfixed, reverse;
@@ -1661,13 +2139,13 @@ static void mincross_step(graph_t * g, int pass)
 
     for (r = first; r != last + dir; r += dir) {
 	other = r - dir;
-	hasfixed = medians(g, r, other);
-	reorder(g, r, reverse, hasfixed);
+	hasfixed = medians(ms, g, r, other);
+	reorder(ms, g, r, reverse, hasfixed);
     }
-    transpose(g, NOT(reverse));
+    transpose(ms, g, NOT(reverse));
 }
 
-static int local_cross(elist l, int dir)
+static int local_cross(mcstate_t * ms, elist l, int dir)
 {
     int i, j, is_out;
     int cross = 0;
@@ -1679,12 +2157,12 @@ static int local_cross(elist l, int dir)
     for (i = 0; (e = l.list[i]); i++) {
 	if (is_out)
 	    for (j = i + 1; (f = l.list[j]); j++) {
-		if ((ND_order(aghead(f)) - ND_order(aghead(e)))
+		if ((ORDER(ms, aghead(f)) - ORDER(ms, aghead(e)))
 			 * (ED_tail_port(f).p.x - ED_tail_port(e).p.x) < 0)
 		    cross += ED_xpenalty(e) * ED_xpenalty(f);
 	} else
 	    for (j = i + 1; (f = l.list[j]); j++) {
-		if ((ND_order(agtail(f)) - ND_order(agtail(e)))
+		if ((ORDER(ms, agtail(f)) - ORDER(ms, agtail(e)))
 			* (ED_head_port(f).p.x - ED_head_port(e).p.x) < 0)
 		    cross += ED_xpenalty(e) * ED_xpenalty(f);
 	    }
@@ -1692,70 +2170,87 @@ static int local_cross(elist l, int dir)
     return cross;
 }
 
-static int rcross(graph_t * g, int r)
+/* rcross:
+ * Count the crossings between ranks r and r+1. Edges are taken in
+ * order of their tails; Count is a Fenwick tree over the positions in
+ * rank r+1 holding the penalty of the edges seen so far, so each edge
+ * finds the weight of earlier edges ending to the right of its head in
+ * O(log n) (Barth, Juenger and Mutzel).
+ */
+static int rcross(mcstate_t * ms, graph_t * g, int r)
 {
     static int *Count, C;
-    int top, bot, cross, max, i, k;
+    int **count = (ms ? &ms->count : &Count);
+    int *c = (ms ? &ms->c : &C);
+    int top, bot, cross, total, sum, n, i, k;
     node_t **rtop, *v;
 
     cross = 0;
-    max = 0;
-    rtop = GD_rank(g)[r].v;
+    total = 0;
+    rtop = RANKS(ms, g)[r].v;
+    n = RANKS(ms, g)[r + 1].n;
 
-    if (C <= GD_rank(Root)[r + 1].n) {
-	C = GD_rank(Root)[r + 1].n + 1;
-	Count = ALLOC(C, Count, int);
+    if (*c <= RANKS(ms, Root)[r + 1].n) {
+	*c = RANKS(ms, Root)[r + 1].n + 1;
+	*count = ALLOC(*c, *count, int);
     }
 
-    for (i = 0; i < GD_rank(g)[r + 1].n; i++)
-	Count[i] = 0;
+    for (i = 0; i <= n; i++)
+	(*count)[i] = 0;
 
-    for (top = 0; top < GD_rank(g)[r].n; top++) {
+    for (top = 0; top < RANKS(ms, g)[r].n; top++) {
 	register edge_t *e;
-	if (max > 0) {
+	if (total > 0) {
 	    for (i = 0; (e = ND_out(rtop[top]).list[i]); i++) {
-		for (k = ND_order(aghead(e)) + 1; k <= max; k++)
-		    cross += Count[k] * ED_xpenalty(e);
+		sum = 0;
+		for (k = ORDER(ms, aghead(e)) + 1; k > 0; k -= k & -k)
+		    sum += (*count)[k];
+		cross += (total - sum) * ED_xpenalty(e);
 	    }
 	}
 	for (i = 0; (e = ND_out(rtop[top]).list[i]); i++) {
-	    register int inv = ND_order(aghead(e));
-	    if (inv > max)
-		max = inv;
-	    Count[inv] += ED_xpenalty(e);
+	    for (k = ORDER(ms, aghead(e)) + 1; k <= n; k += k & -k)
+		(*count)[k] += ED_xpenalty(e);
+	    total += ED_xpenalty(e);
 	}
     }
-    for (top = 0; top < GD_rank(g)[r].n; top++) {
-	v = GD_rank(g)[r].v[top];
+    for (top = 0; top < RANKS(ms, g)[r].n; top++) {
+	v = RANKS(ms, g)[r].v[top];
 	if (ND_has_port(v))
-	    cross += local_cross(ND_out(v), 1);
+	    cross += local_cross(ms, ND_out(v), 1);
     }
-    for (bot = 0; bot < GD_rank(g)[r + 1].n; bot++) {
-	v = GD_rank(g)[r + 1].v[bot];
+    for (bot = 0; bot < RANKS(ms, g)[r + 1].n; bot++) {
+	v = RANKS(ms, g)[r + 1].v[bot];
 	if (ND_has_port(v))
-	    cross += local_cross(ND_in(v), -1);
+	    cross += local_cross(ms, ND_in(v), -1);
     }
     return cross;
 }
 
-int ncross(graph_t * g)
+static int ncross_ms(mcstate_t * ms)
 {
     int r, count, nc;
+    graph_t *g = Root;
+    rank_t *rk = RANKS(ms, g);
 
-    g = Root;
     count = 0;
     for (r = GD_minrank(g); r < GD_maxrank(g); r++) {
-	if (GD_rank(g)[r].valid)
-	    count += GD_rank(g)[r].cache_nc;
+	if (rk[r].valid)
+	    count += rk[r].cache_nc;
 	else {
-	    nc = GD_rank(g)[r].cache_nc = rcross(g, r);
+	    nc = rk[r].cache_nc = rcross(ms, g, r);
 	    count += nc;
-	    GD_rank(g)[r].valid = TRUE;
+	    rk[r].valid = TRUE;
 	}
     }
     return count;
 }
 
+int ncross(graph_t * g)
+{
+    return ncross_ms(NULL);
+}
+
 static int ordercmpf(int *i0, int *i1)
 {
     return (*i0) - (*i1);
@@ -1771,7 +2266,7 @@ static int ordercmpf(int *i0, int *i1)
  * a.mval is > 0.
  * Return true if n.mval is left -1, indicating a fixed node for sorting.
  */
-static int flat_mval(node_t * n)
+static int flat_mval(mcstate_t * ms, node_t * n)
 {
     int i;
     edge_t *e, **fl;
@@ -1781,38 +2276,38 @@ static int flat_mval(node_t * n)
 	fl = ND_flat_in(n).list;
 	nn = agtail(fl[0]);
 	for (i = 1; (e = fl[i]); i++)
-	    if (ND_order(agtail(e)) > ND_order(nn))
+	    if (ORDER(ms, agtail(e)) > ORDER(ms, nn))
 		nn = agtail(e);
-	if (ND_mval(nn) >= 0) {
-	    ND_mval(n) = ND_mval(nn) + 1;
+	if (MVAL(ms, nn) >= 0) {
+	    MVAL(ms, n) = MVAL(ms, nn) + 1;
 	    return FALSE;
 	}
     } else if (ND_flat_out(n).size > 0) {
 	fl = ND_flat_out(n).list;
 	nn = aghead(fl[0]);
 	for (i = 1; (e = fl[i]); i++)
-	    if (ND_order(aghead(e)) < ND_order(nn))
+	    if (ORDER(ms, aghead(e)) < ORDER(ms, nn))
 		nn = aghead(e);
-	if (ND_mval(nn) > 0) {
-	    ND_mval(n) = ND_mval(nn) - 1;
+	if (MVAL(ms, nn) > 0) {
+	    MVAL(ms, n) = MVAL(ms, nn) - 1;
 	    return FALSE;
 	}
     }
     return TRUE;
 }
 
-#define VAL(node,port) (MC_SCALE * ND_order(node) + (port).order)
+#define VAL(node,port) (MC_SCALE * ORDER(ms, node) + (port).order)
 
-static boolean medians(graph_t * g, int r0, int r1)
+static boolean medians(mcstate_t * ms, graph_t * g, int r0, int r1)
 {
     int i, j, j0, lm, rm, lspan, rspan, *list;
     node_t *n, **v;
     edge_t *e;
     boolean hasfixed = FALSE;
 
-    list = TI_list;
-    v = GD_rank(g)[r0].v;
-    for (i = 0; i < GD_rank(g)[r0].n; i++) {
+    list = (ms ? ms->ti_list : TI_list);
+    v = RANKS(ms, g)[r0].v;
+    for (i = 0; i < RANKS(ms, g)[r0].n; i++) {
 	n = v[i];
 	j = 0;
 	if (r1 > r0)
@@ -1826,18 +2321,18 @@ static boolean medians(graph_t * g, int r0, int r1)
 	    }
 	switch (j) {
 	case 0:
-	    ND_mval(n) = -1;
+	    MVAL(ms, n) = -1;
 	    break;
 	case 1:
-	    ND_mval(n) = list[0];
+	    MVAL(ms, n) = list[0];
 	    break;
 	case 2:
-	    ND_mval(n) = (list[0] + list[1]) / 2;
+	    MVAL(ms, n) = (list[0] + list[1]) / 2;
 	    break;
 	default:
 	    qsort(list, j, sizeof(int), (qsort_cmpf) ordercmpf);
 	    if (j % 2)
-		ND_mval(n) = list[j / 2];
+		MVAL(ms, n) = list[j / 2];
 	    else {
 		/* weighted median */
 		rm = j / 2;
@@ -1845,18 +2340,18 @@ static boolean medians(graph_t * g, int r0, int r1)
 		rspan = list[j - 1] - list[rm];
 		lspan = list[lm] - list[0];
 		if (lspan == rspan)
-		    ND_mval(n) = (list[lm] + list[rm]) / 2;
+		    MVAL(ms, n) = (list[lm] + list[rm]) / 2;
 		else {
 		    int w = list[lm] * rspan + list[rm] * lspan;
-		    ND_mval(n) = w / (lspan + rspan);
+		    MVAL(ms, n) = w / (lspan + rspan);
 		}
 	    }
 	}
     }
-    for (i = 0; i < GD_rank(g)[r0].n; i++) {
+    for (i = 0; i < RANKS(ms, g)[r0].n; i++) {
 	n = v[i];
 	if ((ND_out(n).size == 0) && (ND_in(n).size == 0))
-	    hasfixed |= flat_mval(n);
+	    hasfixed |= flat_mval(ms, n);
     }
     return hasfixed;
 }
@@ -1964,6 +2459,25 @@ static void mincross_options(graph_t * g)
     }
 }
 
+/* trial_options:
+ * Read the number of trials and their seed from the mctrials and mcseed
+ * attributes of g, and the number of threads running them from threads.
+ */
+static void trial_options(graph_t * g, mctrial_t * mt)
+{
+    char *p;
+
+    mt->trials = 1;
+    p = agget(g, "mctrials");
+    if (p && (atoi(p) > 1))
+	mt->trials = atoi(p);
+    mt->seed = 1;
+    p = agget(g, "mcseed");
+    if (p && *p)
+	mt->seed = (unsigned int) atoi(p);
+    mt->nthreads = parallel_threads(g);
+}
+
 #ifdef DEBUG
 void check_exchange(node_t * v, node_t * w)
 {
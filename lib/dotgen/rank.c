@@ -666,8 +666,6 @@ collapse_leaves(graph_t * g)
  */
 #define ND_comp(n)  ND_hops(n)   
 
-extern int rank2(Agraph_t *, int, int, int);
-
 static void set_parent(graph_t* g, graph_t* p) 
 {
     GD_parent(g) = p;
@@ -1228,7 +1226,7 @@ void dot2_rank(graph_t * g, aspect_t* asp)
 	ssize = atoi(s);
     else
 	ssize = -1;
-    rank2(Xg, 1, maxiter, ssize);
+    nsrank(Xg, 1, maxiter, ssize, nsmode(g));
 /* fastgr(Xg); */
     readout_levels(g, Xg, ncc);
 #ifdef DEBUG
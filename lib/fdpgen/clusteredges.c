@@ -275,7 +275,7 @@ int compoundEdges(graph_t * g, expand_t* pm, int edgetype)
 	    } else if (ED_count(e)) {
 		objl = objectList(e, pm);
 		if (Plegal_arrangement(objl->obs, objl->cnt)) {
-		    vconfig = Pobsopen(objl->obs, objl->cnt);
+		    vconfig = Pobsopen_incremental(objl->obs, objl->cnt);
 		    if (!vconfig) {
 			agerr(AGWARN, "compoundEdges: could not construct obstacles - falling back to straight line edges\n");
 			rv = 1;
@@ -306,6 +306,7 @@ int compoundEdges(graph_t * g, expand_t* pm, int edgetype)
 			getPath(e0, vconfig, 0, objl->obs, objl->cnt);
 		    makeSpline(g, e0, objl->obs, objl->cnt, FALSE);
 		}
+		Pobsclose(vconfig);
 		resetObjlist(objl);
 	    }
 	}
@@ -44,7 +44,7 @@ static void initialPositions(graph_t * g)
 	if (p[0]) {
 	    pvec = ND_pos(np);
 	    c = '\0';
-	    if (sscanf(p, "%lf,%lf%c", pvec, pvec + 1, &c) >= 2) {
+	    if (agxgetpoint(np, possym, pvec, 2, &c) >= 2) {
 		if (PSinputscale > 0.0) {
 		    int j;
 		    for (j = 0; j < NDIM; j++)
@@ -30,9 +30,11 @@
 #include "gvcint.h"
 #include "gvcproc.h"
 #include "gvc.h"
+#include "parallel.h"
 
 /* from common/utils.c */
 extern void *zmalloc(size_t);
+extern void gv_runatclose(void);
 
 /* from common/textspan.c */
 extern void textfont_dict_close(GVC_t *gvc);
@@ -82,6 +84,9 @@ int gvFreeContext(GVC_t * gvc)
 #undef ELEM
 
     emit_once_reset();
+    gv_runatclose();
+    parallel_shutdown();
+    agpoolclose();
     gvg_next = gvc->gvgs;
     while ((gvg = gvg_next)) {
 	gvg_next = gvg->next;
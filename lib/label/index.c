@@ -11,6 +11,7 @@
  *************************************************************************/
 
 #include <stdlib.h>
+#include <math.h>
 
 #include "index.h"
 #include <stdio.h>
@@ -195,7 +196,8 @@ LeafList_t *RTreeSearch(RTree_t * rtp, Node_t * n, Rect_t * r)
     assert(n->level >= 0);
     assert(r);
 
-    rtp->SeTouchCount++;
+    if (rtp->StatFlag)
+	rtp->SeTouchCount++;
 
     if (n->level > 0) {		/* this is an internal node in the tree */
 	for (i = 0; i < NODECARD; i++)
@@ -222,6 +224,112 @@ LeafList_t *RTreeSearch(RTree_t * rtp, Node_t * n, Rect_t * r)
     return llp;
 }
 
+/* Sort-Tile-Recursive bulk loading, from
+ * "STR: A Simple and Efficient Algorithm for R-Tree Packing"
+ * Scott T. Leutenegger, Mario A. Lopez, Jeffrey M. Edgington
+ * Proceedings of the 13th International Conference on Data Engineering, 1997
+ */
+
+/* A branch, with its rank in the order the branches were given.
+** Branches with equal centers are kept in that order.
+*/
+typedef struct {
+    Branch_t b;
+    int rank;
+} SortBranch_t;
+
+static int bcmpx(const void *x, const void *y)
+{
+    const SortBranch_t *p = x, *q = y;
+    long rc = (long) p->b.rect.boundary[CX(0)] + p->b.rect.boundary[NX(0)];
+    long sc = (long) q->b.rect.boundary[CX(0)] + q->b.rect.boundary[NX(0)];
+
+    if (rc != sc)
+	return (rc > sc) - (rc < sc);
+    return (p->rank > q->rank) - (p->rank < q->rank);
+}
+
+static int bcmpy(const void *x, const void *y)
+{
+    const SortBranch_t *p = x, *q = y;
+    long rc = (long) p->b.rect.boundary[CY(0)] + p->b.rect.boundary[NY(0)];
+    long sc = (long) q->b.rect.boundary[CY(0)] + q->b.rect.boundary[NY(0)];
+
+    if (rc != sc)
+	return (rc > sc) - (rc < sc);
+    return (p->rank > q->rank) - (p->rank < q->rank);
+}
+
+/* Pack the n branches into full nodes of the given level, tiling them
+** into vertical slices by center x, and each slice by center y.
+** The branches are replaced by those of the new nodes, ranked in the
+** order the nodes were made, and their number is returned.
+*/
+static int RTreePackLevel(RTree_t * rtp, SortBranch_t * b, int n, int level)
+{
+    int nnodes = (n + NODECARD - 1) / NODECARD;
+    int nslices = (int) ceil(sqrt((double) nnodes));
+    int slice = nslices * NODECARD;
+    int i, j, k, m, end;
+    Node_t *node;
+
+    qsort(b, n, sizeof(SortBranch_t), bcmpx);
+    for (i = 0, k = 0; i < n; i += slice) {
+	end = (n - i < slice) ? n : i + slice;
+	qsort(b + i, end - i, sizeof(SortBranch_t), bcmpy);
+	/* fill nodes in order; the last of a slice may be short */
+	for (j = i; j < end; j += NODECARD, k++) {
+	    node = RTreeNewNode(rtp);
+	    node->level = level;
+	    if (level == 0)
+		rtp->LeafCount++;
+	    else
+		rtp->NonLeafCount++;
+	    for (m = 0; (m < NODECARD) && (j + m < end); m++)
+		node->branch[m] = b[j + m].b;
+	    node->count = m;
+	    rtp->EntryCount += m;
+	    b[k].b.rect = NodeCover(node);
+	    b[k].b.child = node;
+	    b[k].rank = k;
+	}
+    }
+    return k;
+}
+
+/* Load the n data rectangles in leaves into an empty index.
+** Every node is filled, except possibly the last of each slice, so the
+** tree is smaller and its nodes overlap less than one built by
+** inserting the rectangles one at a time. Rectangles with the same
+** center are stored in the order of leaves.
+** Returns 0 on success, -1 if the index was not empty or memory ran out.
+*/
+int RTreeBulkLoad(RTree_t * rtp, Leaf_t * leaves, int n)
+{
+    SortBranch_t *b;
+    int i, level, nrects = n;
+
+    if (rtp->root->count || (rtp->root->level > 0))
+	return -1;
+    if (n <= 0)
+	return 0;
+    if (!(b = N_GNEW(n, SortBranch_t)))
+	return -1;
+    for (i = 0; i < n; i++) {
+	b[i].b.rect = leaves[i].rect;
+	b[i].b.child = (Node_t *) leaves[i].data;
+	b[i].rank = i;
+    }
+
+    RTreeFreeNode(rtp, rtp->root);
+    for (level = 0; level == 0 || n > 1; level++)
+	n = RTreePackLevel(rtp, b, n, level);
+    rtp->root = b[0].b.child;
+    rtp->RectCount += nrects;
+    free(b);
+    return 0;
+}
+
 /* Insert a data rectangle into an index structure.
 ** RTreeInsert provides for splitting the root;
 ** returns 1 if root was split, 0 if it was not.
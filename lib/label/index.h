@@ -119,6 +119,7 @@ int RTreeClose(RTree_t * rtp);
 Node_t *RTreeNewIndex(RTree_t * rtp);
 LeafList_t *RTreeSearch(RTree_t *, Node_t *, Rect_t *);
 int RTreeInsert(RTree_t *, Rect_t *, void *, Node_t **, int);
+int RTreeBulkLoad(RTree_t *, Leaf_t *, int);
 int RTreeDelete(RTree_t *, Rect_t *, void *, Node_t **);
 
 LeafList_t *RTreeNewLeafList(Leaf_t * lp);
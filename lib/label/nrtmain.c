@@ -188,6 +188,9 @@ int doxlabel(opts_t * opts)
     }
 
     params.force = opts->force;
+    params.tiled = 0;
+    params.bulk = 0;
+    params.nthreads = 1;
     params.bb = bb;
     if (Verbose)
 	printData(objs, n_objs, lbls, n_lbls, &params);
@@ -20,6 +20,7 @@
 #define XLABEL_INT
 #include <xlabels.h>
 #include <memory.h>
+#include <parallel.h>
 
 extern int Verbose;
 
@@ -75,6 +76,8 @@ static XLabels_t *xlnew(object_t * objs, int n_objs,
 static void xlfree(XLabels_t * xlp)
 {
     RTreeClose(xlp->spdx);
+    free(xlp->cands.cands);
+    free(xlp->tile);
     free(xlp);
     return;
 }
@@ -268,14 +271,26 @@ static Rect_t objplpmks(XLabels_t * xlp, object_t * objp)
     return rect;
 }
 
+/*
+ * the label of cp as seen while placing the label of op: when placing
+ * by tiles, the labels of other tiles are not known yet
+ */
+static xlabel_t *xlvisible(XLabels_t * xlp, object_t * op, object_t * cp)
+{
+    if (xlp->bytile
+	&& xlp->tile[cp - xlp->objs] != xlp->tile[op - xlp->objs])
+	return NULL;
+    return cp->lbl;
+}
+
 /* determine the position clp will occupy in intrsx[] */
 static int getintrsxi(XLabels_t * xlp, object_t * op, object_t * cp)
 {
     int i = -1;
-    xlabel_t *lp = op->lbl, *clp = cp->lbl;
+    xlabel_t *lp = op->lbl, *clp = xlvisible(xlp, op, cp);
     assert(lp != clp);
 
-    if (lp->set == 0 || clp->set == 0)
+    if (lp->set == 0 || !clp || clp->set == 0)
 	return i;
     if ((op->pos.x == 0.0 && op->pos.y == 0.0) ||
 	(cp->pos.x == 0.0 && cp->pos.y == 0.0))
@@ -321,7 +336,7 @@ recordointrsx(XLabels_t * xlp, object_t * op, object_t * cp, Rect_t * rp,
 	if (sa > a)
 	    maxa = sa;
 	/*keep maximally overlapping label */
-	if (intrsx[i]->lbl) {
+	if (xlvisible(xlp, op, intrsx[i])) {
 	    objplp2rect(intrsx[i], &srect);
 	    sa = aabbaabb(rp, &srect);
 	    if (sa > a)
@@ -354,7 +369,7 @@ recordlintrsx(XLabels_t * xlp, object_t * op, object_t * cp, Rect_t * rp,
 	if (sa > a)
 	    maxa = sa;
 	/*keep maximally overlapping label */
-	if (intrsx[i]->lbl) {
+	if (xlvisible(xlp, op, intrsx[i])) {
 	    objplp2rect(intrsx[i], &srect);
 	    sa = aabbaabb(rp, &srect);
 	    if (sa > a)
@@ -370,12 +385,13 @@ recordlintrsx(XLabels_t * xlp, object_t * op, object_t * cp, Rect_t * rp,
     return a;
 }
 
-/* find the objects and labels intersecting lp */
+/* find the objects and labels intersecting lp, among the candidates */
 static BestPos_t
-xlintersections(XLabels_t * xlp, object_t * objp, object_t * intrsx[XLNBR])
+xlintersections(XLabels_t * xlp, XLCands_t * cs, object_t * objp,
+		object_t * intrsx[XLNBR])
 {
     int i;
-    LeafList_t *ilp, *llp;
+    xlabel_t *clp;
     Rect_t rect, srect;
     BestPos_t bp;
 
@@ -385,25 +401,23 @@ xlintersections(XLabels_t * xlp, object_t * objp, object_t * intrsx[XLNBR])
     bp.area = 0.0;
     bp.pos = objp->lbl->pos;
 
-    for(i=0; i<xlp->n_objs; i++) {
-      if(objp == &xlp->objs[i]) continue;
-      if(xlp->objs[i].sz.x > 0 && xlp->objs[i].sz.y > 0) continue;
-      if(lblenclosing(objp, &xlp->objs[i]) ) {
+    /* the candidates include every point the label could enclose */
+    for (i = 0; i < cs->n_cands; i++) {
+      object_t *cp = cs->cands[i]->data;
+      if(cp == objp) continue;
+      if(cp->sz.x > 0 && cp->sz.y > 0) continue;
+      if(lblenclosing(objp, cp) ) {
 	bp.n++;
       }
     }
 
     objplp2rect(objp, &rect);
 
-    llp = RTreeSearch(xlp->spdx, xlp->spdx->root, &rect);
-    if (!llp)
-	return bp;
-
-    for (ilp = llp; ilp; ilp = ilp->next) {
+    for (i = 0; i < cs->n_cands; i++) {
 	double a, ra;
-	object_t *cp = ilp->leaf->data;
+	object_t *cp = cs->cands[i]->data;
 
-	if (cp == objp)
+	if (cp == objp || !Overlap(&rect, &cs->cands[i]->rect))
 	    continue;
 
 	/*label-object intersect */
@@ -415,7 +429,8 @@ xlintersections(XLabels_t * xlp, object_t * objp, object_t * intrsx[XLNBR])
 	  bp.area += ra;
 	}
 	/*label-label intersect */
-	if (!cp->lbl || !cp->lbl->set)
+	clp = xlvisible(xlp, objp, cp);
+	if (!clp || !clp->set)
 	    continue;
 	objplp2rect(cp, &srect);
 	a = aabbaabb(&rect, &srect);
@@ -425,16 +440,40 @@ xlintersections(XLabels_t * xlp, object_t * objp, object_t * intrsx[XLNBR])
 	  bp.area += ra;
 	}
     }
-    RTreeLeafListFree(llp);
     return bp;
 }
 
+/*
+ * xlcandidates - gather the objects that may meet any position of objp's
+ * label, with one search of the area holding all of them. They are kept
+ * in the order of the search, so that filtering them by a position gives
+ * the hits of a search for that position, in the same order.
+ */
+static void xlcandidates(XLabels_t * xlp, XLCands_t * cs, object_t * objp)
+{
+    Rect_t rect = objplpmks(xlp, objp);
+    LeafList_t *llp, *ilp;
+    int n = 0;
+
+    llp = RTreeSearch(xlp->spdx, xlp->spdx->root, &rect);
+    for (ilp = llp; ilp; ilp = ilp->next) {
+	if (n == cs->sz_cands) {
+	    cs->sz_cands = cs->sz_cands ? 2 * cs->sz_cands : 64;
+	    cs->cands = ALLOC(cs->sz_cands, cs->cands, Leaf_t *);
+	}
+	cs->cands[n++] = ilp->leaf;
+    }
+    if (llp)
+	RTreeLeafListFree(llp);
+    cs->n_cands = n;
+}
+
 /*
  * xladjust - find a label position
  * the individual tests at the top are intended to place a preference order
  * on the position
  */
-static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
+static BestPos_t xladjust(XLabels_t * xlp, XLCands_t * cs, object_t * objp)
 {
     xlabel_t *lp = objp->lbl;
     double xincr = ((2 * lp->sz.x) + objp->sz.x) / XLXDENOM;
@@ -445,24 +484,25 @@ static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
     assert(objp->lbl);
 
     memset(intrsx, 0, sizeof(intrsx));
+    xlcandidates(xlp, cs, objp);
 
     /*x left */
     lp->pos.x = objp->pos.x - lp->sz.x;
     /*top */
     lp->pos.y = objp->pos.y + objp->sz.y;
-    bp = xlintersections(xlp, objp, intrsx);
+    bp = xlintersections(xlp, cs, objp, intrsx);
     if (bp.n == 0)
 	return bp;
     /*mid */
     lp->pos.y = objp->pos.y;
-    nbp = xlintersections(xlp, objp, intrsx);
+    nbp = xlintersections(xlp, cs, objp, intrsx);
     if (nbp.n == 0)
 	return nbp;
     if (nbp.area < bp.area)
 	bp = nbp;
     /*bottom */
     lp->pos.y = objp->pos.y - lp->sz.y;
-    nbp = xlintersections(xlp, objp, intrsx);
+    nbp = xlintersections(xlp, cs, objp, intrsx);
     if (nbp.n == 0)
 	return nbp;
     if (nbp.area < bp.area)
@@ -472,14 +512,14 @@ static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
     lp->pos.x = objp->pos.x;
     /*top */
     lp->pos.y = objp->pos.y + objp->sz.y;
-    nbp = xlintersections(xlp, objp, intrsx);
+    nbp = xlintersections(xlp, cs, objp, intrsx);
     if (nbp.n == 0)
 	return nbp;
     if (nbp.area < bp.area)
 	bp = nbp;
     /*bottom */
     lp->pos.y = objp->pos.y - lp->sz.y;
-    nbp = xlintersections(xlp, objp, intrsx);
+    nbp = xlintersections(xlp, cs, objp, intrsx);
     if (nbp.n == 0)
 	return nbp;
     if (nbp.area < bp.area)
@@ -489,21 +529,21 @@ static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
     lp->pos.x = objp->pos.x + objp->sz.x;
     /*top */
     lp->pos.y = objp->pos.y + objp->sz.y;
-    nbp = xlintersections(xlp, objp, intrsx);
+    nbp = xlintersections(xlp, cs, objp, intrsx);
     if (nbp.n == 0)
 	return nbp;
     if (nbp.area < bp.area)
 	bp = nbp;
     /*mid */
     lp->pos.y = objp->pos.y;
-    nbp = xlintersections(xlp, objp, intrsx);
+    nbp = xlintersections(xlp, cs, objp, intrsx);
     if (nbp.n == 0)
 	return nbp;
     if (nbp.area < bp.area)
 	bp = nbp;
     /*bottom */
     lp->pos.y = objp->pos.y - lp->sz.y;
-    nbp = xlintersections(xlp, objp, intrsx);
+    nbp = xlintersections(xlp, cs, objp, intrsx);
     if (nbp.n == 0)
 	return nbp;
     if (nbp.area < bp.area)
@@ -517,7 +557,7 @@ static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
 		 lp->pos.y = objp->pos.y + objp->sz.y;
 		 lp->pos.x <= (objp->pos.x + objp->sz.x);
 		 lp->pos.x += xincr) {
-		nbp = xlintersections(xlp, objp, intrsx);
+		nbp = xlintersections(xlp, cs, objp, intrsx);
 		if (nbp.n == 0)
 		    return nbp;
 		if (nbp.area < bp.area)
@@ -530,7 +570,7 @@ static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
 		 lp->pos.y = objp->pos.y + objp->sz.y;
 		 lp->pos.y >= (objp->pos.y - lp->sz.y);
 		 lp->pos.y -= yincr) {
-		nbp = xlintersections(xlp, objp, intrsx);
+		nbp = xlintersections(xlp, cs, objp, intrsx);
 		if (nbp.n == 0)
 		    return nbp;
 		if (nbp.area < bp.area)
@@ -550,7 +590,7 @@ static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
 		 lp->pos.y = objp->pos.y - lp->sz.y;
 		 lp->pos.x >= (objp->pos.x - lp->sz.x);
 		 lp->pos.x -= xincr) {
-		nbp = xlintersections(xlp, objp, intrsx);
+		nbp = xlintersections(xlp, cs, objp, intrsx);
 		if (nbp.n == 0)
 		    return nbp;
 		if (nbp.area < bp.area)
@@ -563,7 +603,7 @@ static BestPos_t xladjust(XLabels_t * xlp, object_t * objp)
 		 lp->pos.y = objp->pos.y - lp->sz.y;
 		 lp->pos.y <= (objp->pos.y + objp->sz.y);
 		 lp->pos.y += yincr) {
-		nbp = xlintersections(xlp, objp, intrsx);
+		nbp = xlintersections(xlp, cs, objp, intrsx);
 		if (nbp.n == 0)
 		    return nbp;
 		if (nbp.area < bp.area)
@@ -623,10 +663,27 @@ static void xlhdxunload(XLabels_t * xlp)
   assert(size==freed);
 }
 
+/*
+ * xlspdxload - load the rtree with the objects, in hilbert order.
+ * If params->bulk is true, the tree is bulk loaded, which is much faster
+ * for large graphs; objects whose areas have the same center keep their
+ * hilbert order. The tree then differs from the one built by insertion,
+ * so ties between label positions may be broken differently.
+ */
 static int xlspdxload(XLabels_t * xlp)
 {
     HDict_t *op=0;
-
+    Leaf_t *leaves;
+    int i = 0, r;
+
+    if (xlp->params->bulk) {
+	leaves = N_NEW(dtsize(xlp->hdx), Leaf_t);
+	for (op = dtfirst(xlp->hdx); op; op = dtnext(xlp->hdx, op))
+	    leaves[i++] = op->d;
+	r = RTreeBulkLoad(xlp->spdx, leaves, i);
+	free(leaves);
+	return r;
+    }
     for (op = dtfirst(xlp->hdx); op; op = dtnext(xlp->hdx, op)) {
 	/*          tree       rectangle    data        node             lvl */
 	RTreeInsert(xlp->spdx, &op->d.rect, op->d.data, &xlp->spdx->root, 0);
@@ -634,6 +691,34 @@ static int xlspdxload(XLabels_t * xlp)
     return 0;
 }
 
+/*
+ * xltiles - split the objects into tiles by cutting their hilbert order
+ * into runs of XLTILELBLS labels, so each tile is a compact region. The
+ * tiles only depend on the labels, not on the number of threads.
+ * Sets xlp->tile and xlp->ntiles.
+ */
+static void xltiles(XLabels_t * xlp)
+{
+    HDict_t *op;
+    int t = 0, k = 0;
+
+    xlp->ntiles = (xlp->n_lbls + XLTILELBLS - 1) / XLTILELBLS;
+    if (xlp->ntiles <= 1)
+	return;
+    xlp->tile = N_NEW(xlp->n_objs, int);
+    for (op = dtfirst(xlp->hdx); op; op = dtnext(xlp->hdx, op)) {
+	object_t *objp = op->d.data;
+	if (objp->lbl) {
+	    if (k == XLTILELBLS) {
+		t++;
+		k = 0;
+	    }
+	    k++;
+	}
+	xlp->tile[objp - xlp->objs] = t;
+    }
+}
+
 static int xlinitialize(XLabels_t * xlp)
 {
     int r=0;
@@ -641,16 +726,139 @@ static int xlinitialize(XLabels_t * xlp)
 	return r;
     if ((r = xlspdxload(xlp)) < 0)
 	return r;
+    if (xlp->params->tiled)
+	xltiles(xlp);
     xlhdxunload(xlp);
     return dtclose(xlp->hdx);
 }
 
+/*
+ * xlplace - place the label of objp as well as possible
+ * Return 0 if it was placed, non-zero otherwise.
+ */
+static int xlplace(XLabels_t * xlp, XLCands_t * cs, object_t * objp)
+{
+    BestPos_t bp = xladjust(xlp, cs, objp);
+
+    if (bp.n == 0) {
+	objp->lbl->set = 1;
+    } else if(bp.area == 0) {
+	objp->lbl->pos.x = bp.pos.x;
+	objp->lbl->pos.y = bp.pos.y;
+	objp->lbl->set = 1;
+    } else if (xlp->params->force == 1) {
+	objp->lbl->pos.x = bp.pos.x;
+	objp->lbl->pos.y = bp.pos.y;
+	objp->lbl->set = 1;
+    } else {
+	return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    XLabels_t *xlp;
+    int *order;
+    int *start;
+    XLCands_t *cs;		/* scratch of each chunk */
+} xltilestate_t;
+
+/* place the labels of tiles [lo,hi), seeing only the labels of the same tile */
+static void xlplacetiles(void *state, int chunk, int lo, int hi)
+{
+    xltilestate_t *st = state;
+    int t, k;
+
+    for (t = lo; t < hi; t++)
+	for (k = st->start[t]; k < st->start[t + 1]; k++)
+	    xlplace(st->xlp, &st->cs[chunk], &st->xlp->objs[st->order[k]]);
+}
+
+/* xlconflict - true if the label of objp meets a label of another tile */
+static int xlconflict(XLabels_t * xlp, XLCands_t * cs, object_t * objp)
+{
+    Rect_t rect, srect;
+    int i, t = xlp->tile[objp - xlp->objs];
+
+    objplp2rect(objp, &rect);
+    xlcandidates(xlp, cs, objp);
+    for (i = 0; i < cs->n_cands; i++) {
+	object_t *cp = cs->cands[i]->data;
+
+	if (cp == objp || !cp->lbl || !cp->lbl->set
+	    || xlp->tile[cp - xlp->objs] == t)
+	    continue;
+	objplp2rect(cp, &srect);
+	if (aabbaabb(&rect, &srect) > 0.0)
+	    return 1;
+    }
+    return 0;
+}
+
+/*
+ * xlplacebytiles - place the labels of each tile independently, and
+ * concurrently, as if the other tiles had no labels. Then, in the order
+ * of the objects, place again any label overlapping a label of another
+ * tile, now seeing all labels. Neither pass depends on how the tiles are
+ * shared among the threads.
+ */
+static void xlplacebytiles(XLabels_t * xlp)
+{
+    xltilestate_t st;
+    int ntiles = xlp->ntiles;
+    int nchunks = xlp->params->nthreads;
+    int *order, *start;
+    int i, t;
+
+    /* the labeled objects of tile t, in object order, are
+     * order[start[t]] .. order[start[t+1]-1]
+     */
+    start = N_NEW(ntiles + 1, int);
+    for (i = 0; i < xlp->n_objs; i++)
+	if (xlp->objs[i].lbl)
+	    start[xlp->tile[i] + 1]++;
+    for (t = 0; t < ntiles; t++)
+	start[t + 1] += start[t];
+    order = N_NEW(start[ntiles], int);
+    for (i = 0; i < xlp->n_objs; i++)
+	if (xlp->objs[i].lbl)
+	    order[start[xlp->tile[i]]++] = i;
+    /* the fill moved each start to the next one */
+    for (t = ntiles; t > 0; t--)
+	start[t] = start[t - 1];
+    start[0] = 0;
+
+    if (nchunks > ntiles)
+	nchunks = ntiles;
+    if (nchunks < 1)
+	nchunks = 1;
+    st.xlp = xlp;
+    st.order = order;
+    st.start = start;
+    st.cs = N_NEW(nchunks, XLCands_t);
+    xlp->bytile = 1;
+    parallel_for(ntiles, nchunks, xlplacetiles, &st);
+    xlp->bytile = 0;
+    for (i = 0; i < nchunks; i++)
+	free(st.cs[i].cands);
+    free(st.cs);
+    free(order);
+    free(start);
+
+    for (i = 0; i < xlp->n_objs; i++) {
+	object_t *op = &xlp->objs[i];
+	if (op->lbl && op->lbl->set && xlconflict(xlp, &xlp->cands, op)) {
+	    op->lbl->set = 0;
+	    xlplace(xlp, &xlp->cands, op);
+	}
+    }
+}
+
 int
 placeLabels(object_t * objs, int n_objs,
 	    xlabel_t * lbls, int n_lbls, label_params_t * params)
 {
     int r, i;
-    BestPos_t bp;
     XLabels_t *xlp = xlnew(objs, n_objs, lbls, n_lbls, params);
     if ((r = xlinitialize(xlp)) < 0)
 	return r;
@@ -667,28 +875,23 @@ placeLabels(object_t * objs, int n_objs,
      * If params->force is true, all labels must be positioned, even if
      * overlaps are necessary.
      *
+     * If params->tiled is true, and there are enough labels, they are
+     * placed by tiles, using params->nthreads threads; see xlplacebytiles.
+     *
      * Return 0 if all labels could be placed without overlap;
      * non-zero otherwise.
      */
+    if (xlp->ntiles > 1) {
+	xlplacebytiles(xlp);
+    } else {
+	for (i = 0; i < n_objs; i++)
+	    if (objs[i].lbl)
+		xlplace(xlp, &xlp->cands, &objs[i]);
+    }
     r = 0;
-    for (i = 0; i < n_objs; i++) {
-	if (objs[i].lbl == 0)
-	    continue;
-	bp = xladjust(xlp, &objs[i]);
-	if (bp.n == 0) {
-	    objs[i].lbl->set = 1;
-	} else if(bp.area == 0) {
-	    objs[i].lbl->pos.x = bp.pos.x;
-	    objs[i].lbl->pos.y = bp.pos.y;
-	    objs[i].lbl->set = 1;
-	} else if (params->force == 1) {
-	    objs[i].lbl->pos.x = bp.pos.x;
-	    objs[i].lbl->pos.y = bp.pos.y;
-	    objs[i].lbl->set = 1;
-	} else {
+    for (i = 0; i < n_objs; i++)
+	if (objs[i].lbl && !objs[i].lbl->set)
 	    r = 1;
-	}
-    }
     xlfree(xlp);
     return r;
 }
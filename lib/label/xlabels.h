@@ -35,6 +35,9 @@ typedef struct {
 typedef struct {
     boxf bb;			/* Bounding box of all objects */
     unsigned char force;	/* If true, all labels must be placed */
+    unsigned char tiled;	/* If true, place labels by spatial tiles */
+    unsigned char bulk;		/* If true, bulk load the spatial index */
+    int nthreads;		/* Number of threads placing tiles */
 } label_params_t;
 
 int placeLabels(object_t * objs, int n_objs,
@@ -75,6 +78,7 @@ int placeLabels(object_t * objs, int n_objs,
 #define XLPXNY   6
 #define XLCXNY   7
 #define XLNXNY   8
+#define XLTILELBLS 256	/* labels per tile when placing by tiles */
     typedef struct best_p_s {
     int n;
     double area;
@@ -87,6 +91,12 @@ typedef struct obyh {
     Leaf_t d;
 } HDict_t;
 
+typedef struct {
+    Leaf_t **cands;		// objects near the label being placed
+    int n_cands;
+    int sz_cands;
+} XLCands_t;
+
 typedef struct XLabels_s {
     object_t *objs;
     int n_objs;
@@ -96,6 +106,10 @@ typedef struct XLabels_s {
 
     Dt_t *hdx;			// splay tree keyed with hilbert spatial codes
     RTree_t *spdx;		// rtree
+    XLCands_t cands;		// scratch when placing serially
+    int ntiles;			// number of tiles, when placing by tiles
+    int *tile;			// tile of each object, when placing by tiles
+    int bytile;			// if true, labels in other tiles are hidden
 
 } XLabels_t;
 
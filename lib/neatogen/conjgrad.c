@@ -14,9 +14,13 @@
 
 #include "matrix_ops.h"
 #include "conjgrad.h"
-/* #include <math.h> */
+#include <assert.h>
+#include <math.h>
 #include <stdlib.h>
 
+/* most right-hand sides of conjugate_gradient_mkernel_block */
+#define MAX_RHS 8
+
 
 /*************************
 ** C.G. method - SPARSE  *
@@ -164,6 +168,464 @@ cleanup1:
     return rv;
 }
 
+/*************************************
+** C.G. method - PACKED, PRECONDITIONED *
+*************************************/
+
+/* Incomplete Cholesky: in row i of the packed matrix, entry a_ij is kept
+ * if |a_ij| >= ICHOL_DROP * sqrt(m_i * m_j), where m_i is the largest
+ * off-diagonal magnitude in row i, and only the ICHOL_FILL largest such
+ * entries of a row are kept. Scaling the diagonal by ICHOL_SHIFT makes
+ * the kept part of the (singular) Laplacian strictly diagonally
+ * dominant, so the factorization cannot break down.
+ */
+#define ICHOL_DROP  0.1
+#define ICHOL_FILL  16
+#define ICHOL_SHIFT 1.01
+
+/* icfactor:
+ * Overwrite the rows of sign*A kept in ws with their incomplete
+ * Cholesky factor U, so that U^T U approximates sign*A. Only entries
+ * already in the pattern are updated.
+ * Return 0 on success, and non-zero if a pivot is not positive.
+ */
+static int icfactor(CGWorkspace * ws, int n)
+{
+    int *pos = N_GNEW(n, int);
+    int i, j, q, q2, t, rv = 0;
+    double d, uij;
+
+    for (i = 0; i < n; i++)
+	pos[i] = -1;
+    for (i = 0; i < n && !rv; i++) {
+	q = ws->ia[i];
+	if (ws->ua[q] <= 0) {
+	    rv = 1;
+	    break;
+	}
+	d = ws->ua[q] = sqrt(ws->ua[q]);
+	for (q++; q < ws->ia[i + 1]; q++)
+	    ws->ua[q] /= d;
+	for (q = ws->ia[i] + 1; q < ws->ia[i + 1]; q++) {
+	    j = ws->ja[q];
+	    uij = ws->ua[q];
+	    for (t = ws->ia[j]; t < ws->ia[j + 1]; t++)
+		pos[ws->ja[t]] = t;
+	    for (q2 = q; q2 < ws->ia[i + 1]; q2++)
+		if ((t = pos[ws->ja[q2]]) >= 0)
+		    ws->ua[t] -= uij * ws->ua[q2];
+	    for (t = ws->ia[j]; t < ws->ia[j + 1]; t++)
+		pos[ws->ja[t]] = -1;
+	}
+    }
+    if (!rv)
+	ws->y = N_GNEW(n, double);
+
+    free(pos);
+    return rv;
+}
+
+/* ichol:
+ * Compute the incomplete Cholesky factor U of sign*A, where sign is the
+ * sign of the diagonal, stored by rows with the diagonal first.
+ * Return 0 on success, and non-zero if the matrix is not definite.
+ */
+static int ichol(CGWorkspace * ws, float *A, int n)
+{
+    double *m = N_NEW(n, double);
+    int keepj[ICHOL_FILL];
+    double keepv[ICHOL_FILL];
+    int i, j, k, t, nkeep, index, nnz, cap, rv = 0;
+    double v, d, sign = (A[0] < 0 ? -1 : 1);
+
+    for (index = 0, i = 0; i < n; i++) {
+	if (sign * A[index] <= 0)
+	    rv = 1;
+	for (index++, j = i + 1; j < n; j++, index++) {
+	    v = fabs(A[index]);
+	    m[i] = MAX(m[i], v);
+	    m[j] = MAX(m[j], v);
+	}
+    }
+    if (rv) {
+	free(m);
+	return rv;
+    }
+
+    cap = n * (ICHOL_FILL / 4 + 1);
+    ws->ia = N_GNEW(n + 1, int);
+    ws->ja = N_GNEW(cap, int);
+    ws->ua = N_GNEW(cap, double);
+    ws->sign = sign;
+    for (nnz = 0, index = 0, i = 0; i < n; i++) {
+	/* keep the largest entries in keepv, in decreasing order */
+	ws->ia[i] = nnz;
+	d = sign * A[index] * ICHOL_SHIFT;
+	for (nkeep = 0, index++, j = i + 1; j < n; j++, index++) {
+	    v = fabs(A[index]);
+	    if (v == 0 || v < ICHOL_DROP * sqrt(m[i] * m[j]))
+		continue;
+	    if (nkeep == ICHOL_FILL) {
+		if (v <= keepv[nkeep - 1])
+		    continue;
+		nkeep--;
+	    }
+	    for (k = nkeep++; k > 0 && keepv[k - 1] < v; k--) {
+		keepv[k] = keepv[k - 1];
+		keepj[k] = keepj[k - 1];
+	    }
+	    keepv[k] = v;
+	    keepj[k] = j;
+	}
+	if (nnz + nkeep + 1 > cap) {
+	    cap = MAX(2 * cap, nnz + nkeep + 1);
+	    ws->ja = ALLOC(cap, ws->ja, int);
+	    ws->ua = ALLOC(cap, ws->ua, double);
+	}
+	ws->ja[nnz] = i;
+	ws->ua[nnz++] = d;
+	/* order by column, as entries of the packed row */
+	for (k = 0; k < nkeep; k++) {
+	    for (t = nnz + k; t > nnz && ws->ja[t - 1] > keepj[k]; t--)
+		ws->ja[t] = ws->ja[t - 1];
+	    ws->ja[t] = keepj[k];
+	}
+	for (k = 0; k < nkeep; k++, nnz++) {
+	    j = ws->ja[nnz];
+	    ws->ua[nnz] = sign * A[index - n + j];
+	}
+    }
+    ws->ia[n] = nnz;
+
+    free(m);
+    return icfactor(ws, n);
+}
+
+/* ichol_sparse:
+ * As ichol, for the sparse symmetric matrix A. All the entries of A
+ * are kept, so this is IC(0) on the pattern of A.
+ */
+static int ichol_sparse(CGWorkspace * ws, vtx_data * A, int n)
+{
+    int i, j, k, t, nnz, cap;
+    double d, sign = 0;
+
+    for (cap = n, i = 0; i < n; i++)
+	cap += A[i].nedges;
+    ws->ia = N_GNEW(n + 1, int);
+    ws->ja = N_GNEW(cap, int);
+    ws->ua = N_GNEW(cap, double);
+    for (nnz = 0, i = 0; i < n; i++) {
+	ws->ia[i] = nnz++;
+	for (d = 0, k = 0; k < A[i].nedges; k++) {
+	    j = A[i].edges[k];
+	    if (j == i) {
+		d += A[i].ewgts[k];
+		continue;
+	    }
+	    if (j < i)
+		continue;
+	    /* insert by column */
+	    for (t = nnz++; t > ws->ia[i] + 1 && ws->ja[t - 1] > j; t--) {
+		ws->ja[t] = ws->ja[t - 1];
+		ws->ua[t] = ws->ua[t - 1];
+	    }
+	    ws->ja[t] = j;
+	    ws->ua[t] = A[i].ewgts[k];
+	}
+	if (sign == 0)
+	    sign = (d < 0 ? -1 : 1);
+	if (sign * d <= 0)
+	    return 1;
+	ws->ja[ws->ia[i]] = i;
+	ws->ua[ws->ia[i]] = sign * d * ICHOL_SHIFT;
+	for (t = ws->ia[i] + 1; t < nnz; t++)
+	    ws->ua[t] *= sign;
+    }
+    ws->ia[n] = nnz;
+    ws->sign = sign;
+
+    return icfactor(ws, n);
+}
+
+/* dropichol:
+ * Free an incomplete Cholesky factor that could not be completed.
+ */
+static void dropichol(CGWorkspace * ws)
+{
+    free(ws->ia);
+    free(ws->ja);
+    free(ws->ua);
+    free(ws->y);
+    ws->ia = ws->ja = NULL;
+    ws->ua = ws->y = NULL;
+}
+
+/* newCGWorkspace:
+ * Work space for conjugate_gradient_mkernel_block with up to nrhs
+ * right-hand sides and the packed matrix A. If the preconditioner cannot
+ * be built for A, a simpler one is used.
+ */
+CGWorkspace *newCGWorkspace(float *A, int n, int nrhs, int precon)
+{
+    CGWorkspace *ws = NEW(CGWorkspace);
+    int i, index;
+
+    ws->n = n;
+    ws->nrhs = nrhs;
+    ws->r = N_GNEW(nrhs * n, float);
+    ws->p = N_GNEW(nrhs * n, float);
+    ws->Ap = N_GNEW(nrhs * n, float);
+
+    if (precon == CG_PRECON_ICHOL && ichol(ws, A, n)) {
+	dropichol(ws);
+	precon = CG_PRECON_JACOBI;
+    }
+    if (precon == CG_PRECON_JACOBI) {
+	ws->invdiag = N_GNEW(n, float);
+	for (index = 0, i = 0; i < n; index += n - i, i++) {
+	    if (A[index] == 0) {
+		precon = CG_PRECON_NONE;
+		break;
+	    }
+	    ws->invdiag[i] = 1 / A[index];
+	}
+    }
+    if (precon != CG_PRECON_NONE)
+	ws->z = N_GNEW(nrhs * n, float);
+    ws->precon = precon;
+    return ws;
+}
+
+/* newSparseCGWorkspace:
+ * Work space for conjugate_gradient_precon with the sparse matrix A.
+ */
+CGWorkspace *newSparseCGWorkspace(vtx_data * A, int n, int precon)
+{
+    CGWorkspace *ws = NEW(CGWorkspace);
+    int i, k;
+    double d;
+
+    ws->n = n;
+    ws->nrhs = 1;
+    ws->rd = N_GNEW(n, double);
+    ws->pd = N_GNEW(n, double);
+    ws->Apd = N_GNEW(n, double);
+
+    if (precon == CG_PRECON_ICHOL && ichol_sparse(ws, A, n)) {
+	dropichol(ws);
+	precon = CG_PRECON_JACOBI;
+    }
+    if (precon == CG_PRECON_JACOBI) {
+	ws->invdiag = N_GNEW(n, float);
+	for (i = 0; i < n; i++) {
+	    for (d = 0, k = 0; k < A[i].nedges; k++)
+		if (A[i].edges[k] == i)
+		    d += A[i].ewgts[k];
+	    if (d == 0) {
+		precon = CG_PRECON_NONE;
+		break;
+	    }
+	    ws->invdiag[i] = 1 / d;
+	}
+    }
+    if (precon != CG_PRECON_NONE)
+	ws->zd = N_GNEW(n, double);
+    ws->precon = precon;
+    return ws;
+}
+
+void freeCGWorkspace(CGWorkspace * ws)
+{
+    if (!ws)
+	return;
+    free(ws->r);
+    free(ws->p);
+    free(ws->Ap);
+    free(ws->z);
+    free(ws->invdiag);
+    free(ws->ia);
+    free(ws->ja);
+    free(ws->ua);
+    free(ws->y);
+    free(ws->rd);
+    free(ws->pd);
+    free(ws->Apd);
+    free(ws->zd);
+    free(ws);
+}
+
+/* icsolve:
+ * y := (U^T U)^-1 y, with the incomplete Cholesky factor U in ws.
+ */
+static void icsolve(CGWorkspace * ws)
+{
+    int i, q, n = ws->n;
+    int *ia = ws->ia, *ja = ws->ja;
+    double *ua = ws->ua, *y = ws->y, yi;
+
+    /* solve U^T w = y, then U y = w */
+    for (i = 0; i < n; i++) {
+	yi = y[i] /= ua[ia[i]];
+	for (q = ia[i] + 1; q < ia[i + 1]; q++)
+	    y[ja[q]] -= ua[q] * yi;
+    }
+    for (i = n - 1; i >= 0; i--) {
+	yi = y[i];
+	for (q = ia[i] + 1; q < ia[i + 1]; q++)
+	    yi -= ua[q] * y[ja[q]];
+	y[i] = yi / ua[ia[i]];
+    }
+}
+
+/* precondition:
+ * z := M^-1 r, centered.
+ */
+static void precondition(CGWorkspace * ws, float *r, float *z)
+{
+    int i, n = ws->n;
+
+    if (ws->precon == CG_PRECON_JACOBI) {
+	for (i = 0; i < n; i++)
+	    z[i] = r[i] * ws->invdiag[i];
+    } else {
+	for (i = 0; i < n; i++)
+	    ws->y[i] = r[i];
+	icsolve(ws);
+	for (i = 0; i < n; i++)
+	    z[i] = (float) (ws->sign * ws->y[i]);
+    }
+    orthog1f(n, z);
+}
+
+/* preconditiond:
+ * As precondition, for double vectors.
+ */
+static void preconditiond(CGWorkspace * ws, double *r, double *z)
+{
+    int i, n = ws->n;
+
+    if (ws->precon == CG_PRECON_JACOBI) {
+	for (i = 0; i < n; i++)
+	    z[i] = r[i] * ws->invdiag[i];
+    } else {
+	copy_vector(n, r, ws->y);
+	icsolve(ws);
+	vectors_scalar_mult(n, ws->y, ws->sign, z);
+    }
+    orthog1(n, z);
+}
+
+/* conjugate_gradient_mkernel_block:
+ * Solve A x[k] = b[k] for k < nrhs with the packed symmetric matrix A,
+ * preconditioned as set in ws. The systems are iterated together, so
+ * each pass over A serves all those not yet converged. With
+ * CG_PRECON_NONE, each x[k] is the same as from
+ * conjugate_gradient_mkernel.
+ */
+int
+conjugate_gradient_mkernel_block(float *A, float **x, float **b, int nrhs,
+				 int n, double tol, int max_iterations,
+				 CGWorkspace * ws)
+{
+    int i, k, na, rv = 0;
+    double alpha, beta, r_z[MAX_RHS], r_z_new, p_Ap;
+    float *r[MAX_RHS], *p[MAX_RHS], *Ap[MAX_RHS], *z[MAX_RHS];
+    float *ap[MAX_RHS], *aAp[MAX_RHS];
+    int active[MAX_RHS];
+
+    assert(nrhs <= ws->nrhs && n == ws->n);
+    if (nrhs > MAX_RHS) {
+	rv = conjugate_gradient_mkernel_block(A, x, b, MAX_RHS, n, tol,
+					      max_iterations, ws);
+	return rv | conjugate_gradient_mkernel_block(A, x + MAX_RHS,
+						     b + MAX_RHS,
+						     nrhs - MAX_RHS, n, tol,
+						     max_iterations, ws);
+    }
+    for (k = 0; k < nrhs; k++) {
+	r[k] = ws->r + k * n;
+	p[k] = ws->p + k * n;
+	Ap[k] = ws->Ap + k * n;
+	z[k] = (ws->precon == CG_PRECON_NONE ? r[k] : ws->z + k * n);
+	active[k] = TRUE;
+
+	/* centering x and b  */
+	orthog1f(n, x[k]);
+	orthog1f(n, b[k]);
+    }
+
+    /* Ap := Ax */
+    right_mult_with_vectors_ff(A, n, nrhs, x, Ap);
+    for (k = 0; k < nrhs; k++) {
+	/* centering Ax */
+	orthog1f(n, Ap[k]);
+	vectors_substractionf(n, b[k], Ap[k], r[k]);
+	if (ws->precon != CG_PRECON_NONE)
+	    precondition(ws, r[k], z[k]);
+	copy_vectorf(n, z[k], p[k]);
+	r_z[k] = vectors_inner_productf(n, r[k], z[k]);
+    }
+
+    for (i = 0; i < max_iterations; i++) {
+	for (na = k = 0; k < nrhs; k++) {
+	    if (active[k] && max_absf(n, r[k]) > tol) {
+		orthog1f(n, p[k]);
+		orthog1f(n, x[k]);
+		orthog1f(n, r[k]);
+		ap[na] = p[k];
+		aAp[na++] = Ap[k];
+	    } else
+		active[k] = FALSE;
+	}
+	if (na == 0)
+	    break;
+
+	right_mult_with_vectors_ff(A, n, na, ap, aAp);
+
+	for (k = 0; k < nrhs; k++) {
+	    if (!active[k])
+		continue;
+	    /* centering Ap */
+	    orthog1f(n, Ap[k]);
+
+	    p_Ap = vectors_inner_productf(n, p[k], Ap[k]);
+	    if (p_Ap == 0) {
+		active[k] = FALSE;
+		continue;
+	    }
+	    alpha = r_z[k] / p_Ap;
+
+	    /* derive new x: */
+	    vectors_mult_additionf(n, x[k], (float) alpha, p[k]);
+
+	    /* compute values for next iteration: */
+	    if (i < max_iterations - 1) {	/* not last iteration */
+		vectors_mult_additionf(n, r[k], (float) -alpha, Ap[k]);
+		if (ws->precon != CG_PRECON_NONE)
+		    precondition(ws, r[k], z[k]);
+
+		r_z_new = vectors_inner_productf(n, r[k], z[k]);
+
+		if (r_z[k] == 0) {
+		    rv = 1;
+		    agerr (AGERR, "conjugate_gradient: unexpected length 0 vector\n");
+		    active[k] = FALSE;
+		    continue;
+		}
+		beta = r_z_new / r_z[k];
+		r_z[k] = r_z_new;
+
+		vectors_scalar_multf(n, p[k], (float) beta, p[k]);
+
+		vectors_additionf(n, z[k], p[k], p[k]);
+	    }
+	}
+    }
+
+    return rv;
+}
+
 int
 conjugate_gradient_mkernel(float *A, float *x, float *b, int n,
 			   double tol, int max_iterations)
@@ -172,70 +634,73 @@ conjugate_gradient_mkernel(float *A, float *x, float *b, int n,
     /* A is a packed symmetric matrix */
     /* matrux A is "packed" (only upper triangular portion exists, row-major); */
 
-    int i, rv = 0;
-
-    double alpha, beta, r_r, r_r_new, p_Ap;
-    float *r = N_NEW(n, float);
-    float *p = N_NEW(n, float);
-    float *Ap = N_NEW(n, float);
-    float *Ax = N_NEW(n, float);
-
-    /* centering x and b  */
-    orthog1f(n, x);
-    orthog1f(n, b);
-
-    right_mult_with_vector_ff(A, n, x, Ax);
-    /* centering Ax */
-    orthog1f(n, Ax);
+    CGWorkspace *ws = newCGWorkspace(A, n, 1, CG_PRECON_NONE);
+    int rv;
 
+    rv = conjugate_gradient_mkernel_block(A, &x, &b, 1, n, tol,
+					  max_iterations, ws);
+    freeCGWorkspace(ws);
+    return rv;
+}
 
-    vectors_substractionf(n, b, Ax, r);
-    copy_vectorf(n, r, p);
+/*****************************************
+** C.G. method - SPARSE, PRECONDITIONED  *
+*****************************************/
 
-    r_r = vectors_inner_productf(n, r, r);
+/* conjugate_gradient_precon:
+ * As conjugate_gradient, preconditioned as set in ws, which was made
+ * for A by newSparseCGWorkspace. The work vectors are those of ws, so
+ * repeated solves with the same matrix allocate nothing.
+ */
+int conjugate_gradient_precon
+    (vtx_data * A, double *x, double *b, int n, double tol,
+     int max_iterations, CGWorkspace * ws) {
+    int i, rv = 0;
 
-    for (i = 0; i < max_iterations && max_absf(n, r) > tol; i++) {
-	orthog1f(n, p);
-	orthog1f(n, x);
-	orthog1f(n, r);
+    double alpha, beta, r_z, r_z_new, p_Ap;
+    double *r = ws->rd;
+    double *p = ws->pd;
+    double *Ap = ws->Apd;
+    double *z = (ws->precon == CG_PRECON_NONE ? r : ws->zd);
 
-	right_mult_with_vector_ff(A, n, p, Ap);
-	/* centering Ap */
-	orthog1f(n, Ap);
+    assert(n == ws->n && r);
+    orthog1(n, x);
+    right_mult_with_vector(A, n, x, Ap);
+    vectors_subtraction(n, b, Ap, r);
+    orthog1(n, r);
+    if (ws->precon != CG_PRECON_NONE)
+	preconditiond(ws, r, z);
+    copy_vector(n, z, p);
+    r_z = vectors_inner_product(n, r, z);
 
-	p_Ap = vectors_inner_productf(n, p, Ap);
+    for (i = 0; i < max_iterations && max_abs(n, r) > tol; i++) {
+	right_mult_with_vector(A, n, p, Ap);
+	p_Ap = vectors_inner_product(n, p, Ap);
 	if (p_Ap == 0)
 	    break;
-	alpha = r_r / p_Ap;
+	alpha = r_z / p_Ap;
 
 	/* derive new x: */
-	vectors_mult_additionf(n, x, (float) alpha, p);
+	vectors_mult_addition(n, x, alpha, p);
 
 	/* compute values for next iteration: */
 	if (i < max_iterations - 1) {	/* not last iteration */
-	    vectors_mult_additionf(n, r, (float) -alpha, Ap);
-
+	    vectors_mult_addition(n, r, -alpha, Ap);
+	    if (ws->precon != CG_PRECON_NONE)
+		preconditiond(ws, r, z);
 
-	    r_r_new = vectors_inner_productf(n, r, r);
-
-	    if (r_r == 0) {
-		rv = 1;
+	    r_z_new = vectors_inner_product(n, r, z);
+	    if (r_z == 0) {
 		agerr (AGERR, "conjugate_gradient: unexpected length 0 vector\n");
-		goto cleanup2;
+		rv = 1;
+		break;
 	    }
-	    beta = r_r_new / r_r;
-	    r_r = r_r_new;
-
-	    vectors_scalar_multf(n, p, (float) beta, p);
-
-	    vectors_additionf(n, r, p, p);
+	    beta = r_z_new / r_z;
+	    r_z = r_z_new;
+	    vectors_scalar_mult(n, p, beta, p);
+	    vectors_addition(n, z, p, p);
 	}
     }
 
-cleanup2 :
-    free(r);
-    free(p);
-    free(Ap);
-    free(Ax);
     return rv;
 }
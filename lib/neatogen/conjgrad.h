@@ -39,6 +39,45 @@ extern "C" {
     extern int conjugate_gradient_mkernel(float *, float *, float *, int,
 					   double, int);
 
+/* Preconditioners for conjugate_gradient_mkernel_block and
+ * conjugate_gradient_precon */
+#define CG_PRECON_NONE   0
+#define CG_PRECON_JACOBI 1
+#define CG_PRECON_ICHOL  2	/* incomplete Cholesky */
+
+    /* Work vectors and preconditioner for up to nrhs systems with the
+     * same packed matrix, made by newCGWorkspace, or for one system
+     * with a sparse matrix, made by newSparseCGWorkspace. Reuse it as
+     * long as the matrix does not change.
+     */
+    typedef struct {
+	int n;
+	int nrhs;
+	int precon;
+	float *r, *p, *Ap, *z;	/* nrhs vectors of n */
+	float *invdiag;		/* Jacobi */
+	int *ia, *ja;		/* incomplete Cholesky factor U, by rows */
+	double *ua;
+	double sign;		/* of the diagonal */
+	double *y;
+	double *rd, *pd, *Apd, *zd;	/* vectors of n, sparse matrix */
+    } CGWorkspace;
+
+    extern CGWorkspace *newCGWorkspace(float *A, int n, int nrhs,
+				       int precon);
+    extern CGWorkspace *newSparseCGWorkspace(vtx_data * A, int n,
+					     int precon);
+    extern void freeCGWorkspace(CGWorkspace *);
+    extern int conjugate_gradient_mkernel_block(float *A, float **x,
+						float **b, int nrhs, int n,
+						double tol,
+						int max_iterations,
+						CGWorkspace * ws);
+    extern int conjugate_gradient_precon(vtx_data * A, double *x,
+					 double *b, int n, double tol,
+					 int max_iterations,
+					 CGWorkspace * ws);
+
 #endif
 
 #ifdef __cplusplus
@@ -60,6 +60,7 @@ int stress_majorization_with_hierarchy(vtx_data * graph,	/* Input graph in spars
 #endif
     double *degrees = NULL;
     float *lap2 = NULL;
+    CGWorkspace *ws = NULL;
     int lap_length;
     float *f_storage = NULL;
     float **coords = NULL;
@@ -358,6 +359,8 @@ int stress_majorization_with_hierarchy(vtx_data * graph,	/* Input graph in spars
     unpackedLap = unpackMatrix(lap2, n);
     cMajEnv =
 	initConstrainedMajorization(lap2, n, ordering, levels, num_levels);
+    ws = newCGWorkspace(lap2, n, 1, (opts & opt_precon) ?
+			 CG_PRECON_ICHOL : CG_PRECON_NONE);
 
     for (converged = FALSE, iterations = 0;
 	 iterations < maxi && !converged; iterations++) {
@@ -489,8 +492,8 @@ int stress_majorization_with_hierarchy(vtx_data * graph,	/* Input graph in spars
 
 	    } else {
 		/* use conjugate gradient for all dimensions except y */
-		if (conjugate_gradient_mkernel(lap2, coords[k], b[k], n,
-					   conj_tol, n)) {
+		if (conjugate_gradient_mkernel_block(lap2, coords + k, b + k,
+						     1, n, conj_tol, n, ws)) {
 		    iterations = -1;
 		    goto finish;
 		}
@@ -531,6 +534,7 @@ int stress_majorization_with_hierarchy(vtx_data * graph,	/* Input graph in spars
 #endif
 
 finish:
+    freeCGWorkspace(ws);
     free(ordering);
 
     free(levels);
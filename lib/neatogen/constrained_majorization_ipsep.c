@@ -79,6 +79,7 @@ int stress_majorization_cola(vtx_data * graph,	/* Input graph in sparse represen
     float **b = NULL;
     double *degrees = NULL;
     float *lap2 = NULL;
+    CGWorkspace *ws = NULL;
     int lap_length;
     float *f_storage = NULL;
     float **coords = NULL;
@@ -289,6 +290,8 @@ int stress_majorization_cola(vtx_data * graph,	/* Input graph in sparse represen
     }
 
     lap1 = N_GNEW(lap_length, float);
+    ws = newCGWorkspace(lap2, n, 2, opt->precon ?
+			 CG_PRECON_ICHOL : CG_PRECON_NONE);
 
     for (converged = FALSE, iterations = 0;
 	 iterations < maxi && !converged; iterations++) {
@@ -412,6 +415,20 @@ int stress_majorization_cola(vtx_data * graph,	/* Input graph in sparse represen
 	 * laplacian is -'lap2')
 	 */
 
+	/* Without constraints in either dimension, x and y share one pass
+	 * of conjugate gradient over lap2. Non-overlap constraints for y
+	 * depend on the new x, so this needs them not to be regenerated.
+	 */
+	if (!(opt->noverlap == 1 && nsizeScale > 0.001)
+	    && cMajEnvHor->m == 0 && cMajEnvVrt->m == 0) {
+	    if (conjugate_gradient_mkernel_block(lap2, coords, b, 2, n,
+						 tolerance_cg, n, ws) < 0) {
+		iterations = -1;
+		goto finish;
+	    }
+	    continue;
+	}
+
 	if (opt->noverlap == 1 && nsizeScale > 0.001) {
 	    generateNonoverlapConstraints(cMajEnvHor, nsizeScale, coords,
 					  0,
@@ -431,8 +448,8 @@ int stress_majorization_cola(vtx_data * graph,	/* Input graph in sparse represen
 	    /* if there are no constraints then use conjugate gradient
 	     * optimisation which should be considerably faster
 	     */
-	    if (conjugate_gradient_mkernel(lap2, coords[0], b[0], n,
-				       tolerance_cg, n) < 0) {
+	    if (conjugate_gradient_mkernel_block(lap2, coords, b, 1, n,
+						 tolerance_cg, n, ws) < 0) {
 		iterations = -1;
 		goto finish;
 	    }
@@ -454,8 +471,8 @@ int stress_majorization_cola(vtx_data * graph,	/* Input graph in sparse represen
 		goto finish;
 	    }
 	} else {
-	    conjugate_gradient_mkernel(lap2, coords[1], b[1], n,
-				       tolerance_cg, n);
+	    conjugate_gradient_mkernel_block(lap2, coords + 1, b + 1, 1, n,
+					     tolerance_cg, n, ws);
 	}
     }
     if (Verbose) {
@@ -490,6 +507,7 @@ finish:
     free(degrees);
     free(lap2);
     free(lap1);
+    freeCGWorkspace(ws);
 
     return iterations;
 }
@@ -38,6 +38,7 @@ typedef struct ipsep_options {
     pointf* nsize;      /* node widths and heights */
     cluster_data* clusters;
                         /* list of node indices for each cluster */
+    int precon;         /* precondition conjugate gradient solves */
 #ifdef MOSEK
     int mosek;          /* use Mosek as constraint optimization engine */
 #endif /* MOSEK */
@@ -95,13 +95,12 @@ static void freeHeap(heap * h)
 }
 
 static void
-initHeap(heap * h, int startVertex, int index[], Word dist[], int n)
+initHeap(heap * h, int *data, int startVertex, int index[], Word dist[],
+	 int n)
 {
     int i, count;
     int j;    /* We cannot use an unsigned value in this loop */
-    /* h->data=(int*) realloc(h->data, (n-1)*sizeof(int)); */
-    if (n == 1) h->data = NULL;
-    else h->data = N_GNEW(n - 1, int);
+    h->data = data;
     h->heapSize = n - 1;
 
     for (count = 0, i = 0; i < n; i++)
@@ -152,29 +151,120 @@ increaseKey(heap * h, int increasedVertex, Word newDist, int index[],
     index[increasedVertex] = i;
 }
 
-void dijkstra(int vertex, vtx_data * graph, int n, DistType * dist)
+/* Edge length as used by the DistType variants; no weights means 1 */
+#define EWGT(graph,v,i) \
+    ((graph)[v].ewgts ? (DistType) (graph)[v].ewgts[i] : 1)
+
+/* In the bucket queue, h->data[v] is the next node in v's bucket and
+ * h->index[v] the previous one, -1 at the head of the bucket.
+ */
+#define NOT_QUEUED -2
+
+static void bucketInsert(DijkstraHeap * h, int v, DistType d)
 {
-    int i;
-    heap H;
-    int closestVertex, neighbor;
-    DistType closestDist, prevClosestDist = INT_MAX;
-    static int *index;
+    int *head = h->bucket + d % h->nbuckets;
 
-#ifdef OBSOLETE
-    mkHeap(&H, n);
-#endif
-    index = (int *) realloc(index, n * sizeof(int));
+    h->index[v] = -1;
+    h->data[v] = *head;
+    if (*head >= 0)
+	h->index[*head] = v;
+    *head = v;
+}
+
+static void bucketRemove(DijkstraHeap * h, int v, DistType d)
+{
+    if (h->index[v] >= 0)
+	h->data[h->index[v]] = h->data[v];
+    else
+	h->bucket[d % h->nbuckets] = h->data[v];
+    if (h->data[v] >= 0)
+	h->index[h->data[v]] = h->index[v];
+    h->index[v] = NOT_QUEUED;
+}
+
+/* mkDijkstraHeap:
+ * Allocate queue storage for the searches on graph. Edge lengths are
+ * truncated to DistType, as in dijkstra. If they all lie in
+ * 0..DIJKSTRA_MAXBUCKET, or the graph has no weights, a bucket queue
+ * with one bucket per possible length is used. As all queued distances
+ * then lie within maxlength of the last settled one, the buckets can
+ * be reused cyclically, and a search takes O(nedges + maxdistance)
+ * rather than O(nedges log n).
+ */
+void mkDijkstraHeap(DijkstraHeap * h, vtx_data * graph, int n)
+{
+    int i, j;
+    DistType w, maxw = 0;
+
+    for (i = 0; i < n && maxw >= 0; i++) {
+	if (!graph[i].ewgts) {
+	    maxw = MAX(maxw, 1);
+	    continue;
+	}
+	for (j = 1; j < graph[i].nedges; j++) {
+	    w = (DistType) graph[i].ewgts[j];
+	    if (w < 0 || w > DIJKSTRA_MAXBUCKET) {
+		maxw = -1;
+		break;
+	    }
+	    maxw = MAX(maxw, w);
+	}
+    }
+
+    h->n = n;
+    h->nbuckets = maxw + 1;
+    h->data = N_GNEW(n, int);
+    h->index = N_GNEW(n, int);
+    h->bucket = h->nbuckets ? N_GNEW(h->nbuckets, int) : NULL;
+    h->inside = NULL;
+    h->Q.data = NULL;
+}
+
+void freeDijkstraHeap(DijkstraHeap * h)
+{
+    free(h->data);
+    free(h->index);
+    free(h->bucket);
+    free(h->inside);
+    if (h->Q.data)
+	freeQueue(&h->Q);
+}
+
+static void
+initDist(int vertex, vtx_data * graph, int n, DistType * dist)
+{
+    int i;
 
     /* initial distances with edge weights: */
     for (i = 0; i < n; i++)
 	dist[i] = (DistType) MAX_DIST;
     dist[vertex] = 0;
     for (i = 1; i < graph[vertex].nedges; i++)
-	dist[graph[vertex].edges[i]] = (DistType) graph[vertex].ewgts[i];
+	dist[graph[vertex].edges[i]] = EWGT(graph, vertex, i);
+}
+
+/* heapSearch:
+ * Settle the nodes in order of distance from vertex with the binary heap.
+ * If nregion > 0, stop once the nregion nodes marked in h->inside,
+ * vertex included, are settled. Return the largest finite distance
+ * found, or INT_MAX if there is none.
+ */
+static DistType
+heapSearch(int vertex, vtx_data * graph, int n, DistType * dist,
+	   DijkstraHeap * h, int nregion)
+{
+    int i;
+    heap H;
+    int closestVertex, neighbor;
+    DistType closestDist, prevClosestDist = INT_MAX;
+    int num_found = 1;
 
-    initHeap(&H, vertex, index, dist, n);
+    initHeap(&H, h->data, vertex, h->index, dist, n);
 
-    while (extractMax(&H, &closestVertex, index, dist)) {
+    while ((nregion == 0 || num_found < nregion)
+	   && extractMax(&H, &closestVertex, h->index, dist)) {
+	if (nregion && h->inside[closestVertex])
+	    num_found++;
 	closestDist = dist[closestVertex];
 	if (closestDist == MAX_DIST)
 	    break;
@@ -182,97 +272,149 @@ void dijkstra(int vertex, vtx_data * graph, int n, DistType * dist)
 	    neighbor = graph[closestVertex].edges[i];
 	    increaseKey(&H, neighbor,
 			closestDist +
-			(DistType) graph[closestVertex].ewgts[i], index,
-			dist);
+			(DistType) graph[closestVertex].ewgts[i],
+			h->index, dist);
 	}
 	prevClosestDist = closestDist;
     }
+    return prevClosestDist;
+}
+
+/* bucketSearch:
+ * As heapSearch, with the bucket queue.
+ */
+static DistType
+bucketSearch(int vertex, vtx_data * graph, int n, DistType * dist,
+	     DijkstraHeap * h, int nregion)
+{
+    int i, v, u;
+    int nqueued = 0;
+    int num_found = 1;
+    DistType d, cur = 0, prevClosestDist = INT_MAX;
+
+    for (i = 0; i < h->nbuckets; i++)
+	h->bucket[i] = -1;
+    for (i = 0; i < n; i++)
+	h->index[i] = NOT_QUEUED;
+    for (i = 1; i < graph[vertex].nedges; i++) {
+	u = graph[vertex].edges[i];
+	if (u != vertex && h->index[u] == NOT_QUEUED) {
+	    bucketInsert(h, u, dist[u]);
+	    nqueued++;
+	}
+    }
+
+    while (nqueued > 0 && (nregion == 0 || num_found < nregion)) {
+	while ((v = h->bucket[cur % h->nbuckets]) < 0)
+	    cur++;
+	bucketRemove(h, v, cur);
+	nqueued--;
+	if (nregion && h->inside[v])
+	    num_found++;
+	for (i = 1; i < graph[v].nedges; i++) {
+	    u = graph[v].edges[i];
+	    d = cur + EWGT(graph, v, i);
+	    if (d < dist[u]) {
+		if (h->index[u] == NOT_QUEUED)
+		    nqueued++;
+		else
+		    bucketRemove(h, u, dist[u]);
+		dist[u] = d;
+		bucketInsert(h, u, d);
+	    }
+	}
+	prevClosestDist = cur;
+    }
+    return prevClosestDist;
+}
+
+/* dijkstra_h:
+ * Shortest paths from vertex, using the storage in h, which must have
+ * been made for graph. Unreachable nodes are put 10 beyond the
+ * farthest reachable one.
+ */
+void
+dijkstra_h(int vertex, vtx_data * graph, int n, DistType * dist,
+	   DijkstraHeap * h)
+{
+    int i;
+    DistType prevClosestDist;
+
+    initDist(vertex, graph, n, dist);
+    if (h->nbuckets)
+	prevClosestDist = bucketSearch(vertex, graph, n, dist, h, 0);
+    else
+	prevClosestDist = heapSearch(vertex, graph, n, dist, h, 0);
 
     /* For dealing with disconnected graphs: */
     for (i = 0; i < n; i++)
 	if (dist[i] == MAX_DIST)	/* 'i' is not connected to 'vertex' */
 	    dist[i] = prevClosestDist + 10;
-    freeHeap(&H);
 }
 
- /* Dijkstra bounded to nodes in *unweighted* radius */
+void dijkstra(int vertex, vtx_data * graph, int n, DistType * dist)
+{
+    DijkstraHeap h;
+
+    mkDijkstraHeap(&h, graph, n);
+    dijkstra_h(vertex, graph, n, dist, &h);
+    freeDijkstraHeap(&h);
+}
+
+/* dijkstra_bounded_h:
+ * Dijkstra bounded to nodes in *unweighted* radius: find the weighted
+ * distances from vertex to the nodes whose *unweighted* distance from
+ * it is at most bound. These nodes are stored in visited_nodes, and
+ * their number returned. The search stops as soon as they are all
+ * settled, so other entries of dist are left undefined.
+ */
 int
-dijkstra_bounded(int vertex, vtx_data * graph, int n, DistType * dist,
-		 int bound, int *visited_nodes)
- /* make dijkstra, but consider only nodes whose *unweighted* distance from 'vertex'  */
- /* is at most 'bound' */
- /* MON-EFFICIENT implementation, see below. */
+dijkstra_bounded_h(int vertex, vtx_data * graph, int n, DistType * dist,
+		   int bound, int *visited_nodes, DijkstraHeap * h)
 {
     int num_visited_nodes;
     int i;
-    static boolean *node_in_neighborhood = NULL;
-    static int size = 0;
-    static int *index;
-    Queue Q;
-    heap H;
-    int closestVertex, neighbor;
-    DistType closestDist;
-    int num_found = 0;
+
+    if (!h->Q.data) {
+	mkQueue(&h->Q, n);
+	h->inside = N_GNEW(n, boolean);
+	for (i = 0; i < n; i++)
+	    h->inside[i] = FALSE;
+    }
 
     /* first, perform BFS to find the nodes in the region */
-    mkQueue(&Q, n);
     /* remember that dist should be init. with -1's */
-    for (i = 0; i < n; i++) {
-	dist[i] = -1;		/* far, TOO COSTLY (O(n))! */
-    }
+    for (i = 0; i < n; i++)
+	dist[i] = -1;
     num_visited_nodes =
-	bfs_bounded(vertex, graph, n, dist, &Q, bound, visited_nodes);
-    if (size < n) {
-	node_in_neighborhood =
-	    (boolean *) realloc(node_in_neighborhood, n * sizeof(boolean));
-	for (i = size; i < n; i++) {
-	    node_in_neighborhood[i] = FALSE;
-	}
-	size = n;
-    }
-    for (i = 0; i < num_visited_nodes; i++) {
-	node_in_neighborhood[visited_nodes[i]] = TRUE;
-    }
-
-
-#ifdef OBSOLETE
-    mkHeap(&H, n);
-#endif
-    index = (int *) realloc(index, n * sizeof(int));
-
-    /* initial distances with edge weights: */
-    for (i = 0; i < n; i++)	/* far, TOO COSTLY (O(n))! */
-	dist[i] = (DistType) MAX_DIST;
-    dist[vertex] = 0;
-    for (i = 1; i < graph[vertex].nedges; i++)
-	dist[graph[vertex].edges[i]] = (DistType) graph[vertex].ewgts[i];
-
-    /* again, TOO COSTLY (O(n)) to put all nodes in heap! */
-    initHeap(&H, vertex, index, dist, n); 
+	bfs_bounded(vertex, graph, n, dist, &h->Q, bound, visited_nodes);
+    for (i = 0; i < num_visited_nodes; i++)
+	h->inside[visited_nodes[i]] = TRUE;
+
+    initDist(vertex, graph, n, dist);
+    if (h->nbuckets)
+	bucketSearch(vertex, graph, n, dist, h, num_visited_nodes);
+    else
+	heapSearch(vertex, graph, n, dist, h, num_visited_nodes);
+
+    /* restore initial false-status of 'inside' */
+    for (i = 0; i < num_visited_nodes; i++)
+	h->inside[visited_nodes[i]] = FALSE;
+    return num_visited_nodes;
+}
 
-    while (num_found < num_visited_nodes
-	   && extractMax(&H, &closestVertex, index, dist)) {
-	if (node_in_neighborhood[closestVertex]) {
-	    num_found++;
-	}
-	closestDist = dist[closestVertex];
-	if (closestDist == MAX_DIST)
-	    break;
-	for (i = 1; i < graph[closestVertex].nedges; i++) {
-	    neighbor = graph[closestVertex].edges[i];
-	    increaseKey(&H, neighbor,
-			closestDist +
-			(DistType) graph[closestVertex].ewgts[i], index,
-			dist);
-	}
-    }
+int
+dijkstra_bounded(int vertex, vtx_data * graph, int n, DistType * dist,
+		 int bound, int *visited_nodes)
+{
+    DijkstraHeap h;
+    int num_visited_nodes;
 
-    /* restore initial false-status of 'node_in_neighborhood' */
-    for (i = 0; i < num_visited_nodes; i++) {
-	node_in_neighborhood[visited_nodes[i]] = FALSE;
-    }
-    freeHeap(&H);
-    freeQueue(&Q);
+    mkDijkstraHeap(&h, graph, n);
+    num_visited_nodes =
+	dijkstra_bounded_h(vertex, graph, n, dist, bound, visited_nodes,
+			   &h);
+    freeDijkstraHeap(&h);
     return num_visited_nodes;
 }
 
@@ -394,3 +536,152 @@ void dijkstra_f(int vertex, vtx_data * graph, int n, float *dist)
     freeHeap(&H);
     free(index);
 }
+
+void mkDijkstraFHeap(DijkstraFHeap * h, int n)
+{
+    int i;
+
+    h->n = n;
+    h->hops = N_GNEW(n, DistType);
+    h->inside = N_GNEW(n, boolean);
+    h->index = N_GNEW(n, int);
+    h->heap = N_GNEW(n, int);
+    h->reached = N_GNEW(n, int);
+    for (i = 0; i < n; i++) {
+	h->hops[i] = -1;
+	h->inside[i] = FALSE;
+	h->index[i] = -1;
+    }
+    mkQueue(&h->Q, n);
+}
+
+void freeDijkstraFHeap(DijkstraFHeap * h)
+{
+    free(h->hops);
+    free(h->inside);
+    free(h->index);
+    free(h->heap);
+    free(h->reached);
+    freeQueue(&h->Q);
+}
+
+/* siftUp_f, siftDown_f:
+ * Restore the order of the binary heap h->heap[0..size-1], keyed by
+ * dist, after the node at position i got closer or farther.
+ */
+static void siftUp_f(DijkstraFHeap * h, int i, float *dist)
+{
+    int v = h->heap[i], p;
+
+    while (i > 0 && dist[h->heap[p = (i - 1) / 2]] > dist[v]) {
+	h->heap[i] = h->heap[p];
+	h->index[h->heap[i]] = i;
+	i = p;
+    }
+    h->heap[i] = v;
+    h->index[v] = i;
+}
+
+static void siftDown_f(DijkstraFHeap * h, int i, int size, float *dist)
+{
+    int v = h->heap[i], c;
+
+    while ((c = 2 * i + 1) < size) {
+	if (c + 1 < size && dist[h->heap[c + 1]] < dist[h->heap[c]])
+	    c++;
+	if (dist[h->heap[c]] >= dist[v])
+	    break;
+	h->heap[i] = h->heap[c];
+	h->index[h->heap[i]] = i;
+	i = c;
+    }
+    h->heap[i] = v;
+    h->index[v] = i;
+}
+
+/* dijkstra_bounded_fh:
+ * As dijkstra_bounded_h, with float edge lengths. Find the weighted
+ * distances from vertex to the nodes whose *unweighted* distance from
+ * it is at most bound. These nodes are stored in visited_nodes, and
+ * their number returned. Only the nodes reached by the search are
+ * queued or reset, so the cost does not depend on n, and other
+ * entries of dist are left undefined.
+ */
+int
+dijkstra_bounded_fh(int vertex, vtx_data * graph, int n, float *dist,
+		    int bound, int *visited_nodes, DijkstraFHeap * h)
+{
+    int num_visited_nodes, num_found, nreached, size;
+    int i, v, u;
+    float d;
+
+    /* first, perform BFS to find the nodes in the region */
+    num_visited_nodes =
+	bfs_bounded(vertex, graph, n, h->hops, &h->Q, bound,
+		    visited_nodes);
+    for (i = 0; i < num_visited_nodes; i++) {
+	h->inside[visited_nodes[i]] = TRUE;
+	h->hops[visited_nodes[i]] = -1;
+    }
+
+    dist[vertex] = 0;
+    h->reached[0] = vertex;
+    nreached = 1;
+    size = 0;
+    v = vertex;
+    /* vertex itself is in the region */
+    num_found = 1;
+    for (;;) {
+	for (i = 1; i < graph[v].nedges; i++) {
+	    u = graph[v].edges[i];
+	    d = dist[v] + graph[v].ewgts[i];
+	    if (u == vertex)
+		continue;
+	    if (h->index[u] < 0) {
+		if (h->index[u] == -2)	/* settled */
+		    continue;
+		h->reached[nreached++] = u;
+		dist[u] = d;
+		h->heap[size] = u;
+		siftUp_f(h, size++, dist);
+	    } else if (d < dist[u]) {
+		dist[u] = d;
+		siftUp_f(h, h->index[u], dist);
+	    }
+	}
+	if (num_found >= num_visited_nodes || size == 0)
+	    break;
+	v = h->heap[0];
+	h->index[v] = -2;
+	if (--size > 0) {
+	    h->heap[0] = h->heap[size];
+	    siftDown_f(h, 0, size, dist);
+	}
+	if (h->inside[v])
+	    num_found++;
+    }
+
+    for (i = 0; i < nreached; i++)
+	h->index[h->reached[i]] = -1;
+    for (i = 0; i < num_visited_nodes; i++)
+	h->inside[visited_nodes[i]] = FALSE;
+    return num_visited_nodes;
+}
+
+/* dijkstra_bounded_f:
+ * As dijkstra_bounded_fh, with storage for a single search.
+ */
+int
+dijkstra_bounded_f(int vertex, vtx_data * graph, int n, float *dist,
+		   int bound, int *visited_nodes)
+{
+    DijkstraFHeap h;
+    int num_visited_nodes;
+
+    mkDijkstraFHeap(&h, n);
+    num_visited_nodes =
+	dijkstra_bounded_fh(vertex, graph, n, dist, bound, visited_nodes,
+			    &h);
+    freeDijkstraFHeap(&h);
+    return num_visited_nodes;
+}
@@ -21,6 +21,7 @@ extern "C" {
 #define _DIJKSTRA_H_
 
 #include "defs.h"
+#include "bfs.h"
 
 #ifdef __cplusplus
     void dijkstra(int vertex, vtx_data * graph, int n, DistType * dist);
@@ -31,12 +32,55 @@ extern "C" {
 			  int &num_visited_nodes);
 
 #else
+    /* Priority queue storage for the DistType variants, reused across
+     * the sources of one graph. If all edge lengths are integers in
+     * 0..DIJKSTRA_MAXBUCKET, a bucket queue replaces the binary heap.
+     */
+#define DIJKSTRA_MAXBUCKET 1024
+    typedef struct {
+	int n;
+	int nbuckets;		/* 0 if the binary heap is used */
+	int *data;		/* heap, or next node in the same bucket */
+	int *index;		/* position in heap, or previous node in bucket */
+	int *bucket;		/* first node in each bucket */
+	boolean *inside;	/* nodes of the region, for dijkstra_bounded_h */
+	Queue Q;		/* for dijkstra_bounded_h */
+    } DijkstraHeap;
+
+    extern void mkDijkstraHeap(DijkstraHeap *, vtx_data *, int);
+    extern void freeDijkstraHeap(DijkstraHeap *);
+    extern void dijkstra_h(int, vtx_data *, int, DistType *,
+			   DijkstraHeap *);
+    extern int dijkstra_bounded_h(int, vtx_data *, int, DistType *, int,
+				  int *, DijkstraHeap *);
+
     extern void dijkstra(int, vtx_data *, int, DistType *);
     extern void dijkstra_f(int, vtx_data *, int, float *);
 
     /* Dijkstra bounded to nodes in *unweighted* radius */
     extern int dijkstra_bounded(int, vtx_data *, int, DistType *, int,
 				int *);
+    extern int dijkstra_bounded_f(int, vtx_data *, int, float *, int,
+				  int *);
+
+    /* Storage for dijkstra_bounded_fh, reused across the sources of one
+     * graph. Between searches, hops and index are -1 and inside is
+     * FALSE everywhere, so a search only touches the nodes it reaches.
+     */
+    typedef struct {
+	int n;
+	DistType *hops;		/* for the BFS of the region */
+	boolean *inside;	/* nodes of the region */
+	int *index;		/* position in heap, or -1 */
+	int *heap;		/* reached nodes not yet settled */
+	int *reached;		/* nodes reached by the search */
+	Queue Q;
+    } DijkstraFHeap;
+
+    extern void mkDijkstraFHeap(DijkstraFHeap *, int);
+    extern void freeDijkstraFHeap(DijkstraFHeap *);
+    extern int dijkstra_bounded_fh(int, vtx_data *, int, float *, int,
+				   int *, DijkstraFHeap *);
 #endif
 
 #endif
@@ -46,6 +46,7 @@ void embed_graph(vtx_data * graph, int n, int dim, DistType *** Coords,
 						   each nodes to the selected "pivots" */
     float *old_weights = graph[0].ewgts;
     Queue Q;
+    DijkstraHeap h;
     DistType max_dist = 0;
 
     if (coords != NULL) {
@@ -60,6 +61,7 @@ void embed_graph(vtx_data * graph, int n, int dim, DistType *** Coords,
 
     if (reweight_graph) {
 	compute_new_weights(graph, n);
+	mkDijkstraHeap(&h, graph, n);
     }
 
     /* select the first pivot */
@@ -67,7 +69,7 @@ void embed_graph(vtx_data * graph, int n, int dim, DistType *** Coords,
 
     mkQueue(&Q, n);
     if (reweight_graph) {
-	dijkstra(node, graph, n, coords[0]);
+	dijkstra_h(node, graph, n, coords[0], &h);
     } else {
 	bfs(node, graph, n, coords[0], &Q);
     }
@@ -83,7 +85,7 @@ void embed_graph(vtx_data * graph, int n, int dim, DistType *** Coords,
     /* select other dim-1 nodes as pivots */
     for (i = 1; i < dim; i++) {
 	if (reweight_graph) {
-	    dijkstra(node, graph, n, coords[i]);
+	    dijkstra_h(node, graph, n, coords[i], &h);
 	} else {
 	    bfs(node, graph, n, coords[i], &Q);
 	}
@@ -101,6 +103,7 @@ void embed_graph(vtx_data * graph, int n, int dim, DistType *** Coords,
     free(dist);
 
     if (reweight_graph) {
+	freeDijkstraHeap(&h);
 	restore_old_weights(graph, n, old_weights);
     }
 
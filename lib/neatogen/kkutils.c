@@ -61,15 +61,18 @@ static DistType **compute_apsp_dijkstra(vtx_data * graph, int n)
     int i;
     DistType *storage;
     DistType **dij;
+    DijkstraHeap h;
 
     storage = N_GNEW(n * n, DistType);
     dij = N_GNEW(n, DistType *);
     for (i = 0; i < n; i++)
 	dij[i] = storage + i * n;
 
+    mkDijkstraHeap(&h, graph, n);
     for (i = 0; i < n; i++) {
-	dijkstra(i, graph, n, dij[i]);
+	dijkstra_h(i, graph, n, dij[i], &h);
     }
+    freeDijkstraHeap(&h);
     return dij;
 }
 
@@ -404,7 +404,6 @@ vectors_addition(int n, double *vector1, double *vector2, double *result)
     }
 }
 
-#ifdef UNUSED
 /* inline */
 void
 vectors_mult_addition(int n, double *vector1, double alpha,
@@ -415,7 +414,6 @@ vectors_mult_addition(int n, double *vector1, double alpha,
 	vector1[i] = vector1[i] + alpha * vector2[i];
     }
 }
-#endif
 
 /* inline */
 void
@@ -505,15 +503,14 @@ right_mult_with_vector_transpose(double **matrix,
 				 double *vector, double *result)
 {
     /* matrix is dim2 x dim1, vector has dim2 components, result=matrix^T x vector */
+    /* traverse the rows of matrix, so the inner loop has unit stride */
     int i, j;
 
-    double res;
-    for (i = 0; i < dim1; i++) {
-	res = 0;
-	for (j = 0; j < dim2; j++)
-	    res += matrix[j][i] * vector[j];
-	result[i] = res;
-    }
+    for (i = 0; i < dim1; i++)
+	result[i] = 0;
+    for (j = 0; j < dim2; j++)
+	for (i = 0; i < dim1; i++)
+	    result[i] += matrix[j][i] * vector[j];
 }
 
 /* inline */
@@ -589,29 +586,369 @@ void right_mult_with_vector_fd
 }
 #endif
 
+/* The float kernels below, for the packed symmetric matrix-vector
+ * product, the inner product and the stress, have SSE2 and AVX versions
+ * chosen at run time. Every version splits its sums over LANES
+ * interleaved partial sums, added in the same fixed order, and does not
+ * fuse multiplications and additions, so all of them give bit-identical
+ * results and a layout does not depend on the CPU.
+ */
+#define LANES 8
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+
+static int SimdLevel = -1;	/* not yet detected */
+
+static int simd_supported(void)
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+	return SIMD_AVX;
+    if (__builtin_cpu_supports("sse2"))
+	return SIMD_SSE2;
+#endif
+    return SIMD_NONE;
+}
+
+/* matrix_ops_simd:
+ * If level >= 0, use the best supported instruction set up to level
+ * for the float kernels. Return the set in use.
+ */
+int matrix_ops_simd(int level)
+{
+    int best = simd_supported();
+
+    if (level >= 0)
+	SimdLevel = (level < best ? level : best);
+    else if (SimdLevel < 0)
+	SimdLevel = best;
+    return SimdLevel;
+}
+
+#define SIMD() (SimdLevel < 0 ? matrix_ops_simd(-1) : SimdLevel)
+
+static float lanesumf(float *s)
+{
+    return ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+}
+
+static double lanesum(double *s)
+{
+    return ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+}
+
+/* symv_row:
+ * The off-diagonal part of one row of the packed product: add a[t]*xi
+ * to r[t], and return the sum of a[t]*x[t], for t < m.
+ */
+static float symv_row(float *a, float *x, float *r, int m, float xi)
+{
+    float s[LANES] = { 0 };
+    int t, k;
+
+    for (t = 0; t + LANES <= m; t += LANES)
+	for (k = 0; k < LANES; k++) {
+	    s[k] += a[t + k] * x[t + k];
+	    r[t + k] += a[t + k] * xi;
+	}
+    for (k = 0; t < m; t++, k++) {
+	s[k] += a[t] * x[t];
+	r[t] += a[t] * xi;
+    }
+    return lanesumf(s);
+}
+
+static double dotf(int n, float *a, float *b)
+{
+    double s[LANES] = { 0 };
+    int t, k;
+
+    for (t = 0; t + LANES <= n; t += LANES)
+	for (k = 0; k < LANES; k++)
+	    s[k] += a[t + k] * b[t + k];
+    for (k = 0; t < n; t++, k++)
+	s[k] += a[t] * b[t];
+    return lanesum(s);
+}
+
+/* stress_term:
+ * Stress of the pair i,j, weighted by w = lap[ij].
+ */
+static double
+stress_term(float **coords, int dim, int i, int j, float w)
+{
+    double dist = 0, Dij = 1.0 / w;
+    int l;
+
+    for (l = 0; l < dim; l++)
+	dist += (coords[l][i] - coords[l][j]) * (coords[l][i] - coords[l][j]);
+    dist = sqrt(dist);
+    return (Dij - dist) * (Dij - dist) * w;
+}
+
+static double stress_rows(float **coords, float *lap, int dim, int n)
+{
+    double s[LANES] = { 0 };
+    int i, j, k, count;
+
+    for (count = 0, i = 0; i < n - 1; i++) {
+	count++;		/* skip diagonal entry */
+	for (j = i + 1; j + LANES <= n; j += LANES, count += LANES)
+	    for (k = 0; k < LANES; k++)
+		s[k] += stress_term(coords, dim, i, j + k, lap[count + k]);
+	for (k = 0; j < n; j++, k++, count++)
+	    s[k] += stress_term(coords, dim, i, j, lap[count]);
+    }
+    return lanesum(s);
+}
+
+#ifdef SIMD_X86
+TARGET("sse2")
+static float symv_row_sse2(float *a, float *x, float *r, int m, float xi)
+{
+    float s[LANES];
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    __m128 vi = _mm_set1_ps(xi), a0, a1;
+    int t, k;
+
+    for (t = 0; t + LANES <= m; t += LANES) {
+	a0 = _mm_loadu_ps(a + t);
+	a1 = _mm_loadu_ps(a + t + 4);
+	s0 = _mm_add_ps(s0, _mm_mul_ps(a0, _mm_loadu_ps(x + t)));
+	s1 = _mm_add_ps(s1, _mm_mul_ps(a1, _mm_loadu_ps(x + t + 4)));
+	_mm_storeu_ps(r + t,
+		      _mm_add_ps(_mm_loadu_ps(r + t), _mm_mul_ps(a0, vi)));
+	_mm_storeu_ps(r + t + 4,
+		      _mm_add_ps(_mm_loadu_ps(r + t + 4),
+				 _mm_mul_ps(a1, vi)));
+    }
+    _mm_storeu_ps(s, s0);
+    _mm_storeu_ps(s + 4, s1);
+    for (k = 0; t < m; t++, k++) {
+	s[k] += a[t] * x[t];
+	r[t] += a[t] * xi;
+    }
+    return lanesumf(s);
+}
+
+TARGET("avx")
+static float symv_row_avx(float *a, float *x, float *r, int m, float xi)
+{
+    float s[LANES];
+    __m256 s0 = _mm256_setzero_ps(), vi = _mm256_set1_ps(xi), a0;
+    int t, k;
+
+    for (t = 0; t + LANES <= m; t += LANES) {
+	a0 = _mm256_loadu_ps(a + t);
+	s0 = _mm256_add_ps(s0, _mm256_mul_ps(a0, _mm256_loadu_ps(x + t)));
+	_mm256_storeu_ps(r + t, _mm256_add_ps(_mm256_loadu_ps(r + t),
+					      _mm256_mul_ps(a0, vi)));
+    }
+    _mm256_storeu_ps(s, s0);
+    for (k = 0; t < m; t++, k++) {
+	s[k] += a[t] * x[t];
+	r[t] += a[t] * xi;
+    }
+    return lanesumf(s);
+}
+
+TARGET("sse2")
+static double dotf_sse2(int n, float *a, float *b)
+{
+    double s[LANES];
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    __m128d s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+    __m128 p0, p1;
+    int t, k;
+
+    for (t = 0; t + LANES <= n; t += LANES) {
+	p0 = _mm_mul_ps(_mm_loadu_ps(a + t), _mm_loadu_ps(b + t));
+	p1 = _mm_mul_ps(_mm_loadu_ps(a + t + 4), _mm_loadu_ps(b + t + 4));
+	s0 = _mm_add_pd(s0, _mm_cvtps_pd(p0));
+	s1 = _mm_add_pd(s1, _mm_cvtps_pd(_mm_movehl_ps(p0, p0)));
+	s2 = _mm_add_pd(s2, _mm_cvtps_pd(p1));
+	s3 = _mm_add_pd(s3, _mm_cvtps_pd(_mm_movehl_ps(p1, p1)));
+    }
+    _mm_storeu_pd(s, s0);
+    _mm_storeu_pd(s + 2, s1);
+    _mm_storeu_pd(s + 4, s2);
+    _mm_storeu_pd(s + 6, s3);
+    for (k = 0; t < n; t++, k++)
+	s[k] += a[t] * b[t];
+    return lanesum(s);
+}
+
+TARGET("avx")
+static double dotf_avx(int n, float *a, float *b)
+{
+    double s[LANES];
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    __m256 p;
+    int t, k;
+
+    for (t = 0; t + LANES <= n; t += LANES) {
+	p = _mm256_mul_ps(_mm256_loadu_ps(a + t), _mm256_loadu_ps(b + t));
+	s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm256_castps256_ps128(p)));
+	s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm256_extractf128_ps(p, 1)));
+    }
+    _mm256_storeu_pd(s, s0);
+    _mm256_storeu_pd(s + 4, s1);
+    for (k = 0; t < n; t++, k++)
+	s[k] += a[t] * b[t];
+    return lanesum(s);
+}
+
+TARGET("sse2")
+static double stress_rows_sse2(float **coords, float *lap, int dim, int n)
+{
+    double s[LANES];
+    __m128d acc[4], d[4], w, one = _mm_set1_pd(1);
+    __m128 ci, q;
+    int i, j, k, l, count;
+
+    for (k = 0; k < 4; k++)
+	acc[k] = _mm_setzero_pd();
+    for (count = 0, i = 0; i < n - 1; i++) {
+	count++;		/* skip diagonal entry */
+	for (j = i + 1; j + LANES <= n; j += LANES, count += LANES) {
+	    for (k = 0; k < 4; k++)
+		d[k] = _mm_setzero_pd();
+	    for (l = 0; l < dim; l++) {
+		ci = _mm_set1_ps(coords[l][i]);
+		for (k = 0; k < 2; k++) {
+		    q = _mm_sub_ps(ci, _mm_loadu_ps(coords[l] + j + 4 * k));
+		    q = _mm_mul_ps(q, q);
+		    d[2 * k] = _mm_add_pd(d[2 * k], _mm_cvtps_pd(q));
+		    d[2 * k + 1] = _mm_add_pd(d[2 * k + 1],
+					      _mm_cvtps_pd(_mm_movehl_ps(q, q)));
+		}
+	    }
+	    for (k = 0; k < 4; k++) {
+		q = _mm_loadu_ps(lap + count + 4 * (k / 2));
+		w = _mm_cvtps_pd(k % 2 ? _mm_movehl_ps(q, q) : q);
+		d[k] = _mm_sub_pd(_mm_div_pd(one, w), _mm_sqrt_pd(d[k]));
+		acc[k] = _mm_add_pd(acc[k], _mm_mul_pd(_mm_mul_pd(d[k], d[k]), w));
+	    }
+	}
+	for (k = 0; k < 4; k++)
+	    _mm_storeu_pd(s + 2 * k, acc[k]);
+	for (k = 0; j < n; j++, k++, count++)
+	    s[k] += stress_term(coords, dim, i, j, lap[count]);
+	for (k = 0; k < 4; k++)
+	    acc[k] = _mm_loadu_pd(s + 2 * k);
+    }
+    return lanesum(s);
+}
+
+TARGET("avx")
+static double stress_rows_avx(float **coords, float *lap, int dim, int n)
+{
+    double s[LANES];
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    __m256d d0, d1, w0, w1, one = _mm256_set1_pd(1);
+    __m256 ci, q;
+    int i, j, k, l, count;
+
+    for (count = 0, i = 0; i < n - 1; i++) {
+	count++;		/* skip diagonal entry */
+	for (j = i + 1; j + LANES <= n; j += LANES, count += LANES) {
+	    d0 = d1 = _mm256_setzero_pd();
+	    for (l = 0; l < dim; l++) {
+		ci = _mm256_set1_ps(coords[l][i]);
+		q = _mm256_sub_ps(ci, _mm256_loadu_ps(coords[l] + j));
+		q = _mm256_mul_ps(q, q);
+		d0 = _mm256_add_pd(d0, _mm256_cvtps_pd(_mm256_castps256_ps128(q)));
+		d1 = _mm256_add_pd(d1, _mm256_cvtps_pd(_mm256_extractf128_ps(q, 1)));
+	    }
+	    q = _mm256_loadu_ps(lap + count);
+	    w0 = _mm256_cvtps_pd(_mm256_castps256_ps128(q));
+	    w1 = _mm256_cvtps_pd(_mm256_extractf128_ps(q, 1));
+	    d0 = _mm256_sub_pd(_mm256_div_pd(one, w0), _mm256_sqrt_pd(d0));
+	    d1 = _mm256_sub_pd(_mm256_div_pd(one, w1), _mm256_sqrt_pd(d1));
+	    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_mul_pd(d0, d0), w0));
+	    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_mul_pd(d1, d1), w1));
+	}
+	_mm256_storeu_pd(s, acc0);
+	_mm256_storeu_pd(s + 4, acc1);
+	for (k = 0; j < n; j++, k++, count++)
+	    s[k] += stress_term(coords, dim, i, j, lap[count]);
+	acc0 = _mm256_loadu_pd(s);
+	acc1 = _mm256_loadu_pd(s + 4);
+    }
+    return lanesum(s);
+}
+#endif
+
+typedef float (*symv_row_fn) (float *, float *, float *, int, float);
+
+static symv_row_fn symv_kernel(void)
+{
+#ifdef SIMD_X86
+    int simd = SIMD();
+
+    if (simd == SIMD_AVX)
+	return symv_row_avx;
+    if (simd == SIMD_SSE2)
+	return symv_row_sse2;
+#endif
+    return symv_row;
+}
+
+/* right_mult_with_vectors_ff:
+ * Multiply the packed symmetric matrix by nvec vectors in one pass over
+ * the matrix. Each result is the same as from right_mult_with_vector_ff.
+ */
+void
+right_mult_with_vectors_ff(float *packed_matrix, int n, int nvec,
+			   float **vectors, float **results)
+{
+    int i, k, index;
+    float vector_i, res;
+    symv_row_fn row = symv_kernel();
+
+    for (k = 0; k < nvec; k++)
+	for (i = 0; i < n; i++)
+	    results[k][i] = 0;
+    for (index = 0, i = 0; i < n; index += n - i, i++) {
+	for (k = 0; k < nvec; k++) {
+	    vector_i = vectors[k][i];
+	    /* deal with main diag */
+	    res = packed_matrix[index] * vector_i;
+	    /* deal with off diag */
+	    res += row(packed_matrix + index + 1, vectors[k] + i + 1,
+		       results[k] + i + 1, n - i - 1, vector_i);
+	    results[k][i] += res;
+	}
+    }
+}
+
 /* inline */
 void right_mult_with_vector_ff
     (float *packed_matrix, int n, float *vector, float *result) {
     /* packed matrix is the upper-triangular part of a symmetric matrix arranged in a vector row-wise */
-    int i, j, index;
-    float vector_i;
+    right_mult_with_vectors_ff(packed_matrix, n, 1, &vector, &result);
+}
 
-    float res;
-    for (i = 0; i < n; i++) {
-	result[i] = 0;
-    }
-    for (index = 0, i = 0; i < n; i++) {
-	res = 0;
-	vector_i = vector[i];
-	/* deal with main diag */
-	res += packed_matrix[index++] * vector_i;
-	/* deal with off diag */
-	for (j = i + 1; j < n; j++, index++) {
-	    res += packed_matrix[index] * vector[j];
-	    result[j] += packed_matrix[index] * vector_i;
-	}
-	result[i] += res;
-    }
+/* stress_packedf:
+ * Stress sum_{i<j} w_ij (1/w_ij - |x_i - x_j|)^2 of the layout coords,
+ * with the weights w in a packed upper-triangular matrix.
+ */
+double stress_packedf(float **coords, float *lap, int dim, int n)
+{
+#ifdef SIMD_X86
+    int simd = SIMD();
+
+    if (simd == SIMD_AVX)
+	return stress_rows_avx(coords, lap, dim, n);
+    if (simd == SIMD_SSE2)
+	return stress_rows_sse2(coords, lap, dim, n);
+#endif
+    return stress_rows(coords, lap, dim, n);
 }
 
 /* inline */
@@ -664,13 +1001,15 @@ void copy_vectorf(int n, float *source, float *dest)
 /* inline */
 double vectors_inner_productf(int n, float *vector1, float *vector2)
 {
-    int i;
-    double result = 0;
-    for (i = 0; i < n; i++) {
-	result += vector1[i] * vector2[i];
-    }
+#ifdef SIMD_X86
+    int simd = SIMD();
 
-    return result;
+    if (simd == SIMD_AVX)
+	return dotf_avx(n, vector1, vector2);
+    if (simd == SIMD_SSE2)
+	return dotf_sse2(n, vector1, vector2);
+#endif
+    return dotf(n, vector1, vector2);
 }
 
 /* inline */
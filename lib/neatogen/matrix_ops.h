@@ -41,8 +41,8 @@ extern "C" {
     extern double vectors_inner_product(int n, double *vector1,
 					double *vector2);
     extern double max_abs(int n, double *vector);
-#ifdef UNUSED
     extern void vectors_mult_addition(int, double *, double, double *);
+#ifdef UNUSED
     extern void orthogvec(int, double *, double *);
 #endif
 
@@ -76,7 +76,16 @@ extern "C" {
     extern void right_mult_with_vector_fd(float **, int, float *,
 					  double *);
 #endif
+    /* instruction sets for the float kernels, see matrix_ops_simd */
+#define SIMD_NONE 0
+#define SIMD_SSE2 1
+#define SIMD_AVX  2
+    extern int matrix_ops_simd(int level);
     extern void right_mult_with_vector_ff(float *, int, float *, float *);
+    extern void right_mult_with_vectors_ff(float *, int, int, float **,
+					   float **);
+    extern double stress_packedf(float **coords, float *lap, int dim,
+				 int n);
     extern void vectors_substractionf(int, float *, float *, float *);
     extern void vectors_additionf(int n, float *vector1, float *vector2,
 				  float *result);
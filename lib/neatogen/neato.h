@@ -21,6 +21,7 @@
 #define MODEL_CIRCUIT        1
 #define MODEL_SUBSET         2
 #define MODEL_MDS            3
+#define MODEL_SPARSE         4
 
 #define MODE_KK          0
 #define MODE_MAJOR       1
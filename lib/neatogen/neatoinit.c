@@ -28,6 +28,8 @@
 #endif
 #include "kkutils.h"
 #include "pointset.h"
+#include "parallel.h"
+#include "matrix_ops.h"
 
 #ifndef HAVE_SRAND48
 #define srand48 srand
@@ -67,7 +69,7 @@ int user_pos(attrsym_t * posptr, attrsym_t * pinptr, node_t * np, int nG)
     if (p[0]) {
 	c = '\0';
 	if ((Ndim >= 3) &&
-            (sscanf(p, "%lf,%lf,%lf%c", pvec, pvec+1, pvec+2, &c) >= 3)){
+            (agxgetpoint(np, posptr, pvec, 3, &c) >= 3)){
 	    ND_pinned(np) = P_SET;
 	    if (PSinputscale > 0.0) {
 		int i;
@@ -80,7 +82,7 @@ int user_pos(attrsym_t * posptr, attrsym_t * pinptr, node_t * np, int nG)
 		ND_pinned(np) = P_PIN;
 	    return TRUE;
 	}
-	else if (sscanf(p, "%lf,%lf%c", pvec, pvec + 1, &c) >= 2) {
+	else if (agxgetpoint(np, posptr, pvec, 2, &c) >= 2) {
 	    ND_pinned(np) = P_SET;
 	    if (PSinputscale > 0.0) {
 		int i;
@@ -615,6 +617,7 @@ static void neato_init_graph (Agraph_t * g)
     GD_ndim(agroot(g)) = late_int(g, agfindgraphattr(g, "dim"), outdim, 2);
     Ndim = GD_ndim(g->root) = MIN(GD_ndim(g->root), MAXDIM);
     GD_odim(g->root) = MIN(outdim, Ndim);
+    Nthreads = parallel_threads(g);
     neato_init_node_edge(g);
 }
 
@@ -632,6 +635,8 @@ static int neatoModel(graph_t * g)
 	    return MODEL_SUBSET;
 	else if (streq(p, "shortpath"))
 	    return MODEL_SHORTPATH;
+	else if (streq(p, "sparse"))
+	    return MODEL_SPARSE;
     }
     if ((c == 'm') && streq(p, "mds")) {
 	if (agattr(g, AGEDGE, "len", 0))
@@ -1141,6 +1146,8 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, int
 
     if (init == INIT_SELF)
 	opts |= opt_smart_init;
+    if (mapbool(agget(g, "precondition")))
+	opts |= opt_precon;
 
     coords = N_GNEW(dim, double *);
     coords[0] = N_GNEW(nv * dim, double);
@@ -1181,6 +1188,7 @@ majorization(graph_t *mg, graph_t * g, int nv, int mode, int model, int dim, int
 #endif /* MOSEK */
             opt.nsize = nsize;
             opt.clusters = cs;
+            opt.precon = opts & opt_precon;
             str = agget(g, "diredgeconstraints");
             if (mapbool(str)) {
                 opt.diredges = 1;
@@ -1300,6 +1308,21 @@ static void mds_model(graph_t * g, int nG)
     }
 }
 
+/* kkSolve:
+ * Given the distances in GD_dist(g), place the nodes of g.
+ */
+static void kkSolve(Agraph_t * g, int nG, int model)
+{
+    initial_positions(g, nG);
+    diffeq_model(g, nG);
+    if (Verbose) {
+	fprintf(stderr, "Solving model %d iterations %d tol %f\n",
+		model, MaxIter, Epsilon);
+	start_timer();
+    }
+    solve_model(g, nG);
+}
+
 /* kkNeato:
  * Solve using gradient descent a la Kamada-Kawai.
  */
@@ -1324,14 +1347,22 @@ static void kkNeato(Agraph_t * g, int nG, int model)
 	mds_model(g, nG);
     } else
 	shortest_path(g, nG);
-    initial_positions(g, nG);
-    diffeq_model(g, nG);
-    if (Verbose) {
-	fprintf(stderr, "Solving model %d iterations %d tol %f\n",
-		model, MaxIter, Epsilon);
-	start_timer();
-    }
-    solve_model(g, nG);
+    kkSolve(g, nG, model);
+}
+
+/* maxIter:
+ * Return the iteration limit for laying out g.
+ */
+static int maxIter(Agraph_t * g, int layoutMode)
+{
+    char *str;
+
+    if ((str = agget(g, "maxiter")))
+	return atoi(str);
+    else if (layoutMode == MODE_MAJOR)
+	return DFLT_ITERATIONS;
+    else
+	return 100 * agnnodes(g);
 }
 
 /* neatoLayout:
@@ -1342,15 +1373,8 @@ neatoLayout(Agraph_t * mg, Agraph_t * g, int layoutMode, int layoutModel,
   adjust_data* am)
 {
     int nG;
-    char *str;
-
-    if ((str = agget(g, "maxiter")))
-	MaxIter = atoi(str);
-    else if (layoutMode == MODE_MAJOR)
-	MaxIter = DFLT_ITERATIONS;
-    else
-	MaxIter = 100 * agnnodes(g);
 
+    MaxIter = maxIter(g, layoutMode);
     nG = scan_graph_mode(g, layoutMode);
     if ((nG < 2) || (MaxIter < 0))
 	return;
@@ -1402,6 +1426,241 @@ static void doEdges(Agraph_t* g)
     spline_edges0(g, TRUE);
 }
 
+/* finishComp:
+ * Remove overlaps in the layout of component gc and route its edges.
+ */
+static void finishComp(Agraph_t * gc, adjust_data * am, boolean noTranslate)
+{
+    removeOverlapWith(gc, am);
+    setEdgeType (gc, ET_LINE);
+    if (noTranslate) doEdges(gc);
+    else spline_edges(gc);
+}
+
+/* Concurrent layout of components.
+ *
+ * Reading attributes, drawing random numbers, and everything after
+ * placing the nodes stay serial, in component order; only the distance
+ * computation and the solver run on threads. The globals that
+ * scan_graph_mode sets for each component are kept in its job and
+ * restored for the serial steps. The layout is therefore the same as
+ * a serial one, whatever the number of threads.
+ */
+typedef struct {
+    Agraph_t *g;
+    int nG;
+    int maxiter;
+    double epsilon;
+    double damping;
+    double initdist;
+    /* stress majorization */
+    vtx_data *gp;
+    node_t **nodes;
+    int ne;
+    int opts;
+    double **coords;
+    int rv;
+#ifdef HAVE_SRAND48
+    unsigned short rng[3];	/* drand48 state after initialization */
+#endif
+} neato_job;
+
+typedef struct {
+    neato_job *jobs;
+    int *order;			/* jobs by decreasing size */
+    int njobs;
+    int nchunks;
+    int layoutMode;
+    int model;
+} neato_jobs;
+
+/* concurrentLayout:
+ * Return true if the components of g can be laid out concurrently.
+ * This needs more than one thread, and a mode and model whose solver
+ * has no static state and draws no random numbers. For stress
+ * majorization, the state of drand48 must also be saved and restored,
+ * since the nodes are placed after every component is initialized.
+ */
+static int
+concurrentLayout(Agraph_t * g, int n_cc, int layoutMode, int model)
+{
+#ifdef HAVE_SRAND48
+    char *p;
+
+    if ((Nthreads < 2) || (n_cc < 2))
+	return FALSE;
+    if (layoutMode == MODE_KK)
+	return ((model == MODEL_SHORTPATH) || (model == MODEL_MDS));
+    if (layoutMode != MODE_MAJOR)
+	return FALSE;
+    if ((model != MODEL_SHORTPATH) && (model != MODEL_SUBSET)
+	&& (model != MODEL_MDS))
+	return FALSE;
+    /* smart initialization draws random numbers while solving */
+    p = agget(g, "start");
+    return !(p && !strncmp(p, SMART, SLEN(SMART)));
+#else
+    return FALSE;
+#endif
+}
+
+#ifdef HAVE_SRAND48
+/* saveRNG:
+ * Store the state of drand48 in st.
+ */
+static void saveRNG(unsigned short *st)
+{
+    unsigned short *cur = seed48(st);
+
+    memcpy(st, cur, 3 * sizeof(unsigned short));
+    seed48(st);
+}
+#endif
+
+/* prepareJob:
+ * The serial part of laying out component g before its nodes are
+ * placed: everything that reads attributes or random numbers.
+ */
+static void
+prepareJob(neato_job * job, Agraph_t * g, int layoutMode, int model)
+{
+    int i;
+
+    job->g = g;
+    job->maxiter = MaxIter = maxIter(g, layoutMode);
+    job->nG = scan_graph_mode(g, layoutMode);
+    job->epsilon = Epsilon;
+    job->damping = Damping;
+    job->initdist = Initial_dist;
+    if ((job->nG < 2) || (job->maxiter < 0) || (layoutMode == MODE_KK))
+	return;
+
+    checkStart(g, job->nG, INIT_RANDOM);
+    job->opts = checkExp(g) | opt_given_init;
+    job->coords = N_GNEW(Ndim, double *);
+    job->coords[0] = N_GNEW(job->nG * Ndim, double);
+    for (i = 1; i < Ndim; i++)
+	job->coords[i] = job->coords[0] + i * job->nG;
+    job->gp = makeGraphData(g, job->nG, &job->ne, layoutMode, model,
+			    &job->nodes);
+    initLayout(job->gp, job->nG, Ndim, job->coords, job->nodes);
+#ifdef HAVE_SRAND48
+    saveRNG(job->rng);
+#endif
+}
+
+/* solveJobs:
+ * parallel_for work function placing the nodes of the jobs in chunk c.
+ */
+static void solveJobs(void *state, int c, int lo, int hi)
+{
+    neato_jobs *js = (neato_jobs *) state;
+    neato_job *job;
+    int i;
+
+    for (i = c; i < js->njobs; i += js->nchunks) {
+	job = js->jobs + js->order[i];
+	if ((job->nG < 2) || (job->maxiter < 0))
+	    continue;
+	if (js->layoutMode == MODE_KK)
+	    shortest_path_dflt(job->g, job->nG, job->initdist);
+	else
+	    job->rv = stress_majorization_kD_mkernel(job->gp, job->nG,
+						     job->ne, job->coords,
+						     job->nodes, Ndim,
+						     job->opts, js->model,
+						     job->maxiter);
+    }
+}
+
+/* finishJob:
+ * The serial part of laying out a component after solveJobs.
+ */
+static void finishJob(neato_job * job, int layoutMode, int model)
+{
+    Agraph_t *g = job->g;
+    node_t *v;
+    int i;
+
+    MaxIter = job->maxiter;
+    Epsilon = job->epsilon;
+    Damping = job->damping;
+    Initial_dist = job->initdist;
+    if ((job->nG < 2) || (job->maxiter < 0))
+	return;
+
+    if (layoutMode == MODE_KK) {
+	if (model == MODEL_MDS)
+	    mds_model(g, job->nG);
+	kkSolve(g, job->nG, model);
+	return;
+    }
+
+#ifdef HAVE_SRAND48
+    seed48(job->rng);
+#endif
+    if (job->rv < 0)
+	agerr(AGPREV, "layout aborted\n");
+    else for (v = agfstnode(g); v; v = agnxtnode(g, v)) {
+	for (i = 0; i < Ndim; i++)
+	    ND_pos(v)[i] = job->coords[i][ND_id(v)];
+    }
+    freeGraphData(job->gp);
+    free(job->coords[0]);
+    free(job->coords);
+    free(job->nodes);
+}
+
+static neato_job *Jobs;
+
+static int cmpjobs(const void *x, const void *y)
+{
+    int a = *(int *) x, b = *(int *) y;
+
+    if (Jobs[a].nG != Jobs[b].nG)
+	return Jobs[b].nG - Jobs[a].nG;
+    return a - b;
+}
+
+/* neatoLayoutComps:
+ * Lay out the n_cc components cc of g, as the serial loop in
+ * neato_layout does, with the nodes of different components placed
+ * concurrently. The larger components are started first, and the
+ * jobs are dealt to the threads in turn, which balances the load well
+ * when there are many small components.
+ */
+static void
+neatoLayoutComps(Agraph_t * g, Agraph_t ** cc, int n_cc, int layoutMode,
+		 int model, adjust_data * am, boolean noTranslate)
+{
+    neato_jobs js;
+    int i;
+
+    js.jobs = N_NEW(n_cc, neato_job);
+    js.order = N_NEW(n_cc, int);
+    js.njobs = n_cc;
+    js.nchunks = MIN(Nthreads, n_cc);
+    js.layoutMode = layoutMode;
+    js.model = model;
+    for (i = 0; i < n_cc; i++) {
+	nodeInduce(cc[i]);
+	prepareJob(js.jobs + i, cc[i], layoutMode, model);
+	js.order[i] = i;
+    }
+    Jobs = js.jobs;
+    qsort(js.order, n_cc, sizeof(int), cmpjobs);
+    matrix_ops_simd(-1);	/* detect before the threads start */
+
+    parallel_for(n_cc, js.nchunks, solveJobs, &js);
+
+    for (i = 0; i < n_cc; i++) {
+	finishJob(js.jobs + i, layoutMode, model);
+	finishComp(cc[i], am, noTranslate);
+    }
+    free(js.jobs);
+    free(js.order);
+}
+
 /* neato_layout:
  */
 void neato_layout(Agraph_t * g)
@@ -1454,14 +1713,14 @@ void neato_layout(Agraph_t * g)
 
 	    if (n_cc > 1) {
 		boolean *bp;
-		for (i = 0; i < n_cc; i++) {
+		if (concurrentLayout(g, n_cc, layoutMode, model))
+		    neatoLayoutComps(g, cc, n_cc, layoutMode, model, &am,
+				     noTranslate);
+		else for (i = 0; i < n_cc; i++) {
 		    gc = cc[i];
 		    nodeInduce(gc);
 		    neatoLayout(g, gc, layoutMode, model, &am);
-		    removeOverlapWith(gc, &am);
-		    setEdgeType (gc, ET_LINE);
-		    if (noTranslate) doEdges(gc);
-		    else spline_edges(gc);
+		    finishComp(gc, &am, noTranslate);
 		}
 		if (pin) {
 		    bp = N_NEW(n_cc, boolean);
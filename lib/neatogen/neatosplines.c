@@ -535,6 +535,82 @@ void makeSpline(graph_t* g, edge_t * e, Ppoly_t ** obs, int npoly, boolean chkPt
   /* True if either head or tail has a port on its boundary */
 #define BOUNDARY_PORT(e) ((ED_tail_port(e).side)||(ED_head_port(e).side))
 
+/* Lastobs:
+ * The obstacles of the last graph routed by _spline_edges, and their
+ * configuration with the visibility found while routing it. When the next
+ * graph has exactly the same obstacles, i.e., nodes of the same geometry
+ * at the same positions with the same margin, as when a layout is redone
+ * after a change that does not move the nodes, the configuration is
+ * reused and the visibility need not be computed again.
+ */
+static struct {
+    Ppoly_t *obs;
+    int npoly;
+    vconfig_t *vconfig;
+} Lastobs;
+
+/* sameObstacles:
+ * Return true if the npoly obstacles obs are those of Lastobs.
+ */
+static boolean sameObstacles(Ppoly_t ** obs, int npoly)
+{
+    int i;
+
+    if (Lastobs.npoly != npoly)
+	return FALSE;
+    for (i = 0; i < npoly; i++) {
+	if (Lastobs.obs[i].pn != obs[i]->pn)
+	    return FALSE;
+	if (memcmp(Lastobs.obs[i].ps, obs[i]->ps,
+		   obs[i]->pn * sizeof(Ppoint_t)))
+	    return FALSE;
+    }
+    return TRUE;
+}
+
+/* closeObstacles:
+ * Release Lastobs. Registered with gv_atclose, so the cache lasts
+ * until gvFreeContext.
+ */
+static void closeObstacles(void)
+{
+    int i;
+
+    if (Lastobs.vconfig)
+	Pobsclose(Lastobs.vconfig);
+    for (i = 0; i < Lastobs.npoly; i++)
+	free(Lastobs.obs[i].ps);
+    free(Lastobs.obs);
+    Lastobs.vconfig = NULL;
+    Lastobs.obs = NULL;
+    Lastobs.npoly = 0;
+}
+
+/* openObstacles:
+ * Return the configuration of the given obstacles, reusing the last
+ * one if possible. The configuration is kept in Lastobs, and should not
+ * be closed by the caller.
+ */
+static vconfig_t *openObstacles(Ppoly_t ** obs, int npoly)
+{
+    int i;
+
+    if (Lastobs.vconfig && sameObstacles(obs, npoly))
+	return Lastobs.vconfig;
+    closeObstacles();
+    gv_atclose(closeObstacles);
+
+    Lastobs.vconfig = Pobsopen_incremental(obs, npoly);
+    Lastobs.obs = N_NEW(npoly, Ppoly_t);
+    Lastobs.npoly = npoly;
+    for (i = 0; i < npoly; i++) {
+	Lastobs.obs[i].pn = obs[i]->pn;
+	Lastobs.obs[i].ps = N_NEW(obs[i]->pn, Ppoint_t);
+	memcpy(Lastobs.obs[i].ps, obs[i]->ps, obs[i]->pn * sizeof(Ppoint_t));
+    }
+    return Lastobs.vconfig;
+}
+
 /* _spline_edges:
  * Basic default routine for creating edges.
  * If splines are requested, we construct the obstacles.
@@ -580,7 +656,7 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
     npoly = i;
     if (obs) {
 	if ((legal = Plegal_arrangement(obs, npoly))) {
-	    if (edgetype != ET_ORTHO) vconfig = Pobsopen(obs, npoly);
+	    if (edgetype != ET_ORTHO) vconfig = openObstacles(obs, npoly);
 	}
 	else {
 	    if (edgetype == ET_ORTHO)
@@ -667,8 +743,6 @@ static int _spline_edges(graph_t * g, expand_t* pmargin, int edgetype)
 	freeRouter (rtr);
 #endif
 
-    if (vconfig)
-	Pobsclose (vconfig);
     if (P) {
 	free(P->boxes);
 	free(P);
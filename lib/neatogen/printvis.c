@@ -35,6 +35,8 @@ void printvis(vconfig_t * cp)
 
     printf("\n\n");
 
+    if (!arr)
+	return;
     for (i = 0; i < cp->N; i++) {
 	for (j = 0; j < cp->N; j++)
 	    printf("%4.1f ", arr[i][j]);
@@ -21,6 +21,7 @@
 #include "embed_graph.h"
 #include "kkutils.h"
 #include "stress.h"
+#include "parallel.h"
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
@@ -62,6 +63,7 @@ static double compute_stressf(float **coords, float *lap, int dim, int n, int ex
 {
     /* compute the overall stress */
 
+#ifdef Dij2
     int i, j, l, neighbor, count;
     double sum, dist, Dij;
     sum = 0;
@@ -78,13 +80,8 @@ static double compute_stressf(float **coords, float *lap, int dim, int n, int ex
 	    }
 	    dist = sqrt(dist);
 	    if (exp == 2) {
-#ifdef Dij2
 		Dij = 1.0 / sqrt(lap[count]);
 		sum += (Dij - dist) * (Dij - dist) * (lap[count]);
-#else
-		Dij = 1.0 / lap[count];
-		sum += (Dij - dist) * (Dij - dist) * (lap[count]);
-#endif
 	    } else {
 		Dij = 1.0 / lap[count];
 		sum += (Dij - dist) * (Dij - dist) * (lap[count]);
@@ -93,6 +90,10 @@ static double compute_stressf(float **coords, float *lap, int dim, int n, int ex
     }
 
     return sum;
+#else
+    /* the same sum for both values of exp */
+    return stress_packedf(coords, lap, dim, n);
+#endif
 }
 
 static double
@@ -295,6 +296,7 @@ static int sparse_stress_subspace_majorization_kD(vtx_data * graph,	/* Input gra
     int *CenterIndex;
     int *invCenterIndex;	/* list the pivot nodes  */
     Queue Q;
+    DijkstraHeap H;
     float *old_weights;
     /* this matrix stores the distance between  each node and each "center" */
     DistType **Dij;
@@ -360,6 +362,7 @@ static int sparse_stress_subspace_majorization_kD(vtx_data * graph,	/* Input gra
 	/* weight graph to separate high-degree nodes */
 	/* in the future, perform slower Dijkstra-based computation */
 	compute_new_weights(graph, n);
+	mkDijkstraHeap(&H, graph, n);
     }
 
     /* compute sparse distance matrix */
@@ -387,7 +390,7 @@ static int sparse_stress_subspace_majorization_kD(vtx_data * graph,	/* Input gra
     invCenterIndex[0] = node;
 
     if (reweight_graph) {
-	dijkstra(node, graph, n, Dij[0]);
+	dijkstra_h(node, graph, n, Dij[0], &H);
     } else {
 	bfs(node, graph, n, Dij[0], &Q);
     }
@@ -406,7 +409,7 @@ static int sparse_stress_subspace_majorization_kD(vtx_data * graph,	/* Input gra
 	CenterIndex[node] = i;
 	invCenterIndex[i] = node;
 	if (reweight_graph) {
-	    dijkstra(node, graph, n, Dij[i]);
+	    dijkstra_h(node, graph, n, Dij[i], &H);
 	} else {
 	    bfs(node, graph, n, Dij[i], &Q);
 	}
@@ -458,8 +461,8 @@ static int sparse_stress_subspace_majorization_kD(vtx_data * graph,	/* Input gra
 	if (dist_bound > 0) {
 	    if (reweight_graph) {
 		num_visited_nodes =
-		    dijkstra_bounded(i, graph, n, dist, dist_bound,
-				     visited_nodes);
+		    dijkstra_bounded_h(i, graph, n, dist, dist_bound,
+				       visited_nodes, &H);
 	    } else {
 		num_visited_nodes =
 		    bfs_bounded(i, graph, n, dist, &Q, dist_bound,
@@ -511,6 +514,8 @@ static int sparse_stress_subspace_majorization_kD(vtx_data * graph,	/* Input gra
 
     free(dist);
     free(visited_nodes);
+    if (reweight_graph)
+	freeDijkstraHeap(&H);
 
     if (Dij != NULL) {
 	free(Dij[0]);
@@ -707,29 +712,78 @@ finish0:
     return iterations;
 }
 
-/* compute_weighted_apsp_packed:
- * Edge lengths can be any float > 0
+/* State of a threaded all-pairs shortest path computation.
+ * Each source fills its own row of the packed matrix.
  */
-static float *compute_weighted_apsp_packed(vtx_data * graph, int n)
-{
-    int i, j, count;
-    float *Dij = N_NEW(n * (n + 1) / 2, float);
+typedef struct {
+    vtx_data *graph;
+    int n;
+    float *Dij;
+    boolean weighted;
+} apsp_t;
 
-    float *Di = N_NEW(n, float);
+/* apsp_rows:
+ * Fill rows lo..hi-1 of the packed matrix, using a distance vector
+ * and queue private to the chunk.
+ */
+static void apsp_rows(void *state, int chunk, int lo, int hi)
+{
+    apsp_t *s = (apsp_t *) state;
+    vtx_data *graph = s->graph;
+    int i, j, n = s->n;
+    float *row = s->Dij + ((long) lo * (2 * n - lo + 1)) / 2;
+    float *Df = NULL;
+    DistType *Di = NULL;
     Queue Q;
 
-    mkQueue(&Q, n);
-
-    count = 0;
-    for (i = 0; i < n; i++) {
-	dijkstra_f(i, graph, n, Di);
-	for (j = i; j < n; j++) {
-	    Dij[count++] = Di[j];
+    if (s->weighted)
+	Df = N_GNEW(n, float);
+    else {
+	Di = N_GNEW(n, DistType);
+	mkQueue(&Q, n);
+    }
+    for (i = lo; i < hi; i++) {
+	if (s->weighted) {
+	    dijkstra_f(i, graph, n, Df);
+	    for (j = i; j < n; j++)
+		*row++ = Df[j];
+	} else {
+	    bfs(i, graph, n, Di, &Q);
+	    for (j = i; j < n; j++)
+		*row++ = ((float) Di[j]);
 	}
     }
-    free(Di);
-    freeQueue(&Q);
-    return Dij;
+    if (s->weighted)
+	free(Df);
+    else {
+	free(Di);
+	freeQueue(&Q);
+    }
+}
+
+/* apsp_packed:
+ * Packed matrix of shortest path lengths, with the sources split
+ * over Nthreads threads. The result does not depend on the number
+ * of threads.
+ */
+static float *apsp_packed(vtx_data * graph, int n, boolean weighted)
+{
+    apsp_t s;
+
+    s.graph = graph;
+    s.n = n;
+    s.Dij = N_NEW(n * (n + 1) / 2, float);
+    s.weighted = weighted;
+    parallel_for(n, MAX(1, MIN(Nthreads, n)), apsp_rows, &s);
+    return s.Dij;
+}
+
+/* compute_weighted_apsp_packed:
+ * Edge lengths can be any float > 0
+ */
+float *compute_weighted_apsp_packed(vtx_data * graph, int n)
+{
+    return apsp_packed(graph, n, TRUE);
 }
 
 
@@ -771,24 +825,7 @@ float *mdsModel(vtx_data * graph, int nG)
  */
 float *compute_apsp_packed(vtx_data * graph, int n)
 {
-    int i, j, count;
-    float *Dij = N_NEW(n * (n + 1) / 2, float);
-
-    DistType *Di = N_NEW(n, DistType);
-    Queue Q;
-
-    mkQueue(&Q, n);
-
-    count = 0;
-    for (i = 0; i < n; i++) {
-	bfs(i, graph, n, Di, &Q);
-	for (j = i; j < n; j++) {
-	    Dij[count++] = ((float) Di[j]);
-	}
-    }
-    free(Di);
-    freeQueue(&Q);
-    return Dij;
+    return apsp_packed(graph, n, FALSE);
 }
 
 #define max(x,y) ((x)>(y)?(x):(y))
@@ -878,6 +915,376 @@ static void dumpMatrix(float *Dij, int n)
 }
 #endif
 
+/* smartLayout:
+ * Initial layout from a quick optimization within a subspace:
+ * at most 50 iterations within 30-D subspace to get an estimate.
+ * Return < 0 on failure.
+ */
+static int smartLayout(vtx_data * graph, int n, int nedges_graph,
+		       double **d_coords, int dim, int exp, int reweight)
+{
+    int i, j;
+
+    if (sparse_stress_subspace_majorization_kD(graph, n, nedges_graph,
+					       d_coords, dim, TRUE, exp,
+					       reweight, 50,
+					       neighborhood_radius_subspace,
+					       num_pivots_stress) < 0)
+	return -1;
+
+    for (i = 0; i < dim; i++) {
+	/* for numerical stability, scale down layout */
+	double max = 1;
+	for (j = 0; j < n; j++) {
+	    if (fabs(d_coords[i][j]) > max) {
+		max = fabs(d_coords[i][j]);
+	    }
+	}
+	for (j = 0; j < n; j++) {
+	    d_coords[i][j] /= max;
+	}
+	/* add small random noise */
+	for (j = 0; j < n; j++) {
+	    d_coords[i][j] += 1e-6 * (drand48() - 0.5);
+	}
+	orthog1(n, d_coords[i]);
+    }
+    return 0;
+}
+
+/* pivotDistances:
+ * Distances from node to all nodes, stored in dist.
+ * Unreachable nodes are put 10 beyond the farthest reachable one.
+ */
+static void
+pivotDistances(vtx_data * graph, int n, int node, float *dist,
+	       DistType * idist, Queue * Q)
+{
+    int i;
+    float max_dist = 0;
+
+    if (graph->ewgts) {
+	dijkstra_f(node, graph, n, dist);
+	for (i = 0; i < n; i++)
+	    if ((dist[i] < MAXFLOAT) && (dist[i] > max_dist))
+		max_dist = dist[i];
+	for (i = 0; i < n; i++)
+	    if (dist[i] == MAXFLOAT)
+		dist[i] = max_dist + 10;
+    } else {
+	bfs(node, graph, n, idist, Q);
+	for (i = 0; i < n; i++)
+	    dist[i] = (float) idist[i];
+    }
+}
+
+/* sparseDistances:
+ * Build the target distances of the sparse stress model, as a graph
+ * whose ewgts are the distances. Node i is paired with
+ *  - every node, if i is a pivot, and otherwise
+ *  - the non-pivot nodes within radius hops of i, and all pivots.
+ * The pairs are symmetric. Pivots are chosen by max-min selection, so they
+ * are spread over the graph. Space is O(n*(num_pivots + neighborhood size)).
+ */
+static vtx_data *sparseDistances(vtx_data * graph, int n, int num_pivots,
+				 int radius)
+{
+    vtx_data *dg;
+    int *pivot;			/* index of each node among the pivots, or -1 */
+    int *pivots;		/* the pivot nodes */
+    float **Dp;			/* distances from each pivot */
+    float *mindist, max_dist;
+    float *fdist = NULL;
+    DistType *idist;
+    int *visited;
+    int *start, *edges;
+    float *ewgts;
+    int i, j, p, node, nvisited, nentries, maxentries;
+    Queue Q;
+    DijkstraFHeap fh;
+
+    mkQueue(&Q, n);
+    idist = N_GNEW(n, DistType);
+    pivot = N_GNEW(n, int);
+    for (i = 0; i < n; i++)
+	pivot[i] = -1;
+    pivots = N_GNEW(num_pivots, int);
+    Dp = N_GNEW(num_pivots, float *);
+    Dp[0] = N_GNEW(num_pivots * n, float);
+    for (p = 1; p < num_pivots; p++)
+	Dp[p] = Dp[0] + p * n;
+
+    /* the first pivot is selected randomly; each following one is
+     * the node farthest from those already selected
+     */
+    mindist = N_GNEW(n, float);
+    node = (int) (drand48() * n) % n;
+    for (p = 0; p < num_pivots; p++) {
+	pivot[node] = p;
+	pivots[p] = node;
+	pivotDistances(graph, n, node, Dp[p], idist, &Q);
+	max_dist = -1;
+	for (j = 0; j < n; j++) {
+	    if ((p == 0) || (Dp[p][j] < mindist[j]))
+		mindist[j] = Dp[p][j];
+	    if ((pivot[j] < 0) && (mindist[j] > max_dist)) {
+		node = j;
+		max_dist = mindist[j];
+	    }
+	}
+    }
+    free(mindist);
+
+    /* rows are built one after the other; entry 0 of each is the node */
+    for (i = 0; i < n; i++)
+	idist[i] = -1;
+    visited = N_GNEW(n, int);
+    if (graph->ewgts) {
+	fdist = N_GNEW(n, float);
+	mkDijkstraFHeap(&fh, n);
+    }
+    start = N_GNEW(n + 1, int);
+    maxentries = n * (num_pivots + 2);
+    edges = N_GNEW(maxentries, int);
+    ewgts = N_GNEW(maxentries, float);
+    nentries = 0;
+    for (i = 0; i < n; i++) {
+	start[i] = nentries;
+	if (pivot[i] >= 0) {
+	    nvisited = 0;
+	} else if (graph->ewgts) {
+	    nvisited =
+		dijkstra_bounded_fh(i, graph, n, fdist, radius, visited, &fh);
+	} else {
+	    nvisited = bfs_bounded(i, graph, n, idist, &Q, radius, visited);
+	}
+	if (nentries + n + nvisited + 1 > maxentries) {
+	    maxentries = MAX(2 * maxentries, nentries + n + nvisited + 1);
+	    edges = RALLOC(maxentries, edges, int);
+	    ewgts = RALLOC(maxentries, ewgts, float);
+	}
+	edges[nentries] = i;
+	ewgts[nentries++] = 0;
+	if (pivot[i] >= 0) {
+	    p = pivot[i];
+	    for (j = 0; j < n; j++) {
+		if (j == i)
+		    continue;
+		edges[nentries] = j;
+		ewgts[nentries++] = Dp[p][j];
+	    }
+	    continue;
+	}
+	for (j = 0; j < nvisited; j++) {
+	    node = visited[j];
+	    if ((node != i) && (pivot[node] < 0)) {
+		edges[nentries] = node;
+		ewgts[nentries++] = (fdist ? fdist[node] : (float) idist[node]);
+	    }
+	    idist[node] = -1;
+	}
+	for (p = 0; p < num_pivots; p++) {
+	    edges[nentries] = pivots[p];
+	    ewgts[nentries++] = Dp[p][i];
+	}
+    }
+    start[n] = nentries;
+
+    dg = N_GNEW(n, vtx_data);
+    for (i = 0; i < n; i++) {
+	dg[i].nedges = start[i + 1] - start[i];
+	dg[i].edges = edges + start[i];
+	dg[i].ewgts = ewgts + start[i];
+	dg[i].eweights = NULL;
+    }
+
+    free(start);
+    free(visited);
+    if (fdist) {
+	free(fdist);
+	freeDijkstraFHeap(&fh);
+    }
+    free(Dp[0]);
+    free(Dp);
+    free(pivots);
+    free(pivot);
+    free(idist);
+    freeQueue(&Q);
+    return dg;
+}
+
+/* sparse_stress_majorization_kD:
+ * Stress majorization over a sparse set of node pairs (model=sparse):
+ * exact distances between nodes at most neighborhood_radius_unrestricted
+ * hops apart, and the distances between all nodes and num_pivots_stress
+ * pivots. Unlike stress_majorization_kD_mkernel, which uses all n^2
+ * distances, space is linear in n, so it can be used on large graphs.
+ */
+static int sparse_stress_majorization_kD(vtx_data * graph, int n,
+					 int nedges_graph,
+					 double **d_coords,
+					 node_t ** nodes, int dim,
+					 int opts, int maxi)
+{
+    int iterations;
+    double conj_tol = tolerance_cg;
+    int smart_ini = opts & opt_smart_init;
+    int exp = opts & opt_exp_flag;
+    int havePinned;
+    vtx_data *dg = NULL;	/* target distances */
+    vtx_data *lap = NULL;	/* weighted Laplacian */
+    float *lap_ewgts = NULL;
+    double **b = NULL;
+    double *tmp_coords = NULL;
+    CGWorkspace *ws = NULL;
+    double degree, dist_ij, d, w, L_ij, old_stress, new_stress;
+    boolean converged;
+    int i, j, k, node, nentries;
+
+    if (maxi < 0)
+	return 0;
+
+    if (Verbose) {
+	fprintf(stderr, "Calculating sparse distances");
+	start_timer();
+    }
+    dg = sparseDistances(graph, n, MIN(n, num_pivots_stress),
+			 neighborhood_radius_unrestricted);
+
+    if (Verbose) {
+	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
+	fprintf(stderr, "Setting initial positions");
+	start_timer();
+    }
+    if (smart_ini && (n > 1)) {
+	havePinned = 0;
+	if (smartLayout(graph, n, nedges_graph, d_coords, dim, exp, FALSE) < 0) {
+	    iterations = -1;
+	    goto finish;
+	}
+    } else {
+	havePinned = initLayout(graph, n, dim, d_coords, nodes);
+    }
+    if (Verbose)
+	fprintf(stderr, ": %.2f sec\n", elapsed_sec());
+    if ((n == 1) || (maxi == 0)) {
+	iterations = 0;
+	goto finish;
+    }
+
+    /* Laplacian with weights w_ij = d_ij^-exp */
+    nentries = dg[n - 1].edges + dg[n - 1].nedges - dg[0].edges;
+    lap = N_GNEW(n, vtx_data);
+    lap_ewgts = N_GNEW(nentries, float);
+    for (i = 0; i < n; i++) {
+	lap[i].nedges = dg[i].nedges;
+	lap[i].edges = dg[i].edges;
+	lap[i].ewgts = lap_ewgts + (dg[i].edges - dg[0].edges);
+	lap[i].eweights = NULL;
+	degree = 0;
+	for (j = 1; j < dg[i].nedges; j++) {
+	    d = dg[i].ewgts[j];
+	    if (d <= 0)
+		w = 0;
+	    else if (exp == 2)
+		w = 1.0 / (d * d);
+	    else
+		w = 1.0 / d;
+	    lap[i].ewgts[j] = (float) -w;
+	    degree += w;
+	}
+	lap[i].ewgts[0] = (float) degree;
+    }
+    /* lap is fixed, so its preconditioner is built once */
+    ws = newSparseCGWorkspace(lap, n, CG_PRECON_ICHOL);
+
+    b = N_NEW(dim, double *);
+    b[0] = N_NEW(dim * n, double);
+    for (k = 1; k < dim; k++)
+	b[k] = b[0] + k * n;
+    tmp_coords = N_NEW(n, double);
+
+    if (Verbose) {
+	fprintf(stderr, "Solving model: ");
+	start_timer();
+    }
+    old_stress = MAXDOUBLE;
+    for (converged = FALSE, iterations = 0;
+	 iterations < maxi && !converged; iterations++) {
+
+	/* b := L^Z(x) x, and the stress of the current layout */
+	new_stress = 0;
+	for (i = 0; i < n; i++) {
+	    for (k = 0; k < dim; k++)
+		b[k][i] = 0;
+	    for (j = 1; j < dg[i].nedges; j++) {
+		node = dg[i].edges[j];
+		d = dg[i].ewgts[j];
+		w = -lap[i].ewgts[j];
+		dist_ij = distance_kD(d_coords, dim, i, node);
+		new_stress += w * (dist_ij - d) * (dist_ij - d);
+		if (dist_ij > 1e-30) {	/* skip zero distances */
+		    L_ij = w * d / dist_ij;
+		    for (k = 0; k < dim; k++)
+			b[k][i] += L_ij * (d_coords[k][i] - d_coords[k][node]);
+		}
+	    }
+	}
+	new_stress /= 2;	/* each pair appears twice */
+
+	{
+	    double diff = old_stress - new_stress;
+	    double change = ABS(diff);
+	    converged = (((change / old_stress) < Epsilon)
+			 || (new_stress < Epsilon));
+	}
+	old_stress = new_stress;
+
+	for (k = 0; k < dim; k++) {
+	    if (havePinned) {
+		copy_vector(n, d_coords[k], tmp_coords);
+		if (conjugate_gradient_precon(lap, tmp_coords, b[k], n,
+					      conj_tol, n, ws)) {
+		    iterations = -1;
+		    goto finish;
+		}
+		for (i = 0; i < n; i++) {
+		    if (!isFixed(nodes[i]))
+			d_coords[k][i] = tmp_coords[i];
+		}
+	    } else {
+		if (conjugate_gradient_precon(lap, d_coords[k], b[k], n,
+					      conj_tol, n, ws)) {
+		    iterations = -1;
+		    goto finish;
+		}
+	    }
+	}
+	if (Verbose && (iterations % 5 == 0)) {
+	    fprintf(stderr, "%.3f ", new_stress);
+	    if ((iterations + 5) % 50 == 0)
+		fprintf(stderr, "\n");
+	}
+    }
+    if (Verbose)
+	fprintf(stderr, "\nfinal e = %f %d iterations %.2f sec\n",
+		old_stress, iterations, elapsed_sec());
+
+  finish:
+    if (b) {
+	free(b[0]);
+	free(b);
+    }
+    free(tmp_coords);
+    freeCGWorkspace(ws);
+    free(lap_ewgts);
+    free(lap);
+    free(dg[0].edges);
+    free(dg[0].ewgts);
+    free(dg);
+    return iterations;
+}
+
 /* Accumulator type for diagonal of Laplacian. Needs to be as large
  * as possible. Use long double; configure to double if necessary.
  */
@@ -916,6 +1323,8 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
     boolean converged;
     float **b = NULL;
     float *tmp_coords = NULL;
+    float **solution = NULL;
+    CGWorkspace *ws = NULL;
     float *dist_accumulator = NULL;
     float *lap1 = NULL;
     int smart_ini = opts & opt_smart_init;
@@ -942,6 +1351,10 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
     if (maxi < 0)
 	return 0;
 
+    if (model == MODEL_SPARSE)
+	return sparse_stress_majorization_kD(graph, n, nedges_graph,
+					     d_coords, nodes, dim, opts, maxi);
+
     if (Verbose)
 	start_timer();
 
@@ -985,35 +1398,15 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
 
     if (smart_ini && (n > 1)) {
 	havePinned = 0;
-	/* optimize layout quickly within subspace */
-	/* perform at most 50 iterations within 30-D subspace to 
-	   get an estimate */
-	if (sparse_stress_subspace_majorization_kD(graph, n, nedges_graph,
-					       d_coords, dim, smart_ini, exp,
-					       (model == MODEL_SUBSET), 50,
-					       neighborhood_radius_subspace,
-					       num_pivots_stress) < 0) {
+	if (smartLayout(graph, n, nedges_graph, d_coords, dim, exp,
+			(model == MODEL_SUBSET)) < 0) {
 	    iterations = -1;
 	    goto finish1;
 	}
-
-	for (i = 0; i < dim; i++) {
-	    /* for numerical stability, scale down layout */
-	    double max = 1;
-	    for (j = 0; j < n; j++) {
-		if (fabs(d_coords[i][j]) > max) {
-		    max = fabs(d_coords[i][j]);
-		}
-	    }
-	    for (j = 0; j < n; j++) {
-		d_coords[i][j] /= max;
-	    }
-	    /* add small random noise */
-	    for (j = 0; j < n; j++) {
-		d_coords[i][j] += 1e-6 * (drand48() - 0.5);
-	    }
-	    orthog1(n, d_coords[i]);
-	}
+    } else if (opts & opt_given_init) {
+	for (havePinned = 0, i = 0; i < n; i++)
+	    if (isFixed(nodes[i]))
+		havePinned = 1;
     } else {
 	havePinned = initLayout(graph, n, dim, d_coords, nodes);
     }
@@ -1114,6 +1507,12 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
     }
 
     tmp_coords = N_NEW(n, float);
+    if (havePinned) {
+	solution = N_NEW(dim, float *);
+	solution[0] = N_NEW(dim * n, float);
+	for (k = 1; k < dim; k++)
+	    solution[k] = solution[0] + k * n;
+    }
     dist_accumulator = N_NEW(n, float);
     lap1 = NULL;
 #ifdef NONCORE
@@ -1255,26 +1654,31 @@ int stress_majorization_kD_mkernel(vtx_data * graph,	/* Input graph in sparse re
 	}
 	old_stress = new_stress;
 
-	for (k = 0; k < dim; k++) {
-	    node_t *np;
-	    if (havePinned) {
-		copy_vectorf(n, coords[k], tmp_coords);
-		if (conjugate_gradient_mkernel(lap2, tmp_coords, b[k], n,
-					   conj_tol, n) < 0) {
-		    iterations = -1;
-		    goto finish1;
-		}
-		for (i = 0; i < n; i++) {
-		    np = nodes[i];
-		    if (!isFixed(np))
-			coords[k][i] = tmp_coords[i];
-		}
-	    } else {
-		if (conjugate_gradient_mkernel(lap2, coords[k], b[k], n,
-					   conj_tol, n) < 0) {
-		    iterations = -1;
-		    goto finish1;
-		}
+	/* lap2 is fixed, so its preconditioner is built once and all
+	 * coordinates are solved for together.
+	 */
+	if (!ws)
+	    ws = newCGWorkspace(lap2, n, dim, (opts & opt_precon) ?
+				 CG_PRECON_ICHOL : CG_PRECON_NONE);
+	if (havePinned) {
+	    for (k = 0; k < dim; k++)
+		copy_vectorf(n, coords[k], solution[k]);
+	    if (conjugate_gradient_mkernel_block(lap2, solution, b, dim, n,
+						 conj_tol, n, ws) < 0) {
+		iterations = -1;
+		goto finish1;
+	    }
+	    for (i = 0; i < n; i++) {
+		if (isFixed(nodes[i]))
+		    continue;
+		for (k = 0; k < dim; k++)
+		    coords[k][i] = solution[k][i];
+	    }
+	} else {
+	    if (conjugate_gradient_mkernel_block(lap2, coords, b, dim, n,
+						 conj_tol, n, ws) < 0) {
+		iterations = -1;
+		goto finish1;
 	    }
 	}
 	if (Verbose && (iterations % 5 == 0)) {
@@ -1308,6 +1712,11 @@ finish1:
 	free(b);
     }
     free(tmp_coords);
+    if (solution) {
+	free(solution[0]);
+	free(solution);
+    }
+    freeCGWorkspace(ws);
     free(dist_accumulator);
     free(degrees);
     free(lap1);
@@ -41,7 +41,9 @@ extern "C" {
 #define neighborhood_radius_subspace 0
 
 #define opt_smart_init 0x4
+#define opt_given_init 0x8	/* coords already set by initLayout */
 #define opt_exp_flag   0x3
+#define opt_precon     0x10	/* precondition conjugate gradient solves */
 
     /* Full dense stress optimization (equivalent to Kamada-Kawai's energy) */
     /* Slowest and most accurate optimization */
@@ -57,6 +59,7 @@ extern "C" {
 	);
 
 extern float *compute_apsp_packed(vtx_data * graph, int n);
+extern float *compute_weighted_apsp_packed(vtx_data * graph, int n);
 extern float *compute_apsp_artifical_weights_packed(vtx_data * graph, int n);
 extern float* circuitModel(vtx_data * graph, int nG);
 extern float* mdsModel (vtx_data * graph, int nG);
@@ -591,99 +591,91 @@ void move_node(graph_t * G, int nG, node_t * n)
     }
 }
 
-static node_t **Heap;
-static int Heapsize;
-static node_t *Src;
+/* nodeheap:
+ * Priority queue of nodes, keyed on ND_dist. Each shortest path
+ * computation has its own, so components can be done concurrently.
+ */
+typedef struct {
+    node_t **data;
+    int size;
+} nodeheap;
 
-void heapup(node_t * v)
+static void heapup(nodeheap * h, node_t * v)
 {
     int i, par;
     node_t *u;
 
     for (i = ND_heapindex(v); i > 0; i = par) {
 	par = (i - 1) / 2;
-	u = Heap[par];
+	u = h->data[par];
 	if (ND_dist(u) <= ND_dist(v))
 	    break;
-	Heap[par] = v;
+	h->data[par] = v;
 	ND_heapindex(v) = par;
-	Heap[i] = u;
+	h->data[i] = u;
 	ND_heapindex(u) = i;
     }
 }
 
-void heapdown(node_t * v)
+static void heapdown(nodeheap * h, node_t * v)
 {
     int i, left, right, c;
     node_t *u;
 
     i = ND_heapindex(v);
-    while ((left = 2 * i + 1) < Heapsize) {
+    while ((left = 2 * i + 1) < h->size) {
 	right = left + 1;
-	if ((right < Heapsize)
-	    && (ND_dist(Heap[right]) < ND_dist(Heap[left])))
+	if ((right < h->size)
+	    && (ND_dist(h->data[right]) < ND_dist(h->data[left])))
 	    c = right;
 	else
 	    c = left;
-	u = Heap[c];
+	u = h->data[c];
 	if (ND_dist(v) <= ND_dist(u))
 	    break;
-	Heap[c] = v;
+	h->data[c] = v;
 	ND_heapindex(v) = c;
-	Heap[i] = u;
+	h->data[i] = u;
 	ND_heapindex(u) = i;
 	i = c;
     }
 }
 
-void neato_enqueue(node_t * v)
+static void neato_enqueue(nodeheap * h, node_t * v)
 {
     int i;
 
     assert(ND_heapindex(v) < 0);
-    i = Heapsize++;
+    i = h->size++;
     ND_heapindex(v) = i;
-    Heap[i] = v;
+    h->data[i] = v;
     if (i > 0)
-	heapup(v);
+	heapup(h, v);
 }
 
-node_t *neato_dequeue(void)
+static node_t *neato_dequeue(nodeheap * h)
 {
     int i;
     node_t *rv, *v;
 
-    if (Heapsize == 0)
+    if (h->size == 0)
 	return NULL;
-    rv = Heap[0];
-    i = --Heapsize;
-    v = Heap[i];
-    Heap[0] = v;
+    rv = h->data[0];
+    i = --h->size;
+    v = h->data[i];
+    h->data[0] = v;
     ND_heapindex(v) = 0;
     if (i > 1)
-	heapdown(v);
+	heapdown(h, v);
     ND_heapindex(rv) = -1;
     return rv;
 }
 
-void shortest_path(graph_t * G, int nG)
-{
-    node_t *v;
-
-    Heap = N_NEW(nG + 1, node_t *);
-    if (Verbose) {
-	fprintf(stderr, "Calculating shortest paths: ");
-	start_timer();
-    }
-    for (v = agfstnode(G); v; v = agnxtnode(G, v))
-	s1(G, v);
-    if (Verbose) {
-	fprintf(stderr, "%.2f sec\n", elapsed_sec());
-    }
-    free(Heap);
-}
-
-void s1(graph_t * G, node_t * node)
+/* s1:
+ * Set the distances from node to every node of G, starting from
+ * the default distance dflt.
+ */
+static void s1(nodeheap * h, graph_t * G, node_t * node, double dflt)
 {
     node_t *v, *u;
     edge_t *e;
@@ -691,15 +683,14 @@ void s1(graph_t * G, node_t * node)
     double f;
 
     for (t = 0; (v = GD_neato_nlist(G)[t]); t++)
-	ND_dist(v) = Initial_dist;
-    Src = node;
-    ND_dist(Src) = 0;
-    ND_hops(Src) = 0;
-    neato_enqueue(Src);
-
-    while ((v = neato_dequeue())) {
-	if (v != Src)
-	    make_spring(G, Src, v, ND_dist(v));
+	ND_dist(v) = dflt;
+    ND_dist(node) = 0;
+    ND_hops(node) = 0;
+    neato_enqueue(h, node);
+
+    while ((v = neato_dequeue(h))) {
+	if (v != node)
+	    make_spring(G, node, v, ND_dist(v));
 	for (e = agfstedge(G, v); e; e = agnxtedge(G, e, v)) {
 	    if ((u = agtail(e)) == v)
 		u = aghead(e);
@@ -707,16 +698,45 @@ void s1(graph_t * G, node_t * node)
 	    if (ND_dist(u) > f) {
 		ND_dist(u) = f;
 		if (ND_heapindex(u) >= 0)
-		    heapup(u);
+		    heapup(h, u);
 		else {
 		    ND_hops(u) = ND_hops(v) + 1;
-		    neato_enqueue(u);
+		    neato_enqueue(h, u);
 		}
 	    }
 	}
     }
 }
 
+/* shortest_path_dflt:
+ * Fill in GD_dist(G) with the shortest path lengths, where dflt is
+ * the distance between nodes with no path. Only G and its nodes are
+ * modified, so this may run concurrently on disjoint subgraphs.
+ */
+void shortest_path_dflt(graph_t * G, int nG, double dflt)
+{
+    node_t *v;
+    nodeheap h;
+
+    h.data = N_NEW(nG + 1, node_t *);
+    h.size = 0;
+    if (Verbose) {
+	fprintf(stderr, "Calculating shortest paths: ");
+	start_timer();
+    }
+    for (v = agfstnode(G); v; v = agnxtnode(G, v))
+	s1(&h, G, v, dflt);
+    if (Verbose) {
+	fprintf(stderr, "%.2f sec\n", elapsed_sec());
+    }
+    free(h.data);
+}
+
+void shortest_path(graph_t * G, int nG)
+{
+    shortest_path_dflt(G, nG, Initial_dist);
+}
+
 void make_spring(graph_t * G, node_t * u, node_t * v, double f)
 {
     int i, j;
@@ -125,14 +125,15 @@ layout (Agraph_t* g, int depth)
     if (pmode < l_graph) pinfo.mode = l_graph;
 
         /* add user sort values if necessary */
-    if ((pinfo.mode == l_array) && (pinfo.flags & PK_USER_VALS)) {
+    if (((pinfo.mode == l_array) || (pinfo.mode == l_skyline)) &&
+	(pinfo.flags & PK_USER_VALS)) {
 	cattr = agattr(root, AGRAPH, "sortv", 0);
 	vattr = agattr(root, AGNODE, "sortv", 0);
 	if (cattr || vattr)
 	    pinfo.vals = N_NEW(total, packval_t);
 	else
-	    agerr (AGWARN, "Graph %s has array packing with user values but no \"sortv\" attributes are defined.",
-		agnameof(g));
+	    agerr (AGWARN, "Graph %s has %s packing with user values but no \"sortv\" attributes are defined.",
+		agnameof(g), (pinfo.mode == l_array ? "array" : "skyline"));
     }
 
     gs = N_NEW(total, boxf);
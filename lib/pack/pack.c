@@ -19,6 +19,8 @@
 
 #include <math.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 #include "render.h"
 #include "pack.h"
 #include "pointset.h"
@@ -36,13 +38,37 @@
 /* Given grid cell size s, CELL(p:point,s:int) sets p to cell containing point p */
 #define CELL(p,s) ((p).x = CVAL((p).x,s), (p).y = CVAL((p).y,(s)))
 
+typedef struct {
+    int y;			/* row */
+    int x0, x1;			/* first and last column */
+} cellrun;
+
 typedef struct {
     int perim;			/* half size of bounding rectangle perimeter */
     point *cells;		/* cells in covering polyomino */
     int nc;			/* no. of cells */
+    cellrun *runs;		/* cells as horizontal runs, sorted by row */
+    int nr;			/* no. of runs */
+    point LL, UR;		/* cell bounding box */
     int index;			/* index in original array */
 } ginfo;
 
+/* Set of occupied cells, kept as bitmaps over a rectangle of the grid.
+ * The bits are stored both by row and by column, so free cells can be
+ * found a word at a time along either direction. Cells outside the
+ * rectangle are free.
+ */
+typedef uint64_t cellword;
+#define WBITS 64
+
+typedef struct {
+    int x0, y0;			/* lower left cell */
+    int w, h;			/* size in cells */
+    int rw, cw;			/* words per row and per column */
+    cellword *rows;		/* h rows of rw words */
+    cellword *cols;		/* w columns of cw words */
+} cellmap;
+
 typedef struct {
     double width, height;
     int index;			/* index in original array */
@@ -219,6 +245,54 @@ fillEdge(Agedge_t * e, point p, PointSet * ps, int dx, int dy,
 
 }
 
+/* cellcmpf:
+ * Order cells by row, then column.
+ */
+static int cellcmpf(const void *X, const void *Y)
+{
+    point *x = (point *) X;
+    point *y = (point *) Y;
+
+    if (x->y != y->y)
+	return (x->y < y->y ? -1 : 1);
+    if (x->x != y->x)
+	return (x->x < y->x ? -1 : 1);
+    return 0;
+}
+
+/* genRuns:
+ * Convert the cells of a polyomino into horizontal runs, and
+ * compute its cell bounding box.
+ */
+static void genRuns(ginfo * info)
+{
+    point *cells = info->cells;
+    int n = info->nc;
+    cellrun *r;
+    int i;
+
+    info->nr = 0;
+    info->runs = r = N_NEW(MAX(n, 1), cellrun);
+    if (n == 0)
+	return;
+    qsort(cells, n, sizeof(point), cellcmpf);
+    info->LL = info->UR = cells[0];
+    for (i = 0; i < n; i++) {
+	if (i && (cells[i].y == r->y) && (cells[i].x == r->x1 + 1))
+	    r->x1++;
+	else {
+	    if (i)
+		r++;
+	    r->y = cells[i].y;
+	    r->x0 = r->x1 = cells[i].x;
+	}
+	info->LL.x = MIN(info->LL.x, cells[i].x);
+	info->UR.x = MAX(info->UR.x, cells[i].x);
+    }
+    info->UR.y = cells[n - 1].y;
+    info->nr = r - info->runs + 1;
+}
+
 /* genBox:
  * Generate polyomino info from graph using the bounding box of
  * the graph.
@@ -248,6 +322,7 @@ genBox(boxf bb0, ginfo * info, int ssize, int margin, point center, char* s)
 
     info->cells = pointsOf(ps);
     info->nc = sizeOf(ps);
+    genRuns(info);
     W = GRID(bb0.UR.x - bb0.LL.x + 2 * margin, ssize);
     H = GRID(bb0.UR.y - bb0.LL.y + 2 * margin, ssize);
     info->perim = W + H;
@@ -398,6 +473,7 @@ genPoly(Agraph_t * root, Agraph_t * g, ginfo * info,
 
     info->cells = pointsOf(ps);
     info->nc = sizeOf(ps);
+    genRuns(info);
     W = GRID(GD_bb(g).UR.x - GD_bb(g).LL.x + 2 * margin, ssize);
     H = GRID(GD_bb(g).UR.y - GD_bb(g).LL.y + 2 * margin, ssize);
     info->perim = W + H;
@@ -415,68 +491,298 @@ genPoly(Agraph_t * root, Agraph_t * g, ginfo * info,
     return 0;
 }
 
+/* ctz, clz:
+ * Number of trailing and leading zero bits of a non-zero word.
+ */
+#if defined(__GNUC__)
+#define ctz(w) __builtin_ctzll(w)
+#define clz(w) __builtin_clzll(w)
+#else
+static int ctz(cellword w)
+{
+    int n = 0;
+    while (!(w & 1)) {
+	w >>= 1;
+	n++;
+    }
+    return n;
+}
+
+static int clz(cellword w)
+{
+    int n = 0;
+    while (!(w >> (WBITS - 1))) {
+	w <<= 1;
+	n++;
+    }
+    return n;
+}
+#endif
+
+#define SETBIT(line,i) ((line)[(i) / WBITS] |= (cellword) 1 << ((i) % WBITS))
+
+static void initMap(cellmap * map)
+{
+    memset(map, 0, sizeof(cellmap));
+}
+
+static void freeMap(cellmap * map)
+{
+    free(map->rows);
+    free(map->cols);
+}
+
+/* growMap:
+ * Make sure the map covers the cells from LL to UR, at least doubling
+ * its size when it has to grow, and copy the occupied cells.
+ */
+static void growMap(cellmap * map, point LL, point UR)
+{
+    cellmap nmap;
+    cellword wd, *line;
+    int x, y, i, dw, dh;
+
+    if (map->rows && (LL.x >= map->x0) && (LL.y >= map->y0) &&
+	(UR.x < map->x0 + map->w) && (UR.y < map->y0 + map->h))
+	return;
+
+    if (map->rows) {
+	LL.x = MIN(LL.x, map->x0);
+	LL.y = MIN(LL.y, map->y0);
+	UR.x = MAX(UR.x, map->x0 + map->w - 1);
+	UR.y = MAX(UR.y, map->y0 + map->h - 1);
+    }
+    dw = (UR.x - LL.x + 1) / 2 + 1;
+    dh = (UR.y - LL.y + 1) / 2 + 1;
+    nmap.x0 = LL.x - dw;
+    nmap.y0 = LL.y - dh;
+    nmap.w = UR.x - LL.x + 1 + 2 * dw;
+    nmap.h = UR.y - LL.y + 1 + 2 * dh;
+    nmap.rw = (nmap.w + WBITS - 1) / WBITS;
+    nmap.cw = (nmap.h + WBITS - 1) / WBITS;
+    nmap.rows = N_NEW((size_t) nmap.h * nmap.rw, cellword);
+    nmap.cols = N_NEW((size_t) nmap.w * nmap.cw, cellword);
+
+    for (y = 0; y < map->h; y++) {
+	line = map->rows + (size_t) y * map->rw;
+	for (i = 0; i < map->rw; i++) {
+	    for (wd = line[i]; wd; wd &= wd - 1) {
+		x = map->x0 + i * WBITS + ctz(wd) - nmap.x0;
+		SETBIT(nmap.rows + (size_t) (y + map->y0 - nmap.y0) * nmap.rw, x);
+		SETBIT(nmap.cols + (size_t) x * nmap.cw, y + map->y0 - nmap.y0);
+	    }
+	}
+    }
+    freeMap(map);
+    *map = nmap;
+}
+
+/* setRun:
+ * Mark the cells from x0 to x1 in row y as occupied.
+ * The map must cover them.
+ */
+static void setRun(cellmap * map, int y, int x0, int x1)
+{
+    cellword *line;
+    int x;
+
+    y -= map->y0;
+    x0 -= map->x0;
+    x1 -= map->x0;
+    line = map->rows + (size_t) y * map->rw;
+    for (x = x0; x <= x1; x++) {
+	SETBIT(line, x);
+	SETBIT(map->cols + (size_t) x * map->cw, y);
+    }
+}
+
+/* spanFree:
+ * Return true if bits lo to hi of line are all clear.
+ */
+static int spanFree(cellword * line, int lo, int hi)
+{
+    int i = lo / WBITS, last = hi / WBITS;
+    cellword mask = ~(cellword) 0 << (lo % WBITS);
+    cellword endmask = ~(cellword) 0 >> (WBITS - 1 - hi % WBITS);
+
+    if (i == last)
+	return !(line[i] & mask & endmask);
+    if (line[i] & mask)
+	return 0;
+    for (i++; i < last; i++)
+	if (line[i])
+	    return 0;
+    return !(line[last] & endmask);
+}
+
+/* runFree:
+ * Return true if the cells from x0 to x1 in row y are all free.
+ */
+static int runFree(cellmap * map, int y, int x0, int x1)
+{
+    y -= map->y0;
+    if ((y < 0) || (y >= map->h))
+	return 1;
+    x0 = MAX(x0 - map->x0, 0);
+    x1 = MIN(x1 - map->x0, map->w - 1);
+    if (x0 > x1)
+	return 1;
+    return spanFree(map->rows + (size_t) y * map->rw, x0, x1);
+}
+
+/* nextFree:
+ * Return the first of the positions i, i+dir, ..., last whose bit in the
+ * line of len bits is clear, or last+dir if there is none.
+ * Positions outside the line are clear.
+ */
+static int nextFree(cellword * line, int len, int i, int last, int dir)
+{
+    cellword wd;
+
+    if (dir > 0) {
+	while ((i <= last) && (i >= 0) && (i < len)) {
+	    wd = ~line[i / WBITS] >> (i % WBITS);
+	    if (wd) {
+		i += ctz(wd);
+		break;
+	    }
+	    i = (i / WBITS + 1) * WBITS;
+	}
+	return MIN(i, last + 1);
+    } else {
+	while ((i >= last) && (i >= 0) && (i < len)) {
+	    wd = ~line[i / WBITS] << (WBITS - 1 - i % WBITS);
+	    if (wd) {
+		i -= clz(wd);
+		break;
+	    }
+	    i = (i / WBITS) * WBITS - 1;
+	}
+	return MAX(i, last - 1);
+    }
+}
+
+/* nextInRow, nextInCol:
+ * Return the first free cell from x to last along row y, or from
+ * y to last along column x, stepping by dir.
+ */
+static int nextInRow(cellmap * map, int y, int x, int last, int dir)
+{
+    y -= map->y0;
+    if ((y < 0) || (y >= map->h))
+	return x;
+    return map->x0 + nextFree(map->rows + (size_t) y * map->rw, map->w,
+			      x - map->x0, last - map->x0, dir);
+}
+
+static int nextInCol(cellmap * map, int x, int y, int last, int dir)
+{
+    x -= map->x0;
+    if ((x < 0) || (x >= map->w))
+	return y;
+    return map->y0 + nextFree(map->cols + (size_t) x * map->cw, map->h,
+			      y - map->y0, last - map->y0, dir);
+}
+
 /* fits:
  * Check if polyomino fits at given point.
- * If so, add cells to pointset, store point in place and return true.
+ * If so, add cells to the map, store point in place and return true.
  */
 static int
-fits(int x, int y, ginfo * info, PointSet * ps, point * place, int step, boxf* bbs)
+fits(int x, int y, ginfo * info, cellmap * map, point * place, int step, boxf* bbs)
 {
-    point *cells = info->cells;
-    int n = info->nc;
-    point cell;
+    cellrun *runs = info->runs;
+    int n = info->nr;
     int i;
-    point LL;
+    point LL, UR;
 
     for (i = 0; i < n; i++) {
-	cell = *cells;
-	cell.x += x;
-	cell.y += y;
-	if (inPS(ps, cell))
+	if (!runFree(map, runs[i].y + y, runs[i].x0 + x, runs[i].x1 + x))
 	    return 0;
-	cells++;
     }
 
     PF2P(bbs[info->index].LL, LL);
     place->x = step * x - LL.x;
     place->y = step * y - LL.y;
 
-    cells = info->cells;
-    for (i = 0; i < n; i++) {
-	cell = *cells;
-	cell.x += x;
-	cell.y += y;
-	insertPS(ps, cell);
-	cells++;
+    if (n) {
+	LL.x = info->LL.x + x;
+	LL.y = info->LL.y + y;
+	UR.x = info->UR.x + x;
+	UR.y = info->UR.y + y;
+	growMap(map, LL, UR);
     }
+    for (i = 0; i < n; i++)
+	setRun(map, runs[i].y + y, runs[i].x0 + x, runs[i].x1 + x);
 
     if (Verbose >= 2)
-	fprintf(stderr, "cc (%d cells) at (%d,%d) (%d,%d)\n", n, x, y,
+	fprintf(stderr, "cc (%d cells) at (%d,%d) (%d,%d)\n", info->nc, x, y,
 		place->x, place->y);
     return 1;
 }
 
+/* fitsRow, fitsCol:
+ * Try the positions from x to last along row y, or from y to last
+ * along column x, in steps of dir, and stop at the first where the
+ * polyomino fits. Positions where the first cell of the polyomino
+ * would be occupied are skipped a word at a time.
+ */
+static int
+fitsRow(int x, int last, int y, int dir, ginfo * info, cellmap * map,
+	point * place, int step, boxf* bbs)
+{
+    int ax = info->runs[0].x0, ay = info->runs[0].y;
+
+    while (dir > 0 ? x <= last : x >= last) {
+	x = nextInRow(map, ay + y, ax + x, ax + last, dir) - ax;
+	if (dir > 0 ? x > last : x < last)
+	    break;
+	if (fits(x, y, info, map, place, step, bbs))
+	    return 1;
+	x += dir;
+    }
+    return 0;
+}
+
+static int
+fitsCol(int x, int y, int last, int dir, ginfo * info, cellmap * map,
+	point * place, int step, boxf* bbs)
+{
+    int ax = info->runs[0].x0, ay = info->runs[0].y;
+
+    while (dir > 0 ? y <= last : y >= last) {
+	y = nextInCol(map, ax + x, ay + y, ay + last, dir) - ay;
+	if (dir > 0 ? y > last : y < last)
+	    break;
+	if (fits(x, y, info, map, place, step, bbs))
+	    return 1;
+	y += dir;
+    }
+    return 0;
+}
+
 /* placeFixed:
  * Position fixed graph. Store final translation and
- * fill polyomino set. Note that polyomino set for the
+ * fill the map. Note that the polyomino for the
  * graph is constructed where it will be.
  */
 static void
-placeFixed(ginfo * info, PointSet * ps, point * place, point center)
+placeFixed(ginfo * info, cellmap * map, point * place, point center)
 {
-    point *cells = info->cells;
-    int n = info->nc;
+    cellrun *runs = info->runs;
+    int n = info->nr;
     int i;
 
     place->x = -center.x;
     place->y = -center.y;
 
-    for (i = 0; i < n; i++) {
-	insertPS(ps, *cells++);
-    }
+    if (n)
+	growMap(map, info->LL, info->UR);
+    for (i = 0; i < n; i++)
+	setRun(map, runs[i].y, runs[i].x0, runs[i].x1);
 
     if (Verbose >= 2)
-	fprintf(stderr, "cc (%d cells) at (%d,%d)\n", n, place->x,
+	fprintf(stderr, "cc (%d cells) at (%d,%d)\n", info->nc, place->x,
 		place->y);
 }
 
@@ -485,12 +791,12 @@ placeFixed(ginfo * info, PointSet * ps, point * place, point center)
  * from the origin. Check if polyomino can be placed
  * with bounding box origin at point.
  * First graph (i == 0) is centered on the origin if possible.
+ * Each side of a circle is searched in order, as a row or column.
  */
 static void
-placeGraph(int i, ginfo * info, PointSet * ps, point * place, int step,
+placeGraph(int i, ginfo * info, cellmap * map, point * place, int step,
 	   int margin, boxf* bbs)
 {
-    int x, y;
     int W, H;
     int bnd;
     boxf bb = bbs[info->index];
@@ -498,53 +804,31 @@ placeGraph(int i, ginfo * info, PointSet * ps, point * place, int step,
     if (i == 0) {
 	W = GRID(bb.UR.x - bb.LL.x + 2 * margin, step);
 	H = GRID(bb.UR.y - bb.LL.y + 2 * margin, step);
-	if (fits(-W / 2, -H / 2, info, ps, place, step, bbs))
+	if (fits(-W / 2, -H / 2, info, map, place, step, bbs))
 	    return;
     }
 
-    if (fits(0, 0, info, ps, place, step, bbs))
+    if (fits(0, 0, info, map, place, step, bbs))
 	return;
     W = ceil(bb.UR.x - bb.LL.x);
     H = ceil(bb.UR.y - bb.LL.y);
     if (W >= H) {
 	for (bnd = 1;; bnd++) {
-	    x = 0;
-	    y = -bnd;
-	    for (; x < bnd; x++)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; y < bnd; y++)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; x > -bnd; x--)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; y > -bnd; y--)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; x < 0; x++)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
+	    if (fitsRow(0, bnd - 1, -bnd, 1, info, map, place, step, bbs) ||
+		fitsCol(bnd, -bnd, bnd - 1, 1, info, map, place, step, bbs) ||
+		fitsRow(bnd, -bnd + 1, bnd, -1, info, map, place, step, bbs) ||
+		fitsCol(-bnd, bnd, -bnd + 1, -1, info, map, place, step, bbs) ||
+		fitsRow(-bnd, -1, -bnd, 1, info, map, place, step, bbs))
+		return;
 	}
     } else {
 	for (bnd = 1;; bnd++) {
-	    y = 0;
-	    x = -bnd;
-	    for (; y > -bnd; y--)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; x < bnd; x++)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; y < bnd; y++)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; x > -bnd; x--)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
-	    for (; y > 0; y--)
-		if (fits(x, y, info, ps, place, step, bbs))
-		    return;
+	    if (fitsCol(-bnd, 0, -bnd + 1, -1, info, map, place, step, bbs) ||
+		fitsRow(-bnd, bnd - 1, -bnd, 1, info, map, place, step, bbs) ||
+		fitsCol(bnd, -bnd, bnd - 1, 1, info, map, place, step, bbs) ||
+		fitsRow(bnd, -bnd + 1, bnd, -1, info, map, place, step, bbs) ||
+		fitsCol(-bnd, bnd, 1, -1, info, map, place, step, bbs))
+		return;
 	}
     }
 }
@@ -726,6 +1010,163 @@ arrayRects (int ng, boxf* gs, pack_info* pinfo)
     return places;
 }
 
+/* hcmpf;
+ * Sort by height, then width, tallest first
+ */
+static int hcmpf(const void *X, const void *Y)
+{
+    ainfo* x = *(ainfo **) X;
+    ainfo* y = *(ainfo **) Y;
+
+    if (x->height < y->height) return 1;
+    else if (x->height > y->height) return -1;
+    else if (x->width < y->width) return 1;
+    else if (x->width > y->width) return -1;
+    else return 0;
+}
+
+typedef struct {
+    int x, y;			/* left end and height */
+    int w;			/* width */
+} skyseg;
+
+/* skylineFit:
+ * Find the lowest position in the skyline where a box of width w fits,
+ * leftmost among equals. Return the index of the first segment under
+ * the box, storing the box's bottom in yp, or -1 if w is too wide.
+ */
+static int
+skylineFit(skyseg * sky, int nseg, int width, int w, int *yp)
+{
+    int i, j, y, end;
+    int best = -1, besty = INT_MAX;
+
+    for (i = 0; i < nseg; i++) {
+	end = sky[i].x + w;
+	if (end > width)
+	    break;
+	y = sky[i].y;
+	for (j = i + 1; (j < nseg) && (sky[j].x < end) && (y < besty); j++)
+	    y = MAX(y, sky[j].y);
+	if (y < besty) {
+	    besty = y;
+	    best = i;
+	}
+    }
+    *yp = besty;
+    return best;
+}
+
+/* skylineAdd:
+ * Raise the skyline to y over the w units starting at segment i,
+ * merging it with level neighbors. Return the new number of segments.
+ * The array must have room for one more segment.
+ */
+static int
+skylineAdd(skyseg * sky, int nseg, int i, int w, int y)
+{
+    int x = sky[i].x, end = x + w;
+    int j;
+
+    /* segments i..j-1 are covered; segment j may be cut on the left */
+    for (j = i; (j < nseg) && (sky[j].x + sky[j].w <= end); j++);
+    if ((j < nseg) && (sky[j].x < end)) {
+	sky[j].w -= end - sky[j].x;
+	sky[j].x = end;
+    }
+    memmove(sky + i + 1, sky + j, (nseg - j) * sizeof(skyseg));
+    nseg += i + 1 - j;
+    sky[i].x = x;
+    sky[i].y = y;
+    sky[i].w = w;
+
+    if ((i + 1 < nseg) && (sky[i + 1].y == y)) {
+	sky[i].w += sky[i + 1].w;
+	memmove(sky + i + 1, sky + i + 2, (nseg - i - 2) * sizeof(skyseg));
+	nseg--;
+    }
+    if ((i > 0) && (sky[i - 1].y == y)) {
+	sky[i - 1].w += sky[i].w;
+	memmove(sky + i, sky + i + 1, (nseg - i - 1) * sizeof(skyseg));
+	nseg--;
+    }
+    return nseg;
+}
+
+/* skylineRects:
+ * Pack the rectangles into a strip, each one dropped onto the lowest
+ * point of the strip's skyline where it fits. By default, the rectangles
+ * are taken tallest first and the strip is about as wide as the square
+ * root of their total area; pinfo->sz, if positive, gives its width.
+ * The skyline has a segment for each rectangle still visible from above,
+ * so placing a rectangle takes time proportional to the number of
+ * rectangles across the strip rather than to all of those placed.
+ */
+static point *
+skylineRects (int ng, boxf* gs, pack_info* pinfo)
+{
+    int i, k, idx, nseg, width, y, maxw = 0;
+    ainfo *info;
+    ainfo *ip;
+    ainfo **sinfo;
+    skyseg *sky;
+    point* places = N_NEW(ng, point);
+    boxf bb;
+    double area = 0, used = 0, top = 0, right = 0;
+
+    /* sizes are in whole points, rounded out, with the margin on the right and top */
+    ip = info = N_NEW(ng, ainfo);
+    sinfo = N_NEW(ng, ainfo*);
+    for (i = 0; i < ng; i++, ip++) {
+	bb = gs[i];
+	ip->width = ceil(bb.UR.x) - floor(bb.LL.x) + pinfo->margin;
+	ip->height = ceil(bb.UR.y) - floor(bb.LL.y) + pinfo->margin;
+	ip->index = i;
+	sinfo[i] = ip;
+	maxw = MAX(maxw, ip->width);
+	area += ip->width * ip->height;
+    }
+
+    if (pinfo->vals) {
+	userVals = pinfo->vals;
+	qsort(sinfo, ng, sizeof(ainfo *), ucmpf);
+    }
+    else if (!(pinfo->flags & PK_INPUT_ORDER)) {
+	qsort(sinfo, ng, sizeof(ainfo *), hcmpf);
+    }
+
+    if (pinfo->sz > 0)
+	width = MAX(pinfo->sz, maxw);
+    else
+	width = MAX(ceil(sqrt(area)), maxw);
+
+    sky = N_NEW(ng + 2, skyseg);
+    sky[0].x = sky[0].y = 0;
+    sky[0].w = width;
+    nseg = 1;
+    for (i = 0; i < ng; i++) {
+	ip = sinfo[i];
+	idx = ip->index;
+	k = skylineFit(sky, nseg, width, ip->width, &y);
+	assert(k >= 0);
+	places[idx].x = sky[k].x - floor(gs[idx].LL.x);
+	places[idx].y = y - floor(gs[idx].LL.y);
+	right = MAX(right, sky[k].x + ip->width);
+	top = MAX(top, y + ip->height);
+	used += (gs[idx].UR.x - gs[idx].LL.x) * (gs[idx].UR.y - gs[idx].LL.y);
+	nseg = skylineAdd(sky, nseg, k, ip->width, y + ip->height);
+    }
+
+    if (Verbose)
+	fprintf (stderr, "skyline packing: %d rectangles in %.0f x %.0f, density %.3f\n",
+	    ng, right, top, (right * top > 0) ? used / (right * top) : 1);
+
+    free (sky);
+    free (info);
+    free (sinfo);
+    return places;
+}
+
 static point*
 polyRects(int ng, boxf* gs, pack_info * pinfo)
 {
@@ -733,7 +1174,7 @@ polyRects(int ng, boxf* gs, pack_info * pinfo)
     ginfo *info;
     ginfo **sinfo;
     point *places;
-    Dict_t *ps;
+    cellmap map;
     int i;
     point center;
 
@@ -759,17 +1200,19 @@ polyRects(int ng, boxf* gs, pack_info * pinfo)
     }
     qsort(sinfo, ng, sizeof(ginfo *), cmpf);
 
-    ps = newPS();
+    initMap(&map);
     places = N_NEW(ng, point);
     for (i = 0; i < ng; i++)
-	placeGraph(i, sinfo[i], ps, places + (sinfo[i]->index),
+	placeGraph(i, sinfo[i], &map, places + (sinfo[i]->index),
 		       stepSize, pinfo->margin, gs);
 
     free(sinfo);
-    for (i = 0; i < ng; i++)
+    for (i = 0; i < ng; i++) {
 	free(info[i].cells);
+	free(info[i].runs);
+    }
     free(info);
-    freePS(ps);
+    freeMap(&map);
 
     if (Verbose > 1)
 	for (i = 0; i < ng; i++)
@@ -811,7 +1254,7 @@ polyGraphs(int ng, Agraph_t ** gs, Agraph_t * root, pack_info * pinfo)
     ginfo *info;
     ginfo **sinfo;
     point *places;
-    Dict_t *ps;
+    cellmap map;
     int i;
     boolean *fixed = pinfo->fixed;
     int fixed_cnt = 0;
@@ -879,30 +1322,32 @@ polyGraphs(int ng, Agraph_t ** gs, Agraph_t * root, pack_info * pinfo)
     }
     qsort(sinfo, ng, sizeof(ginfo *), cmpf);
 
-    ps = newPS();
+    initMap(&map);
     places = N_NEW(ng, point);
     if (fixed) {
 	for (i = 0; i < ng; i++) {
 	    if (fixed[i])
-		placeFixed(sinfo[i], ps, places + (sinfo[i]->index),
+		placeFixed(sinfo[i], &map, places + (sinfo[i]->index),
 			   center);
 	}
 	for (i = 0; i < ng; i++) {
 	    if (!fixed[i])
-		placeGraph(i, sinfo[i], ps, places + (sinfo[i]->index),
+		placeGraph(i, sinfo[i], &map, places + (sinfo[i]->index),
 			   stepSize, pinfo->margin, bbs);
 	}
     } else {
 	for (i = 0; i < ng; i++)
-	    placeGraph(i, sinfo[i], ps, places + (sinfo[i]->index),
+	    placeGraph(i, sinfo[i], &map, places + (sinfo[i]->index),
 		       stepSize, pinfo->margin, bbs);
     }
 
     free(sinfo);
-    for (i = 0; i < ng; i++)
+    for (i = 0; i < ng; i++) {
 	free(info[i].cells);
+	free(info[i].runs);
+    }
     free(info);
-    freePS(ps);
+    freeMap(&map);
     free (bbs);
 
     if (Verbose > 1)
@@ -935,7 +1380,7 @@ point *putGraphs(int ng, Agraph_t ** gs, Agraph_t * root,
 	bbs[i] = GD_bb(g);
     }
 
-    if (pinfo->mode == l_array) {
+    if ((pinfo->mode == l_array) || (pinfo->mode == l_skyline)) {
 	if (pinfo->flags & PK_USER_VALS) {
 	    pinfo->vals = N_NEW(ng, packval_t);
 	    for (i = 0; i < ng; i++) {
@@ -945,7 +1390,10 @@ point *putGraphs(int ng, Agraph_t ** gs, Agraph_t * root,
 	    }
 
 	}
-	pts = arrayRects (ng, bbs, pinfo);
+	if (pinfo->mode == l_array)
+	    pts = arrayRects (ng, bbs, pinfo);
+	else
+	    pts = skylineRects (ng, bbs, pinfo);
 	if (pinfo->flags & PK_USER_VALS)
 	    free (pinfo->vals);
     }
@@ -964,6 +1412,8 @@ putRects(int ng, boxf* bbs, pack_info* pinfo)
 	return polyRects (ng, bbs, pinfo);
     else if (pinfo->mode == l_array)
 	return arrayRects (ng, bbs, pinfo);
+    else if (pinfo->mode == l_skyline)
+	return skylineRects (ng, bbs, pinfo);
     else
 	return NULL;
 }
@@ -1202,6 +1652,7 @@ pack_graph(int ng, Agraph_t** gs, Agraph_t* root, boolean* fixed)
 
 #define ARRAY  "array"
 #define ASPECT "aspect"
+#define SKYLINE "skyline"
 #define SLEN(s) (sizeof(s)/sizeof(char) - 1)
 
 static char*
@@ -1271,6 +1722,9 @@ mode2Str (pack_mode m)
     case l_aspect:
 	s = "aspect";
 	break;
+    case l_skyline:
+	s = "skyline";
+	break;
     case l_undef: 
     default:
 	s = "undefined";
@@ -1336,6 +1790,15 @@ parsePackModeInfo(char* p, pack_mode dflt, pack_info* pinfo)
 	    if (streq(p, "node"))
 		pinfo->mode = l_node;
 	    break;
+	case 's':
+	    if (strneq(p, SKYLINE, SLEN(SKYLINE))) {
+		pinfo->mode = l_skyline;
+		p += SLEN(SKYLINE);
+		p = chkFlags (p, pinfo);
+		if ((sscanf (p, "%d", &i)>0) && (i > 0))
+		    pinfo->sz = i;
+	    }
+	    break;
 #ifdef NOT_IMPLEMENTED
 	case 't':
 	    if (streq(p, "tile"))
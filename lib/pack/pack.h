@@ -30,11 +30,12 @@ extern "C" {
  *  l_graph    - polyomino using computer graph bounding box
  *  l_array    - array based on graph bounding boxes
  *  l_aspect   - tiling based on graph bounding boxes preserving aspect ratio
+ *  l_skyline  - skyline strip packing of graph bounding boxes
  *  l_hull     - polyomino using convex hull (unimplemented)
  *  l_tile     - tiling using graph bounding box (unimplemented)
  *  l_bisect   - alternate bisection using graph bounding box (unimplemented)
  */
-    typedef enum { l_undef, l_clust, l_node, l_graph, l_array, l_aspect } pack_mode;
+    typedef enum { l_undef, l_clust, l_node, l_graph, l_array, l_aspect, l_skyline } pack_mode;
 
 #define PK_COL_MAJOR   (1 << 0)
 #define PK_USER_VALS   (1 << 1)
@@ -59,7 +59,11 @@ static void *mymalloc(size_t newsize)
 }
 
 
-vconfig_t *Pobsopen(Ppoly_t ** obs, int n_obs)
+/* obsopen:
+ * Build the configuration of the obstacles, with the grid of their edges.
+ * Unless incremental, also compute the visibility graph.
+ */
+static vconfig_t *obsopen(Ppoly_t ** obs, int n_obs, int incremental)
 {
     vconfig_t *rv;
     int poly_i, pt_i, i, n;
@@ -97,12 +101,43 @@ vconfig_t *Pobsopen(Ppoly_t ** obs, int n_obs)
 	rv->prev[start] = end;
     }
     rv->start[poly_i] = i;
-    visibility(rv);
+    visgrid(rv);
+    if (incremental) {
+	rv->vis = NULL;
+	rv->rows = mymalloc(n * sizeof(visrow_t));
+	for (i = 0; i < n; i++)
+	    rv->rows[i].n = -1;
+	rv->rowidx = mymalloc(n * sizeof(int));
+	rv->rowd = mymalloc(n * sizeof(COORD));
+	rv->endrows = mymalloc(n_obs * sizeof(visrow_t));
+	rv->endpts = mymalloc(n_obs * sizeof(Ppoint_t));
+	for (i = 0; i < n_obs; i++)
+	    rv->endrows[i].n = -1;
+    } else {
+	rv->rows = NULL;
+	rv->rowidx = NULL;
+	rv->rowd = NULL;
+	rv->endrows = NULL;
+	rv->endpts = NULL;
+	visibility(rv);
+    }
     return rv;
 }
 
+vconfig_t *Pobsopen(Ppoly_t ** obs, int n_obs)
+{
+    return obsopen(obs, n_obs, 0);
+}
+
+vconfig_t *Pobsopen_incremental(Ppoly_t ** obs, int n_obs)
+{
+    return obsopen(obs, n_obs, 1);
+}
+
 void Pobsclose(vconfig_t * config)
 {
+    int i;
+
     free(config->P);
     free(config->start);
     free(config->next);
@@ -111,9 +146,74 @@ void Pobsclose(vconfig_t * config)
 	free(config->vis[0]);
 	free(config->vis);
     }
+    if (config->rows) {
+	for (i = 0; i < config->N; i++)
+	    if (config->rows[i].n >= 0) {
+		free(config->rows[i].idx);
+		free(config->rows[i].d);
+	    }
+	free(config->rows);
+    }
+    if (config->endrows) {
+	for (i = 0; i < config->Npoly; i++)
+	    if (config->endrows[i].n >= 0) {
+		free(config->endrows[i].idx);
+		free(config->endrows[i].d);
+	    }
+	free(config->endrows);
+    }
+    free(config->endpts);
+    free(config->rowidx);
+    free(config->rowd);
+    free(config->gstart);
+    free(config->gedge);
+    free(config->gmark);
     free(config);
 }
 
+/* endVis:
+ * As ptVis, for an endpoint of a path. For a configuration opened by
+ * Pobsopen_incremental, the visibility of the last endpoint inside
+ * each polygon is kept, since paths often share their endpoints,
+ * as when several edges leave the same node.
+ */
+static COORD *endVis(vconfig_t * conf, int pp, Ppoint_t p)
+{
+    visrow_t *row;
+    COORD *vadj;
+    int k, n;
+
+    if (!conf->endrows || pp < 0)
+	return ptVis(conf, pp, p);
+    row = &conf->endrows[pp];
+    if (row->n >= 0 && EQ(p, conf->endpts[pp])) {
+	vadj = (COORD *) calloc(conf->N + 2, sizeof(COORD));
+	for (k = 0; k < row->n; k++)
+	    vadj[row->idx[k]] = row->d[k];
+	return vadj;
+    }
+
+    vadj = ptVis(conf, pp, p);
+    for (n = 0, k = 0; k < conf->N; k++)
+	if (vadj[k] != 0)
+	    n++;
+    if (row->n >= 0) {
+	free(row->idx);
+	free(row->d);
+    }
+    row->idx = (int *) malloc(MAX(n, 1) * sizeof(int));
+    row->d = (COORD *) malloc(MAX(n, 1) * sizeof(COORD));
+    for (n = 0, k = 0; k < conf->N; k++)
+	if (vadj[k] != 0) {
+	    row->idx[n] = k;
+	    row->d[n] = vadj[k];
+	    n++;
+	}
+    row->n = n;
+    conf->endpts[pp] = p;
+    return vadj;
+}
+
 int Pobspath(vconfig_t * config, Ppoint_t p0, int poly0, Ppoint_t p1,
 	     int poly1, Ppolyline_t * output_route)
 {
@@ -125,8 +225,8 @@ int Pobspath(vconfig_t * config, Ppoint_t p0, int poly0, Ppoint_t p1,
 #ifdef GASP
     gasp_print_obstacles(config);
 #endif
-    ptvis0 = ptVis(config, poly0, p0);
-    ptvis1 = ptVis(config, poly1, p1);
+    ptvis0 = endVis(config, poly0, p0);
+    ptvis1 = endVis(config, poly1, p1);
 
 #ifdef GASP
     gasp_print_point(p0);
@@ -205,6 +305,8 @@ static void printVconfig(vconfig_t * cp)
 
     printf("\n\n");
 
+    if (!arr)
+	return;
     for (i = 0; i < cp->N; i++) {
 	for (j = 0; j < cp->N; j++)
 	    printf("%4.1f ", arr[i][j]);
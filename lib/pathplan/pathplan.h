@@ -31,6 +31,13 @@ extern "C" {
     extern int Pshortestpath(Ppoly_t * boundary, Ppoint_t endpoints[2],
 			     Ppolyline_t * output_route);
 
+/* triangulations of the polygon in Pshortestpath */
+#define PTRI_MONOTONE 0		/* monotone pieces, O(n log n); the default */
+#define PTRI_EARCLIP  1		/* ear clipping, O(n^3) */
+
+/* select the triangulation if method >= 0; return the one in use */
+    extern int Pshortestpath_triangulation(int method);
+
 /* fit a spline to an input polyline, without touching barrier segments */
     extern int Proutespline(Pedge_t * barriers, int n_barriers,
 			    Ppolyline_t input_route,
@@ -44,6 +51,24 @@ extern "C" {
 /* function to convert a polyline into a spline representation */
     extern void make_polyline(Ppolyline_t line, Ppolyline_t* sline);
 
+/* The functions above keep their results in static buffers. Those below
+ * keep them in a workspace owned by the caller, which is reused from call
+ * to call; different workspaces may be used by concurrent threads.
+ */
+    typedef struct Pworkspace_s Pworkspace_t;
+
+    extern Pworkspace_t *Pnewworkspace(void);
+    extern void Pfreeworkspace(Pworkspace_t * ws);
+    extern int Pshortestpath_w(Pworkspace_t * ws, Ppoly_t * boundary,
+			       Ppoint_t endpoints[2],
+			       Ppolyline_t * output_route);
+    extern int Proutespline_w(Pworkspace_t * ws, Pedge_t * barriers,
+			      int n_barriers, Ppolyline_t input_route,
+			      Pvector_t endpoint_slopes[2],
+			      Ppolyline_t * output_route);
+    extern void make_polyline_w(Pworkspace_t * ws, Ppolyline_t line,
+				Ppolyline_t * sline);
+
 #undef extern
 
 #ifdef __cplusplus
@@ -48,6 +48,17 @@ extern "C" {
     Ppoly_t copypoly(Ppoly_t);
     void freepoly(Ppoly_t);
 
+    /* The buffers of a workspace; see pathplan.h */
+    struct Pworkspace_s {
+	struct spwork_s *shortest;	/* see shortest.c */
+	struct rtwork_s *route;		/* see route.c */
+	Ppoint_t *ispline;		/* points of make_polyline_w */
+	int isz;			/* size of ispline[] */
+    };
+
+    void freeshortest(struct spwork_s *);
+    void freeroute(struct rtwork_s *);
+
 #undef extern
 #ifdef __cplusplus
 }
@@ -58,7 +58,16 @@ typedef struct elist_t {
     struct elist_t *next, *prev;
 } elist_t;
 
-static jmp_buf jbuf;
+/* the buffers of Proutespline, kept from call to call */
+typedef struct rtwork_s {
+    jmp_buf jbuf;
+    Ppoint_t *ops;
+    int opn, opl;
+    tna_t *tnas;
+    int tnan;
+} rtwork_t;
+
+static rtwork_t Work;		/* used by Proutespline */
 
 #if 0
 static p2e_t *p2es;
@@ -69,15 +78,14 @@ static int p2en;
 static elist_t *elist;
 #endif
 
-static Ppoint_t *ops;
-static int opn, opl;
-
-static int reallyroutespline(Pedge_t *, int,
+static int routespline(rtwork_t *, Pedge_t *, int, Ppolyline_t,
+		       Ppoint_t *, Ppolyline_t *);
+static int reallyroutespline(rtwork_t *, Pedge_t *, int,
 			     Ppoint_t *, int, Ppoint_t, Ppoint_t);
 static int mkspline(Ppoint_t *, int, tna_t *, Ppoint_t, Ppoint_t,
 		    Ppoint_t *, Ppoint_t *, Ppoint_t *, Ppoint_t *);
-static int splinefits(Pedge_t *, int, Ppoint_t, Pvector_t, Ppoint_t,
-		      Pvector_t, Ppoint_t *, int);
+static int splinefits(rtwork_t *, Pedge_t *, int, Ppoint_t, Pvector_t,
+		      Ppoint_t, Pvector_t, Ppoint_t *, int);
 static int splineisinside(Pedge_t *, int, Ppoint_t *);
 static int splineintersectsline(Ppoint_t *, Ppoint_t *, double *);
 static void points2coeff(double, double, double, double, double *);
@@ -85,7 +93,7 @@ static void addroot(double, double *, int *);
 
 static Pvector_t normv(Pvector_t);
 
-static void growops(int);
+static void growops(rtwork_t *, int);
 
 static Ppoint_t add(Ppoint_t, Ppoint_t);
 static Ppoint_t sub(Ppoint_t, Ppoint_t);
@@ -113,7 +121,41 @@ static void listinsert(Pedge_t *, Ppoint_t);
  * Return 0 on success and -1 on failure, including no memory.
  */
 int Proutespline(Pedge_t * edges, int edgen, Ppolyline_t input,
-		 Ppoint_t * evs, Ppolyline_t * output)
+		 Ppoint_t evs[2], Ppolyline_t * output)
+{
+    return routespline(&Work, edges, edgen, input, evs, output);
+}
+
+/* Proutespline_w:
+ * Proutespline using the buffers of ws, so that calls with different
+ * workspaces may run concurrently. The output points into ws, and is
+ * valid until its next use.
+ */
+int Proutespline_w(Pworkspace_t * ws, Pedge_t * edges, int edgen,
+		   Ppolyline_t input, Ppoint_t evs[2], Ppolyline_t * output)
+{
+    if (!ws->route && !(ws->route = calloc(1, sizeof(rtwork_t)))) {
+	prerror("cannot malloc workspace");
+	return -1;
+    }
+    return routespline(ws->route, edges, edgen, input, evs, output);
+}
+
+/* freeroute:
+ * Free the buffers of a workspace used by Proutespline_w.
+ */
+void freeroute(rtwork_t * w)
+{
+    if (!w)
+	return;
+    free(w->ops);
+    free(w->tnas);
+    free(w);
+}
+
+static int routespline(rtwork_t * w, Pedge_t * edges, int edgen,
+		       Ppolyline_t input, Ppoint_t * evs,
+		       Ppolyline_t * output)
 {
 #if 0
     Ppoint_t p0, p1, p2, p3;
@@ -168,34 +210,34 @@ int Proutespline(Pedge_t * edges, int edgen, Ppolyline_t input,
 	}
     }
 #endif
-    if (setjmp(jbuf))
+    if (setjmp(w->jbuf))
 	return -1;
 
     /* generate the splines */
     evs[0] = normv(evs[0]);
     evs[1] = normv(evs[1]);
-    opl = 0;
-    growops(4);
-    ops[opl++] = inps[0];
-    if (reallyroutespline(edges, edgen, inps, inpn, evs[0], evs[1]) == -1)
+    w->opl = 0;
+    growops(w, 4);
+    w->ops[w->opl++] = inps[0];
+    if (reallyroutespline(w, edges, edgen, inps, inpn, evs[0], evs[1]) == -1)
 	return -1;
-    output->pn = opl;
-    output->ps = ops;
+    output->pn = w->opl;
+    output->ps = w->ops;
 
 #if 0
     fprintf(stderr, "edge\na\nb\n");
     fprintf(stderr, "points\n%d\n", inpn);
     for (ipi = 0; ipi < inpn; ipi++)
 	fprintf(stderr, "%f %f\n", inps[ipi].x, inps[ipi].y);
-    fprintf(stderr, "splpoints\n%d\n", opl);
-    for (opi = 0; opi < opl; opi++)
-	fprintf(stderr, "%f %f\n", ops[opi].x, ops[opi].y);
+    fprintf(stderr, "splpoints\n%d\n", w->opl);
+    for (opi = 0; opi < w->opl; opi++)
+	fprintf(stderr, "%f %f\n", w->ops[opi].x, w->ops[opi].y);
 #endif
 
     return 0;
 }
 
-static int reallyroutespline(Pedge_t * edges, int edgen,
+static int reallyroutespline(rtwork_t * w, Pedge_t * edges, int edgen,
 			     Ppoint_t * inps, int inpn, Ppoint_t ev0,
 			     Ppoint_t ev1)
 {
@@ -204,36 +246,33 @@ static int reallyroutespline(Pedge_t * edges, int edgen,
     double maxd, d, t;
     int maxi, i, spliti;
 
-    static tna_t *tnas;
-    static int tnan;
-
-    if (tnan < inpn) {
-	if (!tnas) {
-	    if (!(tnas = malloc(sizeof(tna_t) * inpn)))
+    if (w->tnan < inpn) {
+	if (!w->tnas) {
+	    if (!(w->tnas = malloc(sizeof(tna_t) * inpn)))
 		return -1;
 	} else {
-	    if (!(tnas = realloc(tnas, sizeof(tna_t) * inpn)))
+	    if (!(w->tnas = realloc(w->tnas, sizeof(tna_t) * inpn)))
 		return -1;
 	}
-	tnan = inpn;
+	w->tnan = inpn;
     }
-    tnas[0].t = 0;
+    w->tnas[0].t = 0;
     for (i = 1; i < inpn; i++)
-	tnas[i].t = tnas[i - 1].t + dist(inps[i], inps[i - 1]);
+	w->tnas[i].t = w->tnas[i - 1].t + dist(inps[i], inps[i - 1]);
     for (i = 1; i < inpn; i++)
-	tnas[i].t /= tnas[inpn - 1].t;
+	w->tnas[i].t /= w->tnas[inpn - 1].t;
     for (i = 0; i < inpn; i++) {
-	tnas[i].a[0] = scale(ev0, B1(tnas[i].t));
-	tnas[i].a[1] = scale(ev1, B2(tnas[i].t));
+	w->tnas[i].a[0] = scale(ev0, B1(w->tnas[i].t));
+	w->tnas[i].a[1] = scale(ev1, B2(w->tnas[i].t));
     }
-    if (mkspline(inps, inpn, tnas, ev0, ev1, &p1, &v1, &p2, &v2) == -1)
+    if (mkspline(inps, inpn, w->tnas, ev0, ev1, &p1, &v1, &p2, &v2) == -1)
 	return -1;
-    if (splinefits(edges, edgen, p1, v1, p2, v2, inps, inpn))
+    if (splinefits(w, edges, edgen, p1, v1, p2, v2, inps, inpn))
 	return 0;
     cp1 = add(p1, scale(v1, 1 / 3.0));
     cp2 = sub(p2, scale(v2, 1 / 3.0));
     for (maxd = -1, maxi = -1, i = 1; i < inpn - 1; i++) {
-	t = tnas[i].t;
+	t = w->tnas[i].t;
 	p.x = B0(t) * p1.x + B1(t) * cp1.x + B2(t) * cp2.x + B3(t) * p2.x;
 	p.y = B0(t) * p1.y + B1(t) * cp1.y + B2(t) * cp2.y + B3(t) * p2.y;
 	if ((d = dist(p, inps[i])) > maxd)
@@ -243,8 +282,8 @@ static int reallyroutespline(Pedge_t * edges, int edgen,
     splitv1 = normv(sub(inps[spliti], inps[spliti - 1]));
     splitv2 = normv(sub(inps[spliti + 1], inps[spliti]));
     splitv = normv(add(splitv1, splitv2));
-    reallyroutespline(edges, edgen, inps, spliti + 1, ev0, splitv);
-    reallyroutespline(edges, edgen, &inps[spliti], inpn - spliti, splitv,
+    reallyroutespline(w, edges, edgen, inps, spliti + 1, ev0, splitv);
+    reallyroutespline(w, edges, edgen, &inps[spliti], inpn - spliti, splitv,
 		      ev1);
     return 0;
 }
@@ -304,8 +343,8 @@ static double dist_n(Ppoint_t * p, int n)
     return rv;
 }
 
-static int splinefits(Pedge_t * edges, int edgen, Ppoint_t pa,
-		      Pvector_t va, Ppoint_t pb, Pvector_t vb,
+static int splinefits(rtwork_t * w, Pedge_t * edges, int edgen,
+		      Ppoint_t pa, Pvector_t va, Ppoint_t pb, Pvector_t vb,
 		      Ppoint_t * inps, int inpn)
 {
     Ppoint_t sps[4];
@@ -349,9 +388,9 @@ static int splinefits(Pedge_t * edges, int edgen, Ppoint_t pa,
 	first = 0;
 
 	if (splineisinside(edges, edgen, &sps[0])) {
-	    growops(opl + 4);
+	    growops(w, w->opl + 4);
 	    for (pi = 1; pi < 4; pi++)
-		ops[opl].x = sps[pi].x, ops[opl++].y = sps[pi].y;
+		w->ops[w->opl].x = sps[pi].x, w->ops[w->opl++].y = sps[pi].y;
 #if defined(DEBUG) && DEBUG >= 1
 	    fprintf(stderr, "success: %f %f\n", a, b);
 #endif
@@ -359,9 +398,9 @@ static int splinefits(Pedge_t * edges, int edgen, Ppoint_t pa,
 	}
 	if (a == 0 && b == 0) {
 	    if (forceflag) {
-		growops(opl + 4);
+		growops(w, w->opl + 4);
 		for (pi = 1; pi < 4; pi++)
-		    ops[opl].x = sps[pi].x, ops[opl++].y = sps[pi].y;
+		    w->ops[w->opl].x = sps[pi].x, w->ops[w->opl++].y = sps[pi].y;
 #if defined(DEBUG) && DEBUG >= 1
 		fprintf(stderr, "forced straight line: %f %f\n", a, b);
 #endif
@@ -522,23 +561,23 @@ static Pvector_t normv(Pvector_t v)
     return v;
 }
 
-static void growops(int newopn)
+static void growops(rtwork_t * w, int newopn)
 {
-    if (newopn <= opn)
+    if (newopn <= w->opn)
 	return;
-    if (!ops) {
-	if (!(ops = (Ppoint_t *) malloc(POINTSIZE * newopn))) {
+    if (!w->ops) {
+	if (!(w->ops = (Ppoint_t *) malloc(POINTSIZE * newopn))) {
 	    prerror("cannot malloc ops");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     } else {
-	if (!(ops = (Ppoint_t *) realloc((void *) ops,
+	if (!(w->ops = (Ppoint_t *) realloc((void *) w->ops,
 					 POINTSIZE * newopn))) {
 	    prerror("cannot realloc ops");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     }
-    opn = newopn;
+    w->opn = newopn;
 }
 
 static Ppoint_t add(Ppoint_t p1, Ppoint_t p2)
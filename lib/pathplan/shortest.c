@@ -26,6 +26,10 @@
 #include "dmalloc.h"
 #endif
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 #define ISCCW 1
 #define ISCW  2
 #define ISON  3
@@ -70,44 +74,140 @@ typedef struct deque_t {
     int pnlpn, fpnlpi, lpnlpi, apex;
 } deque_t;
 
-static jmp_buf jbuf;
-static pointnlink_t *pnls, **pnlps;
-static int pnln, pnll;
-
-static triangle_t *tris;
-static int trin, tril;
+/* a vertex of the polygon, for sorting by height */
+typedef struct mvert_t {
+    double x, y;
+    int i;
+} mvert_t;
 
-static deque_t dq;
+/* an edge of a triangle, for finding the triangle across it */
+typedef struct tref_t {
+    pointnlink_t *lo, *hi;
+    int tri, e;
+} tref_t;
 
-static Ppoint_t *ops;
-static int opn;
-
-static void triangulate(pointnlink_t **, int);
+/* the state of a monotone triangulation */
+typedef struct mono_t {
+    pointnlink_t **pnlps;
+    int n;
+    int *rank;			/* position of each vertex from the top */
+    int *type;			/* START, SPLIT, ... of each vertex */
+    int *helper;		/* helper of each edge in the sweep */
+    int *status;		/* edges crossing the sweep line, left to right */
+    int statn;
+    int *diags;			/* pairs of vertices */
+    int diagn;
+    int *start, *adj, *used;	/* vertices with their outgoing edges */
+    int *face, *u, *side, *stack;
+    int trin;			/* triangles made, including flat ones */
+} mono_t;
+
+/* the buffers of Pshortestpath, kept from call to call */
+typedef struct spwork_s {
+    jmp_buf jbuf;
+    pointnlink_t *pnls, **pnlps;
+    int pnln, pnll;
+
+    triangle_t *tris;
+    int trin, tril;
+
+    deque_t dq;
+
+    Ppoint_t *ops;
+    int opn;
+
+    mvert_t *mvs;
+    int mvn;
+    int *ints;
+    int intn;
+    tref_t *trefs;
+    int trefn;
+} spwork_t;
+
+static spwork_t Work;		/* used by Pshortestpath */
+static int Triangulation = PTRI_MONOTONE;
+
+static int shortestpath(spwork_t *, Ppoly_t *, Ppoint_t *, Ppolyline_t *);
+static void triangulate(spwork_t *, pointnlink_t **, int);
 static int isdiagonal(int, int, pointnlink_t **, int);
-static void loadtriangle(pointnlink_t *, pointnlink_t *, pointnlink_t *);
-static void connecttris(int, int);
-static int marktripath(int, int);
+static int monotriangulate(spwork_t *, pointnlink_t **, int);
+static void loadtriangle(spwork_t *, pointnlink_t *, pointnlink_t *,
+			 pointnlink_t *);
+static void connecttris(spwork_t *, int, int);
+static void connectedges(spwork_t *);
+static int marktripath(spwork_t *, int, int);
 
-static void add2dq(int, pointnlink_t *);
-static void splitdq(int, int);
-static int finddqsplit(pointnlink_t *);
+static void add2dq(spwork_t *, int, pointnlink_t *);
+static void splitdq(spwork_t *, int, int);
+static int finddqsplit(spwork_t *, pointnlink_t *);
 
 static int ccw(Ppoint_t *, Ppoint_t *, Ppoint_t *);
 static int intersects(Ppoint_t *, Ppoint_t *, Ppoint_t *, Ppoint_t *);
 static int between(Ppoint_t *, Ppoint_t *, Ppoint_t *);
-static int pointintri(int, Ppoint_t *);
+static int pointintri(spwork_t *, int, Ppoint_t *);
 
-static void growpnls(int);
-static void growtris(int);
-static void growdq(int);
-static void growops(int);
+static void growpnls(spwork_t *, int);
+static void growtris(spwork_t *, int);
+static void growdq(spwork_t *, int);
+static void growops(spwork_t *, int);
+static void *growbuf(spwork_t *, void *, int *, int, size_t);
 
 /* Pshortestpath:
  * Find a shortest path contained in the polygon polyp going between the
  * points supplied in eps. The resulting polyline is stored in output.
  * Return 0 on success, -1 on bad input, -2 on memory allocation problem. 
  */
-int Pshortestpath(Ppoly_t * polyp, Ppoint_t * eps, Ppolyline_t * output)
+int Pshortestpath(Ppoly_t * polyp, Ppoint_t eps[2], Ppolyline_t * output)
+{
+    return shortestpath(&Work, polyp, eps, output);
+}
+
+/* Pshortestpath_w:
+ * Pshortestpath using the buffers of ws, so that calls with different
+ * workspaces may run concurrently. The output points into ws, and is
+ * valid until its next use.
+ */
+int Pshortestpath_w(Pworkspace_t * ws, Ppoly_t * polyp, Ppoint_t eps[2],
+		    Ppolyline_t * output)
+{
+    if (!ws->shortest && !(ws->shortest = calloc(1, sizeof(spwork_t)))) {
+	prerror("cannot malloc workspace");
+	return -2;
+    }
+    return shortestpath(ws->shortest, polyp, eps, output);
+}
+
+/* Pshortestpath_triangulation:
+ * If method >= 0, triangulate the polygons of Pshortestpath with it
+ * from now on. Return the method in use.
+ */
+int Pshortestpath_triangulation(int method)
+{
+    if (method == PTRI_MONOTONE || method == PTRI_EARCLIP)
+	Triangulation = method;
+    return Triangulation;
+}
+
+/* freeshortest:
+ * Free the buffers of a workspace used by Pshortestpath_w.
+ */
+void freeshortest(spwork_t * w)
+{
+    if (!w)
+	return;
+    free(w->pnls);
+    free(w->pnlps);
+    free(w->tris);
+    free(w->dq.pnlps);
+    free(w->ops);
+    free(w->mvs);
+    free(w->ints);
+    free(w->trefs);
+    free(w);
+}
+
+static int shortestpath(spwork_t * w, Ppoly_t * polyp, Ppoint_t * eps,
+			Ppolyline_t * output)
 {
     int pi, minpi;
     double minx;
@@ -117,18 +217,19 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t * eps, Ppolyline_t * output)
     pointnlink_t epnls[2], *lpnlp, *rpnlp, *pnlp;
     triangle_t *trip;
     int splitindex;
+    int method = Triangulation;
 #ifdef DEBUG
     int pnli;
 #endif
 
-    if (setjmp(jbuf))
+    if (setjmp(w->jbuf))
 	return -2;
     /* make space */
-    growpnls(polyp->pn);
-    pnll = 0;
-    tril = 0;
-    growdq(polyp->pn * 2);
-    dq.fpnlpi = dq.pnlpn / 2, dq.lpnlpi = dq.fpnlpi - 1;
+    growpnls(w, polyp->pn);
+    w->pnll = 0;
+    w->tril = 0;
+    growdq(w, polyp->pn * 2);
+    w->dq.fpnlpi = w->dq.pnlpn / 2, w->dq.lpnlpi = w->dq.fpnlpi - 1;
 
     /* make sure polygon is CCW and load pnls array */
     for (pi = 0, minx = HUGE_VAL, minpi = -1; pi < polyp->pn; pi++) {
@@ -145,91 +246,97 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t * eps, Ppolyline_t * output)
 		&& polyp->ps[pi].x == polyp->ps[pi + 1].x
 		&& polyp->ps[pi].y == polyp->ps[pi + 1].y)
 		continue;
-	    pnls[pnll].pp = &polyp->ps[pi];
-	    pnls[pnll].link = &pnls[pnll % polyp->pn];
-	    pnlps[pnll] = &pnls[pnll];
-	    pnll++;
+	    w->pnls[w->pnll].pp = &polyp->ps[pi];
+	    w->pnls[w->pnll].link = &w->pnls[w->pnll % polyp->pn];
+	    w->pnlps[w->pnll] = &w->pnls[w->pnll];
+	    w->pnll++;
 	}
     } else {
 	for (pi = 0; pi < polyp->pn; pi++) {
 	    if (pi > 0 && polyp->ps[pi].x == polyp->ps[pi - 1].x &&
 		polyp->ps[pi].y == polyp->ps[pi - 1].y)
 		continue;
-	    pnls[pnll].pp = &polyp->ps[pi];
-	    pnls[pnll].link = &pnls[pnll % polyp->pn];
-	    pnlps[pnll] = &pnls[pnll];
-	    pnll++;
+	    w->pnls[w->pnll].pp = &polyp->ps[pi];
+	    w->pnls[w->pnll].link = &w->pnls[w->pnll % polyp->pn];
+	    w->pnlps[w->pnll] = &w->pnls[w->pnll];
+	    w->pnll++;
 	}
     }
 
 #if defined(DEBUG) && DEBUG >= 1
-    fprintf(stderr, "points\n%d\n", pnll);
-    for (pnli = 0; pnli < pnll; pnli++)
-	fprintf(stderr, "%f %f\n", pnls[pnli].pp->x, pnls[pnli].pp->y);
+    fprintf(stderr, "points\n%d\n", w->pnll);
+    for (pnli = 0; pnli < w->pnll; pnli++)
+	fprintf(stderr, "%f %f\n", w->pnls[pnli].pp->x, w->pnls[pnli].pp->y);
 #endif
 
     /* generate list of triangles */
-    triangulate(pnlps, pnll);
+    if (method == PTRI_EARCLIP || !monotriangulate(w, w->pnlps, w->pnll)) {
+	w->tril = 0;
+	triangulate(w, w->pnlps, w->pnll);
+    }
 
 #if defined(DEBUG) && DEBUG >= 2
-    fprintf(stderr, "triangles\n%d\n", tril);
-    for (trii = 0; trii < tril; trii++)
+    fprintf(stderr, "triangles\n%d\n", w->tril);
+    for (trii = 0; trii < w->tril; trii++)
 	for (ei = 0; ei < 3; ei++)
-	    fprintf(stderr, "%f %f\n", tris[trii].e[ei].pnl0p->pp->x,
-		    tris[trii].e[ei].pnl0p->pp->y);
+	    fprintf(stderr, "%f %f\n", w->tris[trii].e[ei].pnl0p->pp->x,
+		    w->tris[trii].e[ei].pnl0p->pp->y);
 #endif
 
     /* connect all pairs of triangles that share an edge */
-    for (trii = 0; trii < tril; trii++)
-	for (trij = trii + 1; trij < tril; trij++)
-	    connecttris(trii, trij);
+    if (method == PTRI_EARCLIP) {
+	for (trii = 0; trii < w->tril; trii++)
+	    for (trij = trii + 1; trij < w->tril; trij++)
+		connecttris(w, trii, trij);
+    } else
+	connectedges(w);
 
     /* find first and last triangles */
-    for (trii = 0; trii < tril; trii++)
-	if (pointintri(trii, &eps[0]))
+    for (trii = 0; trii < w->tril; trii++)
+	if (pointintri(w, trii, &eps[0]))
 	    break;
-    if (trii == tril) {
+    if (trii == w->tril) {
 	prerror("source point not in any triangle");
 	return -1;
     }
     ftrii = trii;
-    for (trii = 0; trii < tril; trii++)
-	if (pointintri(trii, &eps[1]))
+    for (trii = 0; trii < w->tril; trii++)
+	if (pointintri(w, trii, &eps[1]))
 	    break;
-    if (trii == tril) {
+    if (trii == w->tril) {
 	prerror("destination point not in any triangle");
 	return -1;
     }
     ltrii = trii;
 
     /* mark the strip of triangles from eps[0] to eps[1] */
-    if (!marktripath(ftrii, ltrii)) {
+    if (!marktripath(w, ftrii, ltrii)) {
 	prerror("cannot find triangle path");
 	/* a straight line is better than failing */
-	growops(2);
+	growops(w, 2);
 	output->pn = 2;
-	ops[0] = eps[0], ops[1] = eps[1];
-	output->ps = ops;
+	w->ops[0] = eps[0], w->ops[1] = eps[1];
+	output->ps = w->ops;
 	return 0;
     }
 
     /* if endpoints in same triangle, use a single line */
     if (ftrii == ltrii) {
-	growops(2);
+	growops(w, 2);
 	output->pn = 2;
-	ops[0] = eps[0], ops[1] = eps[1];
-	output->ps = ops;
+	w->ops[0] = eps[0], w->ops[1] = eps[1];
+	output->ps = w->ops;
 	return 0;
     }
 
     /* build funnel and shortest path linked list (in add2dq) */
     epnls[0].pp = &eps[0], epnls[0].link = NULL;
     epnls[1].pp = &eps[1], epnls[1].link = NULL;
-    add2dq(DQ_FRONT, &epnls[0]);
-    dq.apex = dq.fpnlpi;
+    add2dq(w, DQ_FRONT, &epnls[0]);
+    w->dq.apex = w->dq.fpnlpi;
     trii = ftrii;
     while (trii != -1) {
-	trip = &tris[trii];
+	trip = &w->tris[trii];
 	trip->mark = 2;
 
 	/* find the left and right points of the exiting edge */
@@ -237,11 +344,11 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t * eps, Ppolyline_t * output)
 	    if (trip->e[ei].rtp && trip->e[ei].rtp->mark == 1)
 		break;
 	if (ei == 3) {		/* in last triangle */
-	    if (ccw(&eps[1], dq.pnlps[dq.fpnlpi]->pp,
-		    dq.pnlps[dq.lpnlpi]->pp) == ISCCW)
-		lpnlp = dq.pnlps[dq.lpnlpi], rpnlp = &epnls[1];
+	    if (ccw(&eps[1], w->dq.pnlps[w->dq.fpnlpi]->pp,
+		    w->dq.pnlps[w->dq.lpnlpi]->pp) == ISCCW)
+		lpnlp = w->dq.pnlps[w->dq.lpnlpi], rpnlp = &epnls[1];
 	    else
-		lpnlp = &epnls[1], rpnlp = dq.pnlps[dq.lpnlpi];
+		lpnlp = &epnls[1], rpnlp = w->dq.pnlps[w->dq.lpnlpi];
 	} else {
 	    pnlp = trip->e[(ei + 1) % 3].pnl1p;
 	    if (ccw(trip->e[ei].pnl0p->pp, pnlp->pp,
@@ -253,32 +360,32 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t * eps, Ppolyline_t * output)
 
 	/* update deque */
 	if (trii == ftrii) {
-	    add2dq(DQ_BACK, lpnlp);
-	    add2dq(DQ_FRONT, rpnlp);
+	    add2dq(w, DQ_BACK, lpnlp);
+	    add2dq(w, DQ_FRONT, rpnlp);
 	} else {
-	    if (dq.pnlps[dq.fpnlpi] != rpnlp
-		&& dq.pnlps[dq.lpnlpi] != rpnlp) {
+	    if (w->dq.pnlps[w->dq.fpnlpi] != rpnlp
+		&& w->dq.pnlps[w->dq.lpnlpi] != rpnlp) {
 		/* add right point to deque */
-		splitindex = finddqsplit(rpnlp);
-		splitdq(DQ_BACK, splitindex);
-		add2dq(DQ_FRONT, rpnlp);
+		splitindex = finddqsplit(w, rpnlp);
+		splitdq(w, DQ_BACK, splitindex);
+		add2dq(w, DQ_FRONT, rpnlp);
 		/* if the split is behind the apex, then reset apex */
-		if (splitindex > dq.apex)
-		    dq.apex = splitindex;
+		if (splitindex > w->dq.apex)
+		    w->dq.apex = splitindex;
 	    } else {
 		/* add left point to deque */
-		splitindex = finddqsplit(lpnlp);
-		splitdq(DQ_FRONT, splitindex);
-		add2dq(DQ_BACK, lpnlp);
+		splitindex = finddqsplit(w, lpnlp);
+		splitdq(w, DQ_FRONT, splitindex);
+		add2dq(w, DQ_BACK, lpnlp);
 		/* if the split is in front of the apex, then reset apex */
-		if (splitindex < dq.apex)
-		    dq.apex = splitindex;
+		if (splitindex < w->dq.apex)
+		    w->dq.apex = splitindex;
 	    }
 	}
 	trii = -1;
 	for (ei = 0; ei < 3; ei++)
 	    if (trip->e[ei].rtp && trip->e[ei].rtp->mark == 1) {
-		trii = trip->e[ei].rtp - tris;
+		trii = trip->e[ei].rtp - w->tris;
 		break;
 	    }
     }
@@ -292,17 +399,17 @@ int Pshortestpath(Ppoly_t * polyp, Ppoint_t * eps, Ppolyline_t * output)
 
     for (pi = 0, pnlp = &epnls[1]; pnlp; pnlp = pnlp->link)
 	pi++;
-    growops(pi);
+    growops(w, pi);
     output->pn = pi;
     for (pi = pi - 1, pnlp = &epnls[1]; pnlp; pi--, pnlp = pnlp->link)
-	ops[pi] = *pnlp->pp;
-    output->ps = ops;
+	w->ops[pi] = *pnlp->pp;
+    output->ps = w->ops;
 
     return 0;
 }
 
 /* triangulate polygon */
-static void triangulate(pointnlink_t ** pnlps, int pnln)
+static void triangulate(spwork_t * w, pointnlink_t ** pnlps, int pnln)
 {
     int pnli, pnlip1, pnlip2;
 
@@ -314,17 +421,17 @@ static void triangulate(pointnlink_t ** pnlps, int pnln)
 			pnlip2 = (pnli + 2) % pnln;
 			if (isdiagonal(pnli, pnlip2, pnlps, pnln)) 
 			{
-				loadtriangle(pnlps[pnli], pnlps[pnlip1], pnlps[pnlip2]);
+				loadtriangle(w, pnlps[pnli], pnlps[pnlip1], pnlps[pnlip2]);
 				for (pnli = pnlip1; pnli < pnln - 1; pnli++)
 					pnlps[pnli] = pnlps[pnli + 1];
-				triangulate(pnlps, pnln - 1);
+				triangulate(w, pnlps, pnln - 1);
 				return;
 			}
 		}
 		prerror("triangulation failed");
     } 
 	else
-		loadtriangle(pnlps[0], pnlps[1], pnlps[2]);
+		loadtriangle(w, pnlps[0], pnlps[1], pnlps[2]);
 }
 
 /* check if (i, i + 2) is a diagonal */
@@ -363,16 +470,381 @@ static int isdiagonal(int pnli, int pnlip2, pointnlink_t ** pnlps,
     return TRUE;
 }
 
-static void loadtriangle(pointnlink_t * pnlap, pointnlink_t * pnlbp,
-			 pointnlink_t * pnlcp)
+/* Monotone triangulation.
+ * A sweep from the top splits the polygon into y-monotone pieces with
+ * diagonals from its split and merge vertices, as in de Berg et al.,
+ * "Computational Geometry", ch. 3; each piece is then triangulated in
+ * linear time. Vertices of equal height are ordered left to right, as if
+ * the plane were turned a little, so horizontal edges need no special
+ * case. Apart from sorting the vertices, the sweep does a binary search
+ * among the edges crossing the sweep line at each split, merge and
+ * right-hand regular vertex.
+ */
+
+#define START   0
+#define SPLIT   1
+#define END     2
+#define MERGE   3
+#define REGULAR 4
+
+#define MPT(m,v)  ((m)->pnlps[v]->pp)
+#define ABOVE(m,a,b) ((m)->rank[a] < (m)->rank[b])
+#define NEXTV(m,v) ((v) + 1 == (m)->n ? 0 : (v) + 1)
+#define PREVV(m,v) ((v) == 0 ? (m)->n - 1 : (v) - 1)
+
+static int mvcmp(const void *a, const void *b)
+{
+    const mvert_t *p = a, *q = b;
+
+    if (p->y != q->y)
+	return (p->y > q->y ? -1 : 1);
+    if (p->x != q->x)
+	return (p->x < q->x ? -1 : 1);
+    return p->i - q->i;
+}
+
+/* edgex:
+ * The x coordinate of edge e, from vertex e to the next one, at height y.
+ */
+static double edgex(mono_t * m, int e, double y)
+{
+    Ppoint_t *a = MPT(m, e), *b = MPT(m, NEXTV(m, e));
+
+    if (a->y == b->y)
+	return (a->x < b->x ? a->x : b->x);
+    return a->x + (y - a->y) * (b->x - a->x) / (b->y - a->y);
+}
+
+/* statpos:
+ * The number of edges in the sweep status that are at or left of v.
+ */
+static int statpos(mono_t * m, int v)
+{
+    Ppoint_t *p = MPT(m, v);
+    int lo = 0, hi = m->statn, mid;
+
+    while (lo < hi) {
+	mid = (lo + hi) / 2;
+	if (edgex(m, m->status[mid], p->y) <= p->x)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/* leftof:
+ * The edge in the sweep status directly left of v, or -1.
+ */
+static int leftof(mono_t * m, int v)
+{
+    int k = statpos(m, v);
+
+    return (k > 0 ? m->status[k - 1] : -1);
+}
+
+/* insert edge e, whose upper end is v, into the sweep status */
+static void statinsert(mono_t * m, int e, int v)
+{
+    int k = statpos(m, v), j;
+
+    for (j = m->statn; j > k; j--)
+	m->status[j] = m->status[j - 1];
+    m->status[k] = e;
+    m->statn++;
+    m->helper[e] = v;
+}
+
+static int statremove(mono_t * m, int e)
+{
+    int k, j;
+
+    for (k = 0; k < m->statn; k++)
+	if (m->status[k] == e) {
+	    for (j = k + 1; j < m->statn; j++)
+		m->status[j - 1] = m->status[j];
+	    m->statn--;
+	    return TRUE;
+	}
+    return FALSE;
+}
+
+static int adddiag(mono_t * m, int a, int b)
+{
+    if (m->diagn >= m->n)
+	return FALSE;
+    m->diags[2 * m->diagn] = a;
+    m->diags[2 * m->diagn + 1] = b;
+    m->diagn++;
+    return TRUE;
+}
+
+/* fixup:
+ * If the helper of edge e is a merge vertex, join it to v.
+ */
+static int fixup(mono_t * m, int e, int v)
+{
+    if (m->type[m->helper[e]] == MERGE)
+	return adddiag(m, v, m->helper[e]);
+    return TRUE;
+}
+
+/* sweep:
+ * Add the diagonals that split the polygon into monotone pieces.
+ */
+static int sweep(mono_t * m, mvert_t * mvs)
+{
+    int k, v, prev, next, e, pa, na, cvx;
+
+    for (k = 0; k < m->n; k++)
+	m->rank[mvs[k].i] = k;
+    for (v = 0; v < m->n; v++) {
+	prev = PREVV(m, v), next = NEXTV(m, v);
+	pa = ABOVE(m, prev, v), na = ABOVE(m, next, v);
+	cvx = (ccw(MPT(m, prev), MPT(m, v), MPT(m, next)) != ISCW);
+	if (!pa && !na)
+	    m->type[v] = (cvx ? START : SPLIT);
+	else if (pa && na)
+	    m->type[v] = (cvx ? END : MERGE);
+	else
+	    m->type[v] = REGULAR;
+    }
+
+    m->statn = m->diagn = 0;
+    for (k = 0; k < m->n; k++) {
+	v = mvs[k].i;
+	prev = PREVV(m, v);
+	switch (m->type[v]) {
+	case START:
+	    statinsert(m, v, v);
+	    break;
+	case END:
+	    if (!fixup(m, prev, v) || !statremove(m, prev))
+		return FALSE;
+	    break;
+	case SPLIT:
+	    if ((e = leftof(m, v)) < 0 || !adddiag(m, v, m->helper[e]))
+		return FALSE;
+	    m->helper[e] = v;
+	    statinsert(m, v, v);
+	    break;
+	case MERGE:
+	    if (!fixup(m, prev, v) || !statremove(m, prev))
+		return FALSE;
+	    if ((e = leftof(m, v)) < 0 || !fixup(m, e, v))
+		return FALSE;
+	    m->helper[e] = v;
+	    break;
+	default:
+	    if (ABOVE(m, prev, v)) {	/* the interior is to the right */
+		if (!fixup(m, prev, v) || !statremove(m, prev))
+		    return FALSE;
+		statinsert(m, v, v);
+	    } else {
+		if ((e = leftof(m, v)) < 0 || !fixup(m, e, v))
+		    return FALSE;
+		m->helper[e] = v;
+	    }
+	    break;
+	}
+    }
+    return TRUE;
+}
+
+/* mktri:
+ * Load the triangle abc counterclockwise, unless it is flat. A flat
+ * triangle lies along the boundary and separates nothing.
+ */
+static void mktri(spwork_t * w, mono_t * m, int a, int b, int c)
+{
+    int d;
+
+    m->trin++;
+    d = ccw(MPT(m, a), MPT(m, b), MPT(m, c));
+    if (d == ISON)
+	return;
+    if (d == ISCW)
+	d = b, b = c, c = d;
+    loadtriangle(w, m->pnlps[a], m->pnlps[b], m->pnlps[c]);
+}
+
+/* monopiece:
+ * Triangulate the monotone piece in face[0..fn-1], counterclockwise.
+ * Going counterclockwise from the top vertex runs down the left chain.
+ */
+static int monopiece(spwork_t * w, mono_t * m, int fn)
+{
+    int *f = m->face, *u = m->u, *side = m->side, *st = m->stack;
+    int top, bot, i, l, r, k, j, ns, last;
+
+    for (top = bot = 0, i = 1; i < fn; i++) {
+	if (ABOVE(m, f[i], f[top]))
+	    top = i;
+	if (ABOVE(m, f[bot], f[i]))
+	    bot = i;
+    }
+
+    /* merge the chains by height, checking that they are monotone */
+    u[0] = f[top], side[0] = 0;
+    l = (top + 1) % fn, r = (top + fn - 1) % fn;
+    for (k = 1; k < fn - 1; k++) {
+	if (r == bot || (l != bot && ABOVE(m, f[l], f[r]))) {
+	    u[k] = f[l], side[k] = 0;
+	    l = (l + 1) % fn;
+	} else {
+	    u[k] = f[r], side[k] = 1;
+	    r = (r + fn - 1) % fn;
+	}
+	if (!ABOVE(m, u[k - 1], u[k]))
+	    return FALSE;
+    }
+    u[fn - 1] = f[bot];
+    if (!ABOVE(m, u[fn - 2], u[fn - 1]))
+	return FALSE;
+
+    st[0] = 0, st[1] = 1, ns = 2;
+    for (j = 2; j < fn - 1; j++) {
+	if (side[j] != side[st[ns - 1]]) {
+	    for (; ns > 1; ns--)
+		mktri(w, m, u[j], u[st[ns - 1]], u[st[ns - 2]]);
+	    st[0] = j - 1, st[1] = j, ns = 2;
+	} else {
+	    last = st[--ns];
+	    while (ns > 0 && ccw(MPT(m, side[j] ? u[j] : u[st[ns - 1]]),
+				 MPT(m, u[last]),
+				 MPT(m, side[j] ? u[st[ns - 1]] : u[j]))
+		   == ISCCW) {
+		mktri(w, m, u[j], u[last], u[st[ns - 1]]);
+		last = st[--ns];
+	    }
+	    st[ns++] = last;
+	    st[ns++] = j;
+	}
+    }
+    for (; ns > 1; ns--)
+	mktri(w, m, u[fn - 1], u[st[ns - 1]], u[st[ns - 2]]);
+    return TRUE;
+}
+
+/* nextout:
+ * Leaving v, having come from u, the outgoing edge of v first clockwise
+ * from vu keeps the piece being traced on the left.
+ */
+static int nextout(mono_t * m, int v, int u)
+{
+    Ppoint_t *p = MPT(m, v), *q;
+    double a0, d, bestd = 0;
+    int s, best = -1;
+
+    if (m->start[v + 1] - m->start[v] == 1)
+	return m->start[v];
+    a0 = atan2(MPT(m, u)->y - p->y, MPT(m, u)->x - p->x);
+    for (s = m->start[v]; s < m->start[v + 1]; s++) {
+	q = MPT(m, m->adj[s]);
+	d = a0 - atan2(q->y - p->y, q->x - p->x);
+	while (d <= 0)
+	    d += 2 * M_PI;
+	while (d > 2 * M_PI)
+	    d -= 2 * M_PI;
+	if (best < 0 || d < bestd)
+	    best = s, bestd = d;
+    }
+    return best;
+}
+
+/* monotriangulate:
+ * Triangulate the counterclockwise polygon pnlps[0..pnln-1] through
+ * monotone pieces. Return FALSE if the polygon is too degenerate for
+ * it, so that the caller can fall back to ear clipping.
+ */
+static int monotriangulate(spwork_t * w, pointnlink_t ** pnlps, int pnln)
+{
+    mono_t m;
+    int n = pnln, i, v, s, s0, u, fn, nfaces;
+
+    if (n <= 3)
+	return FALSE;
+    w->mvs = growbuf(w, w->mvs, &w->mvn, n, sizeof(mvert_t));
+    for (i = 0; i < n; i++) {
+	w->mvs[i].x = pnlps[i]->pp->x;
+	w->mvs[i].y = pnlps[i]->pp->y;
+	w->mvs[i].i = i;
+    }
+    qsort(w->mvs, n, sizeof(mvert_t), mvcmp);
+
+    /* there are fewer than n diagonals, so fewer than 3n outgoing edges */
+    w->ints = growbuf(w, w->ints, &w->intn, 17 * n + 1, sizeof(int));
+    m.pnlps = pnlps;
+    m.n = n;
+    m.rank = w->ints;
+    m.type = m.rank + n;
+    m.helper = m.type + n;
+    m.status = m.helper + n;
+    m.diags = m.status + n;
+    m.start = m.diags + 2 * n;
+    m.adj = m.start + n + 1;
+    m.used = m.adj + 3 * n;
+    m.face = m.used + 3 * n;
+    m.u = m.face + n;
+    m.side = m.u + n;
+    m.stack = m.side + n;
+    m.trin = 0;
+
+    if (!sweep(&m, w->mvs))
+	return FALSE;
+
+    /* list the outgoing edges of each vertex, the polygon edge first */
+    for (v = 0; v <= n; v++)
+	m.start[v] = v;
+    for (i = 0; i < 2 * m.diagn; i++)
+	m.start[m.diags[i] + 1]++;
+    for (v = 0; v < n; v++)
+	m.start[v + 1] += m.start[v] - v;
+    for (v = 0; v < n; v++) {
+	m.adj[m.start[v]] = NEXTV(&m, v);
+	m.used[v] = 1;		/* next free slot of v */
+    }
+    for (i = 0; i < m.diagn; i++) {
+	u = m.diags[2 * i], v = m.diags[2 * i + 1];
+	m.adj[m.start[u] + m.used[u]++] = v;
+	m.adj[m.start[v] + m.used[v]++] = u;
+    }
+    for (s = 0; s < m.start[n]; s++)
+	m.used[s] = FALSE;
+
+    /* trace each piece and triangulate it */
+    for (nfaces = 0, v = 0; v < n; v++)
+	for (s0 = m.start[v]; s0 < m.start[v + 1]; s0++) {
+	    if (m.used[s0])
+		continue;
+	    for (fn = 0, u = v, s = s0;;) {
+		m.used[s] = TRUE;
+		m.face[fn++] = u;
+		i = m.adj[s];
+		s = nextout(&m, i, u);
+		u = i;
+		if (s == s0)
+		    break;
+		if (m.used[s] || fn >= n)
+		    return FALSE;
+	    }
+	    if (fn < 3 || !monopiece(w, &m, fn))
+		return FALSE;
+	    nfaces++;
+	}
+    return (nfaces == m.diagn + 1 && m.trin == n - 2);
+}
+
+static void loadtriangle(spwork_t * w, pointnlink_t * pnlap,
+			 pointnlink_t * pnlbp, pointnlink_t * pnlcp)
 {
     triangle_t *trip;
     int ei;
 
     /* make space */
-    if (tril >= trin)
-	growtris(trin + 20);
-    trip = &tris[tril++];
+    if (w->tril >= w->trin)
+	growtris(w, w->trin + 20);
+    trip = &w->tris[w->tril++];
     trip->mark = 0;
     trip->e[0].pnl0p = pnlap, trip->e[0].pnl1p = pnlbp, trip->e[0].rtp =
 	NULL;
@@ -385,14 +857,14 @@ static void loadtriangle(pointnlink_t * pnlap, pointnlink_t * pnlbp,
 }
 
 /* connect a pair of triangles at their common edge (if any) */
-static void connecttris(int tri1, int tri2)
+static void connecttris(spwork_t * w, int tri1, int tri2)
 {
     triangle_t *tri1p, *tri2p;
     int ei, ej;
 
     for (ei = 0; ei < 3; ei++) {
 	for (ej = 0; ej < 3; ej++) {
-	    tri1p = &tris[tri1], tri2p = &tris[tri2];
+	    tri1p = &w->tris[tri1], tri2p = &w->tris[tri2];
 	    if ((tri1p->e[ei].pnl0p->pp == tri2p->e[ej].pnl0p->pp &&
 		 tri1p->e[ei].pnl1p->pp == tri2p->e[ej].pnl1p->pp) ||
 		(tri1p->e[ei].pnl0p->pp == tri2p->e[ej].pnl1p->pp &&
@@ -402,61 +874,100 @@ static void connecttris(int tri1, int tri2)
     }
 }
 
+static int trefcmp(const void *a, const void *b)
+{
+    const tref_t *p = a, *q = b;
+
+    if (p->lo != q->lo)
+	return (p->lo < q->lo ? -1 : 1);
+    if (p->hi != q->hi)
+	return (p->hi < q->hi ? -1 : 1);
+    if (p->tri != q->tri)
+	return p->tri - q->tri;
+    return p->e - q->e;
+}
+
+/* connectedges:
+ * Connect the triangles that share an edge, as connecttris does for each
+ * pair, by sorting the edges of all triangles.
+ */
+static void connectedges(spwork_t * w)
+{
+    int n = 3 * w->tril, i, ei;
+    tref_t *r;
+
+    w->trefs = growbuf(w, w->trefs, &w->trefn, n, sizeof(tref_t));
+    for (i = 0; i < w->tril; i++)
+	for (ei = 0; ei < 3; ei++) {
+	    r = &w->trefs[3 * i + ei];
+	    r->lo = w->tris[i].e[ei].pnl0p, r->hi = w->tris[i].e[ei].pnl1p;
+	    if (r->lo > r->hi)
+		r->lo = r->hi, r->hi = w->tris[i].e[ei].pnl0p;
+	    r->tri = i, r->e = ei;
+	}
+    qsort(w->trefs, n, sizeof(tref_t), trefcmp);
+    for (r = w->trefs, i = 0; i + 1 < n; i++)
+	if (r[i].lo == r[i + 1].lo && r[i].hi == r[i + 1].hi) {
+	    w->tris[r[i].tri].e[r[i].e].rtp = &w->tris[r[i + 1].tri];
+	    w->tris[r[i + 1].tri].e[r[i + 1].e].rtp = &w->tris[r[i].tri];
+	}
+}
+
 /* find and mark path from trii, to trij */
-static int marktripath(int trii, int trij)
+static int marktripath(spwork_t * w, int trii, int trij)
 {
     int ei;
 
-    if (tris[trii].mark)
+    if (w->tris[trii].mark)
 	return FALSE;
-    tris[trii].mark = 1;
+    w->tris[trii].mark = 1;
     if (trii == trij)
 	return TRUE;
     for (ei = 0; ei < 3; ei++)
-	if (tris[trii].e[ei].rtp &&
-	    marktripath(tris[trii].e[ei].rtp - tris, trij))
+	if (w->tris[trii].e[ei].rtp &&
+	    marktripath(w, w->tris[trii].e[ei].rtp - w->tris, trij))
 	    return TRUE;
-    tris[trii].mark = 0;
+    w->tris[trii].mark = 0;
     return FALSE;
 }
 
 /* add a new point to the deque, either front or back */
-static void add2dq(int side, pointnlink_t * pnlp)
+static void add2dq(spwork_t * w, int side, pointnlink_t * pnlp)
 {
     if (side == DQ_FRONT) {
-	if (dq.lpnlpi - dq.fpnlpi >= 0)
-	    pnlp->link = dq.pnlps[dq.fpnlpi];	/* shortest path links */
-	dq.fpnlpi--;
-	dq.pnlps[dq.fpnlpi] = pnlp;
+	if (w->dq.lpnlpi - w->dq.fpnlpi >= 0)
+	    pnlp->link = w->dq.pnlps[w->dq.fpnlpi];	/* shortest path links */
+	w->dq.fpnlpi--;
+	w->dq.pnlps[w->dq.fpnlpi] = pnlp;
     } else {
-	if (dq.lpnlpi - dq.fpnlpi >= 0)
-	    pnlp->link = dq.pnlps[dq.lpnlpi];	/* shortest path links */
-	dq.lpnlpi++;
-	dq.pnlps[dq.lpnlpi] = pnlp;
+	if (w->dq.lpnlpi - w->dq.fpnlpi >= 0)
+	    pnlp->link = w->dq.pnlps[w->dq.lpnlpi];	/* shortest path links */
+	w->dq.lpnlpi++;
+	w->dq.pnlps[w->dq.lpnlpi] = pnlp;
     }
 }
 
-static void splitdq(int side, int index)
+static void splitdq(spwork_t * w, int side, int index)
 {
     if (side == DQ_FRONT)
-	dq.lpnlpi = index;
+	w->dq.lpnlpi = index;
     else
-	dq.fpnlpi = index;
+	w->dq.fpnlpi = index;
 }
 
-static int finddqsplit(pointnlink_t * pnlp)
+static int finddqsplit(spwork_t * w, pointnlink_t * pnlp)
 {
     int index;
 
-    for (index = dq.fpnlpi; index < dq.apex; index++)
-	if (ccw(dq.pnlps[index + 1]->pp, dq.pnlps[index]->pp, pnlp->pp) ==
+    for (index = w->dq.fpnlpi; index < w->dq.apex; index++)
+	if (ccw(w->dq.pnlps[index + 1]->pp, w->dq.pnlps[index]->pp, pnlp->pp) ==
 	    ISCCW)
 	    return index;
-    for (index = dq.lpnlpi; index > dq.apex; index--)
-	if (ccw(dq.pnlps[index - 1]->pp, dq.pnlps[index]->pp, pnlp->pp) ==
+    for (index = w->dq.lpnlpi; index > w->dq.apex; index--)
+	if (ccw(w->dq.pnlps[index - 1]->pp, w->dq.pnlps[index]->pp, pnlp->pp) ==
 	    ISCW)
 	    return index;
-    return dq.apex;
+    return w->dq.apex;
 }
 
 /* ccw test: CCW, CW, or co-linear */
@@ -503,102 +1014,114 @@ static int between(Ppoint_t * pap, Ppoint_t * pbp, Ppoint_t * pcp)
 	(p2.x * p2.x + p2.y * p2.y <= p1.x * p1.x + p1.y * p1.y);
 }
 
-static int pointintri(int trii, Ppoint_t * pp)
+static int pointintri(spwork_t * w, int trii, Ppoint_t * pp)
 {
     int ei, sum;
 
     for (ei = 0, sum = 0; ei < 3; ei++)
-	if (ccw(tris[trii].e[ei].pnl0p->pp,
-		tris[trii].e[ei].pnl1p->pp, pp) != ISCW)
+	if (ccw(w->tris[trii].e[ei].pnl0p->pp,
+		w->tris[trii].e[ei].pnl1p->pp, pp) != ISCW)
 	    sum++;
     return (sum == 3 || sum == 0);
 }
 
-static void growpnls(int newpnln)
+static void growpnls(spwork_t * w, int newpnln)
 {
-    if (newpnln <= pnln)
+    if (newpnln <= w->pnln)
 	return;
-    if (!pnls) {
-	if (!(pnls = (pointnlink_t *) malloc(POINTNLINKSIZE * newpnln))) {
+    if (!w->pnls) {
+	if (!(w->pnls = (pointnlink_t *) malloc(POINTNLINKSIZE * newpnln))) {
 	    prerror("cannot malloc pnls");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
-	if (!(pnlps = (pointnlink_t **) malloc(POINTNLINKPSIZE * newpnln))) {
+	if (!(w->pnlps = (pointnlink_t **) malloc(POINTNLINKPSIZE * newpnln))) {
 	    prerror("cannot malloc pnlps");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     } else {
-	if (!(pnls = (pointnlink_t *) realloc((void *) pnls,
+	if (!(w->pnls = (pointnlink_t *) realloc((void *) w->pnls,
 					      POINTNLINKSIZE * newpnln))) {
 	    prerror("cannot realloc pnls");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
-	if (!(pnlps = (pointnlink_t **) realloc((void *) pnlps,
+	if (!(w->pnlps = (pointnlink_t **) realloc((void *) w->pnlps,
 						POINTNLINKPSIZE *
 						newpnln))) {
 	    prerror("cannot realloc pnlps");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     }
-    pnln = newpnln;
+    w->pnln = newpnln;
 }
 
-static void growtris(int newtrin)
+static void growtris(spwork_t * w, int newtrin)
 {
-    if (newtrin <= trin)
+    if (newtrin <= w->trin)
 	return;
-    if (!tris) {
-	if (!(tris = (triangle_t *) malloc(TRIANGLESIZE * newtrin))) {
+    if (!w->tris) {
+	if (!(w->tris = (triangle_t *) malloc(TRIANGLESIZE * newtrin))) {
 	    prerror("cannot malloc tris");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     } else {
-	if (!(tris = (triangle_t *) realloc((void *) tris,
+	if (!(w->tris = (triangle_t *) realloc((void *) w->tris,
 					    TRIANGLESIZE * newtrin))) {
 	    prerror("cannot realloc tris");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     }
-    trin = newtrin;
+    w->trin = newtrin;
 }
 
-static void growdq(int newdqn)
+static void growdq(spwork_t * w, int newdqn)
 {
-    if (newdqn <= dq.pnlpn)
+    if (newdqn <= w->dq.pnlpn)
 	return;
-    if (!dq.pnlps) {
+    if (!w->dq.pnlps) {
 	if (!
-	    (dq.pnlps =
+	    (w->dq.pnlps =
 	     (pointnlink_t **) malloc(POINTNLINKPSIZE * newdqn))) {
 	    prerror("cannot malloc dq.pnls");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     } else {
-	if (!(dq.pnlps = (pointnlink_t **) realloc((void *) dq.pnlps,
+	if (!(w->dq.pnlps = (pointnlink_t **) realloc((void *) w->dq.pnlps,
 						   POINTNLINKPSIZE *
 						   newdqn))) {
 	    prerror("cannot realloc dq.pnls");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     }
-    dq.pnlpn = newdqn;
+    w->dq.pnlpn = newdqn;
 }
 
-static void growops(int newopn)
+static void growops(spwork_t * w, int newopn)
 {
-    if (newopn <= opn)
+    if (newopn <= w->opn)
 	return;
-    if (!ops) {
-	if (!(ops = (Ppoint_t *) malloc(POINTSIZE * newopn))) {
+    if (!w->ops) {
+	if (!(w->ops = (Ppoint_t *) malloc(POINTSIZE * newopn))) {
 	    prerror("cannot malloc ops");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     } else {
-	if (!(ops = (Ppoint_t *) realloc((void *) ops,
+	if (!(w->ops = (Ppoint_t *) realloc((void *) w->ops,
 					 POINTSIZE * newopn))) {
 	    prerror("cannot realloc ops");
-	    longjmp(jbuf,1);
+	    longjmp(w->jbuf,1);
 	}
     }
-    opn = newopn;
+    w->opn = newopn;
+}
+
+static void *growbuf(spwork_t * w, void *p, int *np, int n, size_t size)
+{
+    if (n <= *np)
+	return p;
+    if (!(p = realloc(p, n * size))) {
+	prerror("cannot realloc triangulation buffer");
+	longjmp(w->jbuf,1);
+    }
+    *np = n;
+    return p;
 }
@@ -87,6 +87,138 @@ int *shortestPath(int root, int target, int V, array2 wadj)
     return dad;
 }
 
+/* heap of (distance, vertex) pairs, least first, ties to the lower vertex */
+typedef struct {
+    int n, sz;
+    int *v;
+    COORD *d;
+} vheap_t;
+
+#define BEFORE(h,i,j) ((h)->d[i] < (h)->d[j] || \
+    ((h)->d[i] == (h)->d[j] && (h)->v[i] < (h)->v[j]))
+
+static void swapitems(vheap_t * h, int i, int j)
+{
+    int v = h->v[i];
+    COORD d = h->d[i];
+
+    h->v[i] = h->v[j];
+    h->d[i] = h->d[j];
+    h->v[j] = v;
+    h->d[j] = d;
+}
+
+static void heappush(vheap_t * h, int v, COORD d)
+{
+    int i, p;
+
+    if (h->n == h->sz) {
+	h->sz = 2 * h->sz + 64;
+	h->v = (int *) realloc(h->v, h->sz * sizeof(int));
+	h->d = (COORD *) realloc(h->d, h->sz * sizeof(COORD));
+    }
+    i = h->n++;
+    h->v[i] = v;
+    h->d[i] = d;
+    for (; i > 0 && BEFORE(h, i, p = (i - 1) / 2); i = p)
+	swapitems(h, i, p);
+}
+
+static void heappop(vheap_t * h, int *v, COORD * d)
+{
+    int i, c;
+
+    *v = h->v[0];
+    *d = h->d[0];
+    h->n--;
+    h->v[0] = h->v[h->n];
+    h->d[0] = h->d[h->n];
+    for (i = 0; (c = 2 * i + 1) < h->n; i = c) {
+	if (c + 1 < h->n && BEFORE(h, c + 1, c))
+	    c++;
+	if (!BEFORE(h, c, i))
+	    break;
+	swapitems(h, i, c);
+    }
+}
+
+/* rowPath:
+ * As shortestPath from p (V+1) to q (V), for a configuration opened
+ * by Pobsopen_incremental. The visibility of a vertex is computed when
+ * the vertex is reached, so only the vertices closer to p than q is are
+ * looked at. Vertices are taken in the same order as by shortestPath,
+ * including ties, so the path is the same.
+ * If q cannot be reached, the path goes straight from p to q.
+ */
+static int *rowPath(vconfig_t * conf, COORD * pvis, COORD * qvis)
+{
+    int V = conf->N;
+    int root = V + 1;
+    int *dad;
+    COORD *val;
+    char *done;
+    vheap_t heap;
+    visrow_t *row;
+    COORD d;
+    int i, k, t;
+
+    dad = (int *) malloc((V + 2) * sizeof(int));
+    val = (COORD *) malloc((V + 2) * sizeof(COORD));
+    done = (char *) calloc(V + 2, sizeof(char));
+    for (k = 0; k < V + 2; k++) {
+	dad[k] = -1;
+	val[k] = unseen;
+    }
+    heap.n = heap.sz = 0;
+    heap.v = NULL;
+    heap.d = NULL;
+
+#define RELAX(t,w) \
+    if ((w) != 0 && !done[t] && val[k] + (w) < val[t]) { \
+	val[t] = val[k] + (w); \
+	dad[t] = k; \
+	heappush(&heap, t, val[t]); \
+    }
+
+    k = root;
+    val[k] = 0;
+    while (k != V) {
+	done[k] = 1;
+	if (k == root) {
+	    for (t = 0; t < V; t++)
+		RELAX(t, pvis[t]);
+	} else {
+	    row = visrow(conf, k);
+	    for (i = 0; i < row->n; i++) {
+		t = row->idx[i];
+		RELAX(t, row->d[i]);
+	    }
+	    RELAX(V, qvis[k]);
+	}
+	/* next closest vertex, skipping stale entries */
+	k = -1;
+	while (heap.n > 0) {
+	    heappop(&heap, &t, &d);
+	    if (!done[t] && d == val[t]) {
+		k = t;
+		break;
+	    }
+	}
+	if (k < 0) {
+	    dad[V] = root;
+	    break;
+	}
+    }
+#undef RELAX
+
+    dad[root] = -1;
+    free(heap.v);
+    free(heap.d);
+    free(val);
+    free(done);
+    return dad;
+}
+
 /* makePath:
  * Given two points p and q in two polygons pp and qp of a vconfig_t conf, 
  * and the visibility vectors of p and q relative to conf, 
@@ -107,6 +239,8 @@ int *makePath(Ppoint_t p, int pp, COORD * pvis,
 	dad[V] = V + 1;
 	dad[V + 1] = -1;
 	return dad;
+    } else if (!conf->vis) {
+	return rowPath(conf, pvis, qvis);
     } else {
 	array2 wadj = conf->vis;
 	wadj[V] = qvis;
@@ -45,6 +45,21 @@ void freepoly(Ppoly_t argpoly)
     free(argpoly.ps);
 }
 
+Pworkspace_t *Pnewworkspace(void)
+{
+    return calloc(1, sizeof(Pworkspace_t));
+}
+
+void Pfreeworkspace(Pworkspace_t * ws)
+{
+    if (!ws)
+	return;
+    freeshortest(ws->shortest);
+    freeroute(ws->route);
+    free(ws->ispline);
+    free(ws);
+}
+
 int Ppolybarriers(Ppoly_t ** polys, int npolys, Pedge_t ** barriers,
 		  int *n_barriers)
 {
@@ -76,19 +91,19 @@ int Ppolybarriers(Ppoly_t ** polys, int npolys, Pedge_t ** barriers,
     return 1;
 }
 
-/* make_polyline:
+/* mkpolyline:
+ * Store the spline points of the polyline in the buffer *isp of size *iszp.
  */
-void
-make_polyline(Ppolyline_t line, Ppolyline_t* sline)
+static void
+mkpolyline(Ppolyline_t line, Ppolyline_t* sline, Ppoint_t** isp, int* iszp)
 {
-    static int isz = 0;
-    static Ppoint_t* ispline = 0;
+    Ppoint_t* ispline = *isp;
     int i, j;
     int npts = 4 + 3*(line.pn-2);
 
-    if (npts > isz) {
-	ispline = ALLOC(npts, ispline, Ppoint_t); 
-	isz = npts;
+    if (npts > *iszp) {
+	ispline = *isp = ALLOC(npts, ispline, Ppoint_t); 
+	*iszp = npts;
     }
 
     j = i = 0;
@@ -105,3 +120,23 @@ make_polyline(Ppolyline_t line, Ppolyline_t* sline)
     sline->ps = ispline;
 }
 
+/* make_polyline:
+ */
+void
+make_polyline(Ppolyline_t line, Ppolyline_t* sline)
+{
+    static int isz = 0;
+    static Ppoint_t* ispline = 0;
+
+    mkpolyline(line, sline, &ispline, &isz);
+}
+
+/* make_polyline_w:
+ * As make_polyline, but the points are kept in the workspace.
+ */
+void
+make_polyline_w(Pworkspace_t* ws, Ppolyline_t line, Ppolyline_t* sline)
+{
+    mkpolyline(line, sline, &ws->ispline, &ws->isz);
+}
+
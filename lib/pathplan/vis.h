@@ -31,10 +31,24 @@ extern "C" {
 #define	OBSCURED	0.0
 #define EQ(p,q)		((p.x == q.x) && (p.y == q.y))
 #define NEQ(p,q)	(!EQ(p,q))
+#ifndef MIN
+#define MIN(a,b)	((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a,b)	((a) > (b) ? (a) : (b))
+#endif
 #define NIL(p)		((p)0)
 #define	CW			0
 #define	CCW			1
 
+    /* visibility of one vertex: the vertices idx[0..n-1] it sees,
+     * at distances d[0..n-1]; n < 0 if not yet computed */
+    typedef struct {
+	int n;
+	int *idx;
+	COORD *d;
+    } visrow_t;
+
     struct vconfig_s {
 	int Npoly;
 	int N;			/* number of points in walk of barriers */
@@ -45,6 +59,25 @@ extern "C" {
 
 	/* this is computed from the above */
 	array2 vis;
+
+	/* grid of cells over the barriers; edge k starts at P[k], and the
+	 * edges near cell c are gedge[gstart[c]..gstart[c+1]-1] */
+	Ppoint_t gorig;		/* lower left corner of the grid */
+	COORD gsize;		/* side of a cell */
+	int gnx, gny;		/* number of columns and rows */
+	int *gstart;
+	int *gedge;
+	int *gmark;		/* last query that tested each edge */
+	int gquery;
+
+	/* with Pobsopen_incremental, vis is NULL and the visibility
+	 * of each vertex is kept in rows, computed when first needed */
+	visrow_t *rows;
+	int *rowidx;		/* scratch for building a row */
+	COORD *rowd;
+	/* and the visibility of the last path endpoint in each polygon */
+	visrow_t *endrows;
+	Ppoint_t *endpts;
     };
 #ifdef _WIN32
 #ifndef PATHPLAN_EXPORTS
@@ -56,6 +89,8 @@ extern "C" {
 	extern COORD *ptVis(vconfig_t *, int, Ppoint_t);
     extern int directVis(Ppoint_t, int, Ppoint_t, int, vconfig_t *);
     extern void visibility(vconfig_t *);
+    extern void visgrid(vconfig_t *);
+    extern visrow_t *visrow(vconfig_t *, int);
     extern int *makePath(Ppoint_t p, int pp, COORD * pvis,
 			 Ppoint_t q, int qp, COORD * qvis,
 			 vconfig_t * conf);
@@ -12,12 +12,16 @@
  *************************************************************************/
 
 
+#include <string.h>
 #include "vis.h"
 
 #ifdef DMALLOC
 #include "dmalloc.h"
 #endif
 
+/* slack for rounding when locating points in the grid */
+#define GRIDEPS(conf) (1e-9 * ((conf)->gsize * ((conf)->gnx + (conf)->gny) + 1))
+
 	/* TRANSPARENT means router sees past colinear obstacles */
 #ifdef TRANSPARENT
 #define INTERSECT(a,b,c,d,e) intersect1((a),(b),(c),(d),(e))
@@ -231,23 +235,179 @@ static int inCone(int i, int j, Ppoint_t pts[], int nextPt[], int prevPt[])
     return in_cone(pts[prevPt[i]], pts[i], pts[nextPt[i]], pts[j]);
 }
 
+#define GRIDMAX 1024		/* at most this many columns or rows */
+
+/* Segments are collinear if twice their triangle's area is within
+ * .0001 (see wind); a little more allows for rounding.
+ */
+#define WINDTOL .0002
+
+/* gcell:
+ * Return the cell of the grid, of n cells of side sz from o,
+ * holding the coordinate v. Values off the grid go to the nearest cell.
+ */
+static int gcell(COORD v, COORD o, COORD sz, int n)
+{
+    COORD c = floor((v - o) / sz);
+
+    if (c < 0)
+	return 0;
+    if (c >= n)
+	return n - 1;
+    return (int) c;
+}
+
+/* gedges:
+ * Visit the grid cells under the bounding box, widened by eps, of
+ * barrier edge k, which runs from P[k] to P[next[k]]. If slot is NULL,
+ * count the edge in cnt; otherwise store it at the next slot of each cell.
+ */
+static void gedges(vconfig_t * conf, int k, COORD eps, int *cnt, int *slot)
+{
+    Ppoint_t p = conf->P[k];
+    Ppoint_t q = conf->P[conf->next[k]];
+    int x0 = gcell(MIN(p.x, q.x) - eps, conf->gorig.x, conf->gsize, conf->gnx);
+    int x1 = gcell(MAX(p.x, q.x) + eps, conf->gorig.x, conf->gsize, conf->gnx);
+    int y0 = gcell(MIN(p.y, q.y) - eps, conf->gorig.y, conf->gsize, conf->gny);
+    int y1 = gcell(MAX(p.y, q.y) + eps, conf->gorig.y, conf->gsize, conf->gny);
+    int x, y, c;
+
+    for (y = y0; y <= y1; y++)
+	for (x = x0; x <= x1; x++) {
+	    c = y * conf->gnx + x;
+	    if (slot)
+		conf->gedge[slot[c]++] = k;
+	    else
+		cnt[c]++;
+	}
+}
+
+/* visgrid:
+ * Register the barrier edges of conf in a grid of square cells
+ * covering the barriers, so that visibility tests only look at the
+ * edges near a segment. There are about as many cells as vertices.
+ */
+void visgrid(vconfig_t * conf)
+{
+    int V = conf->N;
+    Ppoint_t *pts = conf->P;
+    Ppoint_t ll, ur;
+    COORD w, h, sz;
+    int k, c, ncells;
+    int *slot;
+
+    conf->gstart = NULL;
+    conf->gedge = NULL;
+    conf->gmark = NULL;
+    conf->gquery = 0;
+    if (V == 0)
+	return;
+
+    ll = ur = pts[0];
+    for (k = 1; k < V; k++) {
+	ll.x = MIN(ll.x, pts[k].x);
+	ll.y = MIN(ll.y, pts[k].y);
+	ur.x = MAX(ur.x, pts[k].x);
+	ur.y = MAX(ur.y, pts[k].y);
+    }
+    w = ur.x - ll.x;
+    h = ur.y - ll.y;
+    sz = sqrt(w * h / V);
+    sz = MAX(sz, MAX(w, h) / (GRIDMAX - 1));
+    if (sz <= 0)
+	sz = 1;
+    conf->gorig = ll;
+    conf->gsize = sz;
+    conf->gnx = (int) (w / sz) + 1;
+    conf->gny = (int) (h / sz) + 1;
+    ncells = conf->gnx * conf->gny;
+
+    /* count the edges of each cell, then store them */
+    conf->gstart = (int *) calloc(ncells + 1, sizeof(int));
+    for (k = 0; k < V; k++)
+	gedges(conf, k, GRIDEPS(conf), conf->gstart + 1, NULL);
+    for (c = 0; c < ncells; c++)
+	conf->gstart[c + 1] += conf->gstart[c];
+    conf->gedge = (int *) malloc(MAX(conf->gstart[ncells], 1) * sizeof(int));
+    slot = (int *) malloc(ncells * sizeof(int));
+    memcpy(slot, conf->gstart, ncells * sizeof(int));
+    for (k = 0; k < V; k++)
+	gedges(conf, k, GRIDEPS(conf), NULL, slot);
+    free(slot);
+    conf->gmark = (int *) calloc(V, sizeof(int));
+}
+
 /* clear:
  * Return true if no polygon line segment non-trivially intersects
- * the segment [pti,ptj], ignoring segments in [start,end).
+ * the segment [a,b], ignoring segments in [s1,e1) and [s2,e2).
+ *
+ * Only the edges in the grid cells near [a,b] are tested. Those are the
+ * cells that [a,b] crosses, widened by rounding error, and by the band
+ * around [a,b] in which wind treats a point as collinear with a and b.
+ * The band is thin unless [a,b] is nearly, but not exactly, vertical.
  */
-static int clear(Ppoint_t pti, Ppoint_t ptj,
-		 int start, int end,
-		 int V, Ppoint_t pts[], int nextPt[], int prevPt[])
+static int clear(vconfig_t * conf, Ppoint_t a, Ppoint_t b,
+		 int s1, int e1, int s2, int e2)
 {
-    int k;
+    Ppoint_t *pts = conf->P;
+    int *nextPt = conf->next;
+    COORD eps = GRIDEPS(conf);
+    COORD sz = conf->gsize;
+    COORD lo, hi, xl, xr, ylo, yhi, hx, hy, slope;
+    int x, x0, x1, y, y0, y1, i, k;
 
-    for (k = 0; k < start; k++) {
-	if (INTERSECT(pti, ptj, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
+    if (EQ(a, b))		/* nothing lies strictly between */
+	return 1;
+    if (++conf->gquery == INT_MAX) {
+	memset(conf->gmark, 0, conf->N * sizeof(int));
+	conf->gquery = 1;
     }
-    for (k = end; k < V; k++) {
-	if (INTERSECT(pti, ptj, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
+    if (a.x != b.x) {
+	hx = eps;
+	hy = WINDTOL / fabs(b.x - a.x) + eps;
+	slope = (b.y - a.y) / (b.x - a.x);
+    } else {
+	hx = WINDTOL / fabs(b.y - a.y) + eps;
+	hy = eps;
+	slope = 0;
+    }
+    lo = MIN(a.x, b.x);
+    hi = MAX(a.x, b.x);
+    x0 = gcell(lo - hx, conf->gorig.x, sz, conf->gnx);
+    x1 = gcell(hi + hx, conf->gorig.x, sz, conf->gnx);
+    for (x = x0; x <= x1; x++) {
+	/* the part of [a,b] above column x */
+	xl = conf->gorig.x + x * sz - eps;
+	xr = xl + sz + 2 * eps;
+	xl = MIN(MAX(xl, lo), hi);
+	xr = MIN(MAX(xr, lo), hi);
+	if (a.x != b.x) {
+	    ylo = a.y + (xl - a.x) * slope;
+	    yhi = a.y + (xr - a.x) * slope;
+	    if (ylo > yhi) {
+		COORD t = ylo;
+		ylo = yhi;
+		yhi = t;
+	    }
+	} else {
+	    ylo = MIN(a.y, b.y);
+	    yhi = MAX(a.y, b.y);
+	}
+	y0 = gcell(ylo - hy, conf->gorig.y, sz, conf->gny);
+	y1 = gcell(yhi + hy, conf->gorig.y, sz, conf->gny);
+	for (y = y0; y <= y1; y++) {
+	    int c = y * conf->gnx + x;
+	    for (i = conf->gstart[c]; i < conf->gstart[c + 1]; i++) {
+		k = conf->gedge[i];
+		if (conf->gmark[k] == conf->gquery)
+		    continue;
+		conf->gmark[k] = conf->gquery;
+		if ((s1 <= k && k < e1) || (s2 <= k && k < e2))
+		    continue;
+		if (INTERSECT(a, b, pts[k], pts[nextPt[k]], pts[conf->prev[k]]))
+		    return 0;
+	    }
+	}
     }
     return 1;
 }
@@ -287,7 +447,7 @@ static void compVis(vconfig_t * conf, int start)
 	for (; j >= 0; j--) {
 	    if (inCone(i, j, pts, nextPt, prevPt) &&
 		inCone(j, i, pts, nextPt, prevPt) &&
-		clear(pts[i], pts[j], V, V, V, pts, nextPt, prevPt)) {
+		clear(conf, pts[i], pts[j], V, V, V, V)) {
 		/* if i and j see each other, add edge */
 		d = dist(pts[i], pts[j]);
 		wadj[i][j] = d;
@@ -308,6 +468,50 @@ void visibility(vconfig_t * conf)
     compVis(conf, 0);
 }
 
+/* visrow:
+ * Return the vertices seen by vertex k of conf, with their distances,
+ * computing them on the first call. These are the nonzero entries of
+ * row k of the matrix that visibility builds, and hold the same values.
+ */
+visrow_t *visrow(vconfig_t * conf, int k)
+{
+    visrow_t *row = &conf->rows[k];
+    int V = conf->N;
+    Ppoint_t *pts = conf->P;
+    int *nextPt = conf->next;
+    int *prevPt = conf->prev;
+    int hi, lo, j, n;
+    COORD d;
+
+    if (row->n >= 0)
+	return row;
+    n = 0;
+    for (j = 0; j < V; j++) {
+	if (j == k)
+	    continue;
+	/* test the pair in the order compVis does */
+	hi = MAX(j, k);
+	lo = MIN(j, k);
+	if (j == prevPt[k] || k == prevPt[j] ||
+	    (inCone(hi, lo, pts, nextPt, prevPt) &&
+	     inCone(lo, hi, pts, nextPt, prevPt) &&
+	     clear(conf, pts[hi], pts[lo], V, V, V, V))) {
+	    d = dist(pts[hi], pts[lo]);
+	    if (d != 0) {
+		conf->rowidx[n] = j;
+		conf->rowd[n] = d;
+		n++;
+	    }
+	}
+    }
+    row->idx = (int *) malloc(MAX(n, 1) * sizeof(int));
+    row->d = (COORD *) malloc(MAX(n, 1) * sizeof(COORD));
+    memcpy(row->idx, conf->rowidx, n * sizeof(int));
+    memcpy(row->d, conf->rowd, n * sizeof(COORD));
+    row->n = n;
+    return row;
+}
+
 /* polyhit:
  * Given a vconfig_t conf, as above, and a point,
  * return the index of the polygon that contains
@@ -364,7 +568,7 @@ COORD *ptVis(vconfig_t * conf, int pp, Ppoint_t p)
     for (k = 0; k < start; k++) {
 	pk = pts[k];
 	if (in_cone(pts[prevPt[k]], pk, pts[nextPt[k]], p) &&
-	    clear(p, pk, start, end, V, pts, nextPt, prevPt)) {
+	    clear(conf, p, pk, start, end, V, V)) {
 	    /* if p and pk see each other, add edge */
 	    d = dist(p, pk);
 	    vadj[k] = d;
@@ -378,7 +582,7 @@ COORD *ptVis(vconfig_t * conf, int pp, Ppoint_t p)
     for (k = end; k < V; k++) {
 	pk = pts[k];
 	if (in_cone(pts[prevPt[k]], pk, pts[nextPt[k]], p) &&
-	    clear(p, pk, start, end, V, pts, nextPt, prevPt)) {
+	    clear(conf, p, pk, start, end, V, V)) {
 	    /* if p and pk see each other, add edge */
 	    d = dist(p, pk);
 	    vadj[k] = d;
@@ -399,11 +603,6 @@ COORD *ptVis(vconfig_t * conf, int pp, Ppoint_t p)
  */
 int directVis(Ppoint_t p, int pp, Ppoint_t q, int qp, vconfig_t * conf)
 {
-    int V = conf->N;
-    Ppoint_t *pts = conf->P;
-    int *nextPt = conf->next;
-    /* int*   prevPt = conf->prev; */
-    int k;
     int s1, e1;
     int s2, e2;
 
@@ -434,17 +633,5 @@ int directVis(Ppoint_t p, int pp, Ppoint_t q, int qp, vconfig_t * conf)
 	e2 = conf->start[pp + 1];
     }
 
-    for (k = 0; k < s1; k++) {
-	if (INTERSECT(p, q, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
-    }
-    for (k = e1; k < s2; k++) {
-	if (INTERSECT(p, q, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
-    }
-    for (k = e2; k < V; k++) {
-	if (INTERSECT(p, q, pts[k], pts[nextPt[k]], pts[prevPt[k]]))
-	    return 0;
-    }
-    return 1;
+    return clear(conf, p, q, s1, e1, s2, e2);
 }
@@ -31,6 +31,13 @@ extern "C" {
  */
     extern vconfig_t *Pobsopen(Ppoly_t ** obstacles, int n_obstacles);
 
+/* as Pobsopen, but the visibility of each obstacle vertex is only
+ * computed when a path first needs it; better when there are many
+ * obstacles and few paths, or short ones
+ */
+    extern vconfig_t *Pobsopen_incremental(Ppoly_t ** obstacles,
+					   int n_obstacles);
+
 /* close a visibility graph, freeing its storage */
     extern void Pobsclose(vconfig_t * config);
 
@@ -24,6 +24,7 @@
 #include <overlap.h>
 #include <uniform_stress.h>
 #include <stress_model.h>
+#include <parallel.h>
 
 static void sfdp_init_edge(edge_t * e)
 {
@@ -283,6 +284,7 @@ late_quadtree_scheme (graph_t* g, Agsym_t* sym, int dflt)
  * 
  * Possible parameters:
  *   ctrl->use_node_weights
+ *   ctrl->nthreads
  */
 static void
 tuneControl (graph_t* g, spring_electrical_control ctrl)
@@ -312,6 +314,7 @@ tuneControl (graph_t* g, spring_electrical_control ctrl)
 	agerr (AGWARN, "label_scheme = %d > 4 : ignoring\n", ctrl->edge_labeling_scheme);
 	ctrl->edge_labeling_scheme = 0;
     }
+    ctrl->nthreads = parallel_threads(g);
 }
 
 void sfdp_layout(graph_t * g)
@@ -25,6 +25,7 @@
 #include "logic.h"
 #include "math.h"
 #include "globals.h"
+#include "parallel.h"
 #include <string.h>
 #include <time.h>
 
@@ -67,6 +68,7 @@ spring_electrical_control spring_electrical_control_new(){
   ctrl->initial_scaling = -4;
   ctrl->rotation = 0.;
   ctrl->edge_labeling_scheme = 0;
+  ctrl->nthreads = 1;
   return ctrl;
 }
 
@@ -102,6 +104,7 @@ void spring_electrical_control_print(spring_electrical_control ctrl){
     smoothings[ctrl->smoothing], ctrl->overlap, ctrl->initial_scaling, ctrl->do_shrinking);
   fprintf (stderr, "  octree scheme %s method %s\n", tschemes[ctrl->tscheme], methods[ctrl->method]);
   fprintf (stderr, "  edge_labeling_scheme %d\n", ctrl->edge_labeling_scheme);
+  fprintf (stderr, "  threads %d\n", ctrl->nthreads);
 }
 
 void oned_optimizer_delete(oned_optimizer opt){
@@ -496,7 +499,7 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
   int adaptive_cooling = ctrl->adaptive_cooling;
-  QuadTree qt = NULL;
+  LinearQuadTree qt = NULL;
   real counts[4], *force = NULL;
 #ifdef TIME
   clock_t start, end, start0;
@@ -569,9 +572,9 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
     start = clock();
 #endif
     if (ctrl->use_node_weights){
-      qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
+      qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
     } else {
-      qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
+      qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
     }
 
 #ifdef TIME
@@ -583,7 +586,7 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
     start = clock();
 #endif
 
-    QuadTree_get_repulsive_force(qt, force, x, ctrl->bh, p, KP, counts, flag);
+    LinearQuadTree_get_repulsive_force_parallel(qt, force, x, ctrl->bh, p, KP, counts, flag, ctrl->nthreads);
 
     assert(!(*flag));
 
@@ -622,7 +625,7 @@ void spring_electrical_embedding_fast(int dim, SparseMatrix A0, spring_electrica
 #ifdef TIME
       start = clock();
 #endif
-      QuadTree_delete(qt);
+      LinearQuadTree_delete(qt);
 #ifdef TIME
       end = clock();
       qtree_new_cpu += ((real) (end - start)) / CLOCKS_PER_SEC;
@@ -695,7 +698,7 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
   int adaptive_cooling = ctrl->adaptive_cooling;
-  QuadTree qt = NULL;
+  LinearQuadTree qt = NULL;
   int USE_QT = FALSE;
   int nsuper = 0, nsupermax = 10;
   real *center = NULL, *supernode_wgts = NULL, *distances = NULL, nsuper_avg, counts = 0, counts_avg = 0;
@@ -772,9 +775,9 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
     if (USE_QT) {
       max_qtree_level = oned_optimizer_get(qtree_level_optimizer);
       if (ctrl->use_node_weights){
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
       } else {
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
       }
     }
 #ifdef TIME
@@ -789,7 +792,7 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
 #ifdef TIME
 	start = clock();
 #endif
-	QuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
+	LinearQuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
 				&center, &supernode_wgts, &distances, &counts, flag);
 #ifdef TIME
 	end = clock();
@@ -871,7 +874,7 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
     }/* done vertex i */
 
     if (qt) {
-      QuadTree_delete(qt);
+      LinearQuadTree_delete(qt);
       nsuper_avg /= n;
       counts_avg /= n;
 #ifdef TIME
@@ -945,8 +948,57 @@ void spring_electrical_embedding_slow(int dim, SparseMatrix A0, spring_electrica
 
 
 
+/* state of the threaded supernode pass of spring_electrical_embedding. Scratch arrays and
+   statistics are kept per chunk. */
+typedef struct {
+  LinearQuadTree qt;
+  int dim;
+  real bh, p, KP;
+  real *x;
+  real *frep;/* repulsive force on each node, n*dim */
+  int *nsupermax;
+  real **center, **supernode_wgts, **distances;
+  real *counts, *nsuper;
+  int *flag;
+} supernode_force_state;
+
+static void supernode_forces(void *state, int chunk, int lo, int hi){
+  /* repulsive forces on nodes lo..hi-1 from their supernodes */
+  supernode_force_state *s = (supernode_force_state *) state;
+  int dim = s->dim, i, j, k, nsuper;
+  real p = s->p, KP = s->KP, dist, counts, *xi, *f, *center, *wgts;
+
+  for (i = lo; i < hi; i++){
+    xi = &(s->x[dim*i]);
+    LinearQuadTree_get_supernodes(s->qt, s->bh, xi, i, &nsuper, &(s->nsupermax[chunk]), &(s->center[chunk]),
+				  &(s->supernode_wgts[chunk]), &(s->distances[chunk]), &counts, &(s->flag[chunk]));
+    s->counts[chunk] += counts;
+    s->nsuper[chunk] += nsuper;
+    if (s->flag[chunk]) return;
+    center = s->center[chunk];
+    wgts = s->supernode_wgts[chunk];
+    f = &(s->frep[dim*i]);
+    for (k = 0; k < dim; k++) f[k] = 0.;
+    for (j = 0; j < nsuper; j++){
+      dist = MAX(s->distances[chunk][j], MINDIST);
+      for (k = 0; k < dim; k++){
+	if (p == -1){
+	  f[k] += wgts[j]*KP*(xi[k] - center[j*dim+k])/(dist*dist);
+	} else {
+	  f[k] += wgts[j]*KP*(xi[k] - center[j*dim+k])/pow(dist, 1.- p);
+	}
+      }
+    }
+  }
+}
+
 void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_control ctrl, real *node_weights, real *x, int *flag){
   /* x is a point to a 1D array, x[i*dim+j] gives the coordinate of the i-th node at dimension j.  */
+  /* With ctrl->nthreads > 1, the repulsive forces of all nodes are found by several threads
+     before the nodes are moved. This gives the same result as the serial loop below, since they
+     depend only on the quadtree and the node's own position, both fixed during a sweep, but they
+     are then added to the attractive force as a whole, so the layout may differ in rounding from
+     the single threaded one. It does not depend on the number of threads. */
   SparseMatrix A = A0;
   int m, n;
   int i, j, k;
@@ -956,7 +1008,7 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
   int adaptive_cooling = ctrl->adaptive_cooling;
-  QuadTree qt = NULL;
+  LinearQuadTree qt = NULL;
   int USE_QT = FALSE;
   int nsuper = 0, nsupermax = 10;
   real *center = NULL, *supernode_wgts = NULL, *distances = NULL, nsuper_avg, counts = 0, counts_avg = 0;
@@ -968,6 +1020,9 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
 #endif
   int max_qtree_level = ctrl->max_qtree_level;
   oned_optimizer qtree_level_optimizer = NULL;
+  supernode_force_state rs;
+  int c, nchunks = 0;
+  real *frep = NULL;
 
   if (!A || maxiter <= 0) return;
 
@@ -980,6 +1035,21 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
     center = MALLOC(sizeof(real)*nsupermax*dim);
     supernode_wgts = MALLOC(sizeof(real)*nsupermax);
     distances = MALLOC(sizeof(real)*nsupermax);
+    if (ctrl->nthreads > 1) {
+      nchunks = MIN(ctrl->nthreads, n);
+      frep = MALLOC(sizeof(real)*dim*n);
+      rs.frep = frep;
+      rs.nsupermax = MALLOC(sizeof(int)*nchunks);
+      rs.center = MALLOC(sizeof(real*)*nchunks);
+      rs.supernode_wgts = MALLOC(sizeof(real*)*nchunks);
+      rs.distances = MALLOC(sizeof(real*)*nchunks);
+      rs.counts = MALLOC(sizeof(real)*nchunks);
+      rs.nsuper = MALLOC(sizeof(real)*nchunks);
+      rs.flag = MALLOC(sizeof(int)*nchunks);
+      for (c = 0; c < nchunks; c++) {
+	rs.center[c] = rs.supernode_wgts[c] = rs.distances[c] = NULL;
+      }
+    }
   }
   *flag = 0;
   if (m != n) {
@@ -1056,12 +1126,33 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
 
       max_qtree_level = oned_optimizer_get(qtree_level_optimizer);
       if (ctrl->use_node_weights){
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
       } else {
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
       }
 
-	
+      if (frep) {
+	rs.qt = qt;
+	rs.dim = dim;
+	rs.bh = ctrl->bh;
+	rs.p = p;
+	rs.KP = KP;
+	rs.x = x;
+	for (c = 0; c < nchunks; c++) {
+	  rs.counts[c] = rs.nsuper[c] = 0;
+	  rs.flag[c] = 0;
+	}
+	parallel_for(n, nchunks, supernode_forces, &rs);
+	for (c = 0; c < nchunks; c++) {
+	  counts_avg += rs.counts[c];
+	  nsuper_avg += rs.nsuper[c];
+	  if (rs.flag[c]) {
+	    *flag = rs.flag[c];
+	    LinearQuadTree_delete(qt);
+	    goto RETURN;
+	  }
+	}
+      }
     }
 #ifdef TIME
     start2 = clock();
@@ -1079,11 +1170,13 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
       }
 
       /* repulsive force K^(1 - p)/||x_i-x_j||^(1 - p) (x_i - x_j) */
-      if (USE_QT){
+      if (frep){
+	for (k = 0; k < dim; k++) f[k] += frep[i*dim+k];
+      } else if (USE_QT){
 #ifdef TIME
 	start = clock();
 #endif
-	QuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
+	LinearQuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
 				&center, &supernode_wgts, &distances, &counts, flag);
 
 #ifdef TIME
@@ -1144,7 +1237,7 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
     }/* done vertex i */
 
     if (qt) {
-      QuadTree_delete(qt);
+      LinearQuadTree_delete(qt);
       nsuper_avg /= n;
       counts_avg /= n;
 #ifdef TIME
@@ -1212,6 +1305,21 @@ void spring_electrical_embedding(int dim, SparseMatrix A0, spring_electrical_con
   if (center) FREE(center);
   if (supernode_wgts) FREE(supernode_wgts);
   if (distances) FREE(distances);
+  if (frep) {
+    for (c = 0; c < nchunks; c++) {
+      FREE(rs.center[c]);
+      FREE(rs.supernode_wgts[c]);
+      FREE(rs.distances[c]);
+    }
+    FREE(rs.nsupermax);
+    FREE(rs.center);
+    FREE(rs.supernode_wgts);
+    FREE(rs.distances);
+    FREE(rs.counts);
+    FREE(rs.nsuper);
+    FREE(rs.flag);
+    FREE(frep);
+  }
 
 }
 
@@ -1286,7 +1394,7 @@ void spring_maxent_embedding(int dim, SparseMatrix A0, SparseMatrix D, spring_el
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
   int adaptive_cooling = ctrl->adaptive_cooling;
-  QuadTree qt = NULL;
+  LinearQuadTree qt = NULL;
   int USE_QT = FALSE;
   int nsuper = 0, nsupermax = 10;
   real *center = NULL, *supernode_wgts = NULL, *distances = NULL, nsuper_avg, counts = 0;
@@ -1374,9 +1482,9 @@ void spring_maxent_embedding(int dim, SparseMatrix A0, SparseMatrix D, spring_el
 
     if (USE_QT) {
       if (ctrl->use_node_weights){
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
       } else {
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
       }
     }
 
@@ -1447,7 +1555,7 @@ void spring_maxent_embedding(int dim, SparseMatrix A0, SparseMatrix D, spring_el
 
       /* repulsive force ||x_i-x_j||^(1 - p) (x_i - x_j) */
       if (USE_QT){
-	QuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
+	LinearQuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
 				&center, &supernode_wgts, &distances, &counts, flag);
 	nsuper_avg += nsuper;
 	if (*flag) goto RETURN;
@@ -1501,7 +1609,7 @@ void spring_maxent_embedding(int dim, SparseMatrix A0, SparseMatrix D, spring_el
 
     }/* done vertex i */
 
-    if (qt) QuadTree_delete(qt);
+    if (qt) LinearQuadTree_delete(qt);
     nsuper_avg /= n;
 #ifdef DEBUG_PRINT
     stress /= (double) A->nz;
@@ -1547,7 +1655,7 @@ void spring_electrical_spring_embedding(int dim, SparseMatrix A0, SparseMatrix D
   real *f = NULL, dist, F, Fnorm = 0, Fnorm0;
   int iter = 0;
   int adaptive_cooling = ctrl->adaptive_cooling;
-  QuadTree qt = NULL;
+  LinearQuadTree qt = NULL;
   int USE_QT = FALSE;
   int nsuper = 0, nsupermax = 10;
   real *center = NULL, *supernode_wgts = NULL, *distances = NULL, nsuper_avg, counts = 0;
@@ -1611,9 +1719,9 @@ void spring_electrical_spring_embedding(int dim, SparseMatrix A0, SparseMatrix D
 
     if (USE_QT) {
       if (ctrl->use_node_weights){
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, node_weights);
       } else {
-	qt = QuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
+	qt = LinearQuadTree_new_from_point_list(dim, n, max_qtree_level, x, NULL);
       }
     }
 
@@ -1644,7 +1752,7 @@ void spring_electrical_spring_embedding(int dim, SparseMatrix A0, SparseMatrix D
 
       /* repulsive force K^(1 - p)/||x_i-x_j||^(1 - p) (x_i - x_j) */
       if (USE_QT){
-	QuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
+	LinearQuadTree_get_supernodes(qt, ctrl->bh, &(x[dim*i]), i, &nsuper, &nsupermax,
 				&center, &supernode_wgts, &distances, &counts, flag);
 	nsuper_avg += nsuper;
 	if (*flag) goto RETURN;
@@ -1698,7 +1806,7 @@ void spring_electrical_spring_embedding(int dim, SparseMatrix A0, SparseMatrix D
 
     }/* done vertex i */
 
-    if (qt) QuadTree_delete(qt);
+    if (qt) LinearQuadTree_delete(qt);
     nsuper_avg /= n;
 #ifdef DEBUG_PRINT
     if (Verbose && 0) {
@@ -63,6 +63,7 @@ struct spring_electrical_control_struct {
 			       0 (no action, default), 1 (penalty based method to make that kind of node close to the center of its neighbor), 
 			       1 (penalty based method to make that kind of node close to the old center of its neighbor),
 			       3 (two step process of overlap removal and straightening) */
+  int nthreads;/* number of threads used for the repulsive forces. Default 1 */
 };
 
 typedef struct  spring_electrical_control_struct  *spring_electrical_control; 
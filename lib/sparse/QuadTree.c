@@ -17,6 +17,9 @@
 #include "math.h"
 #include "LinkedList.h"
 #include "QuadTree.h"
+#ifndef STANDALONE
+#include "parallel.h"
+#endif
 
 extern real distance_cropped(real *x, int dim, int i, int j);
 
@@ -344,23 +347,18 @@ void QuadTree_get_repulsive_force(QuadTree qt, real *force, real *x, real bh, re
   for (i = 0; i < 4; i++) counts[i] /= n;
 
 }
-QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord, real *weight){
-  /* form a new QuadTree data structure from a list of coordinates of n points
-     coord: of length n*dim, point i sits at [i*dim, i*dim+dim - 1]
-     weight: node weight of lentgth n. If NULL, unit weight assumed.
-   */
-  real *xmin, *xmax, *center, width;
-  QuadTree qt = NULL;
+static int get_bounding_square(int dim, int n, real *coord, real *center, real *width){
+  /* center and half width of the square (cube) enclosing the n points of coord, with some margin.
+     Return FALSE if out of memory */
+  real *xmin, *xmax;
   int i, k;
 
   xmin = MALLOC(sizeof(real)*dim);
   xmax = MALLOC(sizeof(real)*dim);
-  center = MALLOC(sizeof(real)*dim);
-  if (!xmin || !xmax || !center) {
+  if (!xmin || !xmax) {
       FREE(xmin);
       FREE(xmax);
-      FREE(center);
-      return NULL;
+      return FALSE;
   }
 
   for (i = 0; i < dim; i++) xmin[i] = coord[i];
@@ -373,13 +371,33 @@ QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord
     }
   }
 
-  width = xmax[0] - xmin[0];
+  *width = xmax[0] - xmin[0];
   for (i = 0; i < dim; i++) {
     center[i] = (xmin[i] + xmax[i])*0.5;
-    width = MAX(width, xmax[i] - xmin[i]);
+    *width = MAX(*width, xmax[i] - xmin[i]);
+  }
+  if (*width == 0) *width = 0.00001;/* if we only have one point, width = 0! */
+  *width *= 0.52;
+
+  FREE(xmin);
+  FREE(xmax);
+  return TRUE;
+}
+
+QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord, real *weight){
+  /* form a new QuadTree data structure from a list of coordinates of n points
+     coord: of length n*dim, point i sits at [i*dim, i*dim+dim - 1]
+     weight: node weight of lentgth n. If NULL, unit weight assumed.
+   */
+  real *center, width;
+  QuadTree qt = NULL;
+  int i;
+
+  center = MALLOC(sizeof(real)*dim);
+  if (!center || !get_bounding_square(dim, n, coord, center, &width)) {
+      FREE(center);
+      return NULL;
   }
-  if (width == 0) width = 0.00001;/* if we only have one point, width = 0! */
-  width *= 0.52;
   qt = QuadTree_new(dim, center, width, max_level);
 
   if (weight){
@@ -393,8 +411,6 @@ QuadTree QuadTree_new_from_point_list(int dim, int n, int max_level, real *coord
   }
 
 
-  FREE(xmin);
-  FREE(xmax);
   FREE(center);
   return qt;
 }
@@ -735,3 +751,559 @@ void QuadTree_get_nearest(QuadTree qt, real *x, real *ymin, int *imin, real *min
 
 
 }
+
+
+
+/* Linear quadtree.
+   LinearQuadTree_new_from_point_list builds the same cells as QuadTree_new_from_point_list, but
+   into flat arrays. The items of a cell are partitioned stably into its quadrants, level by level,
+   which sorts them by Morton code with no allocation per cell or per item. The items reach each
+   cell in the order in which QuadTree_add would insert them there, and averages are accumulated
+   with the same formulas, so forces computed on either tree are identical.
+*/
+
+struct lqt_build_struct {
+  real *coord;/* input coordinates and weights */
+  real *weight;
+  int *idx;/* item ids, partitioned in place */
+  int *quad;/* quadrant of each item in idx */
+  int *tmp;
+  int *offsets;/* 2^dim+1 quadrant offsets per level */
+  real *centers;/* a child center per level */
+  int nplaced;/* items stored in the tree so far */
+};
+
+static int LinearQuadTree_new_cell(LinearQuadTree qt){
+  int dim = qt->dim, c;
+
+  if (qt->ncells >= qt->ncellsmax){
+    qt->ncellsmax = qt->ncellsmax + MAX(10, qt->ncellsmax/2);
+    qt->npoints = REALLOC(qt->npoints, sizeof(int)*qt->ncellsmax);
+    qt->first = REALLOC(qt->first, sizeof(int)*qt->ncellsmax);
+    qt->qts = REALLOC(qt->qts, sizeof(int)*qt->ncellsmax);
+    qt->width = REALLOC(qt->width, sizeof(real)*qt->ncellsmax);
+    qt->total_weight = REALLOC(qt->total_weight, sizeof(real)*qt->ncellsmax);
+    qt->center = REALLOC(qt->center, sizeof(real)*qt->ncellsmax*dim);
+    qt->average = REALLOC(qt->average, sizeof(real)*qt->ncellsmax*dim);
+  }
+  c = qt->ncells++;
+  qt->qts[c] = -1;
+  return c;
+}
+
+static int LinearQuadTree_new_kids(LinearQuadTree qt){
+  int nq = 1<<(qt->dim), k, i;
+
+  if (qt->nkids + nq > qt->nkidsmax){
+    qt->nkidsmax = qt->nkids + nq + MAX(10*nq, qt->nkidsmax/2);
+    qt->kids = REALLOC(qt->kids, sizeof(int)*qt->nkidsmax);
+  }
+  k = qt->nkids;
+  qt->nkids += nq;
+  for (i = 0; i < nq; i++) qt->kids[k+i] = -1;
+  return k;
+}
+
+static int LinearQuadTree_build(LinearQuadTree qt, struct lqt_build_struct *b, int lo, int hi, int level,
+				real *center, real width){
+  /* make the cell for the items b->idx[lo..hi-1], given in the order they are inserted there,
+     and its descendents. Return the index of the cell */
+  int dim = qt->dim, nq = 1<<dim, i, j, k, c, m, id, q, kids, kid;
+  int *idx = b->idx, *off = &(b->offsets[level*(nq+1)]);
+  real *avg, *x, *ccenter;
+
+  c = LinearQuadTree_new_cell(qt);
+  qt->npoints[c] = hi - lo;
+  qt->width[c] = width;
+  for (k = 0; k < dim; k++) qt->center[c*dim+k] = center[k];
+
+  /* the average as QuadTree_add_internal updates it. At the last level it uses the new count. */
+  avg = &(qt->average[c*dim]);
+  id = idx[lo];
+  for (k = 0; k < dim; k++) avg[k] = b->coord[id*dim+k];
+  qt->total_weight[c] = (b->weight ? b->weight[id] : 1);
+  for (j = lo + 1, m = 1; j < hi; j++, m++){
+    id = idx[j];
+    x = &(b->coord[id*dim]);
+    qt->total_weight[c] += (b->weight ? b->weight[id] : 1);
+    if (level < qt->max_level){
+      for (k = 0; k < dim; k++) avg[k] = (avg[k]*m + x[k])/(m + 1);
+    } else {
+      for (k = 0; k < dim; k++) avg[k] = (avg[k]*(m + 1) + x[k])/(m + 2);
+    }
+  }
+
+  qt->first[c] = b->nplaced;
+  if (hi - lo == 1 || level >= qt->max_level){
+    /* a leaf. QuadTree prepends to its list, so the items are stored in reverse order */
+    for (j = hi - 1; j >= lo; j--){
+      i = b->nplaced++;
+      id = idx[j];
+      qt->id[i] = id;
+      for (k = 0; k < dim; k++) qt->coord[i*dim+k] = b->coord[id*dim+k];
+      qt->weight[i] = (b->weight ? b->weight[id] : 1);
+    }
+    return c;
+  }
+
+  /* the new item is sent down first, then the one that was alone in the cell */
+  id = idx[lo]; idx[lo] = idx[lo+1]; idx[lo+1] = id;
+
+  /* stable partition by quadrant, leaving off[q] the start of quadrant q */
+  for (q = 0; q <= nq; q++) off[q] = 0;
+  for (j = lo; j < hi; j++){
+    b->quad[j] = QuadTree_get_quadrant(dim, center, &(b->coord[idx[j]*dim]));
+    off[b->quad[j]+1]++;
+  }
+  for (q = 0; q < nq; q++) off[q+1] += off[q];
+  for (j = lo; j < hi; j++) b->tmp[lo + off[b->quad[j]]++] = idx[j];
+  for (j = lo; j < hi; j++) idx[j] = b->tmp[j];
+  for (q = nq; q > 0; q--) off[q] = off[q-1];
+  off[0] = 0;
+
+  kids = LinearQuadTree_new_kids(qt);
+  qt->qts[c] = kids;
+  ccenter = &(b->centers[(level+1)*dim]);
+  for (q = 0; q < nq; q++){
+    if (off[q] == off[q+1]) continue;
+    /* as in QuadTree_new_in_quadrant */
+    for (k = 0, i = q; k < dim; k++){
+      if (i%2 == 0){
+	ccenter[k] = qt->center[c*dim+k] - width/2;
+      } else {
+	ccenter[k] = qt->center[c*dim+k] + width/2;
+      }
+      i = (i - i%2)/2;
+    }
+    kid = LinearQuadTree_build(qt, b, lo + off[q], lo + off[q+1], level + 1, ccenter, width/2);
+    qt->kids[kids+q] = kid;
+  }
+  return c;
+}
+
+LinearQuadTree LinearQuadTree_new_from_point_list(int dim, int n, int max_level, real *coord, real *weight){
+  /* form a linear quadtree from a list of coordinates of n points.
+     coord: of length n*dim, point i sits at [i*dim, i*dim+dim - 1]
+     weight: node weight of lentgth n. If NULL, unit weight assumed.
+   */
+  LinearQuadTree qt;
+  struct lqt_build_struct b;
+  real *center, width;
+  int i, nq = 1<<dim;
+
+  if (n <= 0) {
+    /* an empty tree, with no cells */
+    qt = MALLOC(sizeof(struct LinearQuadTree_struct));
+    qt->n = 0;
+    qt->dim = dim;
+    qt->max_level = max_level;
+    qt->ncells = qt->ncellsmax = qt->nkids = qt->nkidsmax = 0;
+    qt->npoints = qt->first = qt->qts = qt->kids = qt->id = NULL;
+    qt->width = qt->total_weight = qt->center = qt->average = NULL;
+    qt->coord = qt->weight = qt->force = NULL;
+    return qt;
+  }
+  center = MALLOC(sizeof(real)*dim);
+  if (!center || !get_bounding_square(dim, n, coord, center, &width)) {
+      FREE(center);
+      return NULL;
+  }
+
+  qt = MALLOC(sizeof(struct LinearQuadTree_struct));
+  qt->n = n;
+  qt->dim = dim;
+  qt->max_level = max_level;
+  qt->ncells = qt->nkids = 0;
+  qt->ncellsmax = 2*n;
+  qt->nkidsmax = nq*n/2 + nq;
+  qt->npoints = MALLOC(sizeof(int)*qt->ncellsmax);
+  qt->first = MALLOC(sizeof(int)*qt->ncellsmax);
+  qt->qts = MALLOC(sizeof(int)*qt->ncellsmax);
+  qt->width = MALLOC(sizeof(real)*qt->ncellsmax);
+  qt->total_weight = MALLOC(sizeof(real)*qt->ncellsmax);
+  qt->center = MALLOC(sizeof(real)*qt->ncellsmax*dim);
+  qt->average = MALLOC(sizeof(real)*qt->ncellsmax*dim);
+  qt->kids = MALLOC(sizeof(int)*qt->nkidsmax);
+  qt->id = MALLOC(sizeof(int)*n);
+  qt->coord = MALLOC(sizeof(real)*n*dim);
+  qt->weight = MALLOC(sizeof(real)*n);
+  qt->force = NULL;
+
+  b.coord = coord;
+  b.weight = weight;
+  b.idx = MALLOC(sizeof(int)*n);
+  b.quad = MALLOC(sizeof(int)*n);
+  b.tmp = MALLOC(sizeof(int)*n);
+  b.offsets = MALLOC(sizeof(int)*(nq+1)*(max_level+1));
+  b.centers = MALLOC(sizeof(real)*dim*(max_level+2));
+  b.nplaced = 0;
+  for (i = 0; i < n; i++) b.idx[i] = i;
+
+  LinearQuadTree_build(qt, &b, 0, n, 0, center, width);
+  assert(b.nplaced == n);
+
+  FREE(b.idx);
+  FREE(b.quad);
+  FREE(b.tmp);
+  FREE(b.offsets);
+  FREE(b.centers);
+  FREE(center);
+  return qt;
+}
+
+void LinearQuadTree_delete(LinearQuadTree qt){
+  if (!qt) return;
+  FREE(qt->npoints);
+  FREE(qt->first);
+  FREE(qt->qts);
+  FREE(qt->kids);
+  FREE(qt->width);
+  FREE(qt->total_weight);
+  FREE(qt->center);
+  FREE(qt->average);
+  FREE(qt->id);
+  FREE(qt->coord);
+  FREE(qt->weight);
+  FREE(qt->force);
+  FREE(qt);
+}
+
+static void LinearQuadTree_get_supernodes_internal(LinearQuadTree qt, int c, real bh, real *point, int nodeid, int *nsuper, int *nsupermax, real **center, real **supernode_wgts, real **distances, real *counts){
+  /* as QuadTree_get_supernodes_internal, on cell c */
+  real *coord, dist;
+  int dim = qt->dim, i, j;
+
+  (*counts)++;
+
+  if (c < 0) return;
+  if (qt->qts[c] < 0){
+    for (j = qt->first[c]; j < qt->first[c] + qt->npoints[c]; j++){
+      check_or_realloc_arrays(dim, nsuper, nsupermax, center, supernode_wgts, distances);
+      if (qt->id[j] != nodeid){
+	coord = &(qt->coord[j*dim]);
+	for (i = 0; i < dim; i++){
+	  (*center)[dim*(*nsuper)+i] = coord[i];
+	}
+	(*supernode_wgts)[*nsuper] = qt->weight[j];
+	(*distances)[*nsuper] = point_distance(point, coord, dim);
+	(*nsuper)++;
+      }
+    }
+    return;
+  }
+
+  dist = point_distance(&(qt->center[c*dim]), point, dim);
+  if (qt->width[c] < bh*dist){
+    check_or_realloc_arrays(dim, nsuper, nsupermax, center, supernode_wgts, distances);
+    for (i = 0; i < dim; i++){
+      (*center)[dim*(*nsuper)+i] = qt->average[c*dim+i];
+    }
+    (*supernode_wgts)[*nsuper] = qt->total_weight[c];
+    (*distances)[*nsuper] = point_distance(&(qt->average[c*dim]), point, dim);
+    (*nsuper)++;
+  } else {
+    for (i = 0; i < 1<<dim; i++){
+      LinearQuadTree_get_supernodes_internal(qt, qt->kids[qt->qts[c]+i], bh, point, nodeid, nsuper, nsupermax, center,
+					     supernode_wgts, distances, counts);
+    }
+  }
+}
+
+void LinearQuadTree_get_supernodes(LinearQuadTree qt, real bh, real *point, int nodeid, int *nsuper,
+				   int *nsupermax, real **center, real **supernode_wgts, real **distances, real *counts, int *flag){
+  int dim = qt->dim;
+
+  (*counts) = 0;
+
+  *nsuper = 0;
+
+  *flag = 0;
+  *nsupermax = 10;
+  if (!*center) *center = MALLOC(sizeof(real)*(*nsupermax)*dim);
+  if (!*supernode_wgts) *supernode_wgts = MALLOC(sizeof(real)*(*nsupermax));
+  if (!*distances) *distances = MALLOC(sizeof(real)*(*nsupermax));
+  if (qt->ncells == 0) return;
+  LinearQuadTree_get_supernodes_internal(qt, 0, bh, point, nodeid, nsuper, nsupermax, center, supernode_wgts, distances, counts);
+}
+
+static void LinearQuadTree_repulsive_force_interact(LinearQuadTree qt, int c1, int c2, real *x, real *force, real *cellforce, real bh, real p, real KP, real *counts){
+  /* as QuadTree_repulsive_force_interact, on cells c1 and c2. Forces on cells are added to cellforce */
+  real *x1, *x2, dist, wgt1, wgt2, f, *f1, *f2, w1, w2;
+  int dim, i, j, i1, i2, j1, j2, k, leaf1, leaf2, nq;
+  int *kids;
+
+  if (c1 < 0 || c2 < 0) return;
+  dim = qt->dim;
+  nq = 1<<dim;
+  leaf1 = (qt->qts[c1] < 0);
+  leaf2 = (qt->qts[c2] < 0);
+
+  /* far enough, calculate repulsive force */
+  dist = point_distance(&(qt->average[c1*dim]), &(qt->average[c2*dim]), dim);
+  if (qt->width[c1] + qt->width[c2] < bh*dist){
+    counts[0]++;
+    x1 = &(qt->average[c1*dim]);
+    w1 = qt->total_weight[c1];
+    f1 = &(cellforce[c1*dim]);
+    x2 = &(qt->average[c2*dim]);
+    w2 = qt->total_weight[c2];
+    f2 = &(cellforce[c2*dim]);
+    assert(dist > 0);
+    for (k = 0; k < dim; k++){
+      if (p == -1){
+	f = w1*w2*KP*(x1[k] - x2[k])/(dist*dist);
+      } else {
+	f = w1*w2*KP*(x1[k] - x2[k])/pow(dist, 1.- p);
+      }
+      f1[k] += f;
+      f2[k] -= f;
+    }
+    return;
+  }
+
+  /* both at leaves, calculate repulsive force */
+  if (leaf1 && leaf2){
+    for (j1 = qt->first[c1]; j1 < qt->first[c1] + qt->npoints[c1]; j1++){
+      x1 = &(qt->coord[j1*dim]);
+      wgt1 = qt->weight[j1];
+      i1 = qt->id[j1];
+      f1 = &(force[i1*dim]);
+      for (j2 = qt->first[c2]; j2 < qt->first[c2] + qt->npoints[c2]; j2++){
+	i2 = qt->id[j2];
+	if ((c1 == c2 && i2 < i1) || i1 == i2) continue;
+	x2 = &(qt->coord[j2*dim]);
+	wgt2 = qt->weight[j2];
+	f2 = &(force[i2*dim]);
+	counts[1]++;
+	dist = distance_cropped(x, dim, i1, i2);
+	for (k = 0; k < dim; k++){
+	  if (p == -1){
+	    f = wgt1*wgt2*KP*(x1[k] - x2[k])/(dist*dist);
+	  } else {
+	    f = wgt1*wgt2*KP*(x1[k] - x2[k])/pow(dist, 1.- p);
+	  }
+	  f1[k] += f;
+	  f2[k] -= f;
+	}
+      }
+    }
+    return;
+  }
+
+  /* identical, split one */
+  kids = qt->kids;
+  if (c1 == c2){
+    for (i = 0; i < nq; i++){
+      for (j = i; j < nq; j++){
+	LinearQuadTree_repulsive_force_interact(qt, kids[qt->qts[c1]+i], kids[qt->qts[c1]+j], x, force, cellforce, bh, p, KP, counts);
+      }
+    }
+  } else {
+    /* split the one with bigger box, or one not at the last level */
+    if (qt->width[c1] > qt->width[c2] && !leaf1){
+      for (i = 0; i < nq; i++){
+	LinearQuadTree_repulsive_force_interact(qt, kids[qt->qts[c1]+i], c2, x, force, cellforce, bh, p, KP, counts);
+      }
+    } else if (qt->width[c2] > qt->width[c1] && !leaf2){
+      for (i = 0; i < nq; i++){
+	LinearQuadTree_repulsive_force_interact(qt, kids[qt->qts[c2]+i], c1, x, force, cellforce, bh, p, KP, counts);
+      }
+    } else if (!leaf1){/* pick one that is not at the last level */
+      for (i = 0; i < nq; i++){
+	LinearQuadTree_repulsive_force_interact(qt, kids[qt->qts[c1]+i], c2, x, force, cellforce, bh, p, KP, counts);
+      }
+    } else if (!leaf2){
+      for (i = 0; i < nq; i++){
+	LinearQuadTree_repulsive_force_interact(qt, kids[qt->qts[c2]+i], c1, x, force, cellforce, bh, p, KP, counts);
+      }
+    } else {
+      assert(0); /* can be both at the leaf level since that should be catched at the beginning of this func. */
+    }
+  }
+}
+
+static void LinearQuadTree_repulsive_force_accumulate(LinearQuadTree qt, int c, real *force, real *counts){
+  /* push down forces on cells into the node level */
+  real wgt, wgt2;
+  real *f, *f2;
+  int i, j, k, c2, dim = qt->dim;
+
+  wgt = qt->total_weight[c];
+  f = &(qt->force[c*dim]);
+  assert(wgt > 0);
+  counts[2]++;
+
+  if (qt->qts[c] < 0){
+    for (j = qt->first[c]; j < qt->first[c] + qt->npoints[c]; j++){
+      f2 = &(force[qt->id[j]*dim]);
+      wgt2 = qt->weight[j]/wgt;
+      for (k = 0; k < dim; k++) f2[k] += wgt2*f[k];
+    }
+    return;
+  }
+
+  for (i = 0; i < 1<<dim; i++){
+    c2 = qt->kids[qt->qts[c]+i];
+    if (c2 < 0) continue;
+    assert(qt->npoints[c2] > 0);
+    f2 = &(qt->force[c2*dim]);
+    wgt2 = qt->total_weight[c2]/wgt;
+    for (k = 0; k < dim; k++) f2[k] += wgt2*f[k];
+    LinearQuadTree_repulsive_force_accumulate(qt, c2, force, counts);
+  }
+}
+
+void LinearQuadTree_get_repulsive_force(LinearQuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int *flag){
+  /* as QuadTree_get_repulsive_force */
+  int n = qt->n, dim = qt->dim, i;
+
+  for (i = 0; i < 4; i++) counts[i] = 0;
+
+  *flag = 0;
+  if (qt->ncells == 0) return;
+
+  for (i = 0; i < dim*n; i++) force[i] = 0;
+  qt->force = REALLOC(qt->force, sizeof(real)*qt->ncells*dim);
+  for (i = 0; i < dim*qt->ncells; i++) qt->force[i] = 0;
+
+  LinearQuadTree_repulsive_force_interact(qt, 0, 0, x, force, qt->force, bh, p, KP, counts);
+  LinearQuadTree_repulsive_force_accumulate(qt, 0, force, counts);
+  for (i = 0; i < 4; i++) counts[i] /= n;
+}
+
+/* Parallel repulsive force.
+   The interaction of the root with itself is expanded, in the order the serial recursion would
+   make them, into a list of cell pairs, each of which is then handled by
+   LinearQuadTree_repulsive_force_interact. The list is split into one chunk per thread. Each chunk
+   adds its forces to its own copy of the node and cell forces, and the copies are summed in chunk
+   order, so the result depends only on the number of threads.
+*/
+
+struct lqt_force_struct {
+  LinearQuadTree qt;
+  int *tasks;/* pairs of cells */
+  real *x;
+  real **force;/* node forces, one array per chunk */
+  real **cellforce;/* cell forces, one array per chunk */
+  real *counts;/* 4 per chunk */
+  real bh, p, KP;
+};
+
+static void LinearQuadTree_collect_tasks(LinearQuadTree qt, int c1, int c2, int depth, real bh, int **tasks, int *ntasks, int *ntasksmax){
+  /* list the interactions of c1 and c2 as the serial recursion would make them, expanding those
+     that would recurse for depth levels */
+  int dim = qt->dim, nq = 1<<dim, i, j, leaf1, leaf2;
+  int *kids = qt->kids;
+  real dist;
+
+  if (c1 < 0 || c2 < 0) return;
+  leaf1 = (qt->qts[c1] < 0);
+  leaf2 = (qt->qts[c2] < 0);
+  dist = point_distance(&(qt->average[c1*dim]), &(qt->average[c2*dim]), dim);
+  if (depth == 0 || qt->width[c1] + qt->width[c2] < bh*dist || (leaf1 && leaf2)){
+    if (*ntasks >= *ntasksmax){
+      *ntasksmax = *ntasks + MAX(10, *ntasks/2);
+      *tasks = REALLOC(*tasks, sizeof(int)*2*(*ntasksmax));
+    }
+    (*tasks)[2*(*ntasks)] = c1;
+    (*tasks)[2*(*ntasks)+1] = c2;
+    (*ntasks)++;
+    return;
+  }
+
+  if (c1 == c2){
+    for (i = 0; i < nq; i++){
+      for (j = i; j < nq; j++){
+	LinearQuadTree_collect_tasks(qt, kids[qt->qts[c1]+i], kids[qt->qts[c1]+j], depth - 1, bh, tasks, ntasks, ntasksmax);
+      }
+    }
+  } else if (qt->width[c1] > qt->width[c2] && !leaf1){
+    for (i = 0; i < nq; i++) LinearQuadTree_collect_tasks(qt, kids[qt->qts[c1]+i], c2, depth - 1, bh, tasks, ntasks, ntasksmax);
+  } else if (qt->width[c2] > qt->width[c1] && !leaf2){
+    for (i = 0; i < nq; i++) LinearQuadTree_collect_tasks(qt, kids[qt->qts[c2]+i], c1, depth - 1, bh, tasks, ntasks, ntasksmax);
+  } else if (!leaf1){
+    for (i = 0; i < nq; i++) LinearQuadTree_collect_tasks(qt, kids[qt->qts[c1]+i], c2, depth - 1, bh, tasks, ntasks, ntasksmax);
+  } else {
+    for (i = 0; i < nq; i++) LinearQuadTree_collect_tasks(qt, kids[qt->qts[c2]+i], c1, depth - 1, bh, tasks, ntasks, ntasksmax);
+  }
+}
+
+static void LinearQuadTree_force_chunk(void *state, int chunk, int lo, int hi){
+  struct lqt_force_struct *st = (struct lqt_force_struct *) state;
+  int t;
+
+  for (t = lo; t < hi; t++){
+    LinearQuadTree_repulsive_force_interact(st->qt, st->tasks[2*t], st->tasks[2*t+1], st->x, st->force[chunk],
+					    st->cellforce[chunk], st->bh, st->p, st->KP, &(st->counts[4*chunk]));
+  }
+}
+
+void LinearQuadTree_get_repulsive_force_parallel(LinearQuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int *flag, int nthreads){
+  /* as LinearQuadTree_get_repulsive_force, using nthreads threads */
+  struct lqt_force_struct st;
+  int n = qt->n, dim = qt->dim, i, c, depth, ntasks, ntasksmax = 0;
+  int *tasks = NULL;
+
+#ifdef STANDALONE
+  nthreads = 1;/* no thread pool */
+#endif
+  if (nthreads <= 1 || qt->ncells == 0){
+    LinearQuadTree_get_repulsive_force(qt, force, x, bh, p, KP, counts, flag);
+    return;
+  }
+
+  /* enough tasks to balance the load */
+  depth = 0;
+  do {
+    depth++;
+    ntasks = 0;
+    LinearQuadTree_collect_tasks(qt, 0, 0, depth, bh, &tasks, &ntasks, &ntasksmax);
+  } while (ntasks < 8*nthreads && depth < 2*qt->max_level);
+  nthreads = MIN(nthreads, ntasks);
+
+  *flag = 0;
+  st.qt = qt;
+  st.tasks = tasks;
+  st.x = x;
+  st.bh = bh;
+  st.p = p;
+  st.KP = KP;
+  st.force = MALLOC(sizeof(real*)*nthreads);
+  st.cellforce = MALLOC(sizeof(real*)*nthreads);
+  st.counts = MALLOC(sizeof(real)*4*nthreads);
+  qt->force = REALLOC(qt->force, sizeof(real)*qt->ncells*dim);
+  st.force[0] = force;
+  st.cellforce[0] = qt->force;
+  for (c = 1; c < nthreads; c++){
+    st.force[c] = MALLOC(sizeof(real)*n*dim);
+    st.cellforce[c] = MALLOC(sizeof(real)*qt->ncells*dim);
+  }
+  for (c = 0; c < nthreads; c++){
+    for (i = 0; i < dim*n; i++) st.force[c][i] = 0;
+    for (i = 0; i < dim*qt->ncells; i++) st.cellforce[c][i] = 0;
+    for (i = 0; i < 4; i++) st.counts[4*c+i] = 0;
+  }
+
+#ifndef STANDALONE
+  parallel_for(ntasks, nthreads, LinearQuadTree_force_chunk, &st);
+#endif
+
+  for (i = 0; i < 4; i++) counts[i] = 0;
+  for (c = 0; c < nthreads; c++){
+    if (c > 0){
+      for (i = 0; i < dim*n; i++) force[i] += st.force[c][i];
+      for (i = 0; i < dim*qt->ncells; i++) qt->force[i] += st.cellforce[c][i];
+      FREE(st.force[c]);
+      FREE(st.cellforce[c]);
+    }
+    for (i = 0; i < 4; i++) counts[i] += st.counts[4*c+i];
+  }
+
+  LinearQuadTree_repulsive_force_accumulate(qt, 0, force, counts);
+  for (i = 0; i < 4; i++) counts[i] /= n;
+
+  FREE(st.force);
+  FREE(st.cellforce);
+  FREE(st.counts);
+  FREE(tasks);
+}
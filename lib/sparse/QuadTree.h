@@ -61,4 +61,44 @@ void QuadTree_get_nearest(QuadTree qt, real *x, real *ymin, int *imin, real *min
 
 QuadTree QuadTree_new_in_quadrant(int dim, real *center, real width, int max_level, int i);
 
+typedef struct LinearQuadTree_struct *LinearQuadTree;
+
+struct LinearQuadTree_struct {
+  /* the tree built by QuadTree_new_from_point_list, stored in flat arrays. Items are sorted by
+     Morton code (the sequence of quadrants on their path from the root) and cells are stored
+     depth first with cell 0 the root, so the items of each cell are contiguous. */
+  int n;/* number of items */
+  int dim;
+  int max_level;
+  int ncells;/* number of cells */
+  int *npoints;/* number of items in each cell */
+  int *first;/* position of the first item of each cell in id, coord and weight */
+  int *qts;/* position of the 2^dim children of each cell in kids, or -1 for a leaf */
+  int *kids;/* index of each child cell, or -1 if that quadrant is empty */
+  real *width;/* half width of each cell */
+  real *total_weight;
+  real *center;/* cell centers, ncells*dim */
+  real *average;/* cell averages, ncells*dim */
+  int *id;/* item ids in Morton order. At a leaf, they are in the order of QuadTree's list */
+  real *coord;/* item coordinates, n*dim, in the same order */
+  real *weight;
+  real *force;/* cell forces, used by LinearQuadTree_get_repulsive_force */
+  int ncellsmax, nkids, nkidsmax;
+};
+
+/* with n <= 0 the tree has no cells, and no forces or supernodes are found in it. Returns NULL only
+   if out of memory */
+LinearQuadTree LinearQuadTree_new_from_point_list(int dim, int n, int max_level, real *coord, real *weight);
+
+void LinearQuadTree_delete(LinearQuadTree qt);
+
+void LinearQuadTree_get_supernodes(LinearQuadTree qt, real bh, real *point, int nodeid, int *nsuper,
+				   int *nsupermax, real **center, real **supernode_wgts, real **distances, real *counts, int *flag);
+
+void LinearQuadTree_get_repulsive_force(LinearQuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int *flag);
+
+/* as LinearQuadTree_get_repulsive_force, splitting the work over nthreads threads. The result is
+   the same for a given number of threads */
+void LinearQuadTree_get_repulsive_force_parallel(LinearQuadTree qt, real *force, real *x, real bh, real p, real KP, real *counts, int *flag, int nthreads);
+
 #endif
@@ -0,0 +1,164 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/*
+ * Speedup of neato's all-pairs shortest paths with the number of threads.
+ *
+ *   apsp_speedup [-n nodes] [-t threads] [-w]
+ *
+ * A random scale-free graph, similar to a network topology, is built
+ * with the given number of nodes. Its packed distance matrix is then
+ * computed with 1, 2, 4, ... up to the given number of threads, and
+ * each result is checked against the single threaded one. With -w,
+ * edges have random lengths and Dijkstra's algorithm is used.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "neato.h"
+#include "stress.h"
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* mkgraph:
+ * Preferential attachment: each new node is joined to 2 earlier nodes,
+ * chosen with probability proportional to their degree.
+ */
+static vtx_data *mkgraph(int n, int weighted)
+{
+    vtx_data *graph = N_GNEW(n, vtx_data);
+    int *ends = N_GNEW(4 * n, int);	/* both ends of every edge */
+    int *deg = N_GNEW(n, int);
+    int *edges;
+    float *ewgts = NULL;
+    int i, j, k, a, b, prev, nends = 0;
+    unsigned int seed = 1;
+
+    for (i = 0; i < n; i++)
+	deg[i] = 1;		/* self */
+    for (i = 1; i < n; i++) {
+	for (k = 0, prev = -1; k < 2; k++) {
+	    a = nends ? ends[rand_r(&seed) % nends] : 0;
+	    if (a == i || a == prev)
+		continue;
+	    ends[nends++] = prev = a;
+	    ends[nends++] = i;
+	    deg[a]++;
+	    deg[i]++;
+	}
+    }
+
+    edges = N_GNEW(nends + n, int);
+    if (weighted)
+	ewgts = N_GNEW(nends + n, float);
+    for (i = 0; i < n; i++) {
+	graph[i].edges = edges;
+	graph[i].ewgts = ewgts;
+	graph[i].eweights = NULL;
+	graph[i].nedges = 1;
+	edges[0] = i;
+	if (ewgts) {
+	    ewgts[0] = 0;
+	    ewgts += deg[i];
+	}
+	edges += deg[i];
+    }
+    for (j = 0; j < nends; j += 2) {
+	a = ends[j];
+	b = ends[j + 1];
+	graph[a].edges[graph[a].nedges] = b;
+	graph[b].edges[graph[b].nedges] = a;
+	if (weighted)
+	    graph[a].ewgts[graph[a].nedges] =
+		graph[b].ewgts[graph[b].nedges] =
+		1 + (rand_r(&seed) % 100) / 10.0;
+	graph[a].nedges++;
+	graph[b].nedges++;
+    }
+    free(ends);
+    free(deg);
+    return graph;
+}
+
+int main(int argc, char *argv[])
+{
+    vtx_data *graph;
+    float *D, *D1 = NULL;
+    double t, t1 = 0;
+    int n = 5000, maxthreads = 8, weighted = 0;
+    int c, nt;
+    size_t len;
+
+    while ((c = getopt(argc, argv, "n:t:w")) != -1) {
+	switch (c) {
+	case 'n':
+	    n = atoi(optarg);
+	    break;
+	case 't':
+	    maxthreads = atoi(optarg);
+	    break;
+	case 'w':
+	    weighted = 1;
+	    break;
+	default:
+	    fprintf(stderr, "usage: %s [-n nodes] [-t threads] [-w]\n",
+		    argv[0]);
+	    return 1;
+	}
+    }
+    if (n < 2 || maxthreads < 1) {
+	fprintf(stderr, "%s: need at least 2 nodes and 1 thread\n", argv[0]);
+	return 1;
+    }
+
+    graph = mkgraph(n, weighted);
+    len = (size_t) n * (n + 1) / 2;
+    printf("%d nodes, %s\n", n, weighted ? "weighted" : "unweighted");
+    printf("%8s %10s %8s\n", "threads", "seconds", "speedup");
+    for (nt = 1;; nt = MIN(2 * nt, maxthreads)) {
+	Nthreads = nt;
+	t = now();
+	if (weighted)
+	    D = compute_weighted_apsp_packed(graph, n);
+	else
+	    D = compute_apsp_packed(graph, n);
+	t = now() - t;
+	if (nt == 1) {
+	    D1 = D;
+	    t1 = t;
+	} else {
+	    if (memcmp(D, D1, len * sizeof(float)))
+		fprintf(stderr, "%d threads: distances differ\n", nt);
+	    free(D);
+	}
+	printf("%8d %10.3f %8.2f\n", nt, t, t > 0 ? t1 / t : 0);
+	if (nt == maxthreads)
+	    break;
+    }
+    free(D1);
+    free(graph[0].edges);
+    free(graph[0].ewgts);
+    free(graph);
+    return 0;
+}
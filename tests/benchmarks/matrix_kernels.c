@@ -0,0 +1,222 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/*
+ * Timing of neato's packed float kernels against the plain loops they
+ * replaced.
+ *
+ *   matrix_kernels [-n nodes] [-r repeats]
+ *
+ * A random packed symmetric matrix on the given number of nodes is
+ * multiplied by a vector, and the stress of a random 2-D layout is
+ * summed, with each instruction set the CPU supports. The results of
+ * all instruction sets must be identical; their difference from the
+ * plain loops, relative to the largest entry of the result, is printed.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "matrix_ops.h"
+
+static const char *isa[] = { "scalar", "sse2", "avx" };
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* The loops used before the kernels were vectorized */
+
+static void
+symv_plain(float *packed_matrix, int n, float *vector, float *result)
+{
+    int i, j, index;
+    float vector_i;
+    float res;
+
+    for (i = 0; i < n; i++)
+	result[i] = 0;
+    for (index = 0, i = 0; i < n; i++) {
+	res = 0;
+	vector_i = vector[i];
+	res += packed_matrix[index++] * vector_i;
+	for (j = i + 1; j < n; j++, index++) {
+	    res += packed_matrix[index] * vector[j];
+	    result[j] += packed_matrix[index] * vector_i;
+	}
+	result[i] += res;
+    }
+}
+
+static double dot_plain(int n, float *vector1, float *vector2)
+{
+    int i;
+    double result = 0;
+
+    for (i = 0; i < n; i++)
+	result += vector1[i] * vector2[i];
+    return result;
+}
+
+static double stress_plain(float **coords, float *lap, int dim, int n)
+{
+    int i, j, l, count;
+    double sum = 0, dist, Dij;
+
+    for (count = 0, i = 0; i < n - 1; i++) {
+	count++;
+	for (j = i + 1; j < n; j++, count++) {
+	    dist = 0;
+	    for (l = 0; l < dim; l++)
+		dist += (coords[l][i] - coords[l][j]) *
+		    (coords[l][i] - coords[l][j]);
+	    dist = sqrt(dist);
+	    Dij = 1.0 / lap[count];
+	    sum += (Dij - dist) * (Dij - dist) * lap[count];
+	}
+    }
+    return sum;
+}
+
+static float frand(unsigned int *seed)
+{
+    return rand_r(seed) / (float) RAND_MAX;
+}
+
+int main(int argc, char *argv[])
+{
+    int n = 4000, repeats = 20, dim = 2;
+    int c, i, r, ndot, level, best;
+    size_t len;
+    unsigned int seed = 1;
+    float *A, *x, *y, *yref, *y0 = NULL, *coords[2];
+    double t, tref, d = 0, dref = 0, d0 = 0, s, sref, s0 = 0, err, ymax;
+
+    while ((c = getopt(argc, argv, "n:r:")) != -1) {
+	switch (c) {
+	case 'n':
+	    n = atoi(optarg);
+	    break;
+	case 'r':
+	    repeats = atoi(optarg);
+	    break;
+	default:
+	    fprintf(stderr, "usage: %s [-n nodes] [-r repeats]\n", argv[0]);
+	    return 1;
+	}
+    }
+    if (n < 2 || repeats < 1) {
+	fprintf(stderr, "%s: need at least 2 nodes and 1 repeat\n", argv[0]);
+	return 1;
+    }
+
+    len = (size_t) n * (n + 1) / 2;
+    A = malloc(len * sizeof(float));
+    x = malloc(n * sizeof(float));
+    y = malloc(n * sizeof(float));
+    yref = malloc(n * sizeof(float));
+    for (i = 0; i < dim; i++) {
+	coords[i] = malloc(n * sizeof(float));
+	for (r = 0; r < n; r++)
+	    coords[i][r] = 100 * frand(&seed);
+    }
+    for (i = 0; i < len; i++)
+	A[i] = 0.01f + frand(&seed);
+    for (i = 0; i < n; i++)
+	x[i] = frand(&seed) - 0.5f;
+
+    tref = now();
+    for (r = 0; r < repeats; r++)
+	symv_plain(A, n, x, yref);
+    tref = now() - tref;
+
+    best = matrix_ops_simd(-1);
+    printf("%d nodes, %d repeats\n", n, repeats);
+    printf("%-8s %-7s %10s %8s %10s\n", "kernel", "isa", "seconds",
+	   "speedup", "rel.diff");
+    printf("%-8s %-7s %10.3f\n", "symv", "plain", tref);
+    for (level = SIMD_NONE; level <= best; level++) {
+	matrix_ops_simd(level);
+	t = now();
+	for (r = 0; r < repeats; r++)
+	    right_mult_with_vector_ff(A, n, x, y);
+	t = now() - t;
+	for (err = ymax = 0, i = 0; i < n; i++) {
+	    err = fmax(err, fabs(y[i] - yref[i]));
+	    ymax = fmax(ymax, fabs(yref[i]));
+	}
+	err /= fmax(ymax, 1e-30);
+	printf("%-8s %-7s %10.3f %8.2f %10.2e\n", "symv", isa[level], t,
+	       t > 0 ? tref / t : 0, err);
+	if (!y0)
+	    y0 = memcpy(malloc(n * sizeof(float)), y, n * sizeof(float));
+	else if (memcmp(y, y0, n * sizeof(float)))
+	    fprintf(stderr, "symv: %s differs from scalar\n", isa[level]);
+    }
+
+    ndot = repeats * (n / 8 + 1);	/* about as much work as symv */
+    tref = now();
+    for (r = 0; r < ndot; r++)
+	dref = dot_plain(n, x, yref);
+    tref = now() - tref;
+    printf("%-8s %-7s %10.3f\n", "dot", "plain", tref);
+    for (level = SIMD_NONE; level <= best; level++) {
+	matrix_ops_simd(level);
+	t = now();
+	for (r = 0; r < ndot; r++)
+	    d = vectors_inner_productf(n, x, yref);
+	t = now() - t;
+	printf("%-8s %-7s %10.3f %8.2f %10.2e\n", "dot", isa[level], t,
+	       t > 0 ? tref / t : 0,
+	       fabs(d - dref) / fmax(fabs(dref), 1e-30));
+	if (level == SIMD_NONE)
+	    d0 = d;
+	else if (d != d0)
+	    fprintf(stderr, "dot: %s differs from scalar\n", isa[level]);
+    }
+
+    tref = now();
+    sref = stress_plain(coords, A, dim, n);
+    tref = now() - tref;
+    printf("%-8s %-7s %10.3f\n", "stress", "plain", tref);
+    for (level = SIMD_NONE; level <= best; level++) {
+	matrix_ops_simd(level);
+	t = now();
+	s = stress_packedf(coords, A, dim, n);
+	t = now() - t;
+	printf("%-8s %-7s %10.3f %8.2f %10.2e\n", "stress", isa[level], t,
+	       t > 0 ? tref / t : 0, fabs(s - sref) / sref);
+	if (level == SIMD_NONE)
+	    s0 = s;
+	else if (s != s0)
+	    fprintf(stderr, "stress: %s differs from scalar\n", isa[level]);
+    }
+
+    free(A);
+    free(x);
+    free(y);
+    free(y0);
+    free(yref);
+    free(coords[0]);
+    free(coords[1]);
+    return 0;
+}
@@ -0,0 +1,122 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/*
+ * Timing of the packing of many rectangles.
+ *
+ *   pack_rects [-n rects] [-m margin] [-p packmode]
+ *
+ * Rectangles of random size, mostly small with a few large ones, as
+ * for the components of a typical disconnected graph, are packed with
+ * putRects, by default in "graph" mode. The time, the density of the
+ * packing and a checksum of the positions are printed, so the result
+ * can be compared between versions of the library and between modes.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "render.h"
+#include "pack.h"
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    int n = 5000, margin = 8;
+    int c, i;
+    unsigned int seed = 1;
+    unsigned long sum = 0;
+    char *mode = "graph";
+    double t, w, h, area = 0;
+    boxf bb;
+    boxf *bbs;
+    point *pp;
+    pack_info pinfo;
+
+    while ((c = getopt(argc, argv, "n:m:p:")) != -1) {
+	switch (c) {
+	case 'n':
+	    n = atoi(optarg);
+	    break;
+	case 'm':
+	    margin = atoi(optarg);
+	    break;
+	case 'p':
+	    mode = optarg;
+	    break;
+	default:
+	    fprintf(stderr, "usage: %s [-n rects] [-m margin] [-p packmode]\n",
+		    argv[0]);
+	    return 1;
+	}
+    }
+    if (n < 1 || margin < 0) {
+	fprintf(stderr, "%s: need at least 1 rectangle\n", argv[0]);
+	return 1;
+    }
+
+    bbs = N_NEW(n, boxf);
+    for (i = 0; i < n; i++) {
+	w = 20 + rand_r(&seed) % 60;
+	h = 20 + rand_r(&seed) % 40;
+	if (rand_r(&seed) % 50 == 0) {
+	    w *= 1 + rand_r(&seed) % 8;
+	    h *= 1 + rand_r(&seed) % 8;
+	}
+	bbs[i].LL.x = bbs[i].LL.y = 0;
+	bbs[i].UR.x = w;
+	bbs[i].UR.y = h;
+	area += w * h;
+    }
+
+    pinfo.aspect = 1;
+    pinfo.margin = margin;
+    pinfo.doSplines = 0;
+    pinfo.fixed = NULL;
+    parsePackModeInfo(mode, l_graph, &pinfo);
+
+    t = now();
+    pp = putRects(n, bbs, &pinfo);
+    t = now() - t;
+    if (!pp) {
+	fprintf(stderr, "%s: packing failed\n", argv[0]);
+	return 1;
+    }
+    bb.LL.x = bb.LL.y = HUGE_VAL;
+    bb.UR.x = bb.UR.y = -HUGE_VAL;
+    for (i = 0; i < n; i++) {
+	sum = sum * 31 + (unsigned) (pp[i].x * 7919 + pp[i].y);
+	bb.LL.x = MIN(bb.LL.x, bbs[i].LL.x + pp[i].x);
+	bb.LL.y = MIN(bb.LL.y, bbs[i].LL.y + pp[i].y);
+	bb.UR.x = MAX(bb.UR.x, bbs[i].UR.x + pp[i].x);
+	bb.UR.y = MAX(bb.UR.y, bbs[i].UR.y + pp[i].y);
+    }
+    printf("%d rects, margin %d, %s: %.3f sec, density %.3f, checksum %lx\n",
+	   n, margin, mode, t,
+	   area / ((bb.UR.x - bb.LL.x) * (bb.UR.y - bb.LL.y)), sum);
+
+    free(pp);
+    free(bbs);
+    return 0;
+}
@@ -0,0 +1,141 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/*
+ * Parse throughput of agread and agmmapread, in MB/s.
+ *
+ *   parse_throughput [-n nodes] [-r reps] [files]
+ *
+ * Each file is parsed reps times with each reader. With -n, a synthetic
+ * graph with the given number of nodes, about 4 edges per node and
+ * a mix of quoted, numeric and plain attribute values is also measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cgraph.h"
+
+typedef Agraph_t *(*readfn) (void *, Agdisc_t *);
+
+static double now(void)
+{
+    return (double) clock() / CLOCKS_PER_SEC;
+}
+
+/* parsefile:
+ * Read every graph in fp with rd, reps times. Return the CPU time
+ * and store the number of graphs read in each pass in ng.
+ */
+static double parsefile(FILE * fp, readfn rd, int reps, int *ng)
+{
+    Agraph_t *g;
+    double t = now();
+    int i;
+
+    for (i = 0; i < reps; i++) {
+	rewind(fp);
+	*ng = 0;
+	while ((g = rd(fp, NULL))) {
+	    (*ng)++;
+	    agclose(g);
+	}
+    }
+    return now() - t;
+}
+
+static void report(char *name, FILE * fp, int reps, double *tot)
+{
+    struct stat st;
+    double mb, t0, t1;
+    int n0, n1;
+
+    fstat(fileno(fp), &st);
+    mb = (double) st.st_size * reps / (1024 * 1024);
+    t0 = parsefile(fp, agread, reps, &n0);
+    t1 = parsefile(fp, agmmapread, reps, &n1);
+    if (n0 != n1)
+	fprintf(stderr, "%s: agread found %d graphs, agmmapread %d\n",
+		name, n0, n1);
+    printf("%-32s %10ld %10.1f %10.1f\n", name, (long) st.st_size,
+	   t0 > 0 ? mb / t0 : 0, t1 > 0 ? mb / t1 : 0);
+    tot[0] += mb;
+    tot[1] += t0;
+    tot[2] += t1;
+}
+
+static FILE *synthetic(int n)
+{
+    FILE *fp = tmpfile();
+    int i, j;
+
+    if (!fp)
+	return NULL;
+    srand(1);
+    fprintf(fp, "digraph synthetic {\n  node [shape=box, width=0.5]\n");
+    for (i = 0; i < n; i++)
+	fprintf(fp, "  n%d [label=\"node %d\", pos=\"%d,%d\", height=%.2f]\n",
+		i, i, rand() % 10000, rand() % 10000, 0.25 + (i % 7) / 10.0);
+    for (i = 1; i < n; i++)
+	for (j = 0; j < 4; j++)
+	    fprintf(fp, "  n%d -> n%d [weight=%d, len=%.3f]\n",
+		    rand() % i, i, 1 + j, 1.0 + (rand() % 1000) / 1000.0);
+    fprintf(fp, "}\n");
+    fflush(fp);
+    return fp;
+}
+
+int main(int argc, char **argv)
+{
+    double tot[3] = { 0, 0, 0 };
+    int c, i, reps = 3, nodes = 0;
+    FILE *fp;
+    char name[64];
+
+    while ((c = getopt(argc, argv, "n:r:")) != -1) {
+	switch (c) {
+	case 'n':
+	    nodes = atoi(optarg);
+	    break;
+	case 'r':
+	    reps = atoi(optarg);
+	    break;
+	default:
+	    fprintf(stderr, "usage: %s [-n nodes] [-r reps] [files]\n",
+		    argv[0]);
+	    return 1;
+	}
+    }
+
+    printf("%-32s %10s %10s %10s\n", "input", "bytes", "agread", "agmmapread");
+    for (i = optind; i < argc; i++) {
+	if (!(fp = fopen(argv[i], "r"))) {
+	    perror(argv[i]);
+	    continue;
+	}
+	report(argv[i], fp, reps, tot);
+	fclose(fp);
+    }
+    if (nodes > 0 && (fp = synthetic(nodes))) {
+	snprintf(name, sizeof(name), "synthetic(%d nodes)", nodes);
+	report(name, fp, reps, tot);
+	fclose(fp);
+    }
+    if (tot[1] > 0 && tot[2] > 0)
+	printf("%-32s %10s %10.1f %10.1f\n", "total MB/s", "", tot[0] / tot[1],
+	       tot[0] / tot[2]);
+    return 0;
+}
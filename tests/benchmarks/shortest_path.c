@@ -0,0 +1,179 @@
+/* $Id$ $Revision$ */
+/* vim:set shiftwidth=4 ts=8: */
+
+/*************************************************************************
+ * Copyright (c) 2011 AT&T Intellectual Property
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors: See CVS logs. Details at http://www.graphviz.org/
+ *************************************************************************/
+
+/*
+ * Timing of Pshortestpath with each triangulation.
+ *
+ *   shortest_path [-r repeats] [file ...]
+ *
+ * The polygons are read from the files, by default corridors.txt, which
+ * holds routing polygons that dot built for the graphs in rtest/graphs.
+ * Each line has a vertex count n, then n vertices and the two endpoints
+ * of the path, as x y pairs; lines starting with # are comments. The
+ * time per path is printed by polygon size, with the number of paths
+ * that differ from those of ear clipping.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "pathplan.h"
+
+#define NSIZES 3
+
+static const int maxsize[NSIZES] = { 31, 127, 1 << 30 };
+static const char *method[] = { "monotone", "earclip" };
+
+typedef struct {
+    Ppoly_t poly;
+    Ppoint_t eps[2];
+    Ppolyline_t path;		/* path by ear clipping */
+} job_t;
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int readjobs(char *name, job_t ** jobs, int *njobs, int *sz)
+{
+    FILE *fp = fopen(name, "r");
+    job_t *j;
+    int c, i, n;
+
+    if (!fp) {
+	perror(name);
+	return 0;
+    }
+    while ((c = getc(fp)) != EOF) {
+	if (c == '#' || c == '\n') {
+	    while (c != '\n' && c != EOF)
+		c = getc(fp);
+	    continue;
+	}
+	ungetc(c, fp);
+	if (fscanf(fp, "%d", &n) != 1 || n < 3)
+	    break;
+	if (*njobs == *sz) {
+	    *sz = 2 * *sz + 16;
+	    *jobs = realloc(*jobs, *sz * sizeof(job_t));
+	}
+	j = &(*jobs)[(*njobs)++];
+	j->poly.pn = n;
+	j->poly.ps = malloc(n * sizeof(Ppoint_t));
+	for (i = 0; i < n; i++)
+	    if (fscanf(fp, "%lf %lf", &j->poly.ps[i].x, &j->poly.ps[i].y) != 2)
+		break;
+	if (i < n || fscanf(fp, "%lf %lf %lf %lf", &j->eps[0].x, &j->eps[0].y,
+			    &j->eps[1].x, &j->eps[1].y) != 4) {
+	    fprintf(stderr, "%s: bad polygon %d\n", name, *njobs);
+	    fclose(fp);
+	    return 0;
+	}
+    }
+    fclose(fp);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int repeats = 200, njobs = 0, sz = 0;
+    int c, i, k, r, m, cnt, ndiff;
+    job_t *jobs = NULL;
+    Ppolyline_t path;
+    double t, tref[NSIZES];
+
+    while ((c = getopt(argc, argv, "r:")) != -1) {
+	switch (c) {
+	case 'r':
+	    repeats = atoi(optarg);
+	    break;
+	default:
+	    fprintf(stderr, "usage: %s [-r repeats] [file ...]\n", argv[0]);
+	    return 1;
+	}
+    }
+    if (repeats < 1) {
+	fprintf(stderr, "%s: need at least 1 repeat\n", argv[0]);
+	return 1;
+    }
+    if (optind == argc) {
+	if (!readjobs("corridors.txt", &jobs, &njobs, &sz))
+	    return 1;
+    }
+    for (i = optind; i < argc; i++)
+	if (!readjobs(argv[i], &jobs, &njobs, &sz))
+	    return 1;
+
+    Pshortestpath_triangulation(PTRI_EARCLIP);
+    for (i = 0; i < njobs; i++) {
+	if (Pshortestpath(&jobs[i].poly, jobs[i].eps, &path) < 0)
+	    path.pn = 0;
+	jobs[i].path.pn = path.pn;
+	jobs[i].path.ps = malloc(path.pn * sizeof(Ppoint_t) + 1);
+	memcpy(jobs[i].path.ps, path.ps, path.pn * sizeof(Ppoint_t));
+    }
+
+    printf("%d polygons, %d repeats\n", njobs, repeats);
+    printf("%-9s %-9s %6s %12s %8s %6s\n", "vertices", "method", "paths",
+	   "usec/path", "speedup", "diffs");
+    for (k = 0; k < NSIZES; k++) {
+	for (m = PTRI_EARCLIP; m >= PTRI_MONOTONE; m--) {
+	    Pshortestpath_triangulation(m);
+	    t = now();
+	    for (cnt = 0, r = 0; r < repeats; r++)
+		for (i = 0; i < njobs; i++) {
+		    if (jobs[i].poly.pn > maxsize[k]
+			|| (k > 0 && jobs[i].poly.pn <= maxsize[k - 1]))
+			continue;
+		    Pshortestpath(&jobs[i].poly, jobs[i].eps, &path);
+		    cnt++;
+		}
+	    t = now() - t;
+	    if (cnt == 0)
+		break;
+	    for (ndiff = 0, i = 0; i < njobs; i++) {
+		if (jobs[i].poly.pn > maxsize[k]
+		    || (k > 0 && jobs[i].poly.pn <= maxsize[k - 1]))
+		    continue;
+		if (Pshortestpath(&jobs[i].poly, jobs[i].eps, &path) < 0)
+		    path.pn = 0;
+		if (path.pn != jobs[i].path.pn
+		    || memcmp(path.ps, jobs[i].path.ps,
+			      path.pn * sizeof(Ppoint_t)))
+		    ndiff++;
+	    }
+	    if (m == PTRI_EARCLIP)
+		tref[k] = t;
+	    printf("%3d-%-5d %-9s %6d %12.2f %8.2f %6d\n",
+		   k > 0 ? maxsize[k - 1] + 1 : 3,
+		   k < NSIZES - 1 ? maxsize[k] : 99999, method[m],
+		   cnt / repeats, 1e6 * t / cnt, t > 0 ? tref[k] / t : 0,
+		   ndiff);
+	}
+    }
+
+    for (i = 0; i < njobs; i++) {
+	free(jobs[i].poly.ps);
+	free(jobs[i].path.ps);
+    }
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <criterion/criterion.h>
+
+#include <stdio.h>
+
+#include "config.h"
+#include "cgraph.h"
+
+Test(cgraph_attr, numbers)
+{
+    Agraph_t *g = agopen("g", Agdirected, NIL(Agdisc_t *));
+    Agnode_t *n = agnode(g, "a", 1);
+    Agsym_t *sym = agattr(g, AGNODE, "width", "0.75");
+    double d;
+    int i;
+
+    cr_assert(agxgetdouble(n, sym, &d));
+    cr_assert_float_eq(d, 0.75, 1e-12);
+    cr_assert(agxgetint(n, sym, &i));
+    cr_assert_eq(i, 0);
+
+    /* a value that is not a number leaves v alone */
+    agxset(n, sym, "wide");
+    d = -1.0;
+    i = -1;
+    cr_assert(!agxgetdouble(n, sym, &d));
+    cr_assert(!agxgetint(n, sym, &i));
+    cr_assert_float_eq(d, -1.0, 1e-12);
+    cr_assert_eq(i, -1);
+
+    agclose(g);
+}
+
+Test(cgraph_attr, agxset_invalidates)
+{
+    Agraph_t *g = agopen("g", Agdirected, NIL(Agdisc_t *));
+    Agnode_t *a = agnode(g, "a", 1);
+    Agnode_t *b = agnode(g, "b", 1);
+    Agsym_t *sym = agattr(g, AGNODE, "height", "1");
+    Agsym_t *late;
+    double d;
+    int i;
+
+    cr_assert(agxgetint(a, sym, &i));
+    cr_assert_eq(i, 1);
+
+    /* setting the value drops what was parsed from the old one */
+    agxset(a, sym, "2.5");
+    cr_assert(agxgetdouble(a, sym, &d));
+    cr_assert_float_eq(d, 2.5, 1e-12);
+    cr_assert(agxgetint(a, sym, &i));
+    cr_assert_eq(i, 2);
+    agset(a, "height", "7");
+    cr_assert(agxgetdouble(a, sym, &d));
+    cr_assert_float_eq(d, 7.0, 1e-12);
+
+    /* the other node keeps the default */
+    cr_assert(agxgetint(b, sym, &i));
+    cr_assert_eq(i, 1);
+
+    /* an attribute declared after the values were cached */
+    late = agattr(g, AGNODE, "fontsize", "14");
+    cr_assert(agxgetint(a, late, &i));
+    cr_assert_eq(i, 14);
+    agxset(a, late, "9");
+    cr_assert(agxgetint(a, late, &i));
+    cr_assert_eq(i, 9);
+    cr_assert(agxgetdouble(a, sym, &d));
+    cr_assert_float_eq(d, 7.0, 1e-12);
+
+    agclose(g);
+}
+
+Test(cgraph_attr, points)
+{
+    Agraph_t *g = agopen("g", Agdirected, NIL(Agdisc_t *));
+    Agnode_t *n = agnode(g, "a", 1);
+    Agsym_t *sym = agattr(g, AGNODE, "pos", "");
+    double pt[3];
+    char c;
+
+    cr_assert_eq(agxgetpoint(n, sym, pt, 2, &c), 0);
+
+    agxset(n, sym, "1.5,2");
+    cr_assert_eq(agxgetpoint(n, sym, pt, 2, &c), 2);
+    cr_assert_float_eq(pt[0], 1.5, 1e-12);
+    cr_assert_float_eq(pt[1], 2.0, 1e-12);
+    cr_assert_eq(c, '\0');
+    cr_assert_eq(agxgetpoint(n, sym, pt, 3, &c), 2);
+
+    /* the pin marker follows the point */
+    agxset(n, sym, "3,4!");
+    cr_assert_eq(agxgetpoint(n, sym, pt, 2, &c), 2);
+    cr_assert_float_eq(pt[0], 3.0, 1e-12);
+    cr_assert_float_eq(pt[1], 4.0, 1e-12);
+    cr_assert_eq(c, '!');
+    cr_assert_eq(agxgetpoint(n, sym, pt, 2, NULL), 2);
+
+    agxset(n, sym, "5,6,7!");
+    cr_assert_eq(agxgetpoint(n, sym, pt, 3, &c), 3);
+    cr_assert_float_eq(pt[2], 7.0, 1e-12);
+    cr_assert_eq(c, '!');
+    /* read in 2 dimensions, the point ends at the second comma */
+    cr_assert_eq(agxgetpoint(n, sym, pt, 2, &c), 2);
+    cr_assert_float_eq(pt[1], 6.0, 1e-12);
+    cr_assert_eq(c, ',');
+
+    agxset(n, sym, "8,");
+    cr_assert_eq(agxgetpoint(n, sym, pt, 2, &c), 1);
+    cr_assert_float_eq(pt[0], 8.0, 1e-12);
+
+    agclose(g);
+}
@@ -0,0 +1,156 @@
+#include <criterion/criterion.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "cgraph.h"
+
+#define NNODES 60
+#define NEDGES 240
+
+/* mkgraph:
+ * A random directed multigraph with loops, and a subgraph holding
+ * every third node and the edges among them.
+ */
+static Agraph_t *mkgraph(unsigned int seed)
+{
+    Agraph_t *g, *sg;
+    Agnode_t *nodes[NNODES];
+    Agedge_t *e;
+    char name[32];
+    int i;
+
+    g = agopen("g", Agdirected, NIL(Agdisc_t *));
+    sg = agsubg(g, "sub", 1);
+    for (i = 0; i < NNODES; i++) {
+	snprintf(name, sizeof(name), "n%d", i);
+	nodes[i] = agnode(g, name, 1);
+    }
+    for (i = 0; i < NEDGES; i++) {
+	e = agedge(g, nodes[rand_r(&seed) % NNODES],
+		   nodes[rand_r(&seed) % NNODES], NULL, 1);
+	if (AGSEQ(agtail(e)) % 3 == 0 && AGSEQ(aghead(e)) % 3 == 0)
+	    agsubedge(sg, e, 1);
+    }
+    for (i = 0; i < NNODES; i += 3)
+	agsubnode(sg, nodes[i], 1);
+    return g;
+}
+
+/* check:
+ * The snapshot of g lists the nodes and edges of g in the order of
+ * the graph's own iterators, and numbers them densely.
+ */
+static void check(Agraph_t * g, Agcsr_t * c)
+{
+    Agnode_t *n;
+    Agedge_t *e, *f;
+    int i, j;
+
+    cr_assert_eq(c->nnodes, agnnodes(g));
+    cr_assert_eq(c->nedges, agnedges(g));
+    for (i = 0, n = agfstnode(g); n; n = agnxtnode(g, n), i++) {
+	cr_assert_eq(c->node[i], n);
+	cr_assert_eq(agnodeindex(c, n), i);
+	for (e = agfstout(g, n), f = agcsrfstout(c, n); e;
+	     e = agnxtout(g, e), f = agcsrnxtout(c, f)) {
+	    cr_assert_eq(f, e);
+	    j = agedgeindex(c, e);
+	    cr_assert_eq(c->out[j], e);
+	    cr_assert_eq(c->node[c->head[j]], aghead(e));
+	}
+	cr_assert_eq(f, NULL);
+	for (e = agfstin(g, n), f = agcsrfstin(c, n); e;
+	     e = agnxtin(g, e), f = agcsrnxtin(c, f))
+	    cr_assert_eq(f, e);
+	cr_assert_eq(f, NULL);
+    }
+    cr_assert_eq(i, c->nnodes);
+}
+
+Test(cgraph_freeze, snapshot_matches_graph)
+{
+    Agraph_t *g = mkgraph(5u);
+    Agraph_t *sg = agsubg(g, "sub", 0);
+    Agcsr_t *c, *sc;
+    Agnode_t *n;
+
+    c = agfreeze(g);
+    sc = agfreeze(sg);
+    check(g, c);
+    check(sg, sc);
+
+    /* nodes outside the subgraph have no index in its snapshot */
+    for (n = agfstnode(g); n; n = agnxtnode(g, n))
+	if (!agsubnode(sg, n, 0)) {
+	    cr_assert_eq(agnodeindex(sc, n), -1);
+	    cr_assert_eq(agcsrfstout(sc, n), NULL);
+	}
+    agthaw(sc);
+    agthaw(c);
+    agclose(g);
+}
+
+Test(cgraph_freeze, mutation_makes_snapshot_stale)
+{
+    Agraph_t *g = mkgraph(11u);
+    Agraph_t *sg = agsubg(g, "sub", 0);
+    Agnode_t *a = agfstnode(g), *b = agnxtnode(g, a);
+    Agnode_t *n;
+    Agedge_t *e;
+    Agcsr_t *c, *sc;
+
+    /* attribute changes do not touch the adjacency */
+    c = agfreeze(g);
+    agattr(g, AGNODE, "color", "black");
+    agset(a, "color", "red");
+    cr_assert(agcsrvalid(c));
+    agthaw(c);
+
+    c = agfreeze(g);
+    e = agedge(g, a, b, NULL, 1);
+    cr_assert(!agcsrvalid(c));
+    /* an edge the snapshot does not hold has no index and no successor */
+    cr_assert_eq(agedgeindex(c, e), -1);
+    cr_assert_eq(agcsrnxtout(c, e), NULL);
+    cr_assert_eq(agcsrnxtin(c, e), NULL);
+    agthaw(c);
+
+    c = agfreeze(g);
+    agdeledge(g, e);
+    cr_assert(!agcsrvalid(c));
+    agthaw(c);
+
+    c = agfreeze(g);
+    n = agnode(g, "extra", 1);
+    cr_assert(!agcsrvalid(c));
+    agthaw(c);
+
+    c = agfreeze(g);
+    agdelnode(g, n);
+    cr_assert(!agcsrvalid(c));
+    agthaw(c);
+
+    /* a change made through a subgraph reaches the root's snapshot,
+     * and one made in the root reaches the subgraph's */
+    c = agfreeze(g);
+    sc = agfreeze(sg);
+    agsubnode(sg, b, 1);
+    cr_assert(!agcsrvalid(c));
+    cr_assert(!agcsrvalid(sc));
+    agthaw(sc);
+    agthaw(c);
+
+    sc = agfreeze(sg);
+    agnode(g, "another", 1);
+    cr_assert(!agcsrvalid(sc));
+    agthaw(sc);
+
+    /* a refreeze sees the changes */
+    c = agfreeze(g);
+    cr_assert(agcsrvalid(c));
+    check(g, c);
+    agthaw(c);
+    agclose(g);
+}
@@ -0,0 +1,88 @@
+#include <criterion/criterion.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+#include "cgraph.h"
+
+#define NNODES 500
+#define NGRAPHS 10
+
+static Agdisc_t PoolDisc = { &AgPoolMemDisc, &AgIdDisc, &AgIoDisc };
+
+/* mkgraph:
+ * A chain of nodes with a label on each, and a subgraph holding
+ * every other edge of the chain.
+ */
+static Agraph_t *mkgraph(int k)
+{
+    Agraph_t *g, *sg;
+    Agnode_t *n, *prev = NULL;
+    Agedge_t *e;
+    char name[32];
+    int i;
+
+    g = agopen("g", Agdirected, &PoolDisc);
+    sg = agsubg(g, "sub", 1);
+    agattr(g, AGNODE, "label", "");
+    for (i = 0; i < NNODES; i++) {
+	snprintf(name, sizeof(name), "n%d_%d", k, i);
+	n = agnode(g, name, 1);
+	agset(n, "label", name);
+	if (prev) {
+	    e = agedge(g, prev, n, NULL, 1);
+	    if (i % 2 == 0)
+		agsubedge(sg, e, 1);
+	}
+	prev = n;
+    }
+    return g;
+}
+
+static void check(Agraph_t * g, int k)
+{
+    Agnode_t *n;
+    char name[32];
+    int i;
+
+    cr_assert_eq(agnnodes(g), NNODES);
+    cr_assert_eq(agnedges(g), NNODES - 1);
+    for (i = 0, n = agfstnode(g); n; n = agnxtnode(g, n), i++) {
+	snprintf(name, sizeof(name), "n%d_%d", k, i);
+	cr_assert_str_eq(agnameof(n), name);
+	cr_assert_str_eq(agget(n, "label"), name);
+    }
+}
+
+Test(cgraph_pool, open_close_reuse)
+{
+    Agraph_t *g[NGRAPHS];
+    int i, k;
+
+    /* more graphs are open at once than the pool keeps */
+    for (k = 0; k < 3; k++) {
+	for (i = 0; i < NGRAPHS; i++)
+	    g[i] = mkgraph(i);
+	for (i = 0; i < NGRAPHS; i++)
+	    check(g[i], i);
+	for (i = 0; i < NGRAPHS; i++)
+	    cr_assert_eq(agclose(g[i]), 0);
+    }
+
+    /* a graph built in a reused arena may have nodes deleted */
+    g[0] = mkgraph(0);
+    agdelnode(g[0], agnxtnode(g[0], agfstnode(g[0])));
+    cr_assert_eq(agnnodes(g[0]), NNODES - 1);
+    cr_assert_eq(agnedges(g[0]), NNODES - 3);
+    cr_assert_eq(agnnodes(agsubg(g[0], "sub", 0)), NNODES - 3);
+    cr_assert_eq(agnedges(agsubg(g[0], "sub", 0)), NNODES / 2 - 2);
+    agclose(g[0]);
+    agpoolclose();
+
+    /* the pool may be released and used again */
+    g[0] = mkgraph(1);
+    check(g[0], 1);
+    agclose(g[0]);
+    agpoolclose();
+}
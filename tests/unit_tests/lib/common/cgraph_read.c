@@ -0,0 +1,187 @@
+#include <criterion/criterion.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "cgraph.h"
+
+#define NGRAPHS 4
+
+/* several graphs in one file, with comments between them, and
+ * strings with escapes, continuations, newlines and concatenation
+ */
+static char Input[] =
+    "/* first */\n"
+    "digraph G1 {\n"
+    "  a -> b [label=\"a\\\"b\"];\n"
+    "  b [label=\"x\\\\y\", tooltip=\"line\\\n"
+    "continued\"];\n"
+    "  c [label=\"raw\n"
+    "newline\"];\n"
+    "}\n"
+    "  # shell comment\n"
+    "graph G2 { x -- y -- z; x [label=\"a\" + \"b\"]; y [label=<<b>x</b>>]; }\n"
+    "// c++ comment\n"
+    "strict digraph G3 { node [shape=box]; subgraph cluster0 { p; q; }\n"
+    "  p -> q; p -> q; }\n"
+    "digraph \"G 4\" { \"n\\\"1\" -> \"n 2\" }\n"
+    "\n";
+
+/* the graph in the form agwrite gives it */
+static char *dump(Agraph_t * g)
+{
+    FILE *fp = tmpfile();
+    long sz;
+    char *s;
+
+    cr_assert_neq(fp, NULL);
+    cr_assert_eq(agwrite(g, fp), 0);
+    sz = ftell(fp);
+    rewind(fp);
+    s = calloc(sz + 1, 1);
+    cr_assert_eq(fread(s, 1, sz, fp), (size_t) sz);
+    fclose(fp);
+    return s;
+}
+
+static FILE *input(void)
+{
+    FILE *fp = tmpfile();
+
+    cr_assert_neq(fp, NULL);
+    fputs(Input, fp);
+    rewind(fp);
+    return fp;
+}
+
+/* read every graph of the input with agread */
+static int readall(char *out[])
+{
+    FILE *fp = input();
+    Agraph_t *g;
+    int n = 0;
+
+    while ((g = agread(fp, NIL(Agdisc_t *)))) {
+	cr_assert_lt(n, NGRAPHS);
+	out[n++] = dump(g);
+	agclose(g);
+    }
+    fclose(fp);
+    return n;
+}
+
+Test(cgraph_read, mmap_matches_agread)
+{
+    char *ref[NGRAPHS], *s;
+    FILE *fp;
+    Agraph_t *g;
+    long pos;
+    int i, n;
+
+    n = readall(ref);
+    cr_assert_eq(n, NGRAPHS);
+
+    fp = input();
+    for (i = 0; (g = agmmapread(fp, NIL(Agdisc_t *))); i++) {
+	cr_assert_lt(i, NGRAPHS);
+	s = dump(g);
+	cr_assert_str_eq(s, ref[i]);
+	free(s);
+	agclose(g);
+
+	/* the file is left just after the graph */
+	pos = ftell(fp);
+	cr_assert_gt(pos, 0);
+	cr_assert_eq(Input[pos - 1], '}');
+    }
+    cr_assert_eq(i, NGRAPHS);
+    fclose(fp);
+
+    /* agread carries on where agmmapread stopped */
+    fp = input();
+    g = agmmapread(fp, NIL(Agdisc_t *));
+    s = dump(g);
+    cr_assert_str_eq(s, ref[0]);
+    free(s);
+    agclose(g);
+    g = agread(fp, NIL(Agdisc_t *));
+    s = dump(g);
+    cr_assert_str_eq(s, ref[1]);
+    free(s);
+    agclose(g);
+    fclose(fp);
+
+    for (i = 0; i < n; i++)
+	free(ref[i]);
+}
+
+Test(cgraph_read, mmap_of_stream)
+{
+    char *ref[NGRAPHS], *s;
+    FILE *fp;
+    Agraph_t *g;
+    int i, n;
+
+    n = readall(ref);
+
+    /* a stream without a file behind it is read with agread */
+    fp = fmemopen(Input, strlen(Input), "r");
+    cr_assert_neq(fp, NULL);
+    for (i = 0; (g = agmmapread(fp, NIL(Agdisc_t *))); i++) {
+	cr_assert_lt(i, n);
+	s = dump(g);
+	cr_assert_str_eq(s, ref[i]);
+	free(s);
+	agclose(g);
+    }
+    cr_assert_eq(i, n);
+    fclose(fp);
+
+    for (i = 0; i < n; i++)
+	free(ref[i]);
+}
+
+Test(cgraph_read, memread_strings)
+{
+    char *ref[NGRAPHS], *s;
+    Agraph_t *g, *h;
+    Agnode_t *n;
+    int i, k;
+
+    g = agmemread(Input);
+    cr_assert_neq(g, NULL);
+    cr_assert_str_eq(agnameof(g), "G1");
+    n = agnode(g, "a", 0);
+    cr_assert_str_eq(agget(agfstout(g, n), "label"), "a\"b");
+    n = agnode(g, "b", 0);
+    cr_assert_str_eq(agget(n, "label"), "x\\\\y");
+    cr_assert_str_eq(agget(n, "tooltip"), "linecontinued");
+    n = agnode(g, "c", 0);
+    cr_assert_str_eq(agget(n, "label"), "raw\nnewline");
+
+    /* strings outside the first graph */
+    h = agmemread(strstr(Input, "graph G2"));
+    cr_assert_neq(h, NULL);
+    cr_assert_str_eq(agget(agnode(h, "x", 0), "label"), "ab");
+    cr_assert_str_eq(agget(agnode(h, "y", 0), "label"), "<b>x</b>");
+    cr_assert(aghtmlstr(agget(agnode(h, "y", 0), "label")));
+    agclose(h);
+
+    h = agmemread(strstr(Input, "digraph \"G 4\""));
+    cr_assert_neq(h, NULL);
+    cr_assert_str_eq(agnameof(h), "G 4");
+    cr_assert_neq(agnode(h, "n\"1", 0), NULL);
+    cr_assert_neq(agnode(h, "n 2", 0), NULL);
+    agclose(h);
+
+    /* agmemread gives what agread does */
+    k = readall(ref);
+    s = dump(g);
+    cr_assert_str_eq(s, ref[0]);
+    free(s);
+    for (i = 0; i < k; i++)
+	free(ref[i]);
+    agclose(g);
+}
@@ -0,0 +1,170 @@
+#include <criterion/criterion.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "render.h"
+
+#define NGRAPHS 16
+#define NNODES 300
+#define NEXTRA 900
+#define NROUNDS 4
+
+typedef struct {
+    graph_t *g;
+    int *serial;		/* ranks from the serial run */
+    int rv;
+} job_t;
+
+/* mkdag:
+ * Build a random connected DAG with the fast node list and edge lists
+ * that rank2 expects. Forward edges from a chain keep it acyclic.
+ */
+static graph_t *mkdag(int id, unsigned int seed)
+{
+    graph_t *g;
+    node_t **nodes;
+    node_t *t, *h;
+    edge_t *e;
+    char name[32];
+    int i, a, b;
+
+    snprintf(name, sizeof(name), "g%d", id);
+    g = agopen(name, Agdirected, NIL(Agdisc_t *));
+    agbindrec(g, "Agraphinfo_t", sizeof(Agraphinfo_t), TRUE);
+    nodes = N_NEW(NNODES, node_t *);
+    for (i = 0; i < NNODES; i++) {
+	snprintf(name, sizeof(name), "%d", i);
+	nodes[i] = agnode(g, name, 1);
+	agbindrec(nodes[i], "Agnodeinfo_t", sizeof(Agnodeinfo_t), TRUE);
+	alloc_elist(4, ND_in(nodes[i]));
+	alloc_elist(4, ND_out(nodes[i]));
+	if (i == 0)
+	    GD_nlist(g) = nodes[i];
+	else
+	    ND_next(nodes[i - 1]) = nodes[i];
+    }
+    for (i = 0; i < NNODES + NEXTRA; i++) {
+	if (i < NNODES - 1) {
+	    a = i;
+	    b = i + 1;
+	} else {
+	    a = rand_r(&seed) % (NNODES - 1);
+	    b = a + 1 + rand_r(&seed) % (NNODES - 1 - a);
+	}
+	t = nodes[a];
+	h = nodes[b];
+	if (agfindedge(g, t, h))
+	    continue;
+	e = agedge(g, t, h, NULL, 1);
+	agbindrec(e, "Agedgeinfo_t", sizeof(Agedgeinfo_t), TRUE);
+	ED_minlen(e) = rand_r(&seed) % 3;
+	ED_weight(e) = 1 + rand_r(&seed) % 5;
+	elist_append(e, ND_out(t));
+	elist_append(e, ND_in(h));
+    }
+    free(nodes);
+    return g;
+}
+
+static void clearranks(graph_t * g)
+{
+    node_t *n;
+    for (n = GD_nlist(g); n; n = ND_next(n))
+	ND_rank(n) = 0;
+}
+
+static void *runjob(void *arg)
+{
+    job_t *job = arg;
+    int r;
+
+    for (r = 0; r < NROUNDS; r++) {
+	clearranks(job->g);
+	job->rv = rank2(job->g, 1, INT_MAX, 30);
+	if (job->rv)
+	    break;
+    }
+    return NULL;
+}
+
+static void closedag(graph_t * g)
+{
+    node_t *n;
+    for (n = GD_nlist(g); n; n = ND_next(n)) {
+	free_list(ND_in(n));
+	free_list(ND_out(n));
+    }
+    agclose(g);
+}
+
+Test(network_simplex, concurrent_rank2_matches_serial)
+{
+    job_t jobs[NGRAPHS];
+    pthread_t tids[NGRAPHS];
+    node_t *n;
+    int i, j;
+
+    for (i = 0; i < NGRAPHS; i++) {
+	jobs[i].g = mkdag(i, 1234u + i);
+	jobs[i].serial = N_NEW(NNODES, int);
+	clearranks(jobs[i].g);
+	cr_assert_eq(rank2(jobs[i].g, 1, INT_MAX, 30), 0);
+	for (j = 0, n = GD_nlist(jobs[i].g); n; j++, n = ND_next(n))
+	    jobs[i].serial[j] = ND_rank(n);
+    }
+
+    for (i = 0; i < NGRAPHS; i++)
+	cr_assert_eq(pthread_create(&tids[i], NULL, runjob, &jobs[i]), 0);
+    for (i = 0; i < NGRAPHS; i++)
+	pthread_join(tids[i], NULL);
+
+    for (i = 0; i < NGRAPHS; i++) {
+	cr_assert_eq(jobs[i].rv, 0, "graph %d: rank2 failed", i);
+	for (j = 0, n = GD_nlist(jobs[i].g); n; j++, n = ND_next(n))
+	    cr_assert_eq(ND_rank(n), jobs[i].serial[j],
+			 "graph %d node %d: rank %d, expected %d", i, j,
+			 ND_rank(n), jobs[i].serial[j]);
+	free(jobs[i].serial);
+	closedag(jobs[i].g);
+    }
+}
+
+/* rankcost:
+ * Weighted sum of edge lengths, the quantity network simplex minimizes.
+ */
+static long rankcost(graph_t * g)
+{
+    node_t *n;
+    edge_t *e;
+    long cost = 0;
+    int i;
+
+    for (n = GD_nlist(g); n; n = ND_next(n))
+	for (i = 0; (e = ND_out(n).list[i]); i++) {
+	    cr_assert_geq(ND_rank(aghead(e)) - ND_rank(agtail(e)), ED_minlen(e));
+	    cost += ED_weight(e) * (ND_rank(aghead(e)) - ND_rank(agtail(e)));
+	}
+    return cost;
+}
+
+Test(network_simplex, incremental_matches_classic_cost)
+{
+    graph_t *g;
+    long classic;
+    int i;
+
+    for (i = 0; i < NGRAPHS; i++) {
+	g = mkdag(i, 4321u + i);
+	clearranks(g);
+	cr_assert_eq(nsrank(g, 0, INT_MAX, 30, NS_CLASSIC), 0);
+	classic = rankcost(g);
+	clearranks(g);
+	cr_assert_eq(nsrank(g, 0, INT_MAX, 30, NS_INCREMENTAL), 0);
+	cr_assert_eq(rankcost(g), classic, "graph %d: cost %ld, expected %ld",
+		     i, rankcost(g), classic);
+	closedag(g);
+    }
+}
@@ -0,0 +1,152 @@
+#include <criterion/criterion.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "pathplan.h"
+#include "vispath.h"
+
+#define GRID 8			/* obstacles are placed in a GRID x GRID lattice */
+#define CELL 100.0
+#define NPATHS 200
+
+typedef struct {
+    Ppoly_t *polys;
+    Ppoly_t **obs;
+    int n;
+} scene_t;
+
+/* mkscene:
+ * Random convex obstacles, in clockwise order, one in most cells of the
+ * lattice. Half of them have integer vertices, so that many vertices are
+ * collinear and many edges are vertical or horizontal.
+ */
+static void mkscene(scene_t * sc, unsigned int seed)
+{
+    Ppoly_t *p;
+    double a, a0, r, cx, cy;
+    int i, j, k, m, integer;
+
+    sc->polys = malloc(GRID * GRID * sizeof(Ppoly_t));
+    sc->obs = malloc(GRID * GRID * sizeof(Ppoly_t *));
+    sc->n = 0;
+    for (i = 0; i < GRID; i++)
+	for (j = 0; j < GRID; j++) {
+	    if (rand_r(&seed) % 4 == 0)
+		continue;
+	    p = &sc->polys[sc->n];
+	    m = 3 + rand_r(&seed) % 6;
+	    p->pn = m;
+	    p->ps = malloc(m * sizeof(Ppoint_t));
+	    cx = i * CELL + CELL / 2;
+	    cy = j * CELL + CELL / 2;
+	    r = 10 + rand_r(&seed) % 35;
+	    a0 = (rand_r(&seed) % 4) * M_PI / 2;
+	    integer = rand_r(&seed) % 2;
+	    for (k = 0; k < m; k++) {
+		a = a0 - 2 * M_PI * k / m;
+		p->ps[k].x = cx + r * cos(a);
+		p->ps[k].y = cy + r * sin(a);
+		if (integer) {
+		    p->ps[k].x = floor(p->ps[k].x);
+		    p->ps[k].y = floor(p->ps[k].y);
+		}
+	    }
+	    sc->obs[sc->n] = p;
+	    sc->n++;
+	}
+}
+
+static void freescene(scene_t * sc)
+{
+    int i;
+
+    for (i = 0; i < sc->n; i++)
+	free(sc->polys[i].ps);
+    free(sc->polys);
+    free(sc->obs);
+}
+
+/* endpoint:
+ * Either a point inside obstacle *poly, or a random point with
+ * *poly set to POLYID_UNKNOWN. Some points share the x coordinate
+ * of the other endpoint, to test vertical segments.
+ */
+static Ppoint_t endpoint(scene_t * sc, unsigned int *seed, int *poly,
+			 Ppoint_t * other)
+{
+    Ppoint_t p, q;
+    Ppoly_t *o;
+
+    if (rand_r(seed) % 2) {
+	*poly = rand_r(seed) % sc->n;
+	o = sc->obs[*poly];
+	p = o->ps[0];
+	q = o->ps[o->pn / 2];
+	p.x = (3 * p.x + q.x) / 4;
+	p.y = (3 * p.y + q.y) / 4;
+    } else {
+	*poly = POLYID_UNKNOWN;
+	p.x = rand_r(seed) % (int) (GRID * CELL);
+	p.y = rand_r(seed) % (int) (GRID * CELL);
+	if (other && rand_r(seed) % 3 == 0)
+	    p.x = other->x;
+    }
+    return p;
+}
+
+Test(pathplan_obstacles, incremental_paths_match_eager)
+{
+    scene_t sc;
+    vconfig_t *eager, *incr;
+    Ppolyline_t a, b;
+    Ppoint_t p, q;
+    int i, pp, qp, s;
+    unsigned int seed;
+
+    for (s = 0; s < 4; s++) {
+	mkscene(&sc, 19u + s);
+	eager = Pobsopen(sc.obs, sc.n);
+	incr = Pobsopen_incremental(sc.obs, sc.n);
+	cr_assert_not_null(eager);
+	cr_assert_not_null(incr);
+	seed = 7u + s;
+	for (i = 0; i < NPATHS; i++) {
+	    p = endpoint(&sc, &seed, &pp, NULL);
+	    q = endpoint(&sc, &seed, &qp, &p);
+	    Pobspath(eager, p, pp, q, qp, &a);
+	    Pobspath(incr, p, pp, q, qp, &b);
+	    cr_assert(a.pn == b.pn
+		      && !memcmp(a.ps, b.ps, a.pn * sizeof(Ppoint_t)),
+		      "scene %d: path %d differs", s, i);
+	    free(a.ps);
+	    free(b.ps);
+	}
+	Pobsclose(eager);
+	Pobsclose(incr);
+	freescene(&sc);
+    }
+}
+
+Test(pathplan_obstacles, path_bends_around_obstacle)
+{
+    Ppoint_t square[4] = { {-10, -10}, {-10, 10}, {10, 10}, {10, -10} };
+    Ppoly_t poly = { square, 4 };
+    Ppoly_t *obs[1] = { &poly };
+    Ppoint_t p = { -20, 0 }, q = { 20, 0 }, r = { -20, 20 };
+    vconfig_t *vc = Pobsopen_incremental(obs, 1);
+    Ppolyline_t line;
+
+    Pobspath(vc, p, POLYID_NONE, q, POLYID_NONE, &line);
+    cr_assert_eq(line.pn, 4);
+    cr_assert_eq(fabs(line.ps[1].y), 10);
+    cr_assert_eq(line.ps[1].y, line.ps[2].y);
+    free(line.ps);
+
+    Pobspath(vc, p, POLYID_NONE, r, POLYID_NONE, &line);
+    cr_assert_eq(line.pn, 2);
+    free(line.ps);
+    Pobsclose(vc);
+}
@@ -0,0 +1,207 @@
+#include <criterion/criterion.h>
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "pathplan.h"
+
+#define NPOLYS 64
+#define NVERTS 40
+#define NTHREADS 8
+#define NROUNDS 4
+
+typedef struct {
+    Ppoly_t poly;
+    Pedge_t *barriers;
+    Ppoint_t eps[2];
+    int rv;			/* result of the serial run */
+    Ppolyline_t path;		/* shortest path of the serial run */
+    Ppolyline_t spline;		/* spline of the serial run */
+} route_t;
+
+typedef struct {
+    route_t *routes;
+    int first;
+    int failed;			/* index of the first mismatch, or -1 */
+} job_t;
+
+/* mkroute:
+ * A random star-shaped polygon around the origin, with endpoints near
+ * the tips of two of its spikes, so that both lie inside it and the
+ * path between them bends around the inner vertices.
+ */
+static void mkroute(route_t * r, unsigned int seed)
+{
+    Ppoint_t *ps;
+    double a, rad;
+    int i, j;
+
+    ps = malloc(NVERTS * sizeof(Ppoint_t));
+    for (i = 0; i < NVERTS; i++) {
+	a = 2 * M_PI * (i + 0.1 + 0.8 * rand_r(&seed) / (double) RAND_MAX)
+	    / NVERTS;
+	if (i % 2)
+	    rad = 10 + rand_r(&seed) % 20;
+	else
+	    rad = 60 + rand_r(&seed) % 40;
+	ps[i].x = rad * cos(a);
+	ps[i].y = rad * sin(a);
+    }
+    r->poly.ps = ps;
+    r->poly.pn = NVERTS;
+    r->barriers = malloc(NVERTS * sizeof(Pedge_t));
+    for (i = 0; i < NVERTS; i++) {
+	r->barriers[i].a = ps[i];
+	r->barriers[i].b = ps[(i + 1) % NVERTS];
+    }
+    i = 2 * (rand_r(&seed) % (NVERTS / 2));
+    j = (i + 2 * (NVERTS / 6 + rand_r(&seed) % (NVERTS / 6))) % NVERTS;
+    r->eps[0].x = 0.8 * ps[i].x;
+    r->eps[0].y = 0.8 * ps[i].y;
+    r->eps[1].x = 0.8 * ps[j].x;
+    r->eps[1].y = 0.8 * ps[j].y;
+}
+
+static Ppolyline_t copyline(Ppolyline_t l)
+{
+    Ppolyline_t c;
+
+    c.pn = l.pn;
+    c.ps = malloc(l.pn * sizeof(Ppoint_t));
+    memcpy(c.ps, l.ps, l.pn * sizeof(Ppoint_t));
+    return c;
+}
+
+static int sameline(Ppolyline_t a, Ppolyline_t b)
+{
+    return a.pn == b.pn && !memcmp(a.ps, b.ps, a.pn * sizeof(Ppoint_t));
+}
+
+/* routeone:
+ * Route r with ws, as the serial run did without one.
+ * Return true if the results agree.
+ */
+static int routeone(Pworkspace_t * ws, route_t * r)
+{
+    Ppolyline_t path, spline;
+    Pvector_t slopes[2];
+
+    if (Pshortestpath_w(ws, &r->poly, r->eps, &path) < 0)
+	return 0;
+    if (!sameline(path, r->path))
+	return 0;
+    slopes[0].x = slopes[0].y = slopes[1].x = slopes[1].y = 0;
+    if (Proutespline_w(ws, r->barriers, r->poly.pn, path, slopes, &spline)
+	!= r->rv)
+	return 0;
+    return r->rv < 0 || sameline(spline, r->spline);
+}
+
+static void *runjob(void *arg)
+{
+    job_t *job = arg;
+    Pworkspace_t *ws = Pnewworkspace();
+    int k, i;
+
+    job->failed = -1;
+    for (k = 0; k < NROUNDS * NPOLYS && job->failed < 0; k++) {
+	i = (job->first + k) % NPOLYS;
+	if (!routeone(ws, &job->routes[i]))
+	    job->failed = i;
+    }
+    Pfreeworkspace(ws);
+    return NULL;
+}
+
+static void mkroutes(route_t * routes)
+{
+    Ppolyline_t path, spline;
+    Pvector_t slopes[2];
+    int i;
+
+    slopes[0].x = slopes[0].y = slopes[1].x = slopes[1].y = 0;
+    for (i = 0; i < NPOLYS; i++) {
+	mkroute(&routes[i], 77u + i);
+	cr_assert_eq(Pshortestpath(&routes[i].poly, routes[i].eps, &path), 0);
+	routes[i].path = copyline(path);
+	routes[i].rv = Proutespline(routes[i].barriers, routes[i].poly.pn,
+				    path, slopes, &spline);
+	routes[i].spline.ps = NULL;
+	if (routes[i].rv == 0)
+	    routes[i].spline = copyline(spline);
+    }
+}
+
+static void freeroutes(route_t * routes)
+{
+    int i;
+
+    for (i = 0; i < NPOLYS; i++) {
+	free(routes[i].poly.ps);
+	free(routes[i].barriers);
+	free(routes[i].path.ps);
+	free(routes[i].spline.ps);
+    }
+}
+
+Test(pathplan_workspace, concurrent_routes_match_serial)
+{
+    route_t routes[NPOLYS];
+    job_t jobs[NTHREADS];
+    pthread_t tids[NTHREADS];
+    int i;
+
+    mkroutes(routes);
+    for (i = 0; i < NTHREADS; i++) {
+	jobs[i].routes = routes;
+	jobs[i].first = i * NPOLYS / NTHREADS;
+	cr_assert_eq(pthread_create(&tids[i], NULL, runjob, &jobs[i]), 0);
+    }
+    for (i = 0; i < NTHREADS; i++)
+	pthread_join(tids[i], NULL);
+    for (i = 0; i < NTHREADS; i++)
+	cr_assert_eq(jobs[i].failed, -1, "thread %d: route %d differs", i,
+		     jobs[i].failed);
+    freeroutes(routes);
+}
+
+Test(pathplan_workspace, reuse_does_not_reallocate)
+{
+    route_t routes[NPOLYS];
+    Pworkspace_t *ws = Pnewworkspace();
+    Ppolyline_t path, spline, line;
+    Ppoint_t *pathps, *splineps, *lineps;
+    Pvector_t slopes[2];
+    int i, r;
+
+    mkroutes(routes);
+    slopes[0].x = slopes[0].y = slopes[1].x = slopes[1].y = 0;
+    pathps = splineps = lineps = NULL;
+    for (r = 0; r < 2; r++) {
+	for (i = 0; i < NPOLYS; i++) {
+	    cr_assert(routeone(ws, &routes[i]), "route %d differs", i);
+	    make_polyline_w(ws, routes[i].path, &line);
+	}
+	/* Once every route has been seen, the buffers are large enough */
+	cr_assert_eq(Pshortestpath_w(ws, &routes[0].poly, routes[0].eps,
+				     &path), 0);
+	spline.ps = NULL;
+	cr_assert_eq(Proutespline_w(ws, routes[0].barriers, NVERTS, path,
+				    slopes, &spline), routes[0].rv);
+	make_polyline_w(ws, routes[0].path, &line);
+	if (r == 0) {
+	    pathps = path.ps;
+	    splineps = spline.ps;
+	    lineps = line.ps;
+	} else {
+	    cr_assert_eq(path.ps, pathps);
+	    cr_assert_eq(spline.ps, splineps);
+	    cr_assert_eq(line.ps, lineps);
+	}
+    }
+    Pfreeworkspace(ws);
+    freeroutes(routes);
+}
@@ -0,0 +1,175 @@
+#include <criterion/criterion.h>
+
+#include <math.h>
+
+#include "config.h"
+#include "general.h"
+#include "QuadTree.h"
+
+#define NPOINTS 600
+#define MAXLEVEL 10
+
+/* points: clustered, with some repeated, so that leaves at the last
+ * level hold more than one item
+ */
+static void points(int dim, int n, real *x, real *w)
+{
+    unsigned long s = 12345;
+    int i, k;
+
+    for (i = 0; i < n; i++) {
+	for (k = 0; k < dim; k++) {
+	    s = s * 1103515245 + 12345;
+	    x[i * dim + k] = ((s >> 8) % 100000) / 1000.0;
+	    if (i % 3 == 0)
+		x[i * dim + k] /= 50;
+	}
+	w[i] = 1 + i % 4;
+    }
+    for (i = 0; i < n; i += 37)
+	for (k = 0; k < dim; k++)
+	    x[(i + 1) * dim + k] = x[i * dim + k];
+}
+
+/* repulsive forces from the pointer tree and the linear tree */
+static void forces(int dim, int n, real p, int weighted)
+{
+    real *x = MALLOC(sizeof(real) * n * dim);
+    real *w = MALLOC(sizeof(real) * n);
+    real *f0 = MALLOC(sizeof(real) * n * dim);
+    real *f1 = MALLOC(sizeof(real) * n * dim);
+    real c0[4], c1[4], bh = 0.6, KP = pow(1.5, 1 - p), scale = 0;
+    real *weight = NULL;
+    QuadTree qt;
+    LinearQuadTree lqt;
+    int flag, i, nthreads;
+
+    points(dim, n, x, w);
+    if (weighted)
+	weight = w;
+
+    qt = QuadTree_new_from_point_list(dim, n, MAXLEVEL, x, weight);
+    lqt = LinearQuadTree_new_from_point_list(dim, n, MAXLEVEL, x, weight);
+    cr_assert_not_null(qt);
+    cr_assert_not_null(lqt);
+
+    QuadTree_get_repulsive_force(qt, f0, x, bh, p, KP, c0, &flag);
+    cr_assert_eq(flag, 0);
+    for (i = 0; i < n * dim; i++)
+	scale = MAX(scale, fabs(f0[i]));
+    cr_assert(scale > 0);
+
+    /* the same forces, to the last bit */
+    LinearQuadTree_get_repulsive_force(lqt, f1, x, bh, p, KP, c1, &flag);
+    cr_assert_eq(flag, 0);
+    for (i = 0; i < n * dim; i++)
+	cr_assert_eq(f0[i], f1[i]);
+    for (i = 0; i < 4; i++)
+	cr_assert_eq(c0[i], c1[i]);
+
+    /* in parallel, the sums are taken in another order */
+    for (nthreads = 2; nthreads <= 5; nthreads += 3) {
+	LinearQuadTree_get_repulsive_force_parallel(lqt, f1, x, bh, p, KP,
+						    c1, &flag, nthreads);
+	cr_assert_eq(flag, 0);
+	for (i = 0; i < n * dim; i++)
+	    cr_assert_float_eq(f0[i], f1[i], 1e-10 * scale);
+	for (i = 0; i < 4; i++)
+	    cr_assert_float_eq(c0[i], c1[i], 1e-10 * c0[i]);
+    }
+
+    QuadTree_delete(qt);
+    LinearQuadTree_delete(lqt);
+    FREE(x);
+    FREE(w);
+    FREE(f0);
+    FREE(f1);
+}
+
+Test(sparse_quadtree, forces_2d)
+{
+    forces(2, NPOINTS, -1, 0);
+    forces(2, NPOINTS, -1, 1);
+    forces(2, NPOINTS, -2, 0);
+}
+
+Test(sparse_quadtree, forces_3d)
+{
+    forces(3, NPOINTS, -1, 0);
+    forces(3, 5, -1, 1);
+}
+
+Test(sparse_quadtree, supernodes)
+{
+    int dim = 2, n = NPOINTS;
+    real *x = MALLOC(sizeof(real) * n * dim);
+    real *w = MALLOC(sizeof(real) * n);
+    real *center0 = NULL, *wgts0 = NULL, *dist0 = NULL;
+    real *center1 = NULL, *wgts1 = NULL, *dist1 = NULL;
+    real counts0, counts1;
+    int nsuper0, nsuper1, nsupermax0, nsupermax1, flag, i, j;
+    QuadTree qt;
+    LinearQuadTree lqt;
+
+    points(dim, n, x, w);
+    qt = QuadTree_new_from_point_list(dim, n, MAXLEVEL, x, w);
+    lqt = LinearQuadTree_new_from_point_list(dim, n, MAXLEVEL, x, w);
+
+    for (i = 0; i < n; i++) {
+	QuadTree_get_supernodes(qt, 0.6, &x[i * dim], i, &nsuper0,
+				&nsupermax0, &center0, &wgts0, &dist0,
+				&counts0, &flag);
+	LinearQuadTree_get_supernodes(lqt, 0.6, &x[i * dim], i, &nsuper1,
+				      &nsupermax1, &center1, &wgts1,
+				      &dist1, &counts1, &flag);
+	cr_assert_eq(nsuper0, nsuper1);
+	cr_assert_eq(counts0, counts1);
+	for (j = 0; j < nsuper0; j++) {
+	    cr_assert_eq(wgts0[j], wgts1[j]);
+	    cr_assert_eq(dist0[j], dist1[j]);
+	    cr_assert_eq(center0[j * dim], center1[j * dim]);
+	    cr_assert_eq(center0[j * dim + 1], center1[j * dim + 1]);
+	}
+    }
+
+    QuadTree_delete(qt);
+    LinearQuadTree_delete(lqt);
+    FREE(center0);
+    FREE(wgts0);
+    FREE(dist0);
+    FREE(center1);
+    FREE(wgts1);
+    FREE(dist1);
+    FREE(x);
+    FREE(w);
+}
+
+Test(sparse_quadtree, empty)
+{
+    real x[2] = { 0, 0 }, f[2] = { 1, 1 }, counts[4], c;
+    real *center = NULL, *wgts = NULL, *dist = NULL;
+    int nsuper = -1, nsupermax, flag = -1;
+    LinearQuadTree lqt = LinearQuadTree_new_from_point_list(2, 0, MAXLEVEL,
+							    x, NULL);
+
+    cr_assert_not_null(lqt);
+    cr_assert_eq(lqt->ncells, 0);
+    LinearQuadTree_get_repulsive_force(lqt, f, x, 0.6, -1, 1, counts,
+				       &flag);
+    cr_assert_eq(flag, 0);
+    cr_assert_eq(counts[0], 0);
+    LinearQuadTree_get_repulsive_force_parallel(lqt, f, x, 0.6, -1, 1,
+						counts, &flag, 4);
+    cr_assert_eq(flag, 0);
+    LinearQuadTree_get_supernodes(lqt, 0.6, x, 0, &nsuper, &nsupermax,
+				  &center, &wgts, &dist, &c, &flag);
+    cr_assert_eq(nsuper, 0);
+    cr_assert_eq(flag, 0);
+    /* the forces of no items were not touched */
+    cr_assert_eq(f[0], 1);
+
+    LinearQuadTree_delete(lqt);
+    FREE(center);
+    FREE(wgts);
+    FREE(dist);
+}